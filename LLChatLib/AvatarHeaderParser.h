@@ -0,0 +1,116 @@
+/**
+ * \brief Reads the root element of avatar_lad.xml without parsing the rest
+ *
+ * Copyright (c) 2009-2010 by R. Douglas Barbieri
+ *
+ * The source code in this file ("Source Code") is provided by R. Douglas Barbieri
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL").  Terms of the GPL can be found in doc/GPL-license.txt in this distribution.
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL SOURCE CODE IN THIS DISTRIBUTION IS PROVIDED "AS IS." THE AUTHOR MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ */
+
+#ifndef __AVATARHEADERPARSER_H__
+#define __AVATARHEADERPARSER_H__
+
+// llvfs
+//
+#include "llfile.h"
+
+// llxml
+//
+#include "llxmlparser.h"
+
+// stdc++
+//
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+
+namespace LLC
+{
+
+/// Reads only the <linden_avatar> root element of avatar_lad.xml, which is
+/// all that startup needs. The rest of the file is parsed by the appearance
+/// code (LLVOAvatar::initClass) the first time an avatar is created, so a
+/// client that never deals with appearance never parses it.
+///
+class AvatarHeaderParser
+	: public LLXmlParser
+{
+public:
+	AvatarHeaderParser()
+		: m_done(false)
+		, m_wearableDefVersion(1)
+	{}
+
+	bool ParseHeader( const std::string& path )
+	{
+		LLFILE* fp = LLFile::fopen( path, "rb" );
+		if( !fp )
+		{
+			return false;
+		}
+		//
+		char buffer[4096];
+		bool ok = true;
+		while( ok && !m_done )
+		{
+			const size_t len = fread( buffer, 1, sizeof(buffer), fp );
+			const bool   end = len < sizeof(buffer);
+			ok = parse( buffer, (int) len, end ) != 0;
+			if( end )
+			{
+				break;
+			}
+		}
+		fclose( fp );
+		return ok && m_done;
+	}
+
+	const std::string&	GetName() const					{ return m_name; }
+	const std::string&	GetVersion() const				{ return m_version; }
+	S32					GetWearableDefVersion() const	{ return m_wearableDefVersion; }
+
+protected:
+	virtual void startElement( const char* name, const char** atts )
+	{
+		if( m_done )
+		{
+			return;
+		}
+		m_done = true;
+		m_name = name;
+		for( ; atts[0]; atts += 2 )
+		{
+			if( !strcmp( atts[0], "version" ) )
+			{
+				m_version = atts[1];
+			}
+			else if( !strcmp( atts[0], "wearable_definition_version" ) )
+			{
+				m_wearableDefVersion = atoi( atts[1] );
+			}
+		}
+	}
+
+private:
+	bool		m_done;
+	std::string	m_name;
+	std::string	m_version;
+	S32			m_wearableDefVersion;
+};
+
+}
+// namespace LLC
+
+#endif // __AVATARHEADERPARSER_H__
+
+// vim: ts=4 sw=4 noexpandtab syntax=cpp.doxygen
@@ -18,6 +18,7 @@
 
 #include "ChatterBox.h"
 #include "ManagerImpl.h"
+#include "Log.h"
 
 
 
@@ -36,7 +37,7 @@ void LLViewerChatterBoxSessionStartReply::post(ResponsePtr response,
 				  const LLSD& context,
 				  const LLSD& input) const
 {
-	std::cout << "LLViewerChatterBoxSessionStartReply::post()" << std::endl;
+	LLC_DEBUGS(CHATTERBOX) << "Session start reply for " << input["body"]["session_id"].asUUID() << LLC_ENDL;
 }
 
 
@@ -56,7 +57,7 @@ void LLViewerChatterBoxSessionEventReply::post(ResponsePtr response,
 				  const LLSD& context,
 				  const LLSD& input) const
 {
-	std::cout << "LLViewerChatterBoxSessionEventReply::post()" << std::endl;
+	LLC_DEBUGS(CHATTERBOX) << "Session event reply for " << input["body"]["session_id"].asUUID() << LLC_ENDL;
 }
 
 
@@ -67,7 +68,7 @@ void LLViewerForceCloseChatterBoxSession::post(ResponsePtr response,
 				  const LLSD& context,
 				  const LLSD& input) const
 {
-	std::cout << "LLViewerForceCloseChatterBoxSession::post()" << std::endl;
+	LLC_INFOS(CHATTERBOX) << "Session " << input["body"]["session_id"].asUUID() << " closed by the server" << LLC_ENDL;
 }
 
 
@@ -81,8 +82,6 @@ void LLViewerChatterBoxSessionAgentListUpdates::post(
 {
 	boost::shared_ptr<LLC::ManagerImpl> mgr = LLC::ManagerImpl::GetInstance();
 	//
-	std::cout << "LLViewerChatterBoxSessionAgentListUpdates::post()" << std::endl;
-	//
 	LLSD body = input["body"];
 	//
 	LLUUID sessionId = body["session_id"].asUUID();
@@ -90,17 +89,10 @@ void LLViewerChatterBoxSessionAgentListUpdates::post(
 	LLSD::map_const_iterator iter;
 	LLSD::map_const_iterator end;
 	//
-	iter = body.beginMap();
-	end  = body.endMap();
-	std::cout << "body: " << std::endl;
-	for( ; iter != end; ++iter )
-	{
-		std::cout
-			<< "name=" << iter->first.c_str()
-			<< ", type="
-			<< iter->second.type()
-			<< std::endl;
-	}
+	// Collected, so the whole update reaches the GUI as one signal
+	//
+	LLC::IdListImpl::LLUUIDList entered;
+	LLC::IdListImpl::LLUUIDList left;
 	//
 	if( body.has("agent_updates") && body["agent_updates"].isMap() )
 	{
@@ -110,50 +102,23 @@ void LLViewerChatterBoxSessionAgentListUpdates::post(
 		{
 			LLUUID	agent_id( iter->first );
 			LLSD 	agent_data( iter->second );
-			std::cout << "\tagent_id: " << agent_id.asString().c_str() << std::endl;
 			//
 			if( agent_data.isMap() && agent_data.has("transition") )
 			{
-				{
-					LLSD::map_const_iterator iter = agent_data.beginMap();
-					LLSD::map_const_iterator end  = agent_data.endMap();
-					std::cout << "\t\tagent_updates: " << std::endl;
-					for( ; iter != end; ++iter )
-					{
-						std::cout
-							<< "\t\t\tname=" << iter->first.c_str()
-							<< ", type="
-							<< iter->second.type()
-							<< std::endl;
-					}
-				}
-				{
-					LLSD::map_const_iterator iter = agent_data["info"].beginMap();
-					LLSD::map_const_iterator end  = agent_data["info"].endMap();
-					std::cout << "\t\tagent_updates|info: " << std::endl;
-					for( ; iter != end; ++iter )
-					{
-						std::cout
-							<< "\t\t\tname=" << iter->first.c_str()
-							<< ", type="
-							<< iter->second.type()
-							<< std::endl;
-					}
-				}
+				const std::string transition = agent_data["transition"].asString();
+				LLC_DEBUGS(CHATTERBOX) << sessionId << ": " << agent_id << " " << transition << LLC_ENDL;
 				//
-				if( agent_data["transition"].asString() == "LEAVE" )
+				if( transition == "LEAVE" )
 				{
-					std::cout << "\t\tLEAVE" << std::endl;
 					// left the chat
 					//
-					mgr->SendGroupChatAgentUpdateSignal( sessionId.getString(), agent_id.getString(), false );
+					left.push_back( agent_id );
 				}
-				else if( agent_data["transition"].asString() == "ENTER" )
+				else if( transition == "ENTER" )
 				{
-					std::cout << "\t\tENTER" << std::endl;
 					// joining the chat
 					//
-					mgr->SendGroupChatAgentUpdateSignal( sessionId.getString(), agent_id.getString(), true );
+					entered.push_back( agent_id );
 				}
 			}
 		}
@@ -171,16 +136,19 @@ void LLViewerChatterBoxSessionAgentListUpdates::post(
 			{
 				// left the chat
 				//
-				mgr->SendGroupChatAgentUpdateSignal( sessionId.getString(), agent_id.getString(), false );
+				left.push_back( agent_id );
 			}
 			else if( agent_transition == "ENTER" )
 			{
 				// joining the chat
 				//
-				mgr->SendGroupChatAgentUpdateSignal( sessionId.getString(), agent_id.getString(), true );
+				entered.push_back( agent_id );
 			}
 		}
 	}
+	//
+	LLC_DEBUGS(CHATTERBOX) << sessionId << ": " << entered.size() << " entered, " << left.size() << " left" << LLC_ENDL;
+	mgr->SendRosterDeltaSignal( sessionId, entered, left );
 }
 
 
@@ -192,7 +160,7 @@ void LLViewerChatterBoxSessionUpdate::post(
 	const LLSD& context,
 	const LLSD& input) const
 {
-	std::cout << "LLViewerChatterBoxSessionUpdate::post()" << std::endl;
+	LLC_DEBUGS(CHATTERBOX) << "Session update for " << input["body"]["session_id"].asUUID() << LLC_ENDL;
 }
 
 
@@ -202,19 +170,18 @@ void LLViewerChatterBoxSessionUpdate::post(
 LLViewerChatterBoxInvitationAcceptResponder::LLViewerChatterBoxInvitationAcceptResponder( const LLUUID& session_id )
 {
 	mSessionID = session_id;
-	std::cout << "LLViewerChatterBoxInvitationAcceptResponder()" << std::endl;
 }
 
 void LLViewerChatterBoxInvitationAcceptResponder::result(const LLSD& content)
 {
 	// TODO
-	std::cout << "LLViewerChatterBoxInvitationAcceptResponder::result()" << std::endl;
+	LLC_DEBUGS(CHATTERBOX) << "Invitation to " << mSessionID << " accepted" << LLC_ENDL;
 }
 
 void LLViewerChatterBoxInvitationAcceptResponder::error(U32 statusNum, const std::string& reason)
 {		
 	// TODO
-	std::cout << "LLViewerChatterBoxInvitationAcceptResponder::error()" << std::endl;
+	LLC_WARNS(CHATTERBOX) << "Accepting invitation to " << mSessionID << " failed: " << statusNum << " " << reason << LLC_ENDL;
 }
 
 
@@ -226,8 +193,6 @@ void LLViewerChatterBoxInvitation::post(
 	const LLSD& context,
 	const LLSD& input) const
 {
-	std::cout << "LLViewerChatterBoxInvitation()" << std::endl;
-
 	//for backwards compatiblity reasons...we need to still
 	//check for 'text' or 'voice' invitations...bleh
 	if ( input["body"].has("instantmessage") )
@@ -1,15 +1,23 @@
 #include "GoogleTranslate.h"
-#include "ManagerImpl.h"
+
+// stdc++
+//
+#include <iostream>
 
 // llcommon
 //
 #include "llsdserialize.h"
+#include "lluri.h"
 
 // llmessage
 //
 #include "llbufferstream.h"
 
 
+#define GOOGLE_XLATE_CONFIDENCE_CODE 0.15f
+#define GOOGLE_XLATE_MAX_BATCH		8		// q= parameters per translate request
+
+
 namespace LLC
 {
 
@@ -18,12 +26,6 @@ const char* GoogleResponderBase::m_translateUrl	= "http://ajax.googleapis.com/aj
 const char* GoogleResponderBase::m_apiKey		= "ABQIAAAAGUEOxhujjY-VWquFTRbTWBQSeCpE_9msdrqpT5NdIC7cv9X-JhQWcGFoVQ9jJILbnHYfRy0uoeevbw";
 
 
-GoogleResponderBase::GoogleResponderBase( const LLSD& params )
-	: m_params(params)
-{
-}
-
-
 void GoogleResponderBase::completedRaw(
 	U32 status,
 	const std::string& reason,
@@ -33,6 +35,16 @@ void GoogleResponderBase::completedRaw(
 	LLSD content;
 	LLBufferStream istr( channels, buffer.get() );
 	LLSDSerialize::fromJSON( content, istr );
+
+	// Google reports its own errors inside a 200 reply
+	//
+	if( isGoodStatus( status ) && content.has("responseStatus")
+		&& (content["responseStatus"].asInteger() != 200) )
+	{
+		status = content["responseStatus"].asInteger();
+		completed( status, content["responseDetails"].asString(), content );
+		return;
+	}
 	completed( status, reason, content );
 }
 
@@ -48,13 +60,7 @@ void GoogleDetectResponder::result( const LLSD& content )
 			<< ", confidence=" << confidence
 			<< std::endl;
 
-	// Add message and language results
-	//
-	LLSD params = m_params;
-	params["language"]   = language;
-	params["isReliable"] = isReliable;
-	params["confidence"] = confidence;
-	m_arrivalSignal( params );
+	m_callback( true, language, isReliable && (confidence > GOOGLE_XLATE_CONFIDENCE_CODE) );
 }
 
 
@@ -62,31 +68,42 @@ void GoogleDetectResponder::error( U32 statusNum, const std::string& reason )
 {		
 	std::cout << "GoogleDetectResponder::error(): " << reason.c_str() << std::endl;
 	//
-	// TODO: Emit failure signal
-	//
+	m_callback( false, std::string(), false );
 }
 
 
 void GoogleTranslateResponder::result( const LLSD& content )
 {
-	LLSD params = m_params;
+	// One q= gets a single responseData; several get an array of replies,
+	// each with its own status.
 	//
-	std::string translatedText	= content["responseData"]["translatedText"]			.asString();
-	std::string	detected_lang	= content["responseData"]["detectedSourceLanguage"]	.asString();
-	std::string language		= LLC::ManagerImpl::GetInstance()->GetAgentLanguage( params["from_id"].asUUID() );
-	std::cout
-			<< "Response from Google: translatedText=" << translatedText.c_str()
-			<< ", detected_language=" << detected_lang.c_str()
-			<< ", language=" << language.c_str()
-			<< std::endl;
-
-	// Add message and language results
-	//
-	params["message"]			= translatedText;
-	params["detected_language"]	= detected_lang;
-	params["language"]			= language;
+	TranslationBackend::TextList translated;
+	const LLSD& data = content["responseData"];
+	if( data.isArray() )
+	{
+		LLSD::array_const_iterator			iter = data.beginArray();
+		const LLSD::array_const_iterator	end  = data.endArray();
+		for( ; iter != end; ++iter )
+		{
+			if( (*iter)["responseStatus"].asInteger() != 200 )
+			{
+				break;
+			}
+			translated.push_back( (*iter)["responseData"]["translatedText"].asString() );
+		}
+	}
+	else
+	{
+		translated.push_back( data["translatedText"].asString() );
+	}
+
+	if( translated.size() != m_count )
+	{
+		std::cout << "GoogleTranslateResponder::result(): got " << translated.size()
+				<< " translations for " << m_count << " lines" << std::endl;
+	}
 	//
-	m_arrivalSignal( params );
+	m_callback( translated.size() == m_count, translated );
 }
 
 
@@ -94,8 +111,64 @@ void GoogleTranslateResponder::error( U32 statusNum, const std::string& reason )
 {		
 	std::cout << "GoogleTranslateResponder::error(): " << reason.c_str() << std::endl;
 	//
-	// TODO: Emit failure signal
+	m_callback( false, TranslationBackend::TextList() );
+}
+
+
+GoogleTranslateBackend::GoogleTranslateBackend	( const std::string& detect_url
+												, const std::string& translate_url
+												, const std::string& api_key
+												)
+	: m_detectUrl(detect_url)
+	, m_translateUrl(translate_url)
+	, m_apiKey(api_key)
+{
+}
+
+
+void GoogleTranslateBackend::Detect( const std::string& text, const DetectCallback& callback )
+{
+	LLSD query;
+	query["key"]		= m_apiKey;
+	query["q"]			= text;
+	query["v"]			= "1.0";
+	//
+	LLHTTPClient::get( m_detectUrl, query, new GoogleDetectResponder( callback ) );
+}
+
+
+void GoogleTranslateBackend::Translate	( const std::string& source_lang
+										, const std::string& target_lang
+										, const TextList& texts
+										, const TranslateCallback& callback
+										)
+{
+	// The LLSD query map can't repeat a key, so the q= list is added by hand
+	//
+	static const std::string unreserved =
+		"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-._~";
+
+	LLSD query;
+	query["key"]		= m_apiKey;
+	query["langpair"]	= source_lang + "|" + target_lang;
+	query["v"]			= "1.0";
+	//
+	std::string url = m_translateUrl + LLURI::mapToQueryString( query );
+	TextList::const_iterator		iter = texts.begin();
+	const TextList::const_iterator	end  = texts.end();
+	for( ; iter != end; ++iter )
+	{
+		url += "&q=";
+		url += LLURI::escape( *iter, unreserved, true );
+	}
 	//
+	LLHTTPClient::get( url, new GoogleTranslateResponder( texts.size(), callback ) );
+}
+
+
+size_t GoogleTranslateBackend::GetMaxBatch() const
+{
+	return GOOGLE_XLATE_MAX_BATCH;
 }
 
 
@@ -5,14 +5,9 @@
 //
 #include <string>
 
-// boost
-//
-#include <boost/signals.hpp>
-
 // llcommon
 //
 #include "llsd.h"
-#include "lluuid.h"
 
 // llmessage
 //
@@ -20,6 +15,10 @@
 #include "llhttpclient.h"
 #include "lliopipe.h"
 
+// Local project
+//
+#include "TranslationPipeline.h"
+
 
 namespace LLC
 {
@@ -29,7 +28,6 @@ class GoogleResponderBase
 	: public LLHTTPClient::Responder
 {
 public:
-	GoogleResponderBase( const LLSD& params );
 	virtual ~GoogleResponderBase() {}
 
 	// LLHTTPClient::Responder
@@ -40,18 +38,10 @@ public:
 		const LLChannelDescriptors& channels,
 		const LLIOPipe::buffer_ptr_t& buffer);
 
-	typedef boost::signal<void (LLSD)> ArrivalSignal;
-	boost::signals::connection ConnectArrivalSignal( const ArrivalSignal::slot_type& slot )
-		{ return m_arrivalSignal.connect( slot ); }
-
 	static const char* GetApiKey()			{ return m_apiKey; }
 	static const char* GetDetectUrl()		{ return m_detectUrl; }
 	static const char* GetTranslateUrl()	{ return m_translateUrl; }
 
-protected:
-	LLSD			m_params;			// Load these up to what your subclass will see
-	ArrivalSignal	m_arrivalSignal;
-
 private:
 	static const char*	m_translateUrl;
 	static const char*	m_detectUrl;
@@ -63,10 +53,13 @@ class GoogleDetectResponder
 	: public GoogleResponderBase
 {
 public:
-	GoogleDetectResponder( const LLSD& params ) : GoogleResponderBase( params ) {}
+	GoogleDetectResponder( const TranslationBackend::DetectCallback& callback ) : m_callback(callback) {}
 
 	virtual void result(const LLSD& content);
 	virtual void error( U32 statusNum, const std::string& reason );
+
+private:
+	TranslationBackend::DetectCallback	m_callback;
 };
 
 
@@ -74,10 +67,42 @@ class GoogleTranslateResponder
 	: public GoogleResponderBase
 {
 public:
-	GoogleTranslateResponder( const LLSD& params ) : GoogleResponderBase( params ) {}
+	GoogleTranslateResponder( const size_t count, const TranslationBackend::TranslateCallback& callback )
+		: m_count(count), m_callback(callback) {}
 
 	virtual void result(const LLSD& content);
 	virtual void error( U32 statusNum, const std::string& reason );
+
+private:
+	size_t								m_count;
+	TranslationBackend::TranslateCallback	m_callback;
+};
+
+
+/// Google AJAX language API. The URLs default to Google's, but can point at
+/// any service that answers the same way.
+///
+class GoogleTranslateBackend
+	: public TranslationBackend
+{
+public:
+	GoogleTranslateBackend	( const std::string& detect_url		= GoogleResponderBase::GetDetectUrl()
+							, const std::string& translate_url	= GoogleResponderBase::GetTranslateUrl()
+							, const std::string& api_key		= GoogleResponderBase::GetApiKey()
+							);
+
+	virtual void	Detect( const std::string& text, const DetectCallback& callback );
+	virtual void	Translate	( const std::string& source_lang
+								, const std::string& target_lang
+								, const TextList& texts
+								, const TranslateCallback& callback
+								);
+	virtual size_t	GetMaxBatch() const;
+
+private:
+	std::string	m_detectUrl;
+	std::string	m_translateUrl;
+	std::string	m_apiKey;
 };
 
 
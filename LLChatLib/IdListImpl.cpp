@@ -0,0 +1,110 @@
+/**
+ * \brief Implements the IdList methods.
+ *
+ * Copyright (c) 2009-2010 by R. Douglas Barbieri
+ *
+ * The source code in this file ("Source Code") is provided by R. Douglas Barbieri
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL").  Terms of the GPL can be found in doc/GPL-license.txt in this distribution.
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL SOURCE CODE IN THIS DISTRIBUTION IS PROVIDED "AS IS." THE AUTHOR MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ */
+
+#include "IdListImpl.h"
+
+namespace LLC
+{
+
+namespace
+{
+	// Shared by every empty list, so a default IdList costs no allocation
+	//
+	const boost::shared_ptr<const IdListImpl>& EmptyList()
+	{
+		static const boost::shared_ptr<const IdListImpl> empty( new IdListImpl );
+		return empty;
+	}
+}
+
+/**
+ * \brief Constructor
+ *
+ * Creates an empty list.
+ */
+IdList::IdList() : m_instance( EmptyList() )
+{
+}
+
+/**
+ * \brief Constructor
+ *
+ * Wraps a list already filled by the library. Copies of the IdList share it.
+ *
+ * \param impl [in]	The filled list, which must not be changed afterwards.
+ */
+IdList::IdList( const boost::shared_ptr<const IdListImpl>& impl ) : m_instance( impl )
+{
+}
+
+/**
+ * \brief Destructor
+ *
+ * Trivial method.
+ */
+IdList::~IdList()
+{
+}
+
+/**
+ * \brief Returns the number of IDs in the list.
+ */
+int IdList::GetCount() const
+{
+	return static_cast<int>( m_instance->GetIds().size() );
+}
+
+/**
+ * \brief Returns one ID as a string.
+ *
+ * \param index [in]	Position in the list, from 0 to GetCount()-1.
+ * \return The ID in the usual 8-4-4-4-12 form.
+ */
+String IdList::GetId( const int index ) const
+{
+	char buffer[ID_STRING_SIZE];
+	GetId( index, buffer );
+	return String( buffer );
+}
+
+/**
+ * \brief Returns one ID as its raw bytes.
+ *
+ * \param index [in]	Position in the list, from 0 to GetCount()-1.
+ */
+Uuid IdList::GetUuid( const int index ) const
+{
+	return ToUuid( m_instance->GetIds()[index] );
+}
+
+/**
+ * \brief Formats one ID into a buffer supplied by the caller, without allocating.
+ *
+ * \param index [in]	Position in the list, from 0 to GetCount()-1.
+ * \param buffer [out]	At least ID_STRING_SIZE chars; receives the ID, null delimited.
+ */
+void IdList::GetId( const int index, char* buffer ) const
+{
+	m_instance->GetIds()[index].toString( buffer );
+}
+
+
+}
+//namespace LLC
+
+// vim: ts=4 sw=4 noexpandtab
@@ -0,0 +1,62 @@
+/**
+ * \brief Implements the IdListImpl class, which backs the IdList methods.
+ *
+ * Copyright (c) 2009-2010 by R. Douglas Barbieri
+ *
+ * The source code in this file ("Source Code") is provided by R. Douglas Barbieri
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL").  Terms of the GPL can be found in doc/GPL-license.txt in this distribution.
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL SOURCE CODE IN THIS DISTRIBUTION IS PROVIDED "AS IS." THE AUTHOR MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ */
+#ifndef __IDLISTIMPL_H__
+#define __IDLISTIMPL_H__
+
+#include "UuidImpl.h"
+
+#include <vector>
+
+
+namespace LLC
+{
+
+
+/**
+ * \class IdListImpl
+ *
+ * Holds the IDs behind an IdList as raw 16-byte UUIDs in one block.
+ *
+ * Like StringImpl, it keeps the STL container out of the exported interface.
+ * The list is filled once, before it is wrapped in an IdList, and never changes
+ * after that, so every copy of the IdList (one per queued signal, one per slot)
+ * shares it without locking.
+ */
+
+class LLCHATLIBEXP	IdListImpl
+{
+public:
+	typedef std::vector<LLUUID>	LLUUIDList;
+
+	IdListImpl() {}
+
+	/// Takes over the contents of ids, leaving it empty.
+	explicit IdListImpl( LLUUIDList& ids ) { m_ids.swap( ids ); }
+
+	const LLUUIDList&	GetIds() const { return m_ids; }
+
+private:
+	LLUUIDList	m_ids;
+};
+
+}
+
+#endif //__IDLISTIMPL_H__
+
+
+// vim: ts=4 sw=4 noexpandtab syntax=cpp.doxygen
@@ -25,6 +25,10 @@
 #include "ManagerImpl.h"
 #include "llworld.h"
 
+// boost
+//
+#include <boost/bind.hpp>
+
 // llxml
 //
 #include "llcontrol.h"
@@ -36,6 +40,19 @@
 namespace LLC
 {
 
+namespace
+{
+	// String copies share their buffer, so anything queued for the network
+	// thread gets a copy of its own
+	//
+	String Detach( const String& str )
+	{
+		return String( str.GetString() );
+	}
+}
+// namespace
+
+
 /** \mainpage LLChatLib Developer Documentation
  *
  * \section Authentication
@@ -48,7 +65,7 @@ namespace LLC
  * a successful auth. Exceptions can also be thrown to indicate the errors.
  *
  * Next, you then request a list of friends via RequestBuddyList(), followed by AnnounceInSim(), which
- * causes you to appear "online."
+ * causes you to appear "online." The whole list arrives in one FriendsAddedSignal.
  *
  * \section Friendship
  *
@@ -70,6 +87,22 @@ namespace LLC
  * \li LLC::Manager::GetFriendDeclineSignal()
  * \li LLC::Manager::GetMessageBoxSignal()
  *
+ * \section Typed Typed calls
+ *
+ * Hot paths can avoid LLC::String altogether. IDs go in and out as LLC::Uuid, message text goes in as an
+ * LLC::StringRef, and names are copied into a buffer you supply (GetFullName( const Uuid&, char*, int )).
+ * ConnectChatEventSignal() delivers IMs, group chat and local chat as one LLC::Manager::ChatEvent whose
+ * strings are only valid during the call; copy whatever you keep. The String signals are only built
+ * if something is connected to them.
+ *
+ * \section Logging
+ *
+ * Declare any of these string settings before calling StartMessagingSystem() to configure the library's log:
+ *
+ * \li "LLChatLibLogLevels", for example "ChatterBox=debug,Names=warn" or "*=debug". The default is info.
+ * \li "LLChatLibLogFile", the file to append to; empty for stdout. Declaring it starts the writer thread.
+ * \li "LLChatLibLogFormat", one of "text", "jsonl" or "binary".
+ *
  * \sa LLC::Manager
  */
 
@@ -104,6 +137,7 @@ Manager::~Manager()
  */
 void Manager::StartMessagingSystem( const char* appname, const char* user_settings )
 {
+	NetworkThread::LibraryLock lock;
 	m_instance->StartMessagingSystem(appname, user_settings);
 }
 
@@ -120,6 +154,7 @@ void Manager::Shutdown()
  */
 void Manager::DeclareString( const String& name, const String& value, const String& description )
 {
+	NetworkThread::LibraryLock lock;
 	gSavedSettings.declareString( name.GetString(), value.GetString(), description.GetString() );
 }
 
@@ -128,6 +163,7 @@ void Manager::DeclareString( const String& name, const String& value, const Stri
  */
 void Manager::DeclareBool( const String& name, const bool value, const String& description )
 {
+	NetworkThread::LibraryLock lock;
 	gSavedSettings.declareBOOL( name.GetString(), value? 1: 0, description.GetString() );
 }
 
@@ -136,6 +172,7 @@ void Manager::DeclareBool( const String& name, const bool value, const String& d
  */
 void Manager::DeclareInt( const String& name, const int value, const String& description )
 {
+	NetworkThread::LibraryLock lock;
 	gSavedSettings.declareS32( name.GetString(), value, description.GetString() );
 }
 
@@ -144,6 +181,7 @@ void Manager::DeclareInt( const String& name, const int value, const String& des
  */
 void Manager::DeclareUInt( const String& name, const unsigned int value, const String& description )
 {
+	NetworkThread::LibraryLock lock;
 	gSavedSettings.declareU32( name.GetString(), value, description.GetString() );
 }
 
@@ -151,6 +189,7 @@ void Manager::DeclareUInt( const String& name, const unsigned int value, const S
  */
 void Manager::DeclareRect( const String& name, const Rect& value, const String& description )
 {
+	NetworkThread::LibraryLock lock;
 	LLRect llrect( value.m_left, value.m_top, value.m_right, value.m_bottom );
 	gSavedSettings.declareRect( name.GetString(), llrect, description.GetString() );
 }
@@ -160,6 +199,7 @@ void Manager::DeclareRect( const String& name, const Rect& value, const String&
  */
 void Manager::SetString( const String& name, const String& value )
 {
+	NetworkThread::LibraryLock lock;
 	gSavedSettings.setString( name.GetString(), value.GetString() );
 }
 
@@ -168,6 +208,7 @@ void Manager::SetString( const String& name, const String& value )
  */
 void Manager::SetBool( const String& name, const bool value )
 {
+	NetworkThread::LibraryLock lock;
 	gSavedSettings.setBOOL( name.GetString(), value? 1: 0 );
 }
 
@@ -176,6 +217,7 @@ void Manager::SetBool( const String& name, const bool value )
  */
 void Manager::SetInt( const String& name, const int value )
 {
+	NetworkThread::LibraryLock lock;
 	gSavedSettings.setS32( name.GetString(), value );
 }
 
@@ -184,6 +226,7 @@ void Manager::SetInt( const String& name, const int value )
  */
 void Manager::SetUInt( const String& name, const unsigned int value )
 {
+	NetworkThread::LibraryLock lock;
 	gSavedSettings.setU32( name.GetString(), value );
 }
 
@@ -192,6 +235,7 @@ void Manager::SetUInt( const String& name, const unsigned int value )
  */
 void Manager::SetRect( const String& name, const Rect& value )
 {
+	NetworkThread::LibraryLock lock;
 	LLRect llrect( value.m_left, value.m_top, value.m_right, value.m_bottom );
 	gSavedSettings.setRect( name.GetString(), llrect );
 }
@@ -201,6 +245,7 @@ void Manager::SetRect( const String& name, const Rect& value )
  */
 String Manager::GetString( const String& name ) const
 {
+	NetworkThread::LibraryLock lock;
 	return gSavedSettings.getString( name.GetString() ).c_str();
 }
 
@@ -209,6 +254,7 @@ String Manager::GetString( const String& name ) const
  */
 bool Manager::GetBool( const String& name ) const
 {
+	NetworkThread::LibraryLock lock;
 	return gSavedSettings.getBOOL( name.GetString() )? true: false;
 }
 
@@ -217,6 +263,7 @@ bool Manager::GetBool( const String& name ) const
  */
 int Manager::GetInt( const String& name ) const
 {
+	NetworkThread::LibraryLock lock;
 	return gSavedSettings.getS32( name.GetString() );
 }
 
@@ -225,6 +272,7 @@ int Manager::GetInt( const String& name ) const
  */
 unsigned int Manager::GetUInt( const String& name ) const
 {
+	NetworkThread::LibraryLock lock;
 	return gSavedSettings.getU32( name.GetString() );
 }
 
@@ -233,6 +281,7 @@ unsigned int Manager::GetUInt( const String& name ) const
  */
 Manager::Rect Manager::GetRect( const String& name ) const
 {
+	NetworkThread::LibraryLock lock;
 	LLRect llrect = gSavedSettings.getRect( name.GetString() );
 	return Rect( llrect.mLeft, llrect.mTop, llrect.mRight, llrect.mBottom );
 }
@@ -262,6 +311,7 @@ String Manager::GetUserSettingsPath() const
  */
 void Manager::Authenticate( const String& login_url, const String& first_name, const String& last_name, const String& munged_password, const String& starting_slurl )
 {
+	NetworkThread::LibraryLock lock;
 	m_instance->Authenticate( login_url, first_name, last_name, munged_password, starting_slurl );
 }
 
@@ -277,6 +327,7 @@ void Manager::Authenticate( const String& login_url, const String& first_name, c
  */
 bool Manager::CheckForResponse()
 {
+	NetworkThread::LibraryLock lock;
 	return m_instance->CheckForResponse();
 }
 
@@ -286,7 +337,7 @@ bool Manager::CheckForResponse()
  */
 void Manager::RequestBuddyList()
 {
-	m_instance->RequestBuddyList();
+	m_instance->RunCommand( boost::bind( &ManagerImpl::RequestBuddyList, m_instance ) );
 }
 
 
@@ -301,6 +352,7 @@ void Manager::RequestBuddyList()
  */
 void Manager::GetNameFromCache( const String& id, String& first_name, String& last_name )
 {
+	NetworkThread::LibraryLock lock;
 	LLUUID agent_id( id.GetString() );
 	std::string first,last;
 	//
@@ -323,6 +375,7 @@ void Manager::GetNameFromCache( const String& id, String& first_name, String& la
  */
 void Manager::GetNameFromCache( const String& id, String& full_name )
 {
+	NetworkThread::LibraryLock lock;
 	LLUUID agent_id( id.GetString() );
 	std::string name;
 	m_instance->GetNameFromCache( agent_id, name );
@@ -340,6 +393,7 @@ void Manager::GetNameFromCache( const String& id, String& full_name )
  */
 String Manager::GetNameFromCache( const String& id )
 {
+	NetworkThread::LibraryLock lock;
 	LLUUID agent_id( id.GetString() );
 	std::string full_name;
 	m_instance->GetNameFromCache( agent_id, full_name );
@@ -355,7 +409,39 @@ String Manager::GetNameFromCache( const String& id )
  */
 String Manager::GetFullName( const String& id )
 {
-	return m_instance->GetFullName( id );
+	NetworkThread::LibraryLock lock;
+	return String( m_instance->GetFullName( LLUUID( id.GetString() ) ).c_str() );
+}
+
+
+/** \brief Lookup full name by agent ID, into a buffer supplied by the caller.
+ *
+ * \param [in]	id		agent ID.
+ * \param [out]	buffer	receives the name, null delimited and cut short if it does not fit.
+ * \param [in]	size	size of buffer in chars.
+ * \return Length of the whole name, which may be size or more if it was cut short.
+ * \sa GetFullName( const String& )
+ */
+int Manager::GetFullName( const Uuid& id, char* buffer, const int size )
+{
+	NetworkThread::LibraryLock lock;
+	return CopyToBuffer( m_instance->GetFullName( ToLLUUID( id ) ), buffer, size );
+}
+
+
+/** \brief Lookup full name by agent ID from SL cache, into a buffer supplied by the caller.
+ *
+ * \param [in]	id		agent ID.
+ * \param [out]	buffer	receives first + " " + last, null delimited and cut short if it does not fit.
+ * \param [in]	size	size of buffer in chars.
+ * \return Length of the whole name, which may be size or more if it was cut short.
+ */
+int Manager::GetNameFromCache( const Uuid& id, char* buffer, const int size )
+{
+	NetworkThread::LibraryLock lock;
+	std::string full_name;
+	m_instance->GetNameFromCache( ToLLUUID( id ), full_name );
+	return CopyToBuffer( full_name, buffer, size );
 }
 
 
@@ -366,6 +452,7 @@ String Manager::GetFullName( const String& id )
  */
 String Manager::LookupId( const String& fullname )
 {
+	NetworkThread::LibraryLock lock;
 	return m_instance->LookupId( fullname );
 }
 
@@ -376,6 +463,7 @@ String Manager::LookupId( const String& fullname )
  */
 String Manager::LookupGroupName( const String& id )
 {
+	NetworkThread::LibraryLock lock;
 	return m_instance->LookupGroupName( id );
 }
 
@@ -385,18 +473,40 @@ String Manager::LookupGroupName( const String& id )
  */
 String Manager::GetAgentId() const
 {
+	NetworkThread::LibraryLock lock;
 	LLUUID id = m_instance->GetAgentId();
 	return String( id.asString().c_str() );
 }
 
 
+/** \brief Get currently logged in agent id.
+ */
+Uuid Manager::GetAgentUuid() const
+{
+	NetworkThread::LibraryLock lock;
+	return ToUuid( m_instance->GetAgentId() );
+}
+
+
 /** \brief Determine agent's online status.
  * \param [in]	id	Text representation of agent id.
  * \return true if found.
  */
 bool Manager::IsOnline( const String& id )
 {
-	return m_instance->IsOnline( id );
+	NetworkThread::LibraryLock lock;
+	return m_instance->IsOnline( LLUUID( id.GetString() ) );
+}
+
+
+/** \brief Determine agent's online status.
+ * \param [in]	id	agent id.
+ * \return true if found.
+ */
+bool Manager::IsOnline( const Uuid& id )
+{
+	NetworkThread::LibraryLock lock;
+	return m_instance->IsOnline( ToLLUUID( id ) );
 }
 
 
@@ -406,7 +516,19 @@ bool Manager::IsOnline( const String& id )
  */
 bool Manager::IsFriend( const String& id )
 {
-	return m_instance->IsFriend( id );
+	NetworkThread::LibraryLock lock;
+	return m_instance->IsFriend( LLUUID( id.GetString() ) );
+}
+
+
+/** \brief Check to see if id appears in our cache, if so then we have a friend.
+ * \param [in] id	Agent id to check for in cache
+ * \return true if in cache
+ */
+bool Manager::IsFriend( const Uuid& id )
+{
+	NetworkThread::LibraryLock lock;
+	return m_instance->IsFriend( ToLLUUID( id ) );
 }
 
 
@@ -416,6 +538,7 @@ bool Manager::IsFriend( const String& id )
  */
 String Manager::GetAgentLanguage( const String& agentId ) const
 {
+	NetworkThread::LibraryLock lock;
 	return m_instance->GetAgentLanguage( LLUUID(agentId.GetString()) ).c_str();
 }
 
@@ -426,6 +549,7 @@ String Manager::GetAgentLanguage( const String& agentId ) const
  */
 void Manager::SetAgentLanguage( const String& agentId, const String& language )
 {
+	NetworkThread::LibraryLock lock;
 	m_instance->SetAgentLanguage( LLUUID(agentId.GetString()), language.GetString() );
 }
 
@@ -436,6 +560,7 @@ void Manager::SetAgentLanguage( const String& agentId, const String& language )
  */
 bool Manager::GetAgentLanguageAuto( const String& agentId ) const
 {
+	NetworkThread::LibraryLock lock;
 	return m_instance->GetAgentLanguageAuto( LLUUID(agentId.GetString()) );
 }
 
@@ -446,6 +571,7 @@ bool Manager::GetAgentLanguageAuto( const String& agentId ) const
  */
 void Manager::SetAgentLanguageAuto( const String& agentId, const bool val )
 {
+	NetworkThread::LibraryLock lock;
 	m_instance->SetAgentLanguageAuto( LLUUID(agentId.GetString()), val );
 }
 
@@ -454,6 +580,7 @@ void Manager::SetAgentLanguageAuto( const String& agentId, const bool val )
  */
 int Manager::GetLocalAvatarCount() const
 {
+	NetworkThread::LibraryLock lock;
 	return m_instance->GetLocalAvatarCount();
 }
 
@@ -462,6 +589,7 @@ int Manager::GetLocalAvatarCount() const
  */
 String Manager::GetLocalAvatar( const int idx ) const
 {
+	NetworkThread::LibraryLock lock;
 	return m_instance->GetLocalAvatar( idx );
 }
 
@@ -470,15 +598,178 @@ String Manager::GetLocalAvatar( const int idx ) const
  */
 void Manager::AnnounceInSim()
 {
-	m_instance->AnnounceInSim();
+	m_instance->RunCommand( boost::bind( &ManagerImpl::AnnounceInSim, m_instance ) );
 }
 
 
 /** \brief Pump the incoming tcp/ip messages from server.
+ *
+ * With the network thread running this only fires the signals it has queued.
+ * \sa StartNetworkThread()
  */
 void Manager::PumpMessages()
 {
-	m_instance->PumpMessages();
+	if( m_instance->IsThreaded() )
+	{
+		m_instance->DispatchEvents( -1 );
+	}
+	else
+	{
+		m_instance->PumpMessages();
+	}
+}
+
+
+/** \brief Run the message system, HTTP pump and timers on a thread of their own.
+ *
+ * Call this once logged in. From then on:
+ *
+ * \li Signals are queued and fired on the calling thread by PumpMessages() or
+ *     DispatchEvents(), so slots still run where they always did.
+ * \li Send and request calls are queued for the network thread and return at once.
+ * \li GetPollFds() returns one descriptor that becomes readable when events are
+ *     waiting (none on Windows, where GetNextDeadline() asks to be polled every frame).
+ * \li Everything else waits for the network thread to finish its current pump.
+ *
+ * Only one front-end thread may call into the Manager.
+ *
+ * \sa StopNetworkThread()
+ */
+void Manager::StartNetworkThread()
+{
+	m_instance->StartNetworkThread();
+}
+
+
+/** \brief Stop the network thread and go back to pumping from the front-end.
+ *
+ * Queued commands are sent and queued events fired before this returns.
+ * Shutdown() does this for you.
+ */
+void Manager::StopNetworkThread()
+{
+	m_instance->StopNetworkThread();
+}
+
+
+/** \brief True between StartNetworkThread() and StopNetworkThread().
+ */
+bool Manager::IsNetworkThreadRunning() const
+{
+	return m_instance->IsThreaded();
+}
+
+
+/** \brief Fire signals queued by the network thread.
+ *
+ * \param [in] max_events	most to fire in one go, or -1 for all of them. Any left
+ *							over keep the event descriptor readable.
+ * \return Number of signals fired.
+ */
+int Manager::DispatchEvents( const int max_events )
+{
+	return m_instance->DispatchEvents( max_events );
+}
+
+
+/** \brief Get the descriptors the library is waiting on.
+ *
+ * Use this to hook LLChatLib into a foreign event loop (e.g. QSocketNotifier). Whenever
+ * one of the descriptors becomes ready, or GetNextDeadline() expires, call PumpMessages()
+ * and then ask again, since the set changes as HTTP connections come and go.
+ *
+ * \param [out] fds		array to fill in.
+ * \param [in]  max_fds	size of the array.
+ * \return Number of descriptors in the set. This may exceed max_fds, in which case only the first max_fds were copied.
+ * \sa GetNextDeadline(), RunUntil()
+ */
+int Manager::GetPollFds( PollFd* fds, const int max_fds ) const
+{
+	return m_instance->GetPollFds( fds, max_fds );
+}
+
+
+/** \brief Milliseconds until PumpMessages() must be called even if no descriptor is ready.
+ *
+ * \return 0 if work is already pending.
+ * \sa GetPollFds()
+ */
+int Manager::GetNextDeadline() const
+{
+	return m_instance->GetNextDeadline();
+}
+
+
+/** \brief Add a descriptor of your own to the set watched by RunUntil().
+ *
+ * \param [in] fd		descriptor to watch for readability.
+ * \param [in] callback	called from RunUntil() each time fd is readable, or from the
+ *						network thread while it is running.
+ */
+void Manager::WatchFd( const int fd, const FdCallback& callback )
+{
+	NetworkThread::LibraryLock lock;
+	m_instance->WatchFd( fd, callback );
+}
+
+
+/** \brief Stop watching a descriptor added with WatchFd().
+ */
+void Manager::UnwatchFd( const int fd )
+{
+	NetworkThread::LibraryLock lock;
+	m_instance->UnwatchFd( fd );
+}
+
+
+/** \brief Block until a descriptor is ready or the next deadline expires.
+ *
+ * \param [in] max_wait_msecs	upper bound on the wait, or -1 to wait for the next deadline.
+ * \return true if any descriptor became ready.
+ */
+bool Manager::WaitForEvents( const int max_wait_msecs )
+{
+	return m_instance->WaitForEvents( max_wait_msecs );
+}
+
+
+/** \brief Run the message pump until done() returns true.
+ *
+ * Sleeps in WaitForEvents() between pumps, so an idle connection costs next to no CPU.
+ * Callbacks registered with WatchFd() are called from here as well.
+ *
+ * \param [in] done	predicate checked before each iteration.
+ */
+void Manager::RunUntil( const DonePredicate& done )
+{
+	m_instance->RunUntil( done );
+}
+
+
+/** \brief Per-stage timings of PumpMessages(), one line per stage.
+ *
+ * Each line gives the stage budget, how often it ran, average and worst-case time,
+ * how often it went over budget or left work for the next pump, and a histogram
+ * of run times in power-of-two microsecond buckets.
+ */
+String Manager::GetPumpStats() const
+{
+	NetworkThread::LibraryLock lock;
+	return String( m_instance->GetPumpStats().c_str() );
+}
+
+
+/** \brief Change how long one stage of PumpMessages() may run before its work is
+ * carried over to the next pump.
+ *
+ * \param [in] stage	"dns", "http", "names", "udp", "acks", "translate" or "timers".
+ * \param [in] usecs	budget in microseconds; 0 runs the stage once per pump.
+ * \return false if there is no such stage.
+ */
+bool Manager::SetPumpBudget( const String& stage, const int usecs )
+{
+	NetworkThread::LibraryLock lock;
+	return m_instance->SetPumpBudget( stage.GetString(), (U64) llmax( usecs, 0 ) );
 }
 
 
@@ -486,6 +777,7 @@ void Manager::PumpMessages()
  */
 bool Manager::IsOnline()
 {
+	NetworkThread::LibraryLock lock;
 	return gMessageSystem->mCircuitInfo.findCircuit( gHost ) != 0;
 }
 
@@ -494,7 +786,7 @@ bool Manager::IsOnline()
  */
 void Manager::RequestLogout()
 {
-	m_instance->RequestLogout();
+	m_instance->RunCommand( boost::bind( &ManagerImpl::RequestLogout, m_instance ) );
 }
 
 
@@ -506,7 +798,21 @@ void Manager::RequestLogout()
  */
 void Manager::SendInstantMessage( const String& to_id, const String& message, const bool to_group )
 {
-	m_instance->SendInstantMessage( to_id, message, to_group );
+	m_instance->RunCommand( boost::bind( &ManagerImpl::SendInstantMessage, m_instance, LLUUID( to_id.GetString() ), std::string( message.GetString() ), to_group ) );
+}
+
+
+/** \brief Send instant message to target agent.
+ *
+ * The message is copied once, into the queued command, before this returns.
+ *
+ * \param [in]	to_id		agent id to send message to.
+ * \param [in]	message		text of message to send; need not be null delimited.
+ * \param [in]	to_group	true if to_id is a group, not an AV (i.e. this is part of a chat session)
+ */
+void Manager::SendInstantMessage( const Uuid& to_id, const StringRef& message, const bool to_group )
+{
+	m_instance->RunCommand( boost::bind( &ManagerImpl::SendInstantMessage, m_instance, ToLLUUID( to_id ), ToStdString( message ), to_group ) );
 }
 	
 
@@ -518,7 +824,19 @@ void Manager::SendInstantMessage( const String& to_id, const String& message, co
  */
 void Manager::SendTypingSignal( const String& target_id, const bool to_group, const bool typing )
 {
-	m_instance->SendTypingSignal( target_id, to_group, typing );
+	m_instance->RunCommand( boost::bind( &ManagerImpl::SendTypingSignal, m_instance, LLUUID( target_id.GetString() ), to_group, typing ) );
+}
+
+
+/** \brief Send typing state signal
+ * 
+ * \param [in] target_id	agent group id to send status to
+ * \param [in] to_group		true if group
+ * \param [in] typing		Started or stopped typing
+ */
+void Manager::SendTypingSignal( const Uuid& target_id, const bool to_group, const bool typing )
+{
+	m_instance->RunCommand( boost::bind( &ManagerImpl::SendTypingSignal, m_instance, ToLLUUID( target_id ), to_group, typing ) );
 }
 
 
@@ -528,7 +846,7 @@ void Manager::SendTypingSignal( const String& target_id, const bool to_group, co
  */
 void Manager::SendLocalChatMessage( const String& message, const int channel )
 {
-	m_instance->SendLocalChatMessage( message, channel );
+	m_instance->RunCommand( boost::bind( &ManagerImpl::SendLocalChatMessage, m_instance, Detach( message ), channel ) );
 }
 	
 
@@ -538,7 +856,7 @@ void Manager::SendLocalChatMessage( const String& message, const int channel )
  */
 void Manager::SendGroupChatStartRequest( const String& group_id )
 {
-	m_instance->SendGroupChatStartRequest( group_id );
+	m_instance->RunCommand( boost::bind( &ManagerImpl::SendGroupChatStartRequest, m_instance, Detach( group_id ) ) );
 }
 
 
@@ -547,7 +865,7 @@ void Manager::SendGroupChatStartRequest( const String& group_id )
  */
 void Manager::SendGroupChatLeaveRequest( const String& group_session_id )
 {
-	m_instance->SendGroupChatLeaveRequest( group_session_id );
+	m_instance->RunCommand( boost::bind( &ManagerImpl::SendGroupChatLeaveRequest, m_instance, Detach( group_session_id ) ) );
 }
 
 
@@ -559,7 +877,7 @@ void Manager::SendGroupChatLeaveRequest( const String& group_session_id )
  */
 void Manager::OfferFriendship( const String& target_id, const String& message )
 {
-	m_instance->OfferFriendship( target_id, message );
+	m_instance->RunCommand( boost::bind( &ManagerImpl::OfferFriendship, m_instance, Detach( target_id ), Detach( message ) ) );
 }
 
 
@@ -572,7 +890,7 @@ void Manager::OfferFriendship( const String& target_id, const String& message )
  */
 void Manager::AcceptFriendship( const String& sessionId, const String& senderIp )
 {
-	m_instance->AcceptFriendship( sessionId, senderIp );
+	m_instance->RunCommand( boost::bind( &ManagerImpl::AcceptFriendship, m_instance, Detach( sessionId ), Detach( senderIp ) ) );
 }
 
 
@@ -585,7 +903,7 @@ void Manager::AcceptFriendship( const String& sessionId, const String& senderIp
  */
 void Manager::DeclineFriendship( const String& sessionId, const String& senderIp )
 {
-	m_instance->DeclineFriendship( sessionId, senderIp );
+	m_instance->RunCommand( boost::bind( &ManagerImpl::DeclineFriendship, m_instance, Detach( sessionId ), Detach( senderIp ) ) );
 }
 
 
@@ -595,7 +913,7 @@ void Manager::DeclineFriendship( const String& sessionId, const String& senderIp
  */
 void Manager::TerminateFriendship( const String& agentId )
 {
-	m_instance->TerminateFriendship( agentId );
+	m_instance->RunCommand( boost::bind( &ManagerImpl::TerminateFriendship, m_instance, Detach( agentId ) ) );
 }
 	
 
@@ -607,7 +925,7 @@ void Manager::TerminateFriendship( const String& agentId )
  */
 void Manager::AcceptGroupJoinOffer( const String& group_id, const String& message, const String& sessionId )
 {
-	m_instance->AcceptGroupJoinOffer( group_id, message, sessionId );
+	m_instance->RunCommand( boost::bind( &ManagerImpl::AcceptGroupJoinOffer, m_instance, Detach( group_id ), Detach( message ), Detach( sessionId ) ) );
 }
 
 
@@ -619,7 +937,7 @@ void Manager::AcceptGroupJoinOffer( const String& group_id, const String& messag
  */
 void Manager::DeclineGroupJoinOffer( const String& group_id, const String& message, const String& sessionId )
 {
-	m_instance->DeclineGroupJoinOffer( group_id, message, sessionId );
+	m_instance->RunCommand( boost::bind( &ManagerImpl::DeclineGroupJoinOffer, m_instance, Detach( group_id ), Detach( message ), Detach( sessionId ) ) );
 }
 
 
@@ -629,7 +947,7 @@ void Manager::DeclineGroupJoinOffer( const String& group_id, const String& messa
  */
 void Manager::LeaveGroupRequest( const String& groupId )
 {
-	m_instance->LeaveGroupRequest( groupId );
+	m_instance->RunCommand( boost::bind( &ManagerImpl::LeaveGroupRequest, m_instance, Detach( groupId ) ) );
 }
 
 
@@ -639,7 +957,7 @@ void Manager::LeaveGroupRequest( const String& groupId )
  */
 void Manager::SearchPeople( const String& fullname )
 {
-	m_instance->SearchPeople( fullname );
+	m_instance->RunCommand( boost::bind( &ManagerImpl::SearchPeople, m_instance, Detach( fullname ) ) );
 }
 
 
@@ -648,6 +966,7 @@ void Manager::SearchPeople( const String& fullname )
  */
 int Manager::GetPeopleSearchCount() const
 {
+	NetworkThread::LibraryLock lock;
 	return m_instance->GetPeopleSearchCount();
 }
 
@@ -659,6 +978,7 @@ int Manager::GetPeopleSearchCount() const
  */
 String Manager::GetPerson( const int index ) const
 {
+	NetworkThread::LibraryLock lock;
 	return m_instance->GetPerson( index );
 }
 
@@ -670,6 +990,7 @@ String Manager::GetPerson( const int index ) const
  */
 void Manager::GetLM( String& region_name, int& x, int& y, int& z ) const
 {
+	NetworkThread::LibraryLock lock;
 	S32 sx, sy, sz;
 	std::string rname;
 	m_instance->GetLM( rname, sx, sy, sz );
@@ -685,6 +1006,7 @@ void Manager::GetLM( String& region_name, int& x, int& y, int& z ) const
  */
 String Manager::GetSLURL() const
 {
+	NetworkThread::LibraryLock lock;
 	return String( m_instance->GetSLURL().c_str() );
 }
 
@@ -694,7 +1016,7 @@ String Manager::GetSLURL() const
 void Manager::TeleportViaLure( const String& lureId )
 {
 	LLUUID uuid( lureId.GetString() );
-	m_instance->TeleportViaLure( uuid );
+	m_instance->RunCommand( boost::bind( &ManagerImpl::TeleportViaLure, m_instance, uuid ) );
 }
 
 
@@ -702,7 +1024,8 @@ void Manager::TeleportViaLure( const String& lureId )
  */
 void Manager::TeleportToRegion( const String& slurl )
 {
-	m_instance->TeleportToRegion( slurl.GetString() );
+	void (ManagerImpl::*teleport)( const std::string& ) = &ManagerImpl::TeleportToRegion;
+	m_instance->RunCommand( boost::bind( teleport, m_instance, std::string( slurl.GetString() ) ) );
 }
 
 
@@ -710,6 +1033,7 @@ void Manager::TeleportToRegion( const String& slurl )
  */
 String Manager::GetLanguage() const
 {
+	NetworkThread::LibraryLock lock;
 	return String( m_instance->GetLanguage().c_str() );
 }
 
@@ -718,6 +1042,7 @@ String Manager::GetLanguage() const
  */
 void Manager::SetLanguage( const String& lang_id )
 {
+	NetworkThread::LibraryLock lock;
 	m_instance->SetLanguage( lang_id.GetString() );
 }
 
@@ -726,6 +1051,7 @@ void Manager::SetLanguage( const String& lang_id )
  */
 void Manager::SetTranslateMessages( const bool val )
 {
+	NetworkThread::LibraryLock lock;
 	m_instance->SetTranslateMessages( val );
 }
 
@@ -734,20 +1060,21 @@ void Manager::SetTranslateMessages( const bool val )
  */
 void Manager::TeleportHome()
 {
-	m_instance->TeleportHome();
+	m_instance->RunCommand( boost::bind( &ManagerImpl::TeleportHome, m_instance ) );
 }
 
 
 /** \brief Signals which eminate to your client app as messages come in from the remote grid server.
  */
 
-Connection	Manager::ConnectFriendAddSignal             ( const StringSignal               ::slot_type& slot ) const { return m_instance->ConnectFriendAddSignal              ( slot ); }
+Connection	Manager::ConnectFriendsAddedSignal          ( const FriendsAddedSignal         ::slot_type& slot ) const { return m_instance->ConnectFriendsAddedSignal           ( slot ); }
 Connection	Manager::ConnectCacheSignal                 ( const CacheSignal                ::slot_type& slot ) const { return m_instance->ConnectCacheSignal                  ( slot ); }
 Connection	Manager::ConnectGroupCacheSignal            ( const GroupCacheSignal           ::slot_type& slot ) const { return m_instance->ConnectGroupCacheSignal             ( slot ); }
 Connection	Manager::ConnectImSignal                    ( const ImSignal                   ::slot_type& slot ) const { return m_instance->ConnectImSignal                     ( slot ); }
 Connection	Manager::ConnectGroupChatSignal             ( const GroupChatSignal            ::slot_type& slot ) const { return m_instance->ConnectGroupChatSignal              ( slot ); }
 Connection	Manager::ConnectLocalChatSignal             ( const LocalChatSignal            ::slot_type& slot ) const { return m_instance->ConnectLocalChatSignal              ( slot ); }
-Connection	Manager::ConnectGroupChatAgentUpdateSignal  ( const GroupChatAgentUpdateSignal ::slot_type& slot ) const { return m_instance->ConnectGroupChatAgentUpdateSignal   ( slot ); }
+Connection	Manager::ConnectChatEventSignal             ( const ChatEventSignal            ::slot_type& slot ) const { return m_instance->ConnectChatEventSignal              ( slot ); }
+Connection	Manager::ConnectRosterDeltaSignal           ( const RosterDeltaSignal          ::slot_type& slot ) const { return m_instance->ConnectRosterDeltaSignal            ( slot ); }
 Connection	Manager::ConnectTypingSignal                ( const TypingSignal               ::slot_type& slot ) const { return m_instance->ConnectTypingSignal                 ( slot ); }
 Connection	Manager::ConnectOnlineSignal                ( const OnlineSignal               ::slot_type& slot ) const { return m_instance->ConnectOnlineSignal                 ( slot ); }
 Connection	Manager::ConnectTerminateFriendshipSignal   ( const StringSignal               ::slot_type& slot ) const { return m_instance->ConnectTerminateFriendshipSignal    ( slot ); }
@@ -761,6 +1088,7 @@ Connection	Manager::ConnectLogoutReplySignal           ( const VoidSignal
 Connection	Manager::ConnectGroupOfferSignal            ( const GroupOfferSignal           ::slot_type& slot ) const { return m_instance->ConnectGroupOfferSignal             ( slot ); }
 Connection	Manager::ConnectAgentMovementCompleteSignal ( const VoidSignal                 ::slot_type& slot ) const { return m_instance->ConnectAgentMovementCompleteSignal  ( slot ); }
 Connection	Manager::ConnectLocalAgentsPresentSignal    ( const VoidSignal                 ::slot_type& slot ) const { return m_instance->ConnectLocalAgentsPresentSignal     ( slot ); }
+Connection	Manager::ConnectLocalAgentUpdateSignal      ( const LocalAgentUpdateSignal     ::slot_type& slot ) const { return m_instance->ConnectLocalAgentUpdateSignal       ( slot ); }
 Connection	Manager::ConnectTeleportRequestSignal       ( const TeleportRequestSignal      ::slot_type& slot ) const { return m_instance->ConnectTeleportRequestSignal        ( slot ); }
 Connection	Manager::ConnectTeleportRequestedSignal     ( const TeleportRequestedSignal    ::slot_type& slot ) const { return m_instance->ConnectTeleportRequestedSignal      ( slot ); }
 Connection	Manager::ConnectTeleportStartSignal         ( const TeleportStartSignal        ::slot_type& slot ) const { return m_instance->ConnectTeleportStartSignal          ( slot ); }
@@ -22,6 +22,9 @@
 
 #include <boost/smart_ptr.hpp>
 #include <boost/signals.hpp>
+#include <boost/function.hpp>
+
+#include <cstring>
 
 namespace LLC
 {
@@ -43,6 +46,69 @@ private:
 };
 
 
+/// An agent, group or session ID as its 16 raw bytes, laid out as in LLUUID.
+/// Plain data, so it is passed, compared and stored without touching the heap
+/// or parsing text.
+struct LLCHATLIBEXP Uuid
+{
+	enum { SIZE = 16, STRING_SIZE = 37 };	// STRING_SIZE includes the terminating null
+
+	unsigned char	m_data[SIZE];
+
+	bool		IsNull() const;
+	void		ToString( char* buffer ) const;		// buffer holds STRING_SIZE chars
+	String		ToString() const;
+
+	/// A null ID if str is not a valid ID
+	static Uuid	FromString( const char* str );
+	static Uuid	Null();
+};
+
+inline bool operator ==( const Uuid& lhs, const Uuid& rhs ) { return !memcmp( lhs.m_data, rhs.m_data, Uuid::SIZE ); }
+inline bool operator !=( const Uuid& lhs, const Uuid& rhs ) { return  memcmp( lhs.m_data, rhs.m_data, Uuid::SIZE ) != 0; }
+inline bool operator < ( const Uuid& lhs, const Uuid& rhs ) { return  memcmp( lhs.m_data, rhs.m_data, Uuid::SIZE ) < 0; }
+
+
+/// Characters borrowed from the other side of the interface, with their length.
+/// Nothing is copied or owned, so a StringRef is only good for as long as the
+/// call or signal that hands it over says. The ones the library hands out are
+/// null-terminated; ones passed in need not be.
+struct StringRef
+{
+	const char*	m_data;
+	int			m_length;
+
+	StringRef() : m_data(""), m_length(0) {}
+	StringRef( const char* data, const int length ) : m_data(data), m_length(length) {}
+	StringRef( const char* str ) : m_data(str), m_length( (int) strlen(str) ) {}
+
+	bool		IsEmpty() const { return m_length == 0; }
+};
+
+
+/// A batch of agent IDs, handed over in one signal instead of one signal per ID.
+/// The IDs are kept packed and shared between copies, so passing a list of
+/// thousands through a queued signal does not copy it.
+class LLCHATLIBEXP IdListImpl;
+class LLCHATLIBEXP IdList
+{
+public:
+	enum { ID_STRING_SIZE = 37 };	// 36 chars plus the terminating null
+
+				IdList();
+				IdList( const boost::shared_ptr<const IdListImpl>& impl );
+	virtual		~IdList();
+
+	int			GetCount() const;
+	String		GetId( const int index ) const;
+	Uuid		GetUuid( const int index ) const;
+	void		GetId( const int index, char* buffer ) const;	// buffer holds ID_STRING_SIZE chars
+
+private:
+	boost::shared_ptr<const IdListImpl>	m_instance;
+};
+
+
 class LLCHATLIBEXP AuthException
 {
 public:
@@ -115,6 +181,35 @@ public:
 	bool			IsOnline();
 	void			PumpMessages();
 	void			RequestLogout();
+
+	// Event loop integration
+	//
+	struct PollFd
+	{
+		int		m_fd;
+		bool	m_read;
+		bool	m_write;
+
+		PollFd() : m_fd(-1), m_read(false), m_write(false) {}
+		PollFd( int fd, bool r, bool w ) : m_fd(fd), m_read(r), m_write(w) {}
+	};
+
+	typedef boost::function<void (void)>	FdCallback;
+	typedef boost::function<bool (void)>	DonePredicate;
+
+	int				GetPollFds( PollFd* fds, const int max_fds ) const;
+	int				GetNextDeadline() const;
+	void			WatchFd( const int fd, const FdCallback& callback );
+	void			UnwatchFd( const int fd );
+	bool			WaitForEvents( const int max_wait_msecs = -1 );
+	void			RunUntil( const DonePredicate& done );
+	String			GetPumpStats() const;
+	bool			SetPumpBudget( const String& stage, const int usecs );
+
+	void			StartNetworkThread();
+	void			StopNetworkThread();
+	bool			IsNetworkThreadRunning() const;
+	int				DispatchEvents( const int max_events = -1 );
 	
 	void			GetNameFromCache( const String& id, String& first_name, String& last_name );
 	void			GetNameFromCache( const String& id, String& full_name );
@@ -126,6 +221,15 @@ public:
 	bool			IsOnline( const String& id );
 	bool			IsFriend( const String& id );
 
+	// Typed versions of the calls above, which neither allocate nor parse
+	// IDs. Names are copied into the caller's buffer.
+	//
+	Uuid			GetAgentUuid() const;
+	bool			IsOnline( const Uuid& id );
+	bool			IsFriend( const Uuid& id );
+	int				GetFullName( const Uuid& id, char* buffer, const int size );
+	int				GetNameFromCache( const Uuid& id, char* buffer, const int size );
+
 	String			GetAgentLanguage( const String& agentId ) const;
 	void			SetAgentLanguage( const String& agentId, const String& language );
 	//
@@ -137,6 +241,8 @@ public:
 
 	void			SendInstantMessage( const String& to_id, const String& message, const bool to_group = false );
 	void			SendTypingSignal( const String& target_id, const bool to_group, const bool typing );
+	void			SendInstantMessage( const Uuid& to_id, const StringRef& message, const bool to_group = false );
+	void			SendTypingSignal( const Uuid& target_id, const bool to_group, const bool typing );
 	void			SendLocalChatMessage( const String& text, const int channel = 0 );
 	void			SendGroupChatStartRequest( const String& group_id );
 	void			SendGroupChatLeaveRequest( const String& group_session_id );
@@ -198,12 +304,38 @@ public:
 							, String				// detected language id
 							)
 							> LocalChatSignal;
+	/// One line of IM, group or local chat. The strings are borrowed from the
+	/// library and are only valid until the slot returns.
+	struct ChatEvent
+	{
+		enum Type { CHAT_IM, CHAT_GROUP, CHAT_LOCAL };
+
+		Type		m_type;
+		Uuid		m_fromId;
+		Uuid		m_groupId;		// CHAT_GROUP only
+		StringRef	m_fromName;
+		StringRef	m_groupName;	// CHAT_GROUP only
+		StringRef	m_verb;			// CHAT_LOCAL only
+		bool		m_hasMe;		// true if started with "/me"
+		StringRef	m_message;
+		StringRef	m_translated;
+		StringRef	m_language;		// detected language id
+	};
+	typedef boost::signal	< void
+							( const ChatEvent&		// the line
+							)
+							> ChatEventSignal;	// Sent for every line, alongside ImSignal, GroupChatSignal or LocalChatSignal
 	typedef boost::signal	< void
 							( String				// session/group id
-							, String				// agent_id
-							, bool					// true=entering, false=leaving
+							, IdList				// agents entering the chat
+							, IdList				// agents leaving the chat
+							)
+							> RosterDeltaSignal;	// Sent once per roster update from the server, however many agents it covers
+	typedef boost::signal	< void
+							( IdList				// avatars coming into chat range
+							, IdList				// avatars going out of chat range
 							)
-							> GroupChatAgentUpdateSignal;	// Sent to indicate entering/leaving the chat
+							> LocalAgentUpdateSignal;	// Sent once per coarse location update that changes who is in range
 	typedef boost::signal	< void
 							( String				// from_id
 							, String				// name
@@ -228,6 +360,10 @@ public:
 							( String				// name
 							)
 							> StringSignal;
+	typedef boost::signal	< void
+							( IdList				// agent_ids
+							)
+							> FriendsAddedSignal;	// Sent once with the whole buddy list
 	typedef boost::signal	< void (void)
 							> VoidSignal;
 	typedef boost::signal	< void
@@ -272,13 +408,14 @@ public:
 							)
 							> TeleportFailedSignal;
 	//
-	Connection	ConnectFriendAddSignal             ( const StringSignal               ::slot_type& slot ) const;
+	Connection	ConnectFriendsAddedSignal          ( const FriendsAddedSignal         ::slot_type& slot ) const;
 	Connection	ConnectCacheSignal                 ( const CacheSignal                ::slot_type& slot ) const;
 	Connection	ConnectGroupCacheSignal            ( const GroupCacheSignal           ::slot_type& slot ) const;
 	Connection	ConnectImSignal                    ( const ImSignal                   ::slot_type& slot ) const;
 	Connection	ConnectGroupChatSignal             ( const GroupChatSignal            ::slot_type& slot ) const;
 	Connection	ConnectLocalChatSignal             ( const LocalChatSignal            ::slot_type& slot ) const;
-	Connection	ConnectGroupChatAgentUpdateSignal  ( const GroupChatAgentUpdateSignal ::slot_type& slot ) const;
+	Connection	ConnectChatEventSignal             ( const ChatEventSignal            ::slot_type& slot ) const;
+	Connection	ConnectRosterDeltaSignal           ( const RosterDeltaSignal          ::slot_type& slot ) const;
 	Connection	ConnectTypingSignal                ( const TypingSignal               ::slot_type& slot ) const;
 	Connection	ConnectOnlineSignal                ( const OnlineSignal               ::slot_type& slot ) const;
 	Connection	ConnectTerminateFriendshipSignal   ( const StringSignal               ::slot_type& slot ) const;
@@ -292,6 +429,7 @@ public:
 	Connection	ConnectGroupOfferSignal            ( const GroupOfferSignal           ::slot_type& slot ) const;
 	Connection	ConnectAgentMovementCompleteSignal ( const VoidSignal                 ::slot_type& slot ) const;
 	Connection	ConnectLocalAgentsPresentSignal    ( const VoidSignal                 ::slot_type& slot ) const;
+	Connection	ConnectLocalAgentUpdateSignal      ( const LocalAgentUpdateSignal     ::slot_type& slot ) const;
 	//
 	Connection	ConnectTeleportRequestSignal       ( const TeleportRequestSignal      ::slot_type& slot ) const;
 	Connection	ConnectTeleportRequestedSignal     ( const TeleportRequestedSignal    ::slot_type& slot ) const;
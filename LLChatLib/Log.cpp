@@ -0,0 +1,569 @@
+/**
+ * \brief Categorised logging for LLChatLib, written out by a background thread.
+ *
+ * Copyright (c) 2009-2010 by R. Douglas Barbieri
+ *
+ * The source code in this file ("Source Code") is provided by R. Douglas Barbieri
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL").  Terms of the GPL can be found in doc/GPL-license.txt in this distribution.
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL SOURCE CODE IN THIS DISTRIBUTION IS PROVIDED "AS IS." THE AUTHOR MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ */
+
+#include "Log.h"
+#include "SPSCQueue.h"		// LLC_MEMORY_BARRIER()
+
+// StdC++
+//
+#include <cstdio>
+#include <cstring>
+#include <map>
+
+// boost
+//
+#include <boost/tokenizer.hpp>
+
+// llcommon
+//
+#include "linden_common.h"
+#include "llerror.h"
+#include "llfile.h"
+#include "llstring.h"
+#include "llthread.h"
+#include "lltimer.h"
+
+
+namespace LLC
+{
+
+volatile apr_uint32_t	Log::s_generation = 1;
+volatile apr_uint32_t	Log::s_levels[Log::CAT_COUNT] =
+	{ LEVEL_INFO, LEVEL_INFO, LEVEL_INFO, LEVEL_INFO, LEVEL_INFO, LEVEL_INFO };
+
+
+namespace
+{
+	const char* const CATEGORY_NAMES[Log::CAT_COUNT] =
+		{ "ChatterBox", "Names", "Login", "IM", "Teleport", "Agent" };
+
+	const char* const LEVEL_NAMES[] =
+		{ "debug", "info", "warn", "error", "none" };
+
+	// The writer sleeps this long when it finds the ring empty
+	//
+	const U32 WRITER_IDLE_MSECS = 20;
+
+	const char BINARY_MAGIC[8] = { 'L', 'L', 'C', 'L', 'O', 'G', '\0', '\1' };
+
+
+	/// Bounded ring for any number of producers and the one writer thread.
+	/// Each slot carries a sequence number that says whose turn it is, so a
+	/// producer claims a slot with one compare-and-swap and never waits on
+	/// the writer; when the ring is full the message is dropped instead.
+	///
+	class Ring
+	{
+	public:
+		enum { SIZE = 1024 };	// Power of two
+
+		struct Entry
+		{
+			volatile apr_uint32_t	m_sequence;
+			const Log::CallSite*	m_site;		// Call sites are static
+			U64						m_time;		// Microseconds since the epoch
+			U32						m_thread;
+			U16						m_length;
+			char					m_text[Log::MESSAGE_SIZE];
+		};
+
+		Ring() : m_enqueuePos(0), m_dequeuePos(0), m_dropped(0)
+		{
+			for( U32 idx = 0; idx < SIZE; ++idx )
+			{
+				m_entries[idx].m_sequence = idx;
+			}
+		}
+
+		/// Any thread
+		void Push( const Log::CallSite& site, const char* text, const size_t length )
+		{
+			Entry* entry;
+			U32 pos = apr_atomic_read32( &m_enqueuePos );
+			for(;;)
+			{
+				entry = &m_entries[pos & (SIZE - 1)];
+				const S32 diff = (S32) (apr_atomic_read32( &entry->m_sequence ) - pos);
+				if( diff == 0 )
+				{
+					if( apr_atomic_cas32( &m_enqueuePos, pos + 1, pos ) == pos )
+					{
+						break;
+					}
+					pos = apr_atomic_read32( &m_enqueuePos );
+				}
+				else if( diff < 0 )
+				{
+					apr_atomic_inc32( &m_dropped );
+					return;
+				}
+				else
+				{
+					pos = apr_atomic_read32( &m_enqueuePos );
+				}
+			}
+			//
+			entry->m_site	= &site;
+			entry->m_time	= LLTimer::getTotalTime();
+			entry->m_thread	= LLThread::currentID();
+			entry->m_length	= (U16) length;
+			memcpy( entry->m_text, text, length );
+			LLC_MEMORY_BARRIER();		// Filled in before the writer may see it
+			apr_atomic_set32( &entry->m_sequence, pos + 1 );
+		}
+
+		/// Writer thread only. Returns 0 if the ring is empty; call Release() when done.
+		const Entry* Peek()
+		{
+			Entry* entry = &m_entries[m_dequeuePos & (SIZE - 1)];
+			if( apr_atomic_read32( &entry->m_sequence ) != m_dequeuePos + 1 )
+			{
+				return 0;
+			}
+			LLC_MEMORY_BARRIER();		// Read the sequence before the contents
+			return entry;
+		}
+
+		/// Writer thread only
+		void Release()
+		{
+			Entry* entry = &m_entries[m_dequeuePos & (SIZE - 1)];
+			LLC_MEMORY_BARRIER();		// Done with the contents before a producer may reuse them
+			apr_atomic_set32( &entry->m_sequence, m_dequeuePos + SIZE );
+			++m_dequeuePos;
+		}
+
+		U32 GetDropped() { return apr_atomic_read32( &m_dropped ); }
+
+	private:
+		Entry					m_entries[SIZE];
+		volatile apr_uint32_t	m_enqueuePos;
+		U32						m_dequeuePos;
+		volatile apr_uint32_t	m_dropped;
+	};
+
+	Ring s_ring;
+
+
+	void WriteTime( FILE* fp, const U64 time )
+	{
+		fprintf( fp, "%llu.%06u", (unsigned long long) (time / 1000000), (unsigned) (time % 1000000) );
+	}
+
+
+	void WriteText( FILE* fp, const Log::CallSite& site, const U64 time, const char* text, const size_t length )
+	{
+		WriteTime( fp, time );
+		fprintf( fp, " %-5s %s: ", Log::GetLevelName( site.m_level ), Log::GetCategoryName( site.m_category ) );
+		fwrite( text, 1, length, fp );
+		fputc( '\n', fp );
+	}
+
+
+	void WriteJsonString( FILE* fp, const char* text, const size_t length )
+	{
+		fputc( '"', fp );
+		for( size_t idx = 0; idx < length; ++idx )
+		{
+			const unsigned char ch = text[idx];
+			switch( ch )
+			{
+				case '"':	fputs( "\\\"", fp ); break;
+				case '\\':	fputs( "\\\\", fp ); break;
+				case '\n':	fputs( "\\n",  fp ); break;
+				case '\r':	fputs( "\\r",  fp ); break;
+				case '\t':	fputs( "\\t",  fp ); break;
+				default:
+					if( ch < 0x20 )
+					{
+						fprintf( fp, "\\u%04x", ch );
+					}
+					else
+					{
+						fputc( ch, fp );
+					}
+			}
+		}
+		fputc( '"', fp );
+	}
+
+
+	void WriteJson( FILE* fp, const Log::CallSite& site, const U64 time, const U32 thread, const char* text, const size_t length )
+	{
+		fputs( "{\"t\":", fp );
+		WriteTime( fp, time );
+		fprintf( fp, ",\"level\":\"%s\",\"cat\":\"%s\",\"thread\":%u,\"file\":",
+				Log::GetLevelName( site.m_level ), Log::GetCategoryName( site.m_category ), (unsigned) thread );
+		WriteJsonString( fp, site.m_file, strlen( site.m_file ) );
+		fprintf( fp, ",\"line\":%d,\"func\":", site.m_line );
+		WriteJsonString( fp, site.m_function, strlen( site.m_function ) );
+		fputs( ",\"msg\":", fp );
+		WriteJsonString( fp, text, length );
+		fputs( "}\n", fp );
+	}
+
+
+	/// Writes the ring to a file or stdout
+	///
+	class Writer : public LLThread
+	{
+	public:
+		Writer( FILE* fp, const bool ownsFile, const Log::Format format )
+			: LLThread( "LLChatLib log writer" )
+			, m_fp( fp )
+			, m_ownsFile( ownsFile )
+			, m_format( format )
+			, m_stopping( 0 )
+			, m_lastDropped( 0 )
+		{
+			if( m_format == Log::FORMAT_BINARY )
+			{
+				fwrite( BINARY_MAGIC, 1, sizeof(BINARY_MAGIC), m_fp );
+			}
+		}
+
+		virtual ~Writer()
+		{
+			if( m_ownsFile )
+			{
+				fclose( m_fp );
+			}
+		}
+
+		void Stop()
+		{
+			apr_atomic_set32( &m_stopping, 1 );
+			while( !isStopped() )
+			{
+				ms_sleep( WRITER_IDLE_MSECS );
+			}
+			// Anything logged while it was stopping
+			//
+			Drain();
+			fflush( m_fp );
+		}
+
+	protected:
+		virtual void run()
+		{
+			while( !apr_atomic_read32( &m_stopping ) )
+			{
+				if( !Drain() )
+				{
+					fflush( m_fp );
+					ms_sleep( WRITER_IDLE_MSECS );
+				}
+			}
+			Drain();
+		}
+
+	private:
+		typedef std::map<const Log::CallSite*, U32>	SiteIds;
+
+		FILE*					m_fp;
+		const bool				m_ownsFile;
+		const Log::Format		m_format;
+		volatile apr_uint32_t	m_stopping;
+		U32						m_lastDropped;
+		SiteIds					m_siteIds;		// FORMAT_BINARY only
+
+		bool Drain()
+		{
+			bool any = false;
+			while( const Ring::Entry* entry = s_ring.Peek() )
+			{
+				Write( *entry );
+				s_ring.Release();
+				any = true;
+			}
+			//
+			const U32 dropped = s_ring.GetDropped();
+			if( dropped != m_lastDropped && m_format != Log::FORMAT_BINARY )
+			{
+				fprintf( m_fp, m_format == Log::FORMAT_JSONL
+						? "{\"dropped\":%u}\n"
+						: "[%u log messages dropped]\n"
+						, (unsigned) (dropped - m_lastDropped) );
+				m_lastDropped = dropped;
+			}
+			return any;
+		}
+
+		void Write( const Ring::Entry& entry )
+		{
+			const Log::CallSite& site = *entry.m_site;
+			switch( m_format )
+			{
+				case Log::FORMAT_TEXT:
+					WriteText( m_fp, site, entry.m_time, entry.m_text, entry.m_length );
+					break;
+
+				case Log::FORMAT_JSONL:
+					WriteJson( m_fp, site, entry.m_time, entry.m_thread, entry.m_text, entry.m_length );
+					break;
+
+				case Log::FORMAT_BINARY:
+					WriteBinary( entry );
+					break;
+			}
+		}
+
+		// After the 8 byte magic, the file holds two kinds of record, in host byte order:
+		//
+		//   'S' U32 site  U8 category  U8 level  S32 line  U16 n  file[n]  U16 n  function[n]
+		//   'M' U32 site  U64 time  U32 thread  U16 n  text[n]
+		//
+		// A call site is described once, by an 'S' record before its first message.
+		//
+		void WriteBinary( const Ring::Entry& entry )
+		{
+			const Log::CallSite& site = *entry.m_site;
+			SiteIds::iterator it = m_siteIds.find( &site );
+			if( it == m_siteIds.end() )
+			{
+				it = m_siteIds.insert( SiteIds::value_type( &site, (U32) m_siteIds.size() ) ).first;
+				//
+				const U8  category	= (U8) site.m_category;
+				const U8  level		= (U8) site.m_level;
+				const S32 line		= site.m_line;
+				fputc( 'S', m_fp );
+				fwrite( &it->second, sizeof(U32), 1, m_fp );
+				fwrite( &category,   sizeof(U8),  1, m_fp );
+				fwrite( &level,      sizeof(U8),  1, m_fp );
+				fwrite( &line,       sizeof(S32), 1, m_fp );
+				WriteBinaryString( site.m_file );
+				WriteBinaryString( site.m_function );
+			}
+			//
+			fputc( 'M', m_fp );
+			fwrite( &it->second,     sizeof(U32), 1, m_fp );
+			fwrite( &entry.m_time,   sizeof(U64), 1, m_fp );
+			fwrite( &entry.m_thread, sizeof(U32), 1, m_fp );
+			fwrite( &entry.m_length, sizeof(U16), 1, m_fp );
+			fwrite( entry.m_text, 1, entry.m_length, m_fp );
+		}
+
+		void WriteBinaryString( const char* str )
+		{
+			const U16 length = (U16) llmin( strlen( str ), (size_t) 0xffff );
+			fwrite( &length, sizeof(U16), 1, m_fp );
+			fwrite( str, 1, length, m_fp );
+		}
+	};
+
+	Writer* volatile	s_writer = 0;
+}
+
+
+//=========================================================================
+// Log
+//=========================================================================
+
+//static
+void Log::SetLevel( const Category category, const Level level )
+{
+	apr_atomic_set32( &s_levels[category], level );
+	apr_atomic_inc32( &s_generation );
+}
+
+
+//static
+Log::Level Log::GetLevel( const Category category )
+{
+	return (Level) apr_atomic_read32( &s_levels[category] );
+}
+
+
+//static
+void Log::SetLevels( const std::string& levels )
+{
+	typedef boost::tokenizer<boost::char_separator<char> > tokenizer;
+	boost::char_separator<char> sep( ", " );
+	tokenizer tokens( levels, sep );
+	for( tokenizer::iterator it = tokens.begin(); it != tokens.end(); ++it )
+	{
+		const std::string& item	= *it;
+		const size_t equals		= item.find( '=' );
+		if( equals == std::string::npos )
+		{
+			llwarns << "Log level '" << item << "' should be Category=level" << llendl;
+			continue;
+		}
+		//
+		const std::string name		= item.substr( 0, equals );
+		const std::string levelName	= item.substr( equals + 1 );
+		int level = 0;
+		for( ; level <= LEVEL_NONE; ++level )
+		{
+			if( !LLStringUtil::compareInsensitive( levelName, LEVEL_NAMES[level] ) )
+			{
+				break;
+			}
+		}
+		if( level > LEVEL_NONE )
+		{
+			llwarns << "Unknown log level '" << levelName << "'" << llendl;
+			continue;
+		}
+		//
+		bool found = false;
+		for( int category = 0; category < CAT_COUNT; ++category )
+		{
+			if( name == "*" || !LLStringUtil::compareInsensitive( name, CATEGORY_NAMES[category] ) )
+			{
+				SetLevel( (Category) category, (Level) level );
+				found = true;
+			}
+		}
+		if( !found )
+		{
+			llwarns << "Unknown log category '" << name << "'" << llendl;
+		}
+	}
+}
+
+
+//static
+bool Log::Start( const std::string& path, const Format format )
+{
+	Stop();
+	//
+	FILE* fp = stdout;
+	if( !path.empty() )
+	{
+		fp = LLFile::fopen( path, format == FORMAT_BINARY? "ab": "a" );
+		if( !fp )
+		{
+			llwarns << "Can't open log file " << path << llendl;
+			return false;
+		}
+	}
+	//
+	Writer* writer = new Writer( fp, !path.empty(), format );
+	writer->start();
+	s_writer = writer;
+	return true;
+}
+
+
+//static
+void Log::Stop()
+{
+	Writer* writer = s_writer;
+	if( writer )
+	{
+		s_writer = 0;
+		writer->Stop();
+		delete writer;
+	}
+}
+
+
+//static
+Log::Format Log::ParseFormat( const std::string& format )
+{
+	if( format == "jsonl" )
+	{
+		return FORMAT_JSONL;
+	}
+	if( format == "binary" )
+	{
+		return FORMAT_BINARY;
+	}
+	return FORMAT_TEXT;
+}
+
+
+//static
+U32 Log::GetDropped()
+{
+	return s_ring.GetDropped();
+}
+
+
+//static
+const char* Log::GetCategoryName( const Category category )
+{
+	return CATEGORY_NAMES[category];
+}
+
+
+//static
+const char* Log::GetLevelName( const Level level )
+{
+	return LEVEL_NAMES[level];
+}
+
+
+//=========================================================================
+// Log::CallSite
+//=========================================================================
+
+Log::CallSite::CallSite( const Category category, const Level level, const char* file, const int line, const char* function )
+	: m_category( category )
+	, m_level( level )
+	, m_file( file )
+	, m_line( line )
+	, m_function( function )
+	, m_generation( 0 )
+	, m_enabled( false )
+{
+}
+
+
+bool Log::CallSite::Refresh()
+{
+	// Read the generation first: if a level changes after this, the next
+	// call comes back here
+	//
+	const U32 generation = apr_atomic_read32( &s_generation );
+	m_enabled	 = m_level >= GetLevel( m_category );
+	m_generation = generation;
+	return m_enabled;
+}
+
+
+//=========================================================================
+// Log::Record
+//=========================================================================
+
+Log::Record::Record( const CallSite& site )
+	: m_site( site )
+	, m_buffer( m_text, m_text + MESSAGE_SIZE )
+	, m_stream( &m_buffer )
+{
+}
+
+
+void Log::Record::Commit()
+{
+	if( s_writer )
+	{
+		s_ring.Push( m_site, m_text, m_buffer.Length() );
+	}
+	else
+	{
+		WriteText( stdout, m_site, LLTimer::getTotalTime(), m_text, m_buffer.Length() );
+	}
+}
+
+
+}
+//namespace LLC
+
+// vim: ts=4 sw=4 noexpandtab syntax=cpp.doxygen
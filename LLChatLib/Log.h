@@ -0,0 +1,237 @@
+/**
+ * \brief Categorised logging for LLChatLib, written out by a background thread.
+ *
+ * Copyright (c) 2009-2010 by R. Douglas Barbieri
+ *
+ * The source code in this file ("Source Code") is provided by R. Douglas Barbieri
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL").  Terms of the GPL can be found in doc/GPL-license.txt in this distribution.
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL SOURCE CODE IN THIS DISTRIBUTION IS PROVIDED "AS IS." THE AUTHOR MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ */
+
+#ifndef __LOG_H__
+#define __LOG_H__
+
+// llcommon
+//
+#include "llapr.h"
+#include "stdtypes.h"
+
+// StdC++
+//
+#include <ostream>
+#include <streambuf>
+#include <string>
+
+
+/*
+	Usage, as with LL_INFOS() and LL_ENDL:
+
+		LLC_DEBUGS(CHATTERBOX) << "agent " << agent_id << " left " << session_id << LLC_ENDL;
+
+	Each category has two floors:
+
+	- Compile time. Messages below LLC_LOG_MIN_LEVEL_<category> are not
+	  compiled in at all. All categories default to LLC_LOG_MIN_LEVEL, which
+	  is info in LL_RELEASE_FOR_DOWNLOAD builds and debug otherwise.
+	- Run time, from Log::SetLevels() or the "LLChatLibLogLevels" setting.
+	  The default is info. Each call site caches the answer, so a disabled
+	  message costs one compare until the levels change again.
+
+	An enabled message is formatted into a fixed buffer on the stack and put
+	on a lock-free ring. A writer thread, started by Log::Start(), drains the
+	ring to a sink. Until the writer is started, messages go straight to
+	stdout. If the ring is full the message is dropped and counted, and the
+	caller never waits.
+*/
+
+#define LLC_LOG_DEBUG	0
+#define LLC_LOG_INFO	1
+#define LLC_LOG_WARN	2
+#define LLC_LOG_ERROR	3
+#define LLC_LOG_NONE	4
+
+#ifndef LLC_LOG_MIN_LEVEL
+#	if LL_RELEASE_FOR_DOWNLOAD
+#		define LLC_LOG_MIN_LEVEL	LLC_LOG_INFO
+#	else
+#		define LLC_LOG_MIN_LEVEL	LLC_LOG_DEBUG
+#	endif
+#endif
+
+#ifndef LLC_LOG_MIN_LEVEL_CHATTERBOX
+#	define LLC_LOG_MIN_LEVEL_CHATTERBOX	LLC_LOG_MIN_LEVEL
+#endif
+#ifndef LLC_LOG_MIN_LEVEL_NAMES
+#	define LLC_LOG_MIN_LEVEL_NAMES		LLC_LOG_MIN_LEVEL
+#endif
+#ifndef LLC_LOG_MIN_LEVEL_LOGIN
+#	define LLC_LOG_MIN_LEVEL_LOGIN		LLC_LOG_MIN_LEVEL
+#endif
+#ifndef LLC_LOG_MIN_LEVEL_IM
+#	define LLC_LOG_MIN_LEVEL_IM			LLC_LOG_MIN_LEVEL
+#endif
+#ifndef LLC_LOG_MIN_LEVEL_TELEPORT
+#	define LLC_LOG_MIN_LEVEL_TELEPORT	LLC_LOG_MIN_LEVEL
+#endif
+#ifndef LLC_LOG_MIN_LEVEL_AGENT
+#	define LLC_LOG_MIN_LEVEL_AGENT		LLC_LOG_MIN_LEVEL
+#endif
+
+
+namespace LLC
+{
+
+
+class Log
+{
+public:
+	enum Level
+	{
+		LEVEL_DEBUG	= LLC_LOG_DEBUG,
+		LEVEL_INFO	= LLC_LOG_INFO,
+		LEVEL_WARN	= LLC_LOG_WARN,
+		LEVEL_ERROR	= LLC_LOG_ERROR,
+		LEVEL_NONE	= LLC_LOG_NONE
+	};
+
+	enum Category
+	{
+		CAT_CHATTERBOX,		// Group chat sessions and rosters
+		CAT_NAMES,			// Name cache arrivals
+		CAT_LOGIN,			// Login, buddy list, logout
+		CAT_IM,				// Instant messages and local chat
+		CAT_TELEPORT,
+		CAT_AGENT,			// Agent and group data updates
+		CAT_COUNT
+	};
+
+	enum Format
+	{
+		FORMAT_TEXT,		// One line per message
+		FORMAT_JSONL,		// One JSON object per line
+		FORMAT_BINARY		// See WriteBinary() in Log.cpp
+	};
+
+	enum { MESSAGE_SIZE = 256 };	// Longer messages are cut short
+
+	static void			SetLevel( const Category category, const Level level );
+	static Level		GetLevel( const Category category );
+
+	/// Sets levels from a list such as "ChatterBox=debug,Names=warn".
+	/// "*" stands for every category. Unknown names are warned about and skipped.
+	static void			SetLevels( const std::string& levels );
+
+	/// Starts the writer thread. An empty path writes to stdout.
+	static bool			Start( const std::string& path, const Format format );
+	/// Writes out what is left on the ring and stops the writer thread.
+	static void			Stop();
+
+	/// "text", "jsonl" or "binary"; anything else is text.
+	static Format		ParseFormat( const std::string& format );
+
+	/// Messages dropped because the ring was full
+	static U32			GetDropped();
+
+	static const char*	GetCategoryName( const Category category );
+	static const char*	GetLevelName( const Level level );
+
+	/// One place in the code that logs. Used by the macros below.
+	class CallSite
+	{
+	public:
+		CallSite( const Category category, const Level level, const char* file, const int line, const char* function );
+
+		bool ShouldLog()
+			{ return m_generation == s_generation ? m_enabled : Refresh(); }
+
+		const Category		m_category;
+		const Level			m_level;
+		const char* const	m_file;
+		const int			m_line;
+		const char* const	m_function;
+
+	private:
+		U32		m_generation;
+		bool	m_enabled;
+
+		bool	Refresh();
+	};
+
+	/// One message being formatted. Used by the macros below.
+	class Record
+	{
+	public:
+		explicit Record( const CallSite& site );
+
+		std::ostream&	Stream() { return m_stream; }
+		void			Commit();
+
+	private:
+		class Buffer : public std::streambuf
+		{
+		public:
+			Buffer( char* begin, char* end ) { setp( begin, end ); }
+			size_t Length() const { return pptr() - pbase(); }
+		};
+
+		const CallSite&	m_site;
+		char			m_text[MESSAGE_SIZE];
+		Buffer			m_buffer;
+		std::ostream	m_stream;
+
+		// Forbidden
+		//
+		Record( const Record& );
+		Record& operator =( const Record& );
+	};
+
+	class End { };
+
+private:
+	friend class CallSite;
+
+	static volatile apr_uint32_t	s_generation;	// Bumped whenever a level changes
+	static volatile apr_uint32_t	s_levels[CAT_COUNT];
+};
+
+
+inline std::ostream& operator <<( std::ostream& s, const Log::End& ) { return s; }
+
+
+}
+//namespace LLC
+
+
+#define llclog(category, level) \
+	{ \
+		if( LLC_LOG_##level >= LLC_LOG_MIN_LEVEL_##category ) \
+		{ \
+			static LLC::Log::CallSite _llc_site( LLC::Log::CAT_##category, LLC::Log::LEVEL_##level, __FILE__, __LINE__, __FUNCTION__ ); \
+			if( _llc_site.ShouldLog() ) \
+			{ \
+				LLC::Log::Record _llc_record( _llc_site ); \
+				_llc_record.Stream()
+
+#define LLC_ENDL \
+				LLC::Log::End(); \
+				_llc_record.Commit(); \
+			} \
+		} \
+	}
+
+#define LLC_DEBUGS(category)	llclog(category, DEBUG)
+#define LLC_INFOS(category)		llclog(category, INFO)
+#define LLC_WARNS(category)		llclog(category, WARN)
+#define LLC_ERRS(category)		llclog(category, ERROR)
+
+#endif // __LOG_H__
+
+// vim: ts=4 sw=4 noexpandtab syntax=cpp.doxygen
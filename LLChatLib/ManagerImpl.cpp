@@ -34,11 +34,13 @@
 #include "LLChatLib.h"
 #include "ManagerImpl.h"
 #include "StringImpl.h"
+#include "Log.h"
 #include "llviewerregion.h"
 #include "llworld.h"
 #include "lljoint.h"
 #include "SLUrlUtils.h"
 #include "GoogleTranslate.h"
+#include "AvatarHeaderParser.h"
 
 // Std libraries
 //
@@ -71,7 +73,6 @@
 // llxml
 //
 #include "llcontrol.h"
-#include "llxmltree.h"
 //
 // llvfs.h
 //
@@ -85,6 +86,7 @@
 #include "message.h"
 #include "llpumpio.h"
 #include "llares.h"
+#include "llcurl.h"
 #include "llcachename.h"
 #include "llinstantmessage.h"
 #include "message_prehash.h"
@@ -121,7 +123,6 @@ extern LLAssetStorage *	gAssetStorage;
 const std::string AVATAR_DEFAULT_CHAR = "avatar";
 
 #define MAP_SIM_IMAGE_TYPES 3
-#define GOOGLE_XLATE_CONFIDENCE_CODE 0.15f
 
 #if LL_WINDOWS || LL_MINGW32
 #	include <tchar.h>
@@ -131,6 +132,36 @@ const std::string AVATAR_DEFAULT_CHAR = "avatar";
 #	include <Carbon/Carbon.h>
 #endif
 
+#if LL_LINUX
+#	include <sys/epoll.h>
+#	include <errno.h>
+#	include <unistd.h>
+#elif !LL_WINDOWS
+#	include <sys/select.h>
+#endif
+
+// Longest we will sleep between pumps when nothing is on the wire. Resends and
+// xfer retransmits are polled from PumpMessages() and expose no deadline.
+//
+const int PUMP_HOUSEKEEPING_MSECS = 250;
+
+// How often the front-end looks for events from the network thread when there
+// is no pipe to wake it, about once a frame.
+//
+const int NETWORK_EVENT_POLL_MSECS = 16;
+
+// Time each stage of PumpMessages() may take before the rest of its work
+// is left for the next pump. Stages that do all their work in one call
+// just run once; their budget is what counts as an overrun.
+//
+const U64 PUMP_BUDGET_DNS_USECS			= 1000;
+const U64 PUMP_BUDGET_HTTP_USECS		= 4000;
+const U64 PUMP_BUDGET_NAMES_USECS		= 1000;
+const U64 PUMP_BUDGET_UDP_USECS			= 8000;
+const U64 PUMP_BUDGET_ACKS_USECS		= 2000;
+const U64 PUMP_BUDGET_TRANSLATE_USECS	= 1000;
+const U64 PUMP_BUDGET_TIMERS_USECS		= 1000;
+
 
 #include "ChatterBox.h"
 
@@ -372,14 +403,159 @@ LLCHATLIBEXP String MungedPassword( const String& clear_text )
 	return String(munged_password);
 }
 
+
+namespace
+{
+
+// Hands ids over to a new IdList, leaving it empty. Empty lists share one instance.
+//
+IdList TakeIdList( IdListImpl::LLUUIDList& ids )
+{
+	if( ids.empty() )
+	{
+		return IdList();
+	}
+	return IdList( boost::shared_ptr<const IdListImpl>( new IdListImpl( ids ) ) );
+}
+
+
+// A ChatEvent that owns its strings, for when it has to wait in the event queue
+//
+class ChatEventCopy
+{
+public:
+	explicit ChatEventCopy( const Manager::ChatEvent& event )
+		: m_event( event )
+		, m_fromName( ToStdString( event.m_fromName ) )
+		, m_groupName( ToStdString( event.m_groupName ) )
+		, m_verb( ToStdString( event.m_verb ) )
+		, m_message( ToStdString( event.m_message ) )
+		, m_translated( ToStdString( event.m_translated ) )
+		, m_language( ToStdString( event.m_language ) )
+	{
+		m_event.m_fromName		= ToStringRef( m_fromName );
+		m_event.m_groupName		= ToStringRef( m_groupName );
+		m_event.m_verb			= ToStringRef( m_verb );
+		m_event.m_message		= ToStringRef( m_message );
+		m_event.m_translated	= ToStringRef( m_translated );
+		m_event.m_language		= ToStringRef( m_language );
+	}
+
+	const Manager::ChatEvent& GetEvent() const { return m_event; }
+
+private:
+	Manager::ChatEvent	m_event;
+	std::string			m_fromName;
+	std::string			m_groupName;
+	std::string			m_verb;
+	std::string			m_message;
+	std::string			m_translated;
+	std::string			m_language;
+};
+
+
+void FireChatEventCopy( Manager::ChatEventSignal& signal, const boost::shared_ptr<ChatEventCopy>& copy )
+{
+	signal( copy->GetEvent() );
+}
+
+
+// Stages run by m_pumpScheduler. Each returns true if it stopped with
+// work still waiting.
+//
+bool PumpAres()
+{
+	gAres->process();
+	return false;
+}
+
+
+bool PumpHttp()
+{
+	gServicePump->pump();
+	gServicePump->callback();
+	return gServicePump->hasPendingWork();
+}
+
+
+bool PumpCacheName()
+{
+	gCacheName->processPending();
+	return false;
+}
+
+
+bool PumpUdp()
+{
+	// One packet per call, so the budget is checked between packets
+	//
+	return gMessageSystem->checkMessages();
+}
+
+
+bool PumpAcks()
+{
+	// Also runs the xfer retransmits and asset timeouts
+	//
+	gMessageSystem->processAcks();
+	return false;
+}
+
+
+bool PumpTranslations( TranslationPipeline* translator )
+{
+	translator->Pump();
+	return false;
+}
+
+
+bool PumpTimers()
+{
+	// LLEventTimers, such as the event poll's retries after an HTTP error
+	//
+	LLEventTimer::updateClass();
+	return false;
+}
+
+
+// Wait until due_usecs, rounded up so the wait does not end just short of it
+//
+int MsecsUntil( const U64 due_usecs, const U64 now_usecs )
+{
+	if( due_usecs <= now_usecs )
+	{
+		return 0;
+	}
+	return (int) llmin( (due_usecs - now_usecs + 999) / 1000, (U64) PUMP_HOUSEKEEPING_MSECS );
+}
+
+}
+// namespace
+
+
 ManagerImpl::ManagerImpl()
 	: m_llua(0)
 	, m_started(false)
 	, m_langId("en")
 	, m_translateMessages(true)
 	, m_user_settings(NULL)
+#if LL_LINUX
+	, m_epollFd(-1)
+#endif
 {
 	gSavedSettings.resetToDefaults();
+	//
+	m_translator.SetBackend( TranslationBackendPtr( new GoogleTranslateBackend ) );
+	m_translator.SetLanguageCallback( boost::bind( &ManagerImpl::HandleLanguageDetected, this, _1, _2 ) );
+	m_translator.SetTargetLanguage( m_langId );
+	//
+	m_pumpScheduler.AddStage( "dns",		PUMP_BUDGET_DNS_USECS,			&PumpAres );
+	m_pumpScheduler.AddStage( "http",		PUMP_BUDGET_HTTP_USECS,			&PumpHttp );
+	m_pumpScheduler.AddStage( "names",		PUMP_BUDGET_NAMES_USECS,		&PumpCacheName );
+	m_pumpScheduler.AddStage( "udp",		PUMP_BUDGET_UDP_USECS,			&PumpUdp );
+	m_pumpScheduler.AddStage( "acks",		PUMP_BUDGET_ACKS_USECS,			&PumpAcks );
+	m_pumpScheduler.AddStage( "translate",	PUMP_BUDGET_TRANSLATE_USECS,	boost::bind( &PumpTranslations, &m_translator ) );
+	m_pumpScheduler.AddStage( "timers",		PUMP_BUDGET_TIMERS_USECS,		&PumpTimers );
 }
 
 
@@ -390,6 +566,7 @@ void ManagerImpl::StartMessagingSystem(const char *appname, const char *settings
 	gDirUtilp->initAppDirs( appname );
 
 	LLHTTPClient::setPump(*gServicePump);
+	LLCurl::initClass();
 	LLCurl::setCAFile(gDirUtilp->getCAFile());
 
 	std::string message_template_path = gDirUtilp->getExpandedFilename( LL_PATH_APP_SETTINGS, "message_template.msg" );
@@ -409,6 +586,20 @@ void ManagerImpl::StartMessagingSystem(const char *appname, const char *settings
 		gSavedSettings.loadFromFile( user_settings );
 	}
 
+	// Logging is configured through settings the front-end may declare
+	//
+	if( gSavedSettings.controlExists( "LLChatLibLogLevels" ) )
+	{
+		Log::SetLevels( gSavedSettings.getString( "LLChatLibLogLevels" ) );
+	}
+	if( gSavedSettings.controlExists( "LLChatLibLogFile" ) )
+	{
+		const std::string format = gSavedSettings.controlExists( "LLChatLibLogFormat" )
+			? gSavedSettings.getString( "LLChatLibLogFormat" )
+			: std::string();
+		Log::Start( gSavedSettings.getString( "LLChatLibLogFile" ), Log::ParseFormat( format ) );
+	}
+
 	U32 port = gSavedSettings.getU32("UserConnectionPort");
 	const LLUseCircuitCodeResponder* responder = NULL;
 	bool failure_is_fatal = true;
@@ -492,6 +683,11 @@ void ManagerImpl::StartMessagingSystem(const char *appname, const char *settings
 
 	m_started = true;
 
+	// Names persist across sessions in a mapped file; each LLCacheName
+	// instance (including the one recreated at login) opens it.
+	//
+	LLCacheName::setCacheFile( gDirUtilp->getExpandedFilename( LL_PATH_CACHE, "name_cache.db" ) );
+
 	// Init VFS and asset storage
 	//
 	const S32 MB = 1024*1024;
@@ -506,13 +702,39 @@ void ManagerImpl::StartMessagingSystem(const char *appname, const char *settings
 	vfs_size = (vfs_size / MB) * MB; // make sure it is MB aligned
 	const U32 vfs_size_u32 = (U32)vfs_size;
 	//
-	const U32 new_salt = rand();
-	const char *VFS_DATA_FILE_BASE = "data.db2.x.";
-	const char *VFS_INDEX_FILE_BASE = "index.db2.x.";
-	std::string new_vfs_data_file  = gDirUtilp->getExpandedFilename(LL_PATH_CACHE, VFS_DATA_FILE_BASE)  + llformat("%u",new_salt);
-	std::string new_vfs_index_file = gDirUtilp->getExpandedFilename(LL_PATH_CACHE, VFS_INDEX_FILE_BASE) + llformat("%u",new_salt);
+	// The VFS lives in the same files from one session to the next, so
+	// wearables, notecards and other assets fetched once are not fetched
+	// again. The version goes up whenever the on-disk format changes.
+	//
+	const U32 VFS_CACHE_VERSION = 1;
+	const char *VFS_DATA_FILE_BASE = "data.db2.v";
+	const char *VFS_INDEX_FILE_BASE = "index.db2.v";
+	std::string vfs_data_file  = gDirUtilp->getExpandedFilename(LL_PATH_CACHE, VFS_DATA_FILE_BASE)  + llformat("%u",VFS_CACHE_VERSION);
+	std::string vfs_index_file = gDirUtilp->getExpandedFilename(LL_PATH_CACHE, VFS_INDEX_FILE_BASE) + llformat("%u",VFS_CACHE_VERSION);
+	//
+	// Older versions started a new, randomly salted pair every time and
+	// never removed them.
 	//
-	gVFS = new LLVFS(new_vfs_index_file, new_vfs_data_file, false, vfs_size_u32, false);
+	gDirUtilp->deleteFilesInDir( gDirUtilp->getCacheDir(), "data.db2.x.*" );
+	gDirUtilp->deleteFilesInDir( gDirUtilp->getCacheDir(), "index.db2.x.*" );
+	//
+	// The data file keeps the size it was created with, so start over if
+	// the cache size setting has changed since.
+	//
+	llstat vfs_stat;
+	if( !LLFile::stat( vfs_data_file, &vfs_stat ) && (U32)vfs_stat.st_size != vfs_size_u32 )
+	{
+		llinfos << "VFS size changed, removing " << vfs_data_file << llendl;
+		LLFile::remove( vfs_data_file );
+		LLFile::remove( vfs_index_file );
+	}
+	//
+	// Data and index are written through separate buffers and the index
+	// can claim a block before its data lands, so a cache left behind by a
+	// crash can't be trusted. The VFS marks its files while they are open
+	// and starts over if the mark is still there on the next run.
+	//
+	gVFS = new LLVFS(vfs_index_file, vfs_data_file, false, vfs_size_u32, true /*remove_after_crash*/);
 	//
 	if( gVFS->isValid() )
 	{
@@ -534,52 +756,40 @@ void ManagerImpl::StartMessagingSystem(const char *appname, const char *settings
 	}
 	gAssetStorage = new LLAssetStorage(gMessageSystem, gXferManager, gVFS);
 
-	LLXmlTree sXMLTree;
-	std::string xmlFile;
-
-	xmlFile = gDirUtilp->getExpandedFilename(LL_PATH_CHARACTER,AVATAR_DEFAULT_CHAR) + "_lad.xml";
-	BOOL success = sXMLTree.parseFile( xmlFile, FALSE );
-	if (!success)
+	const std::string xmlFile = gDirUtilp->getExpandedFilename(LL_PATH_CHARACTER,AVATAR_DEFAULT_CHAR) + "_lad.xml";
+	AvatarHeaderParser header;
+	if( !header.ParseHeader( xmlFile ) )
 	{
 		llerrs << "Problem reading avatar configuration file:" << xmlFile << llendl;
 		throw AuthException( "Problem reading avatar configuration file!" );
 	}
 
-	// now sanity check xml file
-	LLXmlTreeNode* root = sXMLTree.getRoot();
-	if (!root) 
-	{
-		llerrs << "No root node found in avatar configuration file: " << xmlFile << llendl;
-		throw AuthException( "No root node found in avatar configuration file!" );
-	}
-
 	//-------------------------------------------------------------------------
 	// <linden_avatar version="1.0"> (root)
 	//-------------------------------------------------------------------------
-	if( !root->hasName( "linden_avatar" ) )
+	if( header.GetName() != "linden_avatar" )
 	{
 		llerrs << "Invalid avatar file header: " << xmlFile << llendl;
 		throw AuthException( "Invalid avatar file header!" );
 	}
 	
-	std::string version;
-	static LLStdStringHandle version_string = LLXmlTree::addAttributeString("version");
-	if( !root->getFastAttributeString( version_string, version ) || (version != "1.0") )
+	if( header.GetVersion() != "1.0" )
 	{
-		llerrs << "Invalid avatar file version: " << version << " in file: " << xmlFile << llendl;
+		llerrs << "Invalid avatar file version: " << header.GetVersion() << " in file: " << xmlFile << llendl;
 		throw AuthException( "Invalid avatar file version!" );
 	}
 
-	S32 wearable_def_version = 1;
-	static LLStdStringHandle wearable_definition_version_string = LLXmlTree::addAttributeString("wearable_definition_version");
-	root->getFastAttributeS32( wearable_definition_version_string, wearable_def_version );
-	LLWearable::setCurrentDefinitionVersion( wearable_def_version );
+	LLWearable::setCurrentDefinitionVersion( header.GetWearableDefVersion() );
 
 }
 
 
 ManagerImpl::~ManagerImpl()
 {
+	StopNetworkThread();
+	m_retiredThread.reset();
+	Log::Stop();
+
 	if( m_started )
 	{
 		// Save settings
@@ -593,6 +803,16 @@ ManagerImpl::~ManagerImpl()
 		m_viewerRegion.reset();
 	
 		end_messaging_system();
+
+		// Closing the VFS flushes it and clears the crash mark, so the
+		// cache is kept for the next session.
+		//
+		delete gAssetStorage;
+		gAssetStorage = NULL;
+		cleanup_xfer_manager();
+		LLVFile::cleanupClass();
+		delete gVFS;
+		gVFS = NULL;
 	
 		LLUserAuth::Release();
 	
@@ -600,11 +820,19 @@ ManagerImpl::~ManagerImpl()
 		//
 		LLCacheName::Release();
 		LLPumpIO::Release();
+		LLCurl::cleanupClass();
 		LLControlGroup::Release();
 		LLHost::Release();
 	
 		ll_cleanup_apr();
 	}
+
+#if LL_LINUX
+	if( m_epollFd != -1 )
+	{
+		close( m_epollFd );
+	}
+#endif
 }
 
 
@@ -621,6 +849,12 @@ boost::shared_ptr<ManagerImpl>	ManagerImpl::GetInstance()
 
 void ManagerImpl::Release()
 {
+	// The network thread still reaches the manager through GetInstance()
+	//
+	if( m_instance )
+	{
+		m_instance->StopNetworkThread();
+	}
 	m_instance.reset();
 }
 
@@ -650,9 +884,9 @@ void ManagerImpl::Authenticate( const String& login_url, const String& first_nam
     // Remind the avatar name for later use
     m_fullName = first_name.GetString() + std::string(" ") + last_name.GetString();
 
-	std::cout << "Logging in to " << login_url.GetString()
-		  << " as " << first_name.GetString()
-		  << " " << last_name.GetString() << "." << std::endl;
+	LLC_INFOS(LOGIN) << "Logging in to " << login_url.GetString()
+		<< " as " << first_name.GetString()
+		<< " " << last_name.GetString() << "." << LLC_ENDL;
 
 	// Determine starting place
 	std::stringstream start;
@@ -711,7 +945,7 @@ bool ManagerImpl::CheckForResponse()
 				std::string login_response = LLUserAuth::getInstance()->getResponse("login");
 				if( login_response == "true" )
 				{
-					std::cout << "Successful login!" << std::endl;
+					LLC_INFOS(LOGIN) << "Successful login!" << LLC_ENDL;
 					success = true;
 				}
 				else
@@ -767,6 +1001,17 @@ void LocalPumpMessages()
 	gMessageSystem->processAcks();
 }
 
+
+// Holds outgoing UDP traffic for the length of a pump, so it goes out in
+// one batch with any pending acks tacked on.
+//
+class SendBatchScope
+{
+public:
+	SendBatchScope()	{ gMessageSystem->beginSendBatch(); }
+	~SendBatchScope()	{ gMessageSystem->flushSendBatch(); }
+};
+
 }
 
 
@@ -775,49 +1020,38 @@ void ManagerImpl::RequestBuddyList()
 	LLUserAuth::options_t options;
 	options.clear();
 	//
-	typedef std::map<LLUUID, LLRelationship*> buddy_map_t;
-	buddy_map_t list;
-	//
 	if( LLUserAuth::getInstance()->getOptions( "buddy-list", options ) )
 	{
+		IdListImpl::LLUUIDList buddies;
+		buddies.reserve( options.size() );
+		//
 		LLUserAuth::options_t::iterator it = options.begin();
 		const LLUserAuth::options_t::iterator end = options.end();
-		LLUUID agent_id;
-		S32 has_rights = 0, given_rights = 0;
 		for (; it != end; ++it)
 		{
 			LLUserAuth::response_t::const_iterator option_it;
 			option_it = (*it).find("buddy_id");
-			if(option_it != (*it).end())
+			if( option_it == (*it).end() )
 			{
-				std::string id = (*option_it).second;
-				agent_id.set( id );
+				continue;
 			}
-			option_it = (*it).find("buddy_rights_has");
-			if(option_it != (*it).end())
+			LLUUID agent_id( (*option_it).second );
+			if( agent_id.isNull() )
 			{
-				has_rights = atoi((*option_it).second.c_str());
+				continue;
 			}
-			option_it = (*it).find("buddy_rights_given");
-			if(option_it != (*it).end())
-			{
-				given_rights = atoi((*option_it).second.c_str());
-			}
-			LLRelationship* rel = new LLRelationship(given_rights, has_rights, false);
-			list[agent_id] = rel;
+			buddies.push_back( agent_id );
+
+			// Only queues the request; the names come back in batches
 			//
 			std::string name;
 			gCacheName->getFullName( agent_id, name );
-			std::cout << "Cache name request for " << agent_id.asString().c_str() << std::endl;
-
-			// Send notice to GUI
-			//
-			m_friendAddSignal( String(agent_id.asString().c_str()) );
-
-			// This may be necessary for really long friends lists that cause us to get kicked out.
-			//
-			//LocalPumpMessages();
 		}
+		LLC_INFOS(LOGIN) << "Buddy list has " << buddies.size() << " entries" << LLC_ENDL;
+
+		// Send the whole list to the GUI at once
+		//
+		m_friendsAddedSignal( TakeIdList( buddies ) );
 	}
 
 	// Get inventory root folder
@@ -825,7 +1059,7 @@ void ManagerImpl::RequestBuddyList()
 	options.clear();
 	if( LLUserAuth::getInstance()->getOptions( "inventory-root", options ) )
 	{
-		std::cout << "Parsing inventory" << std::endl;
+		LLC_DEBUGS(LOGIN) << "Parsing inventory" << LLC_ENDL;
 		LLUserAuth::options_t::iterator			it  = options.begin();
 		const LLUserAuth::options_t::iterator	end = options.end();
 		//
@@ -986,16 +1220,12 @@ void ManagerImpl::RequestLogout()
 
 void ManagerImpl::PumpMessages()
 {
-	LLFrameTimer::updateFrameTime();
-	gAres->process();
-	gServicePump->pump();
-	gServicePump->callback();
-	gCacheName->processPending();
-
-	LocalPumpMessages();
+	{
+		SendBatchScope batch;
 
-	gXferManager->retransmitUnackedPackets();
-	gAssetStorage->checkForTimeouts();
+		LLFrameTimer::updateFrameTime();
+		m_pumpScheduler.Run();
+	}
 
 	LLCircuitData *cdp = gMessageSystem->mCircuitInfo.findCircuit( gHost );
 	if (!cdp)
@@ -1007,12 +1237,444 @@ void ManagerImpl::PumpMessages()
 }
 
 
-void ManagerImpl::SendInstantMessage( const String& target_id, const String& message, const bool to_group )
+/** \brief Gather every descriptor the message pump is waiting on.
+ *
+ * \return milliseconds until PumpMessages() should run regardless of socket activity.
+ */
+int ManagerImpl::CollectWaitSet( PollFdList& fds ) const
+{
+	fds.clear();
+	if( !m_started )
+	{
+		return PUMP_HOUSEKEEPING_MSECS;
+	}
+
+	typedef std::map<int, Manager::PollFd> FdMap;
+	FdMap fd_map;
+
+	if( gMessageSystem && gMessageSystem->mSocket != -1 )
+	{
+		fd_map[gMessageSystem->mSocket] = Manager::PollFd( gMessageSystem->mSocket, true, false );
+	}
+
+	FdToCallback::const_iterator		watch_iter = m_watchedFds.begin();
+	const FdToCallback::const_iterator	watch_end  = m_watchedFds.end();
+	for( ; watch_iter != watch_end; ++watch_iter )
+	{
+		fd_map[watch_iter->first] = Manager::PollFd( watch_iter->first, true, false );
+	}
+
+	int deadline = PUMP_HOUSEKEEPING_MSECS;
+
+	std::vector<S32> read_fds, write_fds;
+	const S32 ares_timeout = gAres ? gAres->getWaitFds( read_fds, write_fds ) : -1;
+	const S32 curl_timeout = LLCurl::getWaitFds( read_fds, write_fds );
+	const int xlate_timeout = m_translator.GetNextDeadline();
+	if( ares_timeout >= 0 ) deadline = llmin( deadline, (int) ares_timeout );
+	if( curl_timeout >= 0 ) deadline = llmin( deadline, (int) curl_timeout );
+	if( xlate_timeout >= 0 ) deadline = llmin( deadline, xlate_timeout );
+
+	// Circuit pings and LLEventTimers sit on timer wheels that know when they are next due
+	//
+	const U64 now_usecs = totalTime();
+	U64 due_usecs;
+	if( gMessageSystem && gMessageSystem->mCircuitInfo.getNextPingTime( due_usecs ) )
+	{
+		deadline = llmin( deadline, MsecsUntil( due_usecs, now_usecs ) );
+	}
+	if( LLEventTimer::getNextTickTime( due_usecs ) )
+	{
+		deadline = llmin( deadline, MsecsUntil( due_usecs, now_usecs ) );
+	}
+
+	for( size_t idx = 0; idx < read_fds.size(); ++idx )
+	{
+		Manager::PollFd& pfd = fd_map[read_fds[idx]];
+		pfd.m_fd   = read_fds[idx];
+		pfd.m_read = true;
+	}
+	for( size_t idx = 0; idx < write_fds.size(); ++idx )
+	{
+		Manager::PollFd& pfd = fd_map[write_fds[idx]];
+		pfd.m_fd    = write_fds[idx];
+		pfd.m_write = true;
+	}
+
+	FdMap::const_iterator		iter = fd_map.begin();
+	const FdMap::const_iterator	end  = fd_map.end();
+	for( ; iter != end; ++iter )
+	{
+		fds.push_back( iter->second );
+	}
+
+	// Chains that are ready to run, or callbacks queued by them, must not wait
+	//
+	if( (gServicePump && gServicePump->hasPendingWork()) || m_pumpScheduler.HasPendingWork() )
+	{
+		deadline = 0;
+	}
+
+	// Packets already pulled off the socket won't wake us up again
+	//
+	if( gMessageSystem && gMessageSystem->mPacketRing.hasBatchedPackets() )
+	{
+		deadline = 0;
+	}
+
+	return deadline;
+}
+
+
+int ManagerImpl::GetPollFds( Manager::PollFd* fds, const int max_fds ) const
+{
+	PollFdList list;
+	if( m_networkThread )
+	{
+		// The front-end only waits for events to come back
+		//
+		if( m_networkThread->GetEventFd() != -1 )
+		{
+			list.push_back( Manager::PollFd( m_networkThread->GetEventFd(), true, false ) );
+		}
+	}
+	else
+	{
+		CollectWaitSet( list );
+	}
+
+	const int count = (int) list.size();
+	for( int idx = 0; idx < count && idx < max_fds; ++idx )
+	{
+		fds[idx] = list[idx];
+	}
+
+	return count;
+}
+
+
+int ManagerImpl::GetNextDeadline() const
+{
+	if( m_networkThread )
+	{
+		// Without an event descriptor the front-end has to poll
+		//
+		return m_networkThread->GetEventFd() != -1 ? PUMP_HOUSEKEEPING_MSECS : NETWORK_EVENT_POLL_MSECS;
+	}
+
+	PollFdList list;
+	return CollectWaitSet( list );
+}
+
+
+void ManagerImpl::WatchFd( const int fd, const Manager::FdCallback& callback )
+{
+	m_watchedFds[fd] = callback;
+}
+
+
+void ManagerImpl::UnwatchFd( const int fd )
+{
+	m_watchedFds.erase( fd );
+}
+
+
+#if LL_LINUX
+/** \brief Bring the epoll registration in line with the current wait set.
+ *
+ * The UDP socket and watched descriptors rarely change, so they are left alone. Curl and
+ * ares sockets come and go, and a closed descriptor number can be handed out again to a
+ * new connection, so those are always re-armed.
+ */
+void ManagerImpl::SyncEpoll( const PollFdList& fds )
+{
+	if( m_epollFd == -1 )
+	{
+		m_epollFd = epoll_create( 16 );
+		if( m_epollFd == -1 )
+		{
+			llwarns << "epoll_create() failed, errno=" << errno << llendl;
+			return;
+		}
+	}
+
+	FdToEvents wanted;
+	for( size_t idx = 0; idx < fds.size(); ++idx )
+	{
+		U32 events = 0;
+		if( fds[idx].m_read  ) events |= EPOLLIN;
+		if( fds[idx].m_write ) events |= EPOLLOUT;
+		wanted[fds[idx].m_fd] = events;
+	}
+
+	FdToEvents::iterator registered = m_epollEvents.begin();
+	while( registered != m_epollEvents.end() )
+	{
+		if( wanted.find( registered->first ) == wanted.end() )
+		{
+			// The descriptor may already be closed, in which case the kernel dropped it for us
+			//
+			epoll_ctl( m_epollFd, EPOLL_CTL_DEL, registered->first, NULL );
+			m_epollEvents.erase( registered++ );
+		}
+		else
+		{
+			++registered;
+		}
+	}
+
+	FdToEvents::const_iterator			iter = wanted.begin();
+	const FdToEvents::const_iterator	end  = wanted.end();
+	for( ; iter != end; ++iter )
+	{
+		const int fd = iter->first;
+		const bool stable = (fd == gMessageSystem->mSocket) || (m_watchedFds.find( fd ) != m_watchedFds.end());
+		FdToEvents::iterator found = m_epollEvents.find( fd );
+		if( stable && found != m_epollEvents.end() && found->second == iter->second )
+		{
+			continue;
+		}
+
+		struct epoll_event ev;
+		memset( &ev, 0, sizeof(ev) );
+		ev.events  = iter->second;
+		ev.data.fd = fd;
+
+		int op = (found != m_epollEvents.end())? EPOLL_CTL_MOD: EPOLL_CTL_ADD;
+		int result = epoll_ctl( m_epollFd, op, fd, &ev );
+		if( result == -1 && errno == ENOENT )
+		{
+			result = epoll_ctl( m_epollFd, EPOLL_CTL_ADD, fd, &ev );
+		}
+		else if( result == -1 && errno == EEXIST )
+		{
+			result = epoll_ctl( m_epollFd, EPOLL_CTL_MOD, fd, &ev );
+		}
+
+		if( result == -1 )
+		{
+			llwarns << "epoll_ctl() failed for fd " << fd << ", errno=" << errno << llendl;
+			m_epollEvents.erase( fd );
+		}
+		else
+		{
+			m_epollEvents[fd] = iter->second;
+		}
+	}
+}
+#endif
+
+
+/** \brief Sleep until something in the wait set is ready or the deadline passes.
+ */
+bool ManagerImpl::WaitForEvents( const int max_wait_msecs )
+{
+	if( m_networkThread )
+	{
+		return m_networkThread->WaitForEvents( max_wait_msecs );
+	}
+
+	PollFdList fds;
+	const int timeout = PrepareWait( fds, max_wait_msecs );
+	return WaitOn( fds, timeout );
+}
+
+
+/** \brief Build the wait set and get the poller ready for it.
+ *
+ * Split from WaitOn() so the network thread can do this part under the library lock
+ * and sleep without it.
+ *
+ * \return milliseconds to wait.
+ */
+int ManagerImpl::PrepareWait( PollFdList& fds, const int max_wait_msecs )
+{
+	int timeout = CollectWaitSet( fds );
+	if( max_wait_msecs >= 0 && max_wait_msecs < timeout )
+	{
+		timeout = max_wait_msecs;
+	}
+
+#if LL_LINUX
+	SyncEpoll( fds );
+#endif
+
+	return timeout;
+}
+
+
+/** \brief Wait on a set built by PrepareWait(). Touches nothing but the poller and m_readyFds.
+ */
+bool ManagerImpl::WaitOn( const PollFdList& fds, const int timeout )
+{
+	m_readyFds.clear();
+
+#if LL_LINUX
+	if( m_epollFd == -1 )
+	{
+		ms_sleep( timeout );
+		return false;
+	}
+
+	const int MAX_EVENTS = 64;
+	struct epoll_event events[MAX_EVENTS];
+	const int count = epoll_wait( m_epollFd, events, MAX_EVENTS, timeout );
+	for( int idx = 0; idx < count; ++idx )
+	{
+		m_readyFds.push_back( events[idx].data.fd );
+	}
+#else
+	fd_set read_set, write_set;
+	FD_ZERO( &read_set  );
+	FD_ZERO( &write_set );
+	int max_fd = -1;
+	for( size_t idx = 0; idx < fds.size(); ++idx )
+	{
+		if( fds[idx].m_read  ) FD_SET( fds[idx].m_fd, &read_set  );
+		if( fds[idx].m_write ) FD_SET( fds[idx].m_fd, &write_set );
+		max_fd = llmax( max_fd, fds[idx].m_fd );
+	}
+
+	if( max_fd == -1 )
+	{
+		// Winsock refuses select() on an empty set
+		//
+		ms_sleep( timeout );
+		return false;
+	}
+
+	struct timeval tv;
+	tv.tv_sec  = timeout / 1000;
+	tv.tv_usec = (timeout % 1000) * 1000;
+	const int count = select( max_fd + 1, &read_set, &write_set, NULL, &tv );
+	if( count > 0 )
+	{
+		for( size_t idx = 0; idx < fds.size(); ++idx )
+		{
+			if( FD_ISSET( fds[idx].m_fd, &read_set ) || FD_ISSET( fds[idx].m_fd, &write_set ) )
+			{
+				m_readyFds.push_back( fds[idx].m_fd );
+			}
+		}
+	}
+#endif
+
+	return !m_readyFds.empty();
+}
+
+
+void ManagerImpl::DispatchWatchedFds()
+{
+	for( size_t idx = 0; idx < m_readyFds.size(); ++idx )
+	{
+		FdToCallback::iterator found = m_watchedFds.find( m_readyFds[idx] );
+		if( found != m_watchedFds.end() )
+		{
+			// Copy it, the callback is allowed to unwatch itself
+			//
+			Manager::FdCallback callback = found->second;
+			callback();
+		}
+	}
+	m_readyFds.clear();
+}
+
+
+void ManagerImpl::RunUntil( const Manager::DonePredicate& done )
+{
+	while( !done() )
+	{
+		if( m_networkThread )
+		{
+			m_networkThread->WaitForEvents( -1 );
+			m_networkThread->DispatchEvents();
+			continue;
+		}
+
+		WaitForEvents( -1 );
+		DispatchWatchedFds();
+		PumpMessages();
+	}
+}
+
+
+/** \brief Move the message pump onto its own thread.
+ *
+ * From here on signals are queued and fired by DispatchEvents(), and RunCommand()
+ * hands calls over to the thread instead of making them.
+ */
+void ManagerImpl::StartNetworkThread()
+{
+	if( m_networkThread )
+	{
+		return;
+	}
+
+	m_retiredThread.reset();
+	m_networkThread.reset( new NetworkThread( *this ) );
+	m_networkThread->Start();
+}
+
+
+/** \brief Bring the message pump back to the calling thread.
+ *
+ * Whatever was still queued in either direction is run here before returning.
+ * A thread that does not stop in time keeps the library lock and is leaked.
+ */
+void ManagerImpl::StopNetworkThread()
+{
+	if( !m_networkThread )
+	{
+		return;
+	}
+
+	if( !m_networkThread->Stop() )
+	{
+		// Stuck in a handler. The thread still uses the object and the other
+		// end of its queues, so it is leaked, not drained or deleted.
+		//
+		( new boost::scoped_ptr<NetworkThread> )->swap( m_networkThread );
+		return;
+	}
+	m_networkThread->RunCommands();
+	if( m_networkThread->IsDispatching() )
+	{
+		// Called from a slot. The dispatch loop we are inside fires whatever is
+		// left, so the thread object has to outlive it.
+		//
+		m_retiredThread.swap( m_networkThread );
+	}
+	else
+	{
+		m_networkThread->DispatchEvents();
+	}
+	m_networkThread.reset();
+}
+
+
+void ManagerImpl::RunCommand( const NetworkThread::Call& call )
+{
+	if( m_networkThread && !NetworkThread::IsNetworkThread() )
+	{
+		m_networkThread->PostCommand( call );
+	}
+	else
+	{
+		call();
+	}
+}
+
+
+int ManagerImpl::DispatchEvents( const int max_events )
+{
+	return m_networkThread ? m_networkThread->DispatchEvents( max_events ) : 0;
+}
+
+
+void ManagerImpl::SendInstantMessage( const LLUUID& to_uuid, const std::string& message, const bool to_group )
 {
-	LLUUID to_uuid( target_id.GetString() );
 	LLUUID im_session_id = to_group? to_uuid: to_uuid ^ m_agentId;
 
-	std::cout << "ManagerImpl::SendInstantMessage()" << std::endl;
+	LLC_DEBUGS(IM) << "Sending to " << to_uuid << LLC_ENDL;
 
 	LLMessageSystem* msg = gMessageSystem;
 	pack_instant_message(
@@ -1022,7 +1684,7 @@ void ManagerImpl::SendInstantMessage( const String& target_id, const String& mes
 			m_sessionId,
 			to_uuid,
 			m_fullName.c_str(),
-			message.GetString(),
+			message,
 			IM_ONLINE,
 			to_group? IM_SESSION_SEND: IM_NOTHING_SPECIAL,
 			im_session_id);
@@ -1030,12 +1692,11 @@ void ManagerImpl::SendInstantMessage( const String& target_id, const String& mes
 }
 
 
-void ManagerImpl::SendTypingSignal( const String& target_id, const bool to_group, const bool typing )
+void ManagerImpl::SendTypingSignal( const LLUUID& to_uuid, const bool to_group, const bool typing )
 {
-	LLUUID to_uuid( target_id.GetString() );
 	LLUUID im_session_id = to_group? to_uuid: to_uuid ^ m_agentId;
 
-	std::cout << "ManagerImpl::SendTypingSignal()" << std::endl;
+	LLC_DEBUGS(IM) << "Typing " << typing << " to " << to_uuid << LLC_ENDL;
 
 	LLMessageSystem* msg = gMessageSystem;
 	pack_instant_message(
@@ -1286,19 +1947,18 @@ String ManagerImpl::GetPerson( const int index ) const
 
 void ManagerImpl::HandleCacheUpdate( const LLUUID& id, const std::string fullName, const bool is_group )
 {
-	m_cacheReceivedMap[id] = true;
-	//
 	if( is_group )
 	{
-		LLGroupData data;
-		data.mID   = id;
-		data.mName = fullName;
-		m_groupMap[id] = data;
+		AgentRecord& record = GetGroupRecord( id );
+		record.mCacheReceived = true;
+		record.mGroup.mName   = fullName;
 	}
 	else
 	{
+		AgentRecord& record = m_agents.findOrInsert( id );
+		record.mCacheReceived = true;
+		record.mFullName      = fullName;
 		m_nameToIdMap[fullName] = id;
-		m_idToNameMap[id] = fullName;
 	}
 	//
 	m_cacheSignal	( String( id.getString().c_str() )
@@ -1311,7 +1971,7 @@ void ManagerImpl::HandleCacheUpdate( const LLUUID& id, const std::string fullNam
 void ManagerImpl::OnCacheNameCallback( const LLUUID& id, const std::string& firstname, const std::string& lastname, BOOL is_group, void* data )
 {
 	std::string fullName = firstname + " " + lastname;
-	std::cout << "Cache arrived for " << id.asString().c_str() << ", name=" << fullName.c_str() << std::endl;
+	LLC_DEBUGS(NAMES) << "Cache arrived for " << id << ", name=" << fullName << LLC_ENDL;
 	HandleCacheUpdate( id, fullName, is_group );
 }
 
@@ -1383,9 +2043,9 @@ void ManagerImpl::TeleportToRegion( const std::string& slurl )
 	m_z = 0;
 	parse( sim_string, m_destRegionName, &m_x, &m_y, &m_z );
 
-	std::cout << "Teleporting to " << m_destRegionName.c_str()
+	LLC_INFOS(TELEPORT) << "Teleporting to " << m_destRegionName
 		<< ", (" << m_x << ", " << m_y << ", " << m_z << ")"
-		<< std::endl;
+		<< LLC_ENDL;
 
 	// We have to request a lookup from the server for the region name
 	// to region code
@@ -1431,7 +2091,7 @@ void ManagerImpl::OnMapBlockReply( LLMessageSystem* msg, void **user_data )
 		return;
 	}
 
-	std::cout << "Got MapBlockReply, waiting for name=" << m_destRegionName.c_str() << std::endl;
+	LLC_DEBUGS(TELEPORT) << "Got MapBlockReply, waiting for name=" << m_destRegionName << LLC_ENDL;
 
 	S32 num_blocks = msg->getNumberOfBlocksFast(_PREHASH_Data);
 
@@ -1464,7 +2124,7 @@ void ManagerImpl::OnMapBlockReply( LLMessageSystem* msg, void **user_data )
 		if (accesscode == 255)
 		{
 			found_null_sim = true;
-			std::cout << "Null sim" << std::endl;
+			LLC_DEBUGS(TELEPORT) << "Null sim" << LLC_ENDL;
 		}
 		else
 		{
@@ -1556,7 +2216,7 @@ void ManagerImpl::OnTeleportLocal( LLMessageSystem* msg, void **user_data )
 
 void ManagerImpl::OnTeleportFinish( LLMessageSystem* msg, void **user_data )
 {
-	std::cout << "Got teleport location message" << std::endl;
+	LLC_DEBUGS(TELEPORT) << "Got teleport location message" << LLC_ENDL;
 
 	LLUUID agent_id;
 	msg->getUUIDFast(_PREHASH_Info, _PREHASH_AgentID, agent_id);
@@ -1596,7 +2256,7 @@ void ManagerImpl::OnTeleportFinish( LLMessageSystem* msg, void **user_data )
 
 	// now, use the circuit info to tell simulator about us!
 	//
-	std::cout << "process_teleport_finish() Enabling " << sim_host << " with code " << msg->mOurCircuitCode << std::endl;
+	LLC_INFOS(TELEPORT) << "Enabling " << sim_host << " with code " << msg->mOurCircuitCode << LLC_ENDL;
 	msg->newMessageFast(_PREHASH_UseCircuitCode);
 	msg->nextBlockFast(_PREHASH_CircuitCode);
 	msg->addU32Fast(_PREHASH_Code, msg->getOurCircuitCode());
@@ -1708,32 +2368,63 @@ struct LLOfferInfo
 };
 
 
-LLSD ManagerImpl::GetDetectQuery( const std::string& message )
+void ManagerImpl::SetLanguage( const std::string& lang_id )
 {
-	LLSD query;
-	query["key"]		= GoogleTranslateResponder::GetApiKey();
-	query["q"]			= message;
-	query["v"]			= "1.0";
-
-	return query;
+	m_langId = lang_id;
+	m_translator.SetTargetLanguage( lang_id );
 }
 
 
-LLSD ManagerImpl::GetTranslateQuery( const std::string& sourceLangId, const std::string& message )
+/** \brief Called by the translation pipeline when it has reliably detected
+ * the language an agent writes in.
+ */
+void ManagerImpl::HandleLanguageDetected( const LLUUID& agent_id, const std::string& language )
 {
-	LLSD query;
-	query["key"]		= GoogleTranslateResponder::GetApiKey();
-	query["langpair"]	= sourceLangId + "|" + m_langId;
-	query["q"]			= message;
-	query["v"]			= "1.0";
+	if( !GetAgentLanguageAuto( agent_id ) )
+	{
+		return;
+	}
 
-	return query;
+	std::string full_name;
+	GetNameFromCache( agent_id, full_name );
+	//
+	LLC_DEBUGS(IM)	<< "Setting "		<< language
+					<< " for agent "	<< agent_id
+					<< ", "				<< full_name
+					<< LLC_ENDL;
+
+	// Remember it, so later lines from this agent skip detection
+	//
+	SetAgentLanguage( agent_id, language );
+}
+
+
+/** \brief Hand one chat line to the translation pipeline.
+ *
+ * Lines that are not translated go through it as well, so that they stay in
+ * order with the ones that are.
+ */
+void ManagerImpl::SubmitChatLine	( const std::string& conversation
+									, const LLUUID& from_id
+									, const bool translate
+									, LLSD& params
+									, const TranslationPipeline::DispatchFn& dispatch
+									)
+{
+	if( !translate )
+	{
+		params["message"]	= params["source"];
+		params["language"]	= m_langId;
+	}
+	//
+	m_translator.Submit( conversation, from_id, GetAgentLanguage( from_id ), params, dispatch, translate );
 }
 
 
 void ManagerImpl::HandleGroupChatDispatch( const LLSD& params )
 {
 	LLUUID group_id			= params["group_id"];
+	LLUUID from_id			= params["from_id"];
 	std::string group_name	= params["group_name"];
 	std::string agent_name	= params["agent_name"];
 	bool has_me				= params["has_me"];
@@ -1741,92 +2432,35 @@ void ManagerImpl::HandleGroupChatDispatch( const LLSD& params )
 	std::string translated	= params["message"];
 	std::string language	= params["language"];
 
-	String str_group_id( group_id.getString().c_str() );
-	String str_name( group_name.c_str() );
-	String str_agent( agent_name.c_str() );
-	String str_message( message.c_str() );
-	String str_translated( translated.c_str() );
-	String str_language( language.c_str() );
-	//
-	m_groupChatSignal( str_group_id, str_name, str_agent, has_me, str_message, str_translated, str_language );
-}
-
-
-void ManagerImpl::HandleGroupChatDetect( const LLSD& params )
-{
-	if( params["isReliable"].asBoolean()
-		&& (params["confidence"].asReal() > GOOGLE_XLATE_CONFIDENCE_CODE) )
-	{
-		const LLUUID	agent_id = params["from_id"].asUUID();
-		std::string		language = params["language"].asString();
-		if( GetAgentLanguageAuto( agent_id ) )
-		{
-			std::string full_name;
-			GetNameFromCache( agent_id, full_name );
-			//
-			std::cout	<< "Setting "		<< language.c_str()
-						<< " for agent "	<< agent_id.asString().c_str()
-						<< ", "				<< full_name.c_str()
-						<< std::endl;
-
-			// Set the language for this agent, since it's reliable
-			//
-			SetAgentLanguage( agent_id, language );
-		}
-		else
-		{
-			language = GetAgentLanguage( agent_id );
-		}
+	if( !m_chatEventSignal.empty() )
+	{
+		Manager::ChatEvent event;
+		event.m_type		= Manager::ChatEvent::CHAT_GROUP;
+		event.m_fromId		= ToUuid( from_id );
+		event.m_groupId		= ToUuid( group_id );
+		event.m_fromName	= ToStringRef( agent_name );
+		event.m_groupName	= ToStringRef( group_name );
+		event.m_hasMe		= has_me;
+		event.m_message		= ToStringRef( message );
+		event.m_translated	= ToStringRef( translated );
+		event.m_language	= ToStringRef( language );
+		SendChatEvent( event );
+	}
+
+	if( !m_groupChatSignal.empty() )
+	{
+		String str_group_id( group_id.getString().c_str() );
+		String str_name( group_name.c_str() );
+		String str_agent( agent_name.c_str() );
+		String str_message( message.c_str() );
+		String str_translated( translated.c_str() );
+		String str_language( language.c_str() );
 		//
-		GoogleTranslateResponder* responder = new GoogleTranslateResponder( params );
-		responder->ConnectArrivalSignal( boost::bind( &ManagerImpl::HandleGroupChatDispatch, this, _1 ) );
-		//
-		LLHTTPClient::get	( GoogleTranslateResponder::GetTranslateUrl()
-							, GetTranslateQuery( language, params["source"].asString() )
-							, responder
-							);
-	}
-	else
-	{
-		LLSD _params( params );
-		_params["language"]	= m_langId;
-		_params["message"]	= params["source"];
-		//
-		HandleGroupChatDispatch( params );
+		m_groupChatSignal( str_group_id, str_name, str_agent, has_me, str_message, str_translated, str_language );
 	}
 }
 
 
-void ManagerImpl::HandleGroupChatTranslationResponse
-								( const LLUUID& group_id
-								, const LLUUID& from_id
-								, const std::string& group_name
-								, const std::string& agent_name
-								, const bool has_me
-								, const std::string& message
-								)
-{
-	static int serialId = 0;
-
-	LLSD params;
-	params["group_id"]	= group_id;
-	params["from_id"]	= from_id;
-	params["group_name"]= group_name;
-	params["agent_name"]= agent_name;
-	params["has_me"]	= has_me;
-	params["source"]	= message;
-	params["serial_id"]	= serialId++;
-	//
-	GoogleDetectResponder* responder = new GoogleDetectResponder( params );
-	responder->ConnectArrivalSignal( boost::bind( &ManagerImpl::HandleGroupChatDetect, this, _1 ) );
-	//
-	LLHTTPClient::get	( GoogleResponderBase::GetDetectUrl()
-						, GetDetectQuery( message )
-						, responder
-						);
-}
-
-
 void ManagerImpl::HandleIMDispatch( const LLSD& params )
 {
 	LLUUID from_id			= params["from_id"];
@@ -1836,87 +2470,33 @@ void ManagerImpl::HandleIMDispatch( const LLSD& params )
 	std::string translated	= params["message"];
 	std::string language	= params["language"];
 
-	String str_id( from_id.getString().c_str() );
-	String str_name( name.c_str() );
-	String str_message( message.c_str() );
-	String str_translated( translated.c_str() );
-	String str_language( language.c_str() );
-	//
-	m_imSignal( str_id, str_name, has_me, str_message, str_translated, str_language );
-}
-
-
-void ManagerImpl::HandleIMDetect( const LLSD& params )
-{
-	const bool isReliable = params["isReliable"].asBoolean();
-	const F32 confidence  = params["confidence"].asReal();
-	if( isReliable && (confidence > GOOGLE_XLATE_CONFIDENCE_CODE))
+	if( !m_chatEventSignal.empty() )
 	{
-		const LLUUID	agent_id = params["from_id"].asUUID();
-		std::string		language = params["language"].asString();
-		if( GetAgentLanguageAuto( agent_id ) )
-		{
-			std::string full_name;
-			GetNameFromCache( agent_id, full_name );
-			//
-			std::cout	<< "Setting "		<< language.c_str()
-						<< " for agent "	<< agent_id.asString().c_str()
-						<< ", "				<< full_name.c_str()
-						<< std::endl;
-
-			// Set the language for this agent, since it's reliable
-			//
-			SetAgentLanguage( agent_id, language );
-		}
-		else
-		{
-			language = GetAgentLanguage( agent_id );
-		}
-		//
-		GoogleTranslateResponder* responder = new GoogleTranslateResponder( params );
-		responder->ConnectArrivalSignal( boost::bind( &ManagerImpl::HandleIMDispatch, this, _1 ) );
-		//
-		LLHTTPClient::get	( GoogleResponderBase::GetTranslateUrl()
-							, GetTranslateQuery( language, params["source"] )
-							, responder
-							);
+		Manager::ChatEvent event;
+		event.m_type		= Manager::ChatEvent::CHAT_IM;
+		event.m_fromId		= ToUuid( from_id );
+		event.m_groupId		= Uuid::Null();
+		event.m_fromName	= ToStringRef( name );
+		event.m_hasMe		= has_me;
+		event.m_message		= ToStringRef( message );
+		event.m_translated	= ToStringRef( translated );
+		event.m_language	= ToStringRef( language );
+		SendChatEvent( event );
 	}
-	else
+
+	if( !m_imSignal.empty() )
 	{
-		LLSD _params( params );
-		_params["language"]	= m_langId;
-		_params["message"]	= params["source"];
+		String str_id( from_id.getString().c_str() );
+		String str_name( name.c_str() );
+		String str_message( message.c_str() );
+		String str_translated( translated.c_str() );
+		String str_language( language.c_str() );
 		//
-		HandleIMDispatch( params );
+		m_imSignal( str_id, str_name, has_me, str_message, str_translated, str_language );
 	}
 }
 
 
-void ManagerImpl::HandleIMTranslationResponse	( const LLUUID& from_id
-												, const std::string& name
-												, const bool has_me
-												, const std::string& message
-												)
-{
-	static int serialId = 0;
-
-	LLSD params;
-	params["from_id"]	= from_id;
-	params["name"]		= name;
-	params["has_me"]	= has_me;
-	params["source"]	= message;
-	params["serial_id"]	= serialId++;
-	//
-	GoogleDetectResponder* responder = new GoogleDetectResponder( params );
-	responder->ConnectArrivalSignal( boost::bind( &ManagerImpl::HandleIMDetect, this, _1 ) );
-	//
-	LLHTTPClient::get	( GoogleResponderBase::GetDetectUrl()
-						, GetDetectQuery( message )
-						, responder
-						);
-}
-
-
 void ManagerImpl::HandleLocalChatDispatch( const LLSD& params )
 {
 	LLUUID from_id			= params["from_id"];
@@ -1927,90 +2507,52 @@ void ManagerImpl::HandleLocalChatDispatch( const LLSD& params )
 	std::string translated	= params["message"];
 	std::string language	= params["language"];
 
-	String str_from_id( from_id.getString().c_str() );
-	String str_name( from_name.c_str() );
-	String str_verb( verb.c_str() );
-	String str_message( message.c_str() );
-	String str_translated( translated.c_str() );
-	String str_language( language.c_str() );
-	//
-	m_localChatSignal( str_from_id, str_name, str_verb, has_me, str_message, str_translated, str_language );
+	if( !m_chatEventSignal.empty() )
+	{
+		Manager::ChatEvent event;
+		event.m_type		= Manager::ChatEvent::CHAT_LOCAL;
+		event.m_fromId		= ToUuid( from_id );
+		event.m_groupId		= Uuid::Null();
+		event.m_fromName	= ToStringRef( from_name );
+		event.m_verb		= ToStringRef( verb );
+		event.m_hasMe		= has_me;
+		event.m_message		= ToStringRef( message );
+		event.m_translated	= ToStringRef( translated );
+		event.m_language	= ToStringRef( language );
+		SendChatEvent( event );
+	}
+
+	if( !m_localChatSignal.empty() )
+	{
+		String str_from_id( from_id.getString().c_str() );
+		String str_name( from_name.c_str() );
+		String str_verb( verb.c_str() );
+		String str_message( message.c_str() );
+		String str_translated( translated.c_str() );
+		String str_language( language.c_str() );
+		//
+		m_localChatSignal( str_from_id, str_name, str_verb, has_me, str_message, str_translated, str_language );
+	}
 }
 
 
-void ManagerImpl::HandleLocalChatDetect( const LLSD& params )
+void ManagerImpl::SendChatEvent( const Manager::ChatEvent& event )
 {
-	if( params["isReliable"].asBoolean()
-		&& (params["confidence"].asReal() > GOOGLE_XLATE_CONFIDENCE_CODE) )
-	{ 
-		const LLUUID	agent_id = params["from_id"].asUUID();
-		std::string		language = params["language"].asString();
-		if( GetAgentLanguageAuto( agent_id ) )
-		{
-			std::string full_name;
-			GetNameFromCache( agent_id, full_name );
-			//
-			std::cout	<< "Setting "		<< language.c_str()
-						<< " for agent "	<< agent_id.asString().c_str()
-						<< ", "				<< full_name.c_str()
-						<< std::endl;
-
-			// Set the language for this agent, since it's reliable
-			//
-			SetAgentLanguage( agent_id, language );
-		}
-		else
-		{
-			language = GetAgentLanguage( agent_id );
-		}
-		//
-		GoogleTranslateResponder* responder = new GoogleTranslateResponder( params );
-		responder->ConnectArrivalSignal( boost::bind( &ManagerImpl::HandleLocalChatDispatch, this, _1 ) );
+	if( NetworkThread::IsNetworkThread() )
+	{
+		// The strings it points at are gone by the time the front-end fires
+		// it, so a queued event carries its own copies
 		//
-		LLHTTPClient::get	( GoogleResponderBase::GetTranslateUrl()
-							, GetTranslateQuery( language, params["source"] )
-							, responder
-							);
+		boost::shared_ptr<ChatEventCopy> copy( new ChatEventCopy( event ) );
+		NetworkThread::PostEvent( boost::bind( &FireChatEventCopy, boost::ref( m_chatEventSignal ), copy ) );
 	}
 	else
 	{
-		LLSD _params( params );
-		_params["language"]	= m_langId;
-		_params["message"]	= params["source"];
-		//
-		HandleLocalChatDispatch( params );
+		m_chatEventSignal( event );
 	}
 }
 
 
-void ManagerImpl::HandleLocalChatTranslationResponse
-								( const LLUUID& from_id
-								, const std::string& from_name
-								, const std::string& verb
-								, const bool has_me
-								, const std::string& message
-								)
-{
-	static int serialId = 0;
-
-	LLSD params;
-	params["from_id"]	= from_id;
-	params["from_name"] = from_name;
-	params["verb"]		= verb;
-	params["has_me"]	= has_me;
-	params["source"]	= message;
-	params["serial_id"]	= serialId++;
-	//
-	GoogleDetectResponder* responder = new GoogleDetectResponder( params );
-	responder->ConnectArrivalSignal( boost::bind( &ManagerImpl::HandleLocalChatDetect, this, _1 ) );
-	//
-	LLHTTPClient::get	( GoogleResponderBase::GetDetectUrl()
-						, GetDetectQuery( message )
-						, responder
-						);
-}
-
-
 /** /brief if string starts with "/me" then remove and return true
  * /param [in,out] str -- string with "/me" removed if found
  * /return true if starts with "/me"
@@ -2071,22 +2613,18 @@ void ManagerImpl::OnProcessIMCallback( LLMessageSystem *msg, void **user_data )
 		{
 			const bool has_me = HasMe( message );
 			//
-			if( m_translateMessages )
-			{
-				HandleIMTranslationResponse( from_id, name, has_me, message );
-			}
-			else
-			{
-				LLSD params;
-				params["from_id"] 	= from_id;
-				params["name"]		= name;
-				params["source"]	= message;
-				params["has_me"]	= has_me;
-				params["message"] 	= message;
-				params["language"]	= m_langId;
-				//
-				HandleIMDispatch( params );
-			}
+			LLSD params;
+			params["from_id"] 	= from_id;
+			params["name"]		= name;
+			params["source"]	= message;
+			params["has_me"]	= has_me;
+			//
+			SubmitChatLine	( "im:" + from_id.asString()
+							, from_id
+							, m_translateMessages
+							, params
+							, boost::bind( &ManagerImpl::HandleIMDispatch, this, _1 )
+							);
 		}
 		break;
 
@@ -2096,29 +2634,20 @@ void ManagerImpl::OnProcessIMCallback( LLMessageSystem *msg, void **user_data )
 			std::string group_name = ll_safe_string( (char*) binary_bucket);
 			// This is group chat
 			//
-			if( m_translateMessages && (from_id != m_agentId) )
-			{
-				HandleGroupChatTranslationResponse
-					( session_id
-					, from_id
-					, group_name
-					, name
-					, has_me
-					, message );
-			}
-			else
-			{
-				LLSD params;
-				params["group_id"] 		= session_id;
-				params["group_name"]	= group_name;
-				params["agent_name"]	= name;
-				params["has_me"]		= has_me;
-				params["source"]		= message;
-				params["message"] 		= message;
-				params["language"]		= m_langId;
-				//
-				HandleGroupChatDispatch( params );
-			}
+			LLSD params;
+			params["group_id"] 		= session_id;
+			params["from_id"]		= from_id;
+			params["group_name"]	= group_name;
+			params["agent_name"]	= name;
+			params["has_me"]		= has_me;
+			params["source"]		= message;
+			//
+			SubmitChatLine	( "group:" + session_id.asString()
+							, from_id
+							, m_translateMessages && (from_id != m_agentId)
+							, params
+							, boost::bind( &ManagerImpl::HandleGroupChatDispatch, this, _1 )
+							);
 		}
 		break;
 
@@ -2184,7 +2713,7 @@ void ManagerImpl::OnProcessIMCallback( LLMessageSystem *msg, void **user_data )
 	case IM_SESSION_GROUP_START:
 	case IM_SESSION_CONFERENCE_START:
 	case IM_SESSION_LEAVE:
-		std::cout << "IM_SESSION_*" << std::endl;
+		LLC_DEBUGS(IM) << "Ignoring session dialog " << (S32) dialog << LLC_ENDL;
 		break;
 
 	case IM_GROUP_INVITATION:
@@ -2410,7 +2939,7 @@ void ManagerImpl::OnProcessIMCallback( LLMessageSystem *msg, void **user_data )
 	case IM_GROUP_INVITATION_DECLINE:
 	case IM_COUNT:
 		// Not supported (yet)
-		std::cout << "OTHER" << std::endl;
+		LLC_DEBUGS(IM) << "Ignoring dialog " << (S32) dialog << LLC_ENDL;
 		break;
 	}
 }
@@ -2477,26 +3006,21 @@ void ManagerImpl::OnProcessLocalChat( LLMessageSystem *msg, void **user_data )
 		{
 			const bool has_me = HasMe( mesg );
 			//
-			if( m_translateMessages
-				&& (sourceType == CHAT_SOURCE_AGENT)
-				&& (from_id != m_agentId)
-				)
-			{
-				HandleLocalChatTranslationResponse( from_id, from_name, verb, has_me, mesg );
-			}
-			else
-			{
-				LLSD params;
-				params["from_id"] 	= from_id;
-				params["from_name"]	= from_name;
-				params["verb"]		= verb;
-				params["has_me"]	= has_me;
-				params["source"] 	= mesg;
-				params["message"] 	= mesg;
-				params["language"]	= m_langId;
-				//
-				HandleLocalChatDispatch( params );
-			}
+			LLSD params;
+			params["from_id"] 	= from_id;
+			params["from_name"]	= from_name;
+			params["verb"]		= verb;
+			params["has_me"]	= has_me;
+			params["source"] 	= mesg;
+			//
+			SubmitChatLine	( "local"
+							, from_id
+							, m_translateMessages
+								&& (sourceType == CHAT_SOURCE_AGENT)
+								&& (from_id != m_agentId)
+							, params
+							, boost::bind( &ManagerImpl::HandleLocalChatDispatch, this, _1 )
+							);
 		}
 	}
 }
@@ -2511,8 +3035,9 @@ void ManagerImpl::OnOnlineNotifyCallback( LLMessageSystem *msg, void **user_data
 		LLUUID agent_id;
 		msg->getUUIDFast( _PREHASH_AgentBlock, _PREHASH_AgentID, agent_id, i );
 
-		m_onlineStatuses[agent_id] = true;
-		if( m_cacheReceivedMap[agent_id] )
+		AgentRecord& record = m_agents.findOrInsert( agent_id );
+		record.mOnline = true;
+		if( record.mCacheReceived )
 		{
 			// Only send if we got the cache first
 			//
@@ -2531,8 +3056,9 @@ void ManagerImpl::OnOfflineNotifyCallback( LLMessageSystem *msg, void **user_dat
 		LLUUID agent_id;
 		msg->getUUIDFast( _PREHASH_AgentBlock, _PREHASH_AgentID, agent_id, i );
 
-		m_onlineStatuses[agent_id] = false;
-		if( m_cacheReceivedMap[agent_id] )
+		AgentRecord& record = m_agents.findOrInsert( agent_id );
+		record.mOnline = false;
+		if( record.mCacheReceived )
 		{
 			// Only send if we got the cache first
 			//
@@ -2550,21 +3076,17 @@ void ManagerImpl::OnTerminateFriendshipCallback( LLMessageSystem *msg, void **us
 
 	// Pull these out of our local cache
 	//
-	m_cacheReceivedMap[id] = false;
-	std::string fullName;
-	//
-	LLUUIDToString::iterator id_iter = m_idToNameMap.find( id );
-	if( id_iter != m_idToNameMap.end() )
+	AgentRecord* record = m_agents.find( id );
+	if( record )
 	{
-		fullName = id_iter->second;
-		//
-		m_idToNameMap.erase( id_iter );
+		record->mCacheReceived = false;
 		//
-		StringToLLUUID::iterator name_iter = m_nameToIdMap.find( fullName );
+		StringToLLUUID::iterator name_iter = m_nameToIdMap.find( record->mFullName );
 		if( name_iter != m_nameToIdMap.end() )
 		{
 			m_nameToIdMap.erase( name_iter );
 		}
+		record->mFullName.clear();
 	}
 }
 
@@ -2607,7 +3129,7 @@ void ManagerImpl::OnSearchResultCallback( LLMessageSystem *msg, void **user_data
 
 void ManagerImpl::OnLogoutCallback( LLMessageSystem *msg, void **user_data )
 {
-	std::cout << "Log out reply received..." << std::endl;
+	LLC_INFOS(LOGIN) << "Log out reply received" << LLC_ENDL;
 
 	LLUUID agent_id;
 	msg->getUUIDFast( _PREHASH_AgentData, _PREHASH_AgentID, agent_id );
@@ -2662,7 +3184,6 @@ void ManagerImpl::OnAgentGroupDataUpdate( LLMessageSystem *msg, void **user_data
 {
 	LLUUID	agent_id;
 
-	std::cout << "ManagerImpl::OnAgentGroupDataUpdate()" << std::endl;
 
 	msg->getUUIDFast( _PREHASH_AgentData, _PREHASH_AgentID, agent_id );
 
@@ -2687,8 +3208,8 @@ void ManagerImpl::OnAgentGroupDataUpdate( LLMessageSystem *msg, void **user_data
 
 		if(group.mID.notNull())
 		{
-			std::cout << "Belongs to group " << group.mName.c_str() << std::endl;
-			m_groupMap[group.mID] = group;
+			LLC_DEBUGS(AGENT) << "Belongs to group " << group.mName << LLC_ENDL;
+			GetGroupRecord( group.mID ).mGroup = group;
 
 			m_groupCacheSignal( String(group.mID.getString().c_str()), String(group.mName.c_str()) );
 		}
@@ -2698,7 +3219,7 @@ void ManagerImpl::OnAgentGroupDataUpdate( LLMessageSystem *msg, void **user_data
 
 void ManagerImpl::OnAgentWearablesUpdate( LLMessageSystem *msg, void **user_data )
 {
-	std::cout << "ManagerImpl::OnAgentWearablesUpdate()" << std::endl;
+	LLC_DEBUGS(AGENT) << "Ignoring AgentWearablesUpdate" << LLC_ENDL;
 	//
 	// WARNING!!!! This causes big problems with OpenSIM...don't use this!
 	//
@@ -2708,7 +3229,7 @@ void ManagerImpl::OnAgentWearablesUpdate( LLMessageSystem *msg, void **user_data
 
 void ManagerImpl::OnAgentCachedTextureResponse( LLMessageSystem* msg, void **user_data )
 {
-	std::cout << "ManagerImpl::OnAgentCachedTextureResponse()" << std::endl;
+	LLC_DEBUGS(AGENT) << "Ignoring AgentCachedTextureResponse" << LLC_ENDL;
 	//
 	// WARNING!!!! This causes big problems with OpenSIM...don't use this!
 	//
@@ -2718,7 +3239,7 @@ void ManagerImpl::OnAgentCachedTextureResponse( LLMessageSystem* msg, void **use
 
 void ManagerImpl::OnKickUserCallback( LLMessageSystem *msg, void **user_data )
 {
-	std::cout << "Kicked from sim!" << std::endl;
+	LLC_WARNS(LOGIN) << "Kicked from sim!" << LLC_ENDL;
 
 	std::string message;
 	msg->getStringFast( _PREHASH_UserInfo, _PREHASH_Reason, message );
@@ -2742,18 +3263,18 @@ void ManagerImpl::GetNameFromCache( const LLUUID& id, std::string& full_name )
 }
 
 
-String ManagerImpl::GetFullName( const String& id )
+const std::string& ManagerImpl::GetFullName( const LLUUID& agent_id )
 {
-	LLUUID agent_id( id.GetString() );
-	std::string name;
-	name = m_idToNameMap[agent_id];
-	return String( name.c_str() );
+	static const std::string empty;
+	const AgentRecord* record = m_agents.find( agent_id );
+	return record ? record->mFullName : empty;
 }
 
 
 String ManagerImpl::LookupId( const String& fullname )
 {
-	std::string id = m_nameToIdMap[fullname.GetString()].getString();
+	StringToLLUUID::const_iterator iter = m_nameToIdMap.find( fullname.GetString() );
+	std::string id = ( iter != m_nameToIdMap.end() ? iter->second : LLUUID::null ).getString();
 	return String( id.c_str() );
 }
 
@@ -2761,40 +3282,68 @@ String ManagerImpl::LookupId( const String& fullname )
 String ManagerImpl::LookupGroupName( const String& id )
 {
 	LLUUID group_id( id.GetString() );
-	std::string groupName = m_groupMap[group_id].mName;
+	const AgentRecord* record = m_agents.find( group_id );
+	std::string groupName;
+	if( record && record->mIsGroup )
+	{
+		groupName = record->mGroup.mName;
+	}
 	if( groupName.empty() )
 	{
 		gCacheName->getGroupName( group_id, groupName );
-		m_groupMap[group_id].mName = groupName;
+		GetGroupRecord( group_id ).mGroup.mName = groupName;
 	}
 	//
 	return String( groupName.c_str() );
 }
 
 
-bool ManagerImpl::IsOnline( const String& id )
+bool ManagerImpl::IsOnline( const LLUUID& agent_id )
 {
-	LLUUID agent_id( id.GetString() );
-	return m_onlineStatuses[agent_id];
+	const AgentRecord* record = m_agents.find( agent_id );
+	return record && record->mOnline;
 } 
 
-bool ManagerImpl::IsFriend( const String& id )
+bool ManagerImpl::IsFriend( const LLUUID& agent_id )
 {
-	LLUUID agent_id( id.GetString() );
-	return m_cacheReceivedMap[agent_id];
+	const AgentRecord* record = m_agents.find( agent_id );
+	return record && record->mCacheReceived;
 }
 
 
-void ManagerImpl::UpdateLocalAvatars()
+ManagerImpl::AgentRecord& ManagerImpl::GetGroupRecord( const LLUUID& group_id )
 {
-	LLViewerRegion::LLUUIDList	nearAvs;
-	m_viewerRegion->getAvatars( nearAvs, m_agent.getPosGlobalFromAgent( m_agentPosition ), CHAT_NORMAL_RADIUS );
+	AgentRecord& record = m_agents.findOrInsert( group_id );
+	record.mIsGroup   = true;
+	record.mGroup.mID = group_id;
+	return record;
+}
 
-	if( nearAvs != m_nearAvatars )
+
+void ManagerImpl::UpdateLocalAvatars( const LLViewerRegion* region )
+{
+	// Neighbour regions send coarse updates too, but chat range is only
+	// ever looked for in the region we are in
+	//
+	if( region != m_viewerRegion.get() )
 	{
-		m_nearAvatars = nearAvs;
-		m_localAgentsPresentSignal();
+		return;
 	}
+
+	LLViewerRegion::LLUUIDList	entered;
+	LLViewerRegion::LLUUIDList	left;
+	if( !m_viewerRegion->updateNearbyAvatars( m_nearAvatars
+											, m_agent.getPosGlobalFromAgent( m_agentPosition )
+											, CHAT_NORMAL_RADIUS
+											, entered
+											, left
+											) )
+	{
+		return;
+	}
+
+	m_localAgentUpdateSignal( TakeIdList( entered ), TakeIdList( left ) );
+	m_localAgentsPresentSignal();
 }
 
 
@@ -2817,8 +3366,9 @@ String ManagerImpl::GetLocalAvatar( const int idx ) const
 
 void ManagerImpl::SendGroupChatInvite( const LLUUID& groupId, const std::string& fromName, const std::string& message )
 {
+	const AgentRecord* record = m_agents.find( groupId );
 	m_groupChatSignal		( String(groupId.getString().c_str())
-							, String(m_groupMap[groupId].mName.c_str())
+							, String(record ? record->mGroup.mName.c_str() : "")
 							, String(fromName.c_str())
 							, false
 							, String(message.c_str())
@@ -2830,52 +3380,50 @@ void ManagerImpl::SendGroupChatInvite( const LLUUID& groupId, const std::string&
 
 std::string	ManagerImpl::GetAgentLanguage( const LLUUID& agentId ) const
 {
-	if( m_agentLang.find( agentId ) == m_agentLang.end() )
-	{
-		// Default to true...
-		//
-		m_agentLang[agentId]["auto"] = true;
-	}
-	//
 	if( agentId == m_agentId )
 	{
 		// Always fix to local lang if it us who is logged in.
 		//
-		m_agentLang[agentId]["language"] = m_langId;
+		return m_langId;
 	}
 	//
-	return m_agentLang[agentId]["language"].asString();
+	const AgentRecord* record = m_agents.find( agentId );
+	return record ? record->mLanguage : std::string();
 }
 
 
 void ManagerImpl::SetAgentLanguage( const LLUUID& agentId, const std::string& language )
 {
-	m_agentLang[agentId]["language"] = language;
+	m_agents.findOrInsert( agentId ).mLanguage = language;
 }
 
 
 bool ManagerImpl::GetAgentLanguageAuto( const LLUUID& agentId ) const
 {
-	if( m_agentLang.find( agentId ) == m_agentLang.end() )
-	{
-		// Default to true...
-		//
-		m_agentLang[agentId]["auto"] = true;
-	}
+	// Default to true...
 	//
-	return m_agentLang[agentId]["auto"].asBoolean();
+	const AgentRecord* record = m_agents.find( agentId );
+	return record ? record->mLanguageAuto : true;
 }
 
 
 void ManagerImpl::SetAgentLanguageAuto( const LLUUID& agentId, const bool val )
 {
-	m_agentLang[agentId]["auto"] = val;
+	m_agents.findOrInsert( agentId ).mLanguageAuto = val;
 }
 
 
-void ManagerImpl::SendGroupChatAgentUpdateSignal( const std::string& session_id, const std::string& agent_id, const bool entering )
+void ManagerImpl::SendRosterDeltaSignal( const LLUUID& session_id, IdListImpl::LLUUIDList& entered, IdListImpl::LLUUIDList& left )
 {
-	m_groupChatAgentUpdateSignal( LLC::String(session_id.c_str()), LLC::String(agent_id.c_str()), entering );
+	if( entered.empty() && left.empty() )
+	{
+		return;
+	}
+	//
+	m_rosterDeltaSignal	( LLC::String(session_id.asString().c_str())
+						, TakeIdList( entered )
+						, TakeIdList( left )
+						);
 }
 
 
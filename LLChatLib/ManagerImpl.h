@@ -22,22 +22,30 @@
 //
 #include "LLChatLib.h"
 #include "StringImpl.h"
+#include "IdListImpl.h"
 #include "Agent.h"
+#include "TranslationPipeline.h"
+#include "PumpScheduler.h"
+#include "NetworkThread.h"
+#include "QueuedSignal.h"
 
 // Boost
 //
+#include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/signals.hpp>
 
 // StdC++
 //
 #include <map>
+#include <vector>
 
 //============== LINDEN Libraries =====================
 //
 #include "stdtypes.h"
 #include "lluserauth.h"
 #include "lluuid.h"
+#include "lluuidflatmap.h"
 #include "message.h"
 #include "v3math.h"
 #include "lljoint.h"
@@ -67,13 +75,13 @@ public:
 	void		RequestBuddyList();
 	void		GetNameFromCache( const LLUUID& id, std::string& first_name, std::string& last_name );
 	void		GetNameFromCache( const LLUUID& id, std::string& full_name );
-	String		GetFullName( const String& id );
+	const std::string&	GetFullName( const LLUUID& id );
 	String		LookupId( const String& fullname );
 	String		LookupGroupName( const String& id );
-	bool		IsOnline( const String& id );
-	bool		IsFriend( const String& id );
+	bool		IsOnline( const LLUUID& id );
+	bool		IsFriend( const LLUUID& id );
 
-	void		UpdateLocalAvatars();
+	void		UpdateLocalAvatars( const LLViewerRegion* region );
 	int			GetLocalAvatarCount() const;
 	String		GetLocalAvatar( const int idx ) const;
 
@@ -82,10 +90,32 @@ public:
 	void		PumpMessages();
 	void		RequestLogout();
 
-	void		SendInstantMessage( const String& to_id, const String& message, const bool to_group );
+	int			GetPollFds( Manager::PollFd* fds, const int max_fds ) const;
+	int			GetNextDeadline() const;
+	void		WatchFd( const int fd, const Manager::FdCallback& callback );
+	void		UnwatchFd( const int fd );
+	bool		WaitForEvents( const int max_wait_msecs );
+	void		RunUntil( const Manager::DonePredicate& done );
+	std::string	GetPumpStats() const										{ return m_pumpScheduler.GetStatsReport(); }
+	bool		SetPumpBudget( const std::string& stage, const U64 usecs )	{ return m_pumpScheduler.SetBudget( stage, usecs ); }
+
+	// Network thread support
+	//
+	typedef std::vector<Manager::PollFd>		PollFdList;
+
+	void		StartNetworkThread();
+	void		StopNetworkThread();
+	bool		IsThreaded() const { return m_networkThread.get() != NULL; }
+	void		RunCommand( const NetworkThread::Call& call );
+	int			DispatchEvents( const int max_events );
+	int			PrepareWait( PollFdList& fds, const int max_wait_msecs );
+	bool		WaitOn( const PollFdList& fds, const int timeout );
+	void		DispatchWatchedFds();
+
+	void		SendInstantMessage( const LLUUID& to_id, const std::string& message, const bool to_group );
 	void		SendLocalChatMessage( const String& text, const int channel );
 	void		SendGroupChatStartRequest( const String& group_id );
-	void		SendTypingSignal( const String& target_id, const bool to_group, const bool typing );
+	void		SendTypingSignal( const LLUUID& target_id, const bool to_group, const bool typing );
 	void		SendGroupChatLeaveRequest( const String& group_session_id );
 	void		OfferFriendship( const String& target_id, const String& message );
 	void		AcceptFriendship( const String& sessionId, const String& senderIp );
@@ -115,7 +145,7 @@ public:
 	void SendGroupChatInvite( const LLUUID& groupId, const std::string& fromName, const std::string& message );
 
 	std::string	GetLanguage() const { return m_langId; }
-	void		SetLanguage( const std::string& lang_id )	{ m_langId = lang_id; }
+	void		SetLanguage( const std::string& lang_id );
 	//
 	std::string	GetAgentLanguage( const LLUUID& agentId ) const;
 	void		SetAgentLanguage( const LLUUID& agentId, const std::string& language );
@@ -124,17 +154,20 @@ public:
 	void		SetAgentLanguageAuto( const LLUUID& agentId, const bool val );
 
 	void SetTranslateMessages( const bool val ) { m_translateMessages = val; }
+	void SetTranslationBackend( const TranslationBackendPtr& backend ) { m_translator.SetBackend( backend ); }
 
-	void SendGroupChatAgentUpdateSignal( const std::string& session_id, const std::string& agent_id, const bool entering );
+	// Empties entered and left into the lists handed to the signal
+	void SendRosterDeltaSignal( const LLUUID& session_id, IdListImpl::LLUUIDList& entered, IdListImpl::LLUUIDList& left );
 
-	Connection ConnectFriendAddSignal             ( const Manager::StringSignal               ::slot_type& slot ) { return m_friendAddSignal             .connect(slot); }
+	Connection ConnectFriendsAddedSignal          ( const Manager::FriendsAddedSignal         ::slot_type& slot ) { return m_friendsAddedSignal          .connect(slot); }
 	Connection ConnectTerminateFriendshipSignal   ( const Manager::StringSignal               ::slot_type& slot ) { return m_terminateFriendshipSignal   .connect(slot); }
 	Connection ConnectCacheSignal                 ( const Manager::CacheSignal                ::slot_type& slot ) { return m_cacheSignal                 .connect(slot); }
 	Connection ConnectGroupCacheSignal            ( const Manager::GroupCacheSignal           ::slot_type& slot ) { return m_groupCacheSignal            .connect(slot); }
 	Connection ConnectImSignal                    ( const Manager::ImSignal                   ::slot_type& slot ) { return m_imSignal                    .connect(slot); }
 	Connection ConnectGroupChatSignal             ( const Manager::GroupChatSignal            ::slot_type& slot ) { return m_groupChatSignal             .connect(slot); }
 	Connection ConnectLocalChatSignal             ( const Manager::LocalChatSignal            ::slot_type& slot ) { return m_localChatSignal             .connect(slot); }
-	Connection ConnectGroupChatAgentUpdateSignal  ( const Manager::GroupChatAgentUpdateSignal ::slot_type& slot ) { return m_groupChatAgentUpdateSignal  .connect(slot); }
+	Connection ConnectChatEventSignal             ( const Manager::ChatEventSignal            ::slot_type& slot ) { return m_chatEventSignal             .connect(slot); }
+	Connection ConnectRosterDeltaSignal           ( const Manager::RosterDeltaSignal          ::slot_type& slot ) { return m_rosterDeltaSignal           .connect(slot); }
 	Connection ConnectTypingSignal                ( const Manager::TypingSignal               ::slot_type& slot ) { return m_typingSignal                .connect(slot); }
 	Connection ConnectOnlineSignal                ( const Manager::OnlineSignal               ::slot_type& slot ) { return m_onlineSignal                .connect(slot); }
 	Connection ConnectFriendOfferSignal           ( const Manager::FriendOfferSignal          ::slot_type& slot ) { return m_friendOfferSignal           .connect(slot); }
@@ -147,6 +180,7 @@ public:
 	Connection ConnectGroupOfferSignal            ( const Manager::GroupOfferSignal           ::slot_type& slot ) { return m_groupOfferSignal            .connect(slot); }
 	Connection ConnectAgentMovementCompleteSignal ( const Manager::VoidSignal                 ::slot_type& slot ) { return m_agentMovementCompleteSignal .connect(slot); }
 	Connection ConnectLocalAgentsPresentSignal    ( const Manager::VoidSignal                 ::slot_type& slot ) { return m_localAgentsPresentSignal    .connect(slot); }
+	Connection ConnectLocalAgentUpdateSignal      ( const Manager::LocalAgentUpdateSignal     ::slot_type& slot ) { return m_localAgentUpdateSignal      .connect(slot); }
 	Connection ConnectTeleportRequestSignal       ( const Manager::TeleportRequestSignal      ::slot_type& slot ) { return m_teleportRequestSignal       .connect(slot); }
 	Connection ConnectTeleportRequestedSignal     ( const Manager::TeleportRequestedSignal    ::slot_type& slot ) { return m_teleportRequestedSignal     .connect(slot); }
 	Connection ConnectTeleportStartSignal         ( const Manager::TeleportStartSignal        ::slot_type& slot ) { return m_teleportStartSignal         .connect(slot); }
@@ -182,6 +216,10 @@ public:
 	void		OnTeleportFinish( LLMessageSystem* msg, void **user_data );
 
 private:
+	// llcbench drives the private dispatch paths through this (bench/BenchChatEvent.cpp)
+	//
+	friend class BenchAccess;
+
 	// Forbidden--this is a singleton
 	//
 	ManagerImpl();
@@ -207,24 +245,14 @@ private:
 	LLUUID					m_rootInventoryFolder;
 	LLUUID					m_searchId;
 
-	LLViewerRegion::LLUUIDList	m_nearAvatars;
+	LLViewerRegion::LLUUIDList	m_nearAvatars;		// Sorted
 	
 	typedef boost::shared_ptr<LLWearable>	LLWearablePtr;
 	typedef std::map<LLAssetID, LLWearablePtr> LLAssetIdToLLWearable;
 	LLAssetIdToLLWearable	m_wearableList;
 
-	typedef std::map<LLUUID, bool>	LLUUIDToBool;
-	LLUUIDToBool			m_onlineStatuses;	
-	LLUUIDToBool			m_cacheReceivedMap;
-
 	typedef std::map<std::string, LLUUID>	StringToLLUUID;
 	StringToLLUUID			m_nameToIdMap;
-	
-	typedef std::map<LLUUID, std::string>	LLUUIDToString;
-	LLUUIDToString			m_idToNameMap;	// Our own cache
-
-	typedef std::map<LLUUID, LLSD>			LLUUIDToLLSD;
-	mutable LLUUIDToLLSD	m_agentLang;
     
     struct LLGroupData
     {
@@ -239,81 +267,103 @@ private:
         LLGroupData() : mPowers(0), mAcceptNotices(FALSE), mListInProfile(FALSE), mContribution(0) {}
     };
 
-    typedef std::map<LLUUID,LLGroupData>    LLUUIDToGroupData;
-	LLUUIDToGroupData		m_groupMap;
+	// Everything we track per agent or group, in one flat table keyed
+	// by UUID.  Queries use find() so a miss never inserts.
+	//
+	struct AgentRecord
+	{
+		std::string		mFullName;		// Our own cache of the name
+		std::string		mLanguage;		// Translation language, empty for default
+		bool			mOnline;
+		bool			mCacheReceived;	// Name arrived; friends stay flagged
+		bool			mLanguageAuto;
+		bool			mIsGroup;
+		LLGroupData		mGroup;			// Valid if mIsGroup
+
+		AgentRecord() : mOnline(false), mCacheReceived(false), mLanguageAuto(true), mIsGroup(false) {}
+	};
+	typedef LLUUIDFlatMap<AgentRecord>	AgentTable;
+	AgentTable				m_agents;
+
+	AgentRecord&			GetGroupRecord( const LLUUID& group_id );
 
 	typedef std::vector<LLUUID>	LLUUIDList;
 	LLUUIDList				m_peopleSearchResult;
 
 	std::string					m_fullName;
 	bool						m_translateMessages;
-
-	Manager::StringSignal				m_friendAddSignal;
-	Manager::CacheSignal				m_cacheSignal;
-    Manager::GroupCacheSignal   		m_groupCacheSignal;
-	Manager::ImSignal					m_imSignal;
-	Manager::GroupChatSignal			m_groupChatSignal;
-	Manager::LocalChatSignal			m_localChatSignal;
-	Manager::GroupChatAgentUpdateSignal	m_groupChatAgentUpdateSignal;
-	Manager::TypingSignal				m_typingSignal;
-	Manager::OnlineSignal				m_onlineSignal;
-	Manager::StringSignal				m_terminateFriendshipSignal;
-	Manager::FriendOfferSignal			m_friendOfferSignal;
-	Manager::CacheSignal				m_friendAcceptSignal;
-	Manager::CacheSignal				m_friendDeclineSignal;
-	Manager::StringSignal				m_messageBoxSignal;
-	Manager::SearchResultSignal			m_searchResultSignal;
-	Manager::StringSignal				m_forceQuitSignal;
-	Manager::VoidSignal					m_logoutReplySignal;
-	Manager::GroupOfferSignal			m_groupOfferSignal;
-	Manager::VoidSignal					m_agentMovementCompleteSignal;
-	Manager::VoidSignal					m_localAgentsPresentSignal;
+	TranslationPipeline			m_translator;
+	PumpScheduler				m_pumpScheduler;
+
+	QueuedSignal<Manager::FriendsAddedSignal>			m_friendsAddedSignal;
+	QueuedSignal<Manager::CacheSignal>					m_cacheSignal;
+    QueuedSignal<Manager::GroupCacheSignal>				m_groupCacheSignal;
+	QueuedSignal<Manager::ImSignal>						m_imSignal;
+	QueuedSignal<Manager::GroupChatSignal>				m_groupChatSignal;
+	QueuedSignal<Manager::LocalChatSignal>				m_localChatSignal;
+	Manager::ChatEventSignal							m_chatEventSignal;	// Queued by SendChatEvent()
+	QueuedSignal<Manager::RosterDeltaSignal>			m_rosterDeltaSignal;
+	QueuedSignal<Manager::TypingSignal>					m_typingSignal;
+	QueuedSignal<Manager::OnlineSignal>					m_onlineSignal;
+	QueuedSignal<Manager::StringSignal>					m_terminateFriendshipSignal;
+	QueuedSignal<Manager::FriendOfferSignal>			m_friendOfferSignal;
+	QueuedSignal<Manager::CacheSignal>					m_friendAcceptSignal;
+	QueuedSignal<Manager::CacheSignal>					m_friendDeclineSignal;
+	QueuedSignal<Manager::StringSignal>					m_messageBoxSignal;
+	QueuedSignal<Manager::SearchResultSignal>			m_searchResultSignal;
+	QueuedSignal<Manager::StringSignal>					m_forceQuitSignal;
+	QueuedSignal<Manager::VoidSignal>					m_logoutReplySignal;
+	QueuedSignal<Manager::GroupOfferSignal>				m_groupOfferSignal;
+	QueuedSignal<Manager::VoidSignal>					m_agentMovementCompleteSignal;
+	QueuedSignal<Manager::VoidSignal>					m_localAgentsPresentSignal;
+	QueuedSignal<Manager::LocalAgentUpdateSignal>		m_localAgentUpdateSignal;
 	//
-	Manager::TeleportRequestSignal		m_teleportRequestSignal;
-	Manager::TeleportRequestedSignal	m_teleportRequestedSignal;
-	Manager::TeleportStartSignal		m_teleportStartSignal;
-	Manager::TeleportProgressSignal		m_teleportProgressSignal;
-	Manager::VoidSignal					m_teleportLocalSignal;
-	Manager::TeleportFailedSignal		m_teleportFailedSignal;
-	Manager::VoidSignal					m_teleportFinishSignal;
+	QueuedSignal<Manager::TeleportRequestSignal>		m_teleportRequestSignal;
+	QueuedSignal<Manager::TeleportRequestedSignal>		m_teleportRequestedSignal;
+	QueuedSignal<Manager::TeleportStartSignal>			m_teleportStartSignal;
+	QueuedSignal<Manager::TeleportProgressSignal>		m_teleportProgressSignal;
+	QueuedSignal<Manager::VoidSignal>					m_teleportLocalSignal;
+	QueuedSignal<Manager::TeleportFailedSignal>			m_teleportFailedSignal;
+	QueuedSignal<Manager::VoidSignal>					m_teleportFinishSignal;
 
 	Agent								m_agent;
 	S32									m_x, m_y, m_z;		// Request for teleport...
 	std::string							m_destRegionName;	// Request for teleport...
 
+	// Event loop support
+	//
+	typedef std::map<int, Manager::FdCallback>	FdToCallback;
+	FdToCallback						m_watchedFds;
+	std::vector<int>					m_readyFds;			// Descriptors that fired in the last WaitForEvents()
+#if LL_LINUX
+	typedef std::map<int, U32>			FdToEvents;
+	int									m_epollFd;
+	FdToEvents							m_epollEvents;		// What is currently registered with m_epollFd
+
+	void		SyncEpoll( const PollFdList& fds );
+#endif
+
+	int			CollectWaitSet( PollFdList& fds ) const;
+
+	boost::scoped_ptr<NetworkThread>	m_networkThread;
+	boost::scoped_ptr<NetworkThread>	m_retiredThread;	// Stopped from inside its own DispatchEvents()
+
 	void		TeleportToRegion( const U64& region_handle, S32 x, S32 y, S32 z );
 	void		HandleCacheUpdate( const LLUUID& id, const std::string fullName, const bool is_group = false );
 	void		SendReliable( LLMessageSystem* msg );
 	void		SendCompleteAgentMovement( const LLHost& sim_host );
 
-	LLSD GetDetectQuery( const std::string& message );
-	LLSD GetTranslateQuery( const std::string& sourceLangId, const std::string& message );
+	void HandleLanguageDetected( const LLUUID& agent_id, const std::string& language );
+	void SubmitChatLine	( const std::string& conversation
+						, const LLUUID& from_id
+						, const bool translate
+						, LLSD& params
+						, const TranslationPipeline::DispatchFn& dispatch
+						);
 	void HandleGroupChatDispatch( const LLSD& params );
-	void HandleGroupChatDetect( const LLSD& params );
-	void HandleGroupChatTranslationResponse
-									( const LLUUID& group_id
-									, const LLUUID& from_id
-									, const std::string& group_name
-									, const std::string& agent_name
-									, const bool has_me
-									, const std::string& message
-									);
 	void HandleIMDispatch( const LLSD& params );
-	void HandleIMDetect( const LLSD& params );
-	void HandleIMTranslationResponse	( const LLUUID& from_id
-										, const std::string& name
-										, const bool has_me
-										, const std::string& message
-										);
 	void HandleLocalChatDispatch( const LLSD& params );
-	void HandleLocalChatDetect( const LLSD& params );
-	void HandleLocalChatTranslationResponse
-									( const LLUUID& from_id
-									, const std::string& from_name
-									, const std::string& verb
-									, const bool has_me
-									, const std::string& message
-									);
+	void SendChatEvent( const Manager::ChatEvent& event );
 };
 
 
@@ -0,0 +1,386 @@
+/**
+ * \brief Optional LLChatLib network thread
+ *
+ * Copyright (c) 2009-2010 by R. Douglas Barbieri
+ *
+ * The source code in this file ("Source Code") is provided by R. Douglas Barbieri
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL").  Terms of the GPL can be found in doc/GPL-license.txt in this distribution.
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL SOURCE CODE IN THIS DISTRIBUTION IS PROVIDED "AS IS." THE AUTHOR MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ */
+
+#include "NetworkThread.h"
+#include "ManagerImpl.h"
+
+// boost
+//
+#include <boost/bind.hpp>
+
+// stdc
+//
+#if !LL_WINDOWS
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+// llcommon
+//
+#include "lldefs.h"
+#include "llerror.h"
+#include "lltimer.h"
+
+
+namespace LLC
+{
+
+namespace
+{
+	// Without a wake pipe the thread can't be woken for a command, so it
+	// never sleeps longer than this.
+	//
+	const int NETWORK_POLL_MSECS = 20;
+
+#if !LL_WINDOWS
+	bool OpenPipe( int fds[2] )
+	{
+		if( pipe( fds ) == -1 )
+		{
+			llwarns << "pipe() failed, errno=" << errno << llendl;
+			fds[0] = fds[1] = -1;
+			return false;
+		}
+		fcntl( fds[0], F_SETFL, fcntl( fds[0], F_GETFL ) | O_NONBLOCK );
+		fcntl( fds[1], F_SETFL, fcntl( fds[1], F_GETFL ) | O_NONBLOCK );
+		return true;
+	}
+
+	void ClosePipe( int fds[2] )
+	{
+		if( fds[0] != -1 ) close( fds[0] );
+		if( fds[1] != -1 ) close( fds[1] );
+		fds[0] = fds[1] = -1;
+	}
+
+	void DrainPipe( const int fd )
+	{
+		char buffer[64];
+		while( read( fd, buffer, sizeof(buffer) ) > 0 )
+		{
+			// Keep going until it would block
+		}
+	}
+
+	void PokePipe( const int fd )
+	{
+		const char byte = 0;
+		// A full pipe is already readable, so a failed write loses nothing
+		//
+		if( write( fd, &byte, 1 ) == -1 && errno != EAGAIN )
+		{
+			llwarns << "write() to wake pipe failed, errno=" << errno << llendl;
+		}
+	}
+#endif
+}
+// namespace
+
+
+NetworkThread*	NetworkThread::s_instance	= NULL;
+U32				NetworkThread::s_threadId	= 0;
+int				NetworkThread::LibraryLock::s_depth = 0;
+
+
+NetworkThread::NetworkThread( ManagerImpl& manager )
+	: LLThread( "LLChatLib network" )
+	, m_manager( manager )
+	, m_lock( NULL )
+	, m_eventSignalled( 0 )
+	, m_stopping( 0 )
+	, m_dispatching( false )
+{
+	m_wakePipe[0]  = m_wakePipe[1]  = -1;
+	m_eventPipe[0] = m_eventPipe[1] = -1;
+
+#if !LL_WINDOWS
+	if( OpenPipe( m_wakePipe ) )
+	{
+		m_manager.WatchFd( m_wakePipe[0], boost::bind( &NetworkThread::DrainWakePipe, this ) );
+	}
+	OpenPipe( m_eventPipe );
+#endif
+}
+
+
+NetworkThread::~NetworkThread()
+{
+	if( s_instance == this )
+	{
+		Stop();
+	}
+	// ~LLThread() will be called here
+
+#if !LL_WINDOWS
+	if( m_wakePipe[0] != -1 )
+	{
+		m_manager.UnwatchFd( m_wakePipe[0] );
+	}
+	ClosePipe( m_wakePipe );
+	ClosePipe( m_eventPipe );
+#endif
+}
+
+
+void NetworkThread::Start()
+{
+	// Set before the thread exists, so the front-end locks from here on
+	//
+	s_instance = this;
+	start();
+}
+
+
+bool NetworkThread::Stop()
+{
+	setQuitting();
+	apr_atomic_set32( &m_stopping, 1 );
+	Wake();
+
+	// It finishes the pump in progress and leaves, which takes milliseconds
+	// unless a handler is stuck
+	//
+	S32 timeout = 500;
+	for( ; timeout > 0; timeout-- )
+	{
+		if( isStopped() )
+		{
+			break;
+		}
+		ms_sleep( 10 );
+		LLThread::yield();
+	}
+	if( timeout == 0 )
+	{
+		// Still inside a handler. Clearing s_instance would let the front-end
+		// into the library without the lock while the thread is in it.
+		//
+		llwarns << "NetworkThread::Stop() timed out!" << llendl;
+		return false;
+	}
+
+	if( s_instance == this )
+	{
+		s_instance = NULL;
+	}
+	return true;
+}
+
+
+// static
+bool NetworkThread::IsNetworkThread()
+{
+	return s_instance && LLThread::currentID() == s_threadId;
+}
+
+
+// static
+bool NetworkThread::PostEvent( const Call& call )
+{
+	if( !IsNetworkThread() )
+	{
+		return false;
+	}
+
+	s_instance->m_events.Push( call );
+	s_instance->SignalEvent();
+	return true;
+}
+
+
+void NetworkThread::PostCommand( const Call& call )
+{
+	m_commands.Push( call );
+	Wake();
+}
+
+
+int NetworkThread::DispatchEvents( const int max_events )
+{
+#if !LL_WINDOWS
+	// Empty the pipe before clearing the flag: any event pushed after this
+	// point either finds the flag clear and writes a fresh byte, or is
+	// picked up by the loop below.
+	//
+	if( m_eventPipe[0] != -1 )
+	{
+		DrainPipe( m_eventPipe[0] );
+	}
+#endif
+	apr_atomic_set32( &m_eventSignalled, 0 );
+
+	const bool nested = m_dispatching;
+	m_dispatching = true;
+
+	int count = 0;
+	Call call;
+	while( (max_events < 0 || count < max_events) && m_events.Pop( call ) )
+	{
+		call();
+		++count;
+	}
+
+	m_dispatching = nested;
+
+	if( !m_events.IsEmpty() )
+	{
+		// Stopped early, so make sure the front-end comes back for the rest
+		//
+		SignalEvent();
+	}
+
+	return count;
+}
+
+
+bool NetworkThread::WaitForEvents( const int max_wait_msecs )
+{
+	if( !m_events.IsEmpty() )
+	{
+		return true;
+	}
+
+#if !LL_WINDOWS
+	if( m_eventPipe[0] != -1 )
+	{
+		struct pollfd pfd;
+		pfd.fd		= m_eventPipe[0];
+		pfd.events	= POLLIN;
+		pfd.revents	= 0;
+		poll( &pfd, 1, max_wait_msecs );
+		return !m_events.IsEmpty();
+	}
+#endif
+
+	ms_sleep( max_wait_msecs < 0 ? NETWORK_POLL_MSECS : llmin( max_wait_msecs, NETWORK_POLL_MSECS ) );
+	return !m_events.IsEmpty();
+}
+
+
+void NetworkThread::RunCommands()
+{
+	Call call;
+	while( m_commands.Pop( call ) )
+	{
+		call();
+	}
+}
+
+
+void NetworkThread::run()
+{
+	s_threadId = LLThread::currentID();
+
+	ManagerImpl::PollFdList fds;
+	while( !isQuitting() && !apr_atomic_read32( &m_stopping ) )
+	{
+		int timeout;
+		{
+			LLMutexLock lock( &m_lock );
+			timeout = m_manager.PrepareWait( fds, -1 );
+		}
+		if( m_wakePipe[0] == -1 )
+		{
+			timeout = llmin( timeout, NETWORK_POLL_MSECS );
+		}
+
+		m_manager.WaitOn( fds, timeout );
+
+		if( apr_atomic_read32( &m_stopping ) )
+		{
+			break;
+		}
+
+		LLMutexLock lock( &m_lock );
+		m_manager.DispatchWatchedFds();
+		RunCommands();
+		m_manager.PumpMessages();
+	}
+}
+
+
+void NetworkThread::Wake()
+{
+#if !LL_WINDOWS
+	if( m_wakePipe[1] != -1 )
+	{
+		PokePipe( m_wakePipe[1] );
+	}
+#endif
+}
+
+
+void NetworkThread::DrainWakePipe()
+{
+#if !LL_WINDOWS
+	DrainPipe( m_wakePipe[0] );
+#endif
+}
+
+
+void NetworkThread::SignalEvent()
+{
+	if( apr_atomic_cas32( &m_eventSignalled, 1, 0 ) != 0 )
+	{
+		// Already a byte in the pipe the front-end hasn't read
+		return;
+	}
+#if !LL_WINDOWS
+	if( m_eventPipe[1] != -1 )
+	{
+		PokePipe( m_eventPipe[1] );
+	}
+#endif
+}
+
+
+NetworkThread::LibraryLock::LibraryLock()
+	: m_mutex( NULL )
+	, m_counted( false )
+{
+	if( s_instance && !IsNetworkThread() )
+	{
+		m_counted = true;
+		if( s_depth++ == 0 )
+		{
+			m_mutex = &s_instance->m_lock;
+			m_mutex->lock();
+		}
+	}
+}
+
+
+NetworkThread::LibraryLock::~LibraryLock()
+{
+	if( m_mutex )
+	{
+		m_mutex->unlock();
+	}
+	if( m_counted )
+	{
+		--s_depth;
+	}
+}
+
+
+}
+//namespace LLC
+
+// vim: ts=4 sw=4 noexpandtab syntax=cpp.doxygen
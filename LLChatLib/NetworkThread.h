@@ -0,0 +1,149 @@
+/**
+ * \brief Header for the optional LLChatLib network thread
+ *
+ * Copyright (c) 2009-2010 by R. Douglas Barbieri
+ *
+ * The source code in this file ("Source Code") is provided by R. Douglas Barbieri
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL").  Terms of the GPL can be found in doc/GPL-license.txt in this distribution.
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL SOURCE CODE IN THIS DISTRIBUTION IS PROVIDED "AS IS." THE AUTHOR MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ */
+
+#ifndef __NETWORKTHREAD_H__
+#define __NETWORKTHREAD_H__
+
+// Local project
+//
+#include "SPSCQueue.h"
+
+// boost
+//
+#include <boost/function.hpp>
+
+// llcommon
+//
+#include "llapr.h"
+#include "llthread.h"
+#include "stdtypes.h"
+
+
+namespace LLC
+{
+
+class ManagerImpl;
+
+
+/// Runs the message system, HTTP pump and timers away from the front-end.
+///
+/// Two queues connect it to the front-end thread, and neither side takes a
+/// lock to use them:
+///
+/// - Events: signals raised on the network thread are queued by PostEvent()
+///   and fired when the front-end calls DispatchEvents(). The first event
+///   after a drain makes GetEventFd() readable, so a burst costs one wake-up.
+/// - Commands: outgoing requests (SendInstantMessage() etc.) are queued by
+///   PostCommand() and run on the network thread before its next pump.
+///
+/// Front-end calls that read library state take LibraryLock, which the
+/// network thread holds while it pumps and releases while it sleeps.
+///
+class NetworkThread : public LLThread
+{
+public:
+	typedef boost::function<void (void)>	Call;
+
+	NetworkThread( ManagerImpl& manager );
+	virtual ~NetworkThread();
+
+	void		Start();
+	/// Wake the thread and wait for it to finish its current pump and exit.
+	/// Returns false if it is still running after the wait; it then stays
+	/// the current instance and must be leaked rather than deleted.
+	bool		Stop();
+
+	/// Queue an event if called on the network thread; returns false
+	/// otherwise, and the caller should make the call directly.
+	static bool	PostEvent( const Call& call );
+
+	/// Front-end side. Queue a call to run on the network thread.
+	void		PostCommand( const Call& call );
+
+	/// Front-end side. Fire queued events, at most max_events of them if it
+	/// is not -1. Returns the number fired.
+	int			DispatchEvents( const int max_events = -1 );
+
+	/// True while DispatchEvents() is firing events
+	bool		IsDispatching() const { return m_dispatching; }
+
+	/// Front-end side. Readable while events are waiting, -1 if the platform
+	/// has no pipes and the front-end has to poll DispatchEvents().
+	int			GetEventFd() const { return m_eventPipe[0]; }
+
+	/// Front-end side. Sleep until an event is queued or max_wait_msecs passes.
+	bool		WaitForEvents( const int max_wait_msecs );
+
+	/// Run commands left behind after the thread has stopped.
+	void		RunCommands();
+
+	static bool	IsNetworkThread();
+
+	/// Serialises front-end access to the library with the network thread.
+	/// Does nothing on the network thread itself or when the thread is not
+	/// running, and nests, since a signal fired directly may call back into
+	/// the Manager.
+	class LibraryLock
+	{
+	public:
+		LibraryLock();
+		~LibraryLock();
+
+	private:
+		LLMutex*	m_mutex;
+		bool		m_counted;
+
+		static int	s_depth;		// Front-end thread only
+	};
+
+protected:
+	virtual void run();
+
+private:
+	friend class BenchAccess;	// llcbench, see bench/BenchChatEvent.cpp
+
+	static NetworkThread*		s_instance;
+	static U32					s_threadId;
+
+	ManagerImpl&				m_manager;
+	LLMutex						m_lock;
+	SPSCQueue<Call>				m_events;
+	SPSCQueue<Call>				m_commands;
+	volatile apr_uint32_t		m_eventSignalled;	// A byte is in the event pipe
+	volatile apr_uint32_t		m_stopping;
+	bool						m_dispatching;		// Front-end thread only
+	int							m_wakePipe[2];		// Front-end to network thread
+	int							m_eventPipe[2];		// Network thread to front-end
+
+	void		Wake();
+	void		DrainWakePipe();
+	void		SignalEvent();
+
+	// Forbidden
+	//
+	NetworkThread( const NetworkThread& );
+	NetworkThread& operator =( const NetworkThread& );
+};
+
+
+}
+//namespace LLC
+
+#endif // __NETWORKTHREAD_H__
+
+// vim: ts=4 sw=4 noexpandtab syntax=cpp.doxygen
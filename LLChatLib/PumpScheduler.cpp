@@ -0,0 +1,195 @@
+/**
+ * \brief Time-budgeted message pump scheduler
+ *
+ * Copyright (c) 2009-2010 by R. Douglas Barbieri
+ *
+ * The source code in this file ("Source Code") is provided by R. Douglas Barbieri
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL").  Terms of the GPL can be found in doc/GPL-license.txt in this distribution.
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL SOURCE CODE IN THIS DISTRIBUTION IS PROVIDED "AS IS." THE AUTHOR MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ */
+
+#include "PumpScheduler.h"
+
+// stdc++
+//
+#include <sstream>
+
+// llcommon
+//
+#include "lldefs.h"
+#include "timing.h"
+
+
+namespace LLC
+{
+
+namespace
+{
+
+int HistogramBucket( U64 usecs )
+{
+	int bucket = 0;
+	while( usecs > 1 && bucket < PumpScheduler::HISTOGRAM_BUCKETS - 1 )
+	{
+		usecs >>= 1;
+		++bucket;
+	}
+	return bucket;
+}
+
+}
+// namespace
+
+
+PumpScheduler::StageStats::StageStats()
+	: mRuns(0)
+	, mOverruns(0)
+	, mDeferred(0)
+	, mTotalUsecs(0)
+	, mMaxUsecs(0)
+{
+	for( int idx = 0; idx < HISTOGRAM_BUCKETS; ++idx )
+	{
+		mHistogram[idx] = 0;
+	}
+}
+
+
+PumpScheduler::PumpScheduler()
+	: m_pending(false)
+{
+}
+
+
+void PumpScheduler::AddStage( const std::string& name, const U64 budget_usecs, const StageFn& stage )
+{
+	Stage entry;
+	entry.mName		= name;
+	entry.mBudget	= budget_usecs;
+	entry.mFn		= stage;
+	m_stages.push_back( entry );
+}
+
+
+bool PumpScheduler::SetBudget( const std::string& name, const U64 budget_usecs )
+{
+	StageList::iterator			iter = m_stages.begin();
+	const StageList::iterator	end  = m_stages.end();
+	for( ; iter != end; ++iter )
+	{
+		if( iter->mName == name )
+		{
+			iter->mBudget = budget_usecs;
+			return true;
+		}
+	}
+	return false;
+}
+
+
+void PumpScheduler::Run()
+{
+	m_pending = false;
+
+	StageList::iterator			iter = m_stages.begin();
+	const StageList::iterator	end  = m_stages.end();
+	for( ; iter != end; ++iter )
+	{
+		Stage& stage = *iter;
+
+		const U64 start   = totalTime();
+		U64  elapsed      = 0;
+		U64  longest_call = 0;
+		bool more         = false;
+		do
+		{
+			const U64 call_start = start + elapsed;
+			more    = stage.mFn();
+			elapsed = totalTime() - start;
+			longest_call = llmax( longest_call, start + elapsed - call_start );
+		}
+		while( more && elapsed < stage.mBudget );
+
+		StageStats& stats = stage.mStats;
+		stats.mRuns++;
+		stats.mTotalUsecs += elapsed;
+		stats.mHistogram[HistogramBucket( elapsed )]++;
+		if( elapsed > stats.mMaxUsecs )
+		{
+			stats.mMaxUsecs = elapsed;
+		}
+		if( stage.mBudget && longest_call > stage.mBudget )
+		{
+			stats.mOverruns++;
+		}
+		if( more )
+		{
+			stats.mDeferred++;
+			m_pending = true;
+		}
+	}
+}
+
+
+std::string PumpScheduler::GetStatsReport() const
+{
+	std::ostringstream ostr;
+
+	StageList::const_iterator		iter = m_stages.begin();
+	const StageList::const_iterator	end  = m_stages.end();
+	for( ; iter != end; ++iter )
+	{
+		const StageStats& stats = iter->mStats;
+		ostr	<< iter->mName
+				<< ": budget="	<< iter->mBudget << "us"
+				<< " runs="		<< stats.mRuns
+				<< " avg="		<< (stats.mRuns ? stats.mTotalUsecs / stats.mRuns : 0) << "us"
+				<< " max="		<< stats.mMaxUsecs << "us"
+				<< " over="		<< stats.mOverruns
+				<< " deferred="	<< stats.mDeferred
+				<< " |";
+		for( int idx = 0; idx < HISTOGRAM_BUCKETS; ++idx )
+		{
+			if( stats.mHistogram[idx] )
+			{
+				if( idx == HISTOGRAM_BUCKETS - 1 )
+				{
+					ostr << " >=" << (1U << idx) << "us:";
+				}
+				else
+				{
+					ostr << " <" << (2U << idx) << "us:";
+				}
+				ostr << stats.mHistogram[idx];
+			}
+		}
+		ostr << "\n";
+	}
+
+	return ostr.str();
+}
+
+
+void PumpScheduler::ResetStats()
+{
+	StageList::iterator			iter = m_stages.begin();
+	const StageList::iterator	end  = m_stages.end();
+	for( ; iter != end; ++iter )
+	{
+		iter->mStats = StageStats();
+	}
+}
+
+
+}
+//namespace LLC
+
+// vim: ts=4 sw=4 noexpandtab syntax=cpp.doxygen
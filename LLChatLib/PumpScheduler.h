@@ -0,0 +1,103 @@
+/**
+ * \brief Header for the time-budgeted message pump scheduler
+ *
+ * Copyright (c) 2009-2010 by R. Douglas Barbieri
+ *
+ * The source code in this file ("Source Code") is provided by R. Douglas Barbieri
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL").  Terms of the GPL can be found in doc/GPL-license.txt in this distribution.
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL SOURCE CODE IN THIS DISTRIBUTION IS PROVIDED "AS IS." THE AUTHOR MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ */
+
+#ifndef __PUMPSCHEDULER_H__
+#define __PUMPSCHEDULER_H__
+
+// stdc++
+//
+#include <string>
+#include <vector>
+
+// boost
+//
+#include <boost/function.hpp>
+
+// llcommon
+//
+#include "stdtypes.h"
+
+
+namespace LLC
+{
+
+
+/// Runs the stages of ManagerImpl::PumpMessages() in order, each within a
+/// time budget in microseconds.
+///
+/// A stage function does one unit of work and returns true if more is
+/// waiting. The scheduler calls it again until it returns false or the
+/// budget is spent. Anything left over is picked up on the next Run(), and
+/// HasPendingWork() tells the event loop not to sleep in the meantime. A
+/// budget of 0 runs the stage once per pump.
+///
+/// The time each stage takes per pump goes into a histogram with
+/// power-of-two buckets, so the worst cases show up as well as the average.
+///
+class PumpScheduler
+{
+public:
+	typedef boost::function<bool (void)>	StageFn;
+
+	enum { HISTOGRAM_BUCKETS = 16 };		// Last bucket holds everything over 2^15 usecs
+
+	struct StageStats
+	{
+		U32		mRuns;
+		U32		mOverruns;					// One call alone took longer than the budget
+		U32		mDeferred;					// Left work for the next pump
+		U64		mTotalUsecs;
+		U64		mMaxUsecs;
+		U32		mHistogram[HISTOGRAM_BUCKETS];
+
+		StageStats();
+	};
+
+	PumpScheduler();
+
+	void		AddStage( const std::string& name, const U64 budget_usecs, const StageFn& stage );
+	bool		SetBudget( const std::string& name, const U64 budget_usecs );
+
+	void		Run();
+	bool		HasPendingWork() const { return m_pending; }
+
+	/// One line per stage: runs, average, worst case and the histogram
+	std::string	GetStatsReport() const;
+	void		ResetStats();
+
+private:
+	struct Stage
+	{
+		std::string		mName;
+		U64				mBudget;
+		StageFn			mFn;
+		StageStats		mStats;
+	};
+	typedef std::vector<Stage>	StageList;
+
+	StageList	m_stages;
+	bool		m_pending;
+};
+
+
+}
+//namespace LLC
+
+#endif // __PUMPSCHEDULER_H__
+
+// vim: ts=4 sw=4 noexpandtab syntax=cpp.doxygen
@@ -0,0 +1,146 @@
+/**
+ * \brief Signals that are delivered through the network thread's event queue
+ *
+ * Copyright (c) 2009-2010 by R. Douglas Barbieri
+ *
+ * The source code in this file ("Source Code") is provided by R. Douglas Barbieri
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL").  Terms of the GPL can be found in doc/GPL-license.txt in this distribution.
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL SOURCE CODE IN THIS DISTRIBUTION IS PROVIDED "AS IS." THE AUTHOR MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ */
+
+#ifndef __QUEUEDSIGNAL_H__
+#define __QUEUEDSIGNAL_H__
+
+// Local project
+//
+#include "LLChatLib.h"
+#include "NetworkThread.h"
+
+// boost
+//
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
+#include <boost/signals.hpp>
+
+
+namespace LLC
+{
+
+
+/// Wraps one of the Manager signal types. Raised on the network thread, the
+/// arguments are copied into the event queue and the slots run when the
+/// front-end calls Manager::DispatchEvents(); raised anywhere else, the
+/// slots run straight away as before.
+///
+/// Slots only ever run on the front-end thread, so connecting needs no lock.
+///
+template<class SIGNAL>
+class QueuedSignalBase
+{
+public:
+	typedef typename SIGNAL::slot_type	slot_type;
+
+	Connection	connect( const slot_type& slot ) { return m_signal.connect( slot ); }
+
+	/// True if nothing is connected, so the caller can skip building the
+	/// arguments. Read on the raising thread, which is safe as long as slots
+	/// are connected before StartNetworkThread().
+	bool		empty() const { return m_signal.empty(); }
+
+protected:
+	SIGNAL		m_signal;
+
+	void Emit( const NetworkThread::Call& call )
+	{
+		if( !NetworkThread::PostEvent( call ) )
+		{
+			call();
+		}
+	}
+};
+
+
+template<class SIGNAL> class QueuedSignal;
+
+// The arguments are taken as the signal's own types, so a const char* from
+// the caller is turned into a String before it is queued.
+//
+template<class R>
+class QueuedSignal< boost::signal<R (void)> > : public QueuedSignalBase< boost::signal<R (void)> >
+{
+public:
+	void operator()()
+	{ this->Emit( boost::bind( boost::ref( this->m_signal ) ) ); }
+};
+
+template<class R, class A1>
+class QueuedSignal< boost::signal<R (A1)> > : public QueuedSignalBase< boost::signal<R (A1)> >
+{
+public:
+	void operator()( A1 a1 )
+	{ this->Emit( boost::bind( boost::ref( this->m_signal ), a1 ) ); }
+};
+
+template<class R, class A1, class A2>
+class QueuedSignal< boost::signal<R (A1, A2)> > : public QueuedSignalBase< boost::signal<R (A1, A2)> >
+{
+public:
+	void operator()( A1 a1, A2 a2 )
+	{ this->Emit( boost::bind( boost::ref( this->m_signal ), a1, a2 ) ); }
+};
+
+template<class R, class A1, class A2, class A3>
+class QueuedSignal< boost::signal<R (A1, A2, A3)> > : public QueuedSignalBase< boost::signal<R (A1, A2, A3)> >
+{
+public:
+	void operator()( A1 a1, A2 a2, A3 a3 )
+	{ this->Emit( boost::bind( boost::ref( this->m_signal ), a1, a2, a3 ) ); }
+};
+
+template<class R, class A1, class A2, class A3, class A4>
+class QueuedSignal< boost::signal<R (A1, A2, A3, A4)> > : public QueuedSignalBase< boost::signal<R (A1, A2, A3, A4)> >
+{
+public:
+	void operator()( A1 a1, A2 a2, A3 a3, A4 a4 )
+	{ this->Emit( boost::bind( boost::ref( this->m_signal ), a1, a2, a3, a4 ) ); }
+};
+
+template<class R, class A1, class A2, class A3, class A4, class A5>
+class QueuedSignal< boost::signal<R (A1, A2, A3, A4, A5)> > : public QueuedSignalBase< boost::signal<R (A1, A2, A3, A4, A5)> >
+{
+public:
+	void operator()( A1 a1, A2 a2, A3 a3, A4 a4, A5 a5 )
+	{ this->Emit( boost::bind( boost::ref( this->m_signal ), a1, a2, a3, a4, a5 ) ); }
+};
+
+template<class R, class A1, class A2, class A3, class A4, class A5, class A6>
+class QueuedSignal< boost::signal<R (A1, A2, A3, A4, A5, A6)> > : public QueuedSignalBase< boost::signal<R (A1, A2, A3, A4, A5, A6)> >
+{
+public:
+	void operator()( A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6 )
+	{ this->Emit( boost::bind( boost::ref( this->m_signal ), a1, a2, a3, a4, a5, a6 ) ); }
+};
+
+template<class R, class A1, class A2, class A3, class A4, class A5, class A6, class A7>
+class QueuedSignal< boost::signal<R (A1, A2, A3, A4, A5, A6, A7)> > : public QueuedSignalBase< boost::signal<R (A1, A2, A3, A4, A5, A6, A7)> >
+{
+public:
+	void operator()( A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7 )
+	{ this->Emit( boost::bind( boost::ref( this->m_signal ), a1, a2, a3, a4, a5, a6, a7 ) ); }
+};
+
+
+}
+//namespace LLC
+
+#endif // __QUEUEDSIGNAL_H__
+
+// vim: ts=4 sw=4 noexpandtab syntax=cpp.doxygen
@@ -0,0 +1,152 @@
+/**
+ * \brief Lock-free single-producer/single-consumer queue
+ *
+ * Copyright (c) 2009-2010 by R. Douglas Barbieri
+ *
+ * The source code in this file ("Source Code") is provided by R. Douglas Barbieri
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL").  Terms of the GPL can be found in doc/GPL-license.txt in this distribution.
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL SOURCE CODE IN THIS DISTRIBUTION IS PROVIDED "AS IS." THE AUTHOR MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ */
+
+#ifndef __SPSCQUEUE_H__
+#define __SPSCQUEUE_H__
+
+#if LL_WINDOWS
+#include <windows.h>
+#endif
+
+
+namespace LLC
+{
+
+
+#if LL_WINDOWS
+#define LLC_MEMORY_BARRIER()	MemoryBarrier()
+#else
+#define LLC_MEMORY_BARRIER()	__sync_synchronize()
+#endif
+
+
+/// Unbounded queue for exactly one thread calling Push() and exactly one
+/// thread calling Pop(). Neither side ever blocks or takes a lock.
+///
+/// Nodes the consumer is done with are handed back to the producer through
+/// the same list, so once the queue has grown to its working size Push()
+/// stops allocating.
+///
+template<class T>
+class SPSCQueue
+{
+public:
+	SPSCQueue()
+	{
+		Node* node	= new Node;
+		node->mNext	= 0;
+		mTail		= node;
+		mHead		= node;
+		mFirst		= node;
+		mTailCopy	= node;
+	}
+
+	~SPSCQueue()
+	{
+		Node* node = mFirst;
+		while( node )
+		{
+			Node* next = node->mNext;
+			delete node;
+			node = next;
+		}
+	}
+
+	/// Producer side
+	void Push( const T& value )
+	{
+		Node* node		= AllocNode();
+		node->mValue	= value;
+		node->mNext		= 0;
+		LLC_MEMORY_BARRIER();		// Value is in place before the node is linked
+		mHead->mNext	= node;
+		mHead			= node;
+	}
+
+	/// Consumer side. Returns false if the queue is empty.
+	bool Pop( T& value )
+	{
+		Node* next = mTail->mNext;
+		if( !next )
+		{
+			return false;
+		}
+		LLC_MEMORY_BARRIER();		// Read the link before the value behind it
+		value			= next->mValue;
+		next->mValue	= T();		// Don't keep the payload alive in a spare node
+		LLC_MEMORY_BARRIER();		// Done with the node before the producer may reuse it
+		mTail			= next;
+		return true;
+	}
+
+	/// Consumer side
+	bool IsEmpty() const { return mTail->mNext == 0; }
+
+private:
+	struct Node
+	{
+		Node* volatile	mNext;
+		T				mValue;
+	};
+
+	enum { CACHE_LINE = 64 };
+
+	// Consumer
+	//
+	Node* volatile	mTail;
+	char			mPad0[CACHE_LINE - sizeof(Node*)];
+
+	// Producer
+	//
+	Node*			mHead;
+	Node*			mFirst;			// Oldest node, spare if the consumer has moved past it
+	Node*			mTailCopy;		// Last seen value of mTail
+	char			mPad1[CACHE_LINE - 3 * sizeof(Node*)];
+
+	Node* AllocNode()
+	{
+		if( mFirst != mTailCopy )
+		{
+			Node* node	= mFirst;
+			mFirst		= mFirst->mNext;
+			return node;
+		}
+		mTailCopy = mTail;
+		LLC_MEMORY_BARRIER();
+		if( mFirst != mTailCopy )
+		{
+			Node* node	= mFirst;
+			mFirst		= mFirst->mNext;
+			return node;
+		}
+		return new Node;
+	}
+
+	// Forbidden
+	//
+	SPSCQueue( const SPSCQueue& );
+	SPSCQueue& operator =( const SPSCQueue& );
+};
+
+
+}
+//namespace LLC
+
+#endif // __SPSCQUEUE_H__
+
+// vim: ts=4 sw=4 noexpandtab syntax=cpp.doxygen
@@ -0,0 +1,421 @@
+/**
+ * \brief Chat translation pipeline: caching, batching and in-order delivery
+ *
+ * Copyright (c) 2009-2010 by R. Douglas Barbieri
+ *
+ * The source code in this file ("Source Code") is provided by R. Douglas Barbieri
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL").  Terms of the GPL can be found in doc/GPL-license.txt in this distribution.
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL SOURCE CODE IN THIS DISTRIBUTION IS PROVIDED "AS IS." THE AUTHOR MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ */
+
+#include "TranslationPipeline.h"
+
+// boost
+//
+#include <boost/bind.hpp>
+
+// llcommon
+//
+#include "lldefs.h"
+#include "lltimer.h"
+
+
+namespace LLC
+{
+
+namespace
+{
+	const size_t	TRANSLATION_CACHE_SIZE	= 512;
+	const F64		DEFAULT_LATENCY_CAP		= 4.0;	// Seconds a line may hold up its conversation
+}
+
+
+TranslationPipeline::TranslationPipeline()
+	: m_targetLang("en")
+	, m_latencyCap(DEFAULT_LATENCY_CAP)
+	, m_nextSerial(0)
+{
+}
+
+
+void TranslationPipeline::SetTargetLanguage( const std::string& lang_id )
+{
+	// Anything already batched was keyed against the old language
+	//
+	FlushBatches();
+	m_targetLang = lang_id;
+}
+
+
+void TranslationPipeline::Submit( const std::string& conversation
+								, const LLUUID& from_id
+								, const std::string& source_lang
+								, const LLSD& params
+								, const DispatchFn& dispatch
+								, const bool translate
+								)
+{
+	const U32 serial = m_nextSerial++;
+	//
+	Line& line			= m_lines[serial];
+	line.mConversation	= conversation;
+	line.mParams		= params;
+	line.mDispatch		= dispatch;
+	line.mExpires		= LLTimer::getTotalSeconds() + m_latencyCap;
+	line.mReady			= false;
+	m_conversations[conversation].push_back( serial );
+
+	if( !translate )
+	{
+		line.mReady = true;
+		Release( conversation );
+	}
+	else if( !m_backend )
+	{
+		Finish( serial, params["source"].asString(), m_targetLang );
+	}
+	else if( !source_lang.empty() )
+	{
+		Resolve( serial, source_lang );
+	}
+	else
+	{
+		// Only the first line from a sender goes out for detection; the rest
+		// wait for its answer.
+		//
+		SerialList& waiting = m_detecting[from_id];
+		waiting.push_back( serial );
+		if( waiting.size() == 1 )
+		{
+			m_backend->Detect	( params["source"].asString()
+								, boost::bind( &TranslationPipeline::OnDetect, this, from_id, _1, _2, _3 )
+								);
+		}
+	}
+}
+
+
+void TranslationPipeline::Pump()
+{
+	FlushBatches();
+
+	ConversationMap::iterator		iter = m_conversations.begin();
+	const ConversationMap::iterator	end  = m_conversations.end();
+	for( ; iter != end; ++iter )
+	{
+		Release( iter->first );
+	}
+
+	// Release() never erases, since a dispatch callback may land back in it
+	//
+	for( iter = m_conversations.begin(); iter != m_conversations.end(); )
+	{
+		if( iter->second.empty() )
+		{
+			m_conversations.erase( iter++ );
+		}
+		else
+		{
+			++iter;
+		}
+	}
+}
+
+
+int TranslationPipeline::GetNextDeadline() const
+{
+	if( !m_batches.empty() )
+	{
+		return 0;
+	}
+
+	F64 next = -1.0;
+	ConversationMap::const_iterator			iter = m_conversations.begin();
+	const ConversationMap::const_iterator	end  = m_conversations.end();
+	for( ; iter != end; ++iter )
+	{
+		if( iter->second.empty() )
+		{
+			continue;
+		}
+		LineMap::const_iterator line = m_lines.find( iter->second.front() );
+		if( line != m_lines.end() && (next < 0.0 || line->second.mExpires < next) )
+		{
+			next = line->second.mExpires;
+		}
+	}
+
+	if( next < 0.0 )
+	{
+		return -1;
+	}
+	const F64 remaining = next - LLTimer::getTotalSeconds();
+	return remaining > 0.0 ? (int) (remaining * 1000.0) + 1 : 0;
+}
+
+
+// static
+std::string TranslationPipeline::MakeKey( const std::string& text, const std::string& source_lang, const std::string& target_lang )
+{
+	std::string key;
+	key.reserve( text.size() + source_lang.size() + target_lang.size() + 2 );
+	key.append( source_lang );
+	key.push_back( '\0' );
+	key.append( target_lang );
+	key.push_back( '\0' );
+	key.append( text );
+	return key;
+}
+
+
+bool TranslationPipeline::CacheLookup( const std::string& key, std::string& translated )
+{
+	CacheIndex::iterator iter = m_cacheIndex.find( key );
+	if( iter == m_cacheIndex.end() )
+	{
+		return false;
+	}
+	m_cache.splice( m_cache.begin(), m_cache, iter->second );
+	translated = iter->second->second;
+	return true;
+}
+
+
+void TranslationPipeline::CacheStore( const std::string& key, const std::string& translated )
+{
+	CacheIndex::iterator iter = m_cacheIndex.find( key );
+	if( iter != m_cacheIndex.end() )
+	{
+		iter->second->second = translated;
+		m_cache.splice( m_cache.begin(), m_cache, iter->second );
+		return;
+	}
+
+	m_cache.push_front( CacheEntry( key, translated ) );
+	m_cacheIndex[key] = m_cache.begin();
+	if( m_cache.size() > TRANSLATION_CACHE_SIZE )
+	{
+		m_cacheIndex.erase( m_cache.back().first );
+		m_cache.pop_back();
+	}
+}
+
+
+void TranslationPipeline::Resolve( const U32 serial, const std::string& source_lang )
+{
+	LineMap::iterator iter = m_lines.find( serial );
+	if( iter == m_lines.end() )
+	{
+		// Already went out untranslated
+		return;
+	}
+
+	const std::string text = iter->second.mParams["source"].asString();
+	if( text.empty() || source_lang == m_targetLang )
+	{
+		Finish( serial, text, source_lang );
+		return;
+	}
+
+	const std::string key = MakeKey( text, source_lang, m_targetLang );
+	std::string translated;
+	if( CacheLookup( key, translated ) )
+	{
+		Finish( serial, translated, source_lang );
+		return;
+	}
+
+	SerialList& waiting = m_translating[key];
+	if( waiting.empty() )
+	{
+		m_batches[source_lang].push_back( text );
+	}
+	waiting.push_back( serial );
+}
+
+
+void TranslationPipeline::Finish( const U32 serial, const std::string& message, const std::string& language )
+{
+	LineMap::iterator iter = m_lines.find( serial );
+	if( iter == m_lines.end() )
+	{
+		return;
+	}
+
+	Line& line = iter->second;
+	line.mParams["message"]		= message;
+	line.mParams["language"]	= language;
+	line.mReady					= true;
+	//
+	Release( line.mConversation );
+}
+
+
+void TranslationPipeline::Release( const std::string& conversation )
+{
+	ConversationMap::iterator conv = m_conversations.find( conversation );
+	if( conv == m_conversations.end() )
+	{
+		return;
+	}
+
+	SerialList& serials = conv->second;
+	F64 now = -1.0;
+	while( !serials.empty() )
+	{
+		LineMap::iterator iter = m_lines.find( serials.front() );
+		if( iter == m_lines.end() )
+		{
+			serials.pop_front();
+			continue;
+		}
+
+		Line& line = iter->second;
+		if( !line.mReady )
+		{
+			if( now < 0.0 )
+			{
+				now = LLTimer::getTotalSeconds();
+			}
+			if( now < line.mExpires )
+			{
+				break;
+			}
+			// Waited long enough: show the original and drop the translation
+			// when it turns up.
+			//
+			line.mParams["message"]		= line.mParams["source"];
+			line.mParams["language"]	= m_targetLang;
+		}
+
+		// Take the line off the queue before dispatching, so anything the
+		// callback submits lands behind it.
+		//
+		const LLSD			params	 = line.mParams;
+		const DispatchFn	dispatch = line.mDispatch;
+		m_lines.erase( iter );
+		serials.pop_front();
+		//
+		dispatch( params );
+	}
+}
+
+
+void TranslationPipeline::FlushBatches()
+{
+	if( m_batches.empty() || !m_backend )
+	{
+		return;
+	}
+
+	BatchMap batches;
+	batches.swap( m_batches );
+
+	const size_t max_batch = llmax( (size_t) 1, m_backend->GetMaxBatch() );
+	BatchMap::const_iterator		iter = batches.begin();
+	const BatchMap::const_iterator	end  = batches.end();
+	for( ; iter != end; ++iter )
+	{
+		const TranslationBackend::TextList& texts = iter->second;
+		for( size_t start = 0; start < texts.size(); start += max_batch )
+		{
+			const size_t stop = llmin( start + max_batch, texts.size() );
+			const TranslationBackend::TextList chunk( texts.begin() + start, texts.begin() + stop );
+			m_backend->Translate( iter->first
+								, m_targetLang
+								, chunk
+								, boost::bind( &TranslationPipeline::OnTranslate, this, iter->first, m_targetLang, chunk, _1, _2 )
+								);
+		}
+	}
+}
+
+
+void TranslationPipeline::OnDetect( const LLUUID from_id, bool ok, const std::string& language, bool reliable )
+{
+	DetectWaitMap::iterator iter = m_detecting.find( from_id );
+	if( iter == m_detecting.end() )
+	{
+		return;
+	}
+	SerialList waiting;
+	waiting.swap( iter->second );
+	m_detecting.erase( iter );
+
+	const bool usable = ok && reliable && !language.empty();
+	if( usable && m_languageCallback )
+	{
+		m_languageCallback( from_id, language );
+	}
+
+	SerialList::const_iterator			serial = waiting.begin();
+	const SerialList::const_iterator	end    = waiting.end();
+	for( ; serial != end; ++serial )
+	{
+		if( usable )
+		{
+			Resolve( *serial, language );
+		}
+		else
+		{
+			LineMap::iterator line = m_lines.find( *serial );
+			if( line != m_lines.end() )
+			{
+				Finish( *serial, line->second.mParams["source"].asString(), m_targetLang );
+			}
+		}
+	}
+}
+
+
+void TranslationPipeline::OnTranslate	( const std::string source_lang
+										, const std::string target_lang
+										, const TranslationBackend::TextList texts
+										, bool ok
+										, const TranslationBackend::TextList& translated
+										)
+{
+	for( size_t idx = 0; idx < texts.size(); ++idx )
+	{
+		const std::string key = MakeKey( texts[idx], source_lang, target_lang );
+
+		std::string message  = texts[idx];
+		std::string language = target_lang;
+		if( ok && idx < translated.size() )
+		{
+			message  = translated[idx];
+			language = source_lang;
+			CacheStore( key, message );
+		}
+
+		TranslateWaitMap::iterator iter = m_translating.find( key );
+		if( iter == m_translating.end() )
+		{
+			continue;
+		}
+		SerialList waiting;
+		waiting.swap( iter->second );
+		m_translating.erase( iter );
+
+		SerialList::const_iterator			serial = waiting.begin();
+		const SerialList::const_iterator	end    = waiting.end();
+		for( ; serial != end; ++serial )
+		{
+			Finish( *serial, message, language );
+		}
+	}
+}
+
+
+}
+//namespace LLC
+
+// vim: ts=4 sw=4 noexpandtab syntax=cpp.doxygen
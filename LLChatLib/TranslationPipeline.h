@@ -0,0 +1,182 @@
+/**
+ * \brief Header for the chat translation pipeline
+ *
+ * Copyright (c) 2009-2010 by R. Douglas Barbieri
+ *
+ * The source code in this file ("Source Code") is provided by R. Douglas Barbieri
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL").  Terms of the GPL can be found in doc/GPL-license.txt in this distribution.
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL SOURCE CODE IN THIS DISTRIBUTION IS PROVIDED "AS IS." THE AUTHOR MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ */
+
+#ifndef __TRANSLATIONPIPELINE_H__
+#define __TRANSLATIONPIPELINE_H__
+
+// stdc++
+//
+#include <deque>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+// boost
+//
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+
+// llcommon
+//
+#include "llsd.h"
+#include "lluuid.h"
+#include "stdtypes.h"
+
+
+namespace LLC
+{
+
+
+/// The service that does the actual work. The pipeline only ever talks to
+/// this interface, so a local stand-in can take the place of Google.
+/// Callbacks may be made before Detect() or Translate() returns.
+///
+class TranslationBackend
+{
+public:
+	typedef std::vector<std::string>	TextList;
+
+	/// ok is false if the request failed. reliable is false if the service
+	/// could not tell with enough confidence.
+	typedef boost::function<void (bool ok, const std::string& language, bool reliable)>	DetectCallback;
+	/// translated has one entry per text sent, in the same order.
+	typedef boost::function<void (bool ok, const TextList& translated)>						TranslateCallback;
+
+	virtual ~TranslationBackend() {}
+
+	virtual void	Detect( const std::string& text, const DetectCallback& callback ) = 0;
+	virtual void	Translate	( const std::string& source_lang
+								, const std::string& target_lang
+								, const TextList& texts
+								, const TranslateCallback& callback
+								) = 0;
+
+	/// Most texts Translate() accepts in one call
+	virtual size_t	GetMaxBatch() const { return 1; }
+};
+
+typedef boost::shared_ptr<TranslationBackend>	TranslationBackendPtr;
+
+
+/// Takes incoming chat lines and hands them back translated, in the order
+/// they arrived in each conversation.
+///
+/// - Translations are kept in an LRU cache keyed on (text, source, target),
+///   and a line already on its way to the backend is not sent twice.
+/// - Lines waiting for the same source language are sent together, up to
+///   GetMaxBatch() per request, when Pump() runs.
+/// - A sender with no known language gets one detect request; any more lines
+///   from them wait on it. A reliable result is reported to the language
+///   callback so the caller can remember it and pass it in next time.
+/// - A line that is still waiting after the latency cap goes out untranslated
+///   rather than hold up its conversation.
+///
+class TranslationPipeline
+{
+public:
+	typedef boost::function<void (const LLSD&)>								DispatchFn;
+	typedef boost::function<void (const LLUUID&, const std::string&)>		LanguageFn;
+
+	TranslationPipeline();
+
+	void	SetBackend( const TranslationBackendPtr& backend )	{ m_backend = backend; }
+	void	SetLanguageCallback( const LanguageFn& callback )	{ m_languageCallback = callback; }
+	void	SetTargetLanguage( const std::string& lang_id );
+	void	SetLatencyCap( const F64 seconds )					{ m_latencyCap = seconds; }
+
+	/// Queue one line. params must hold "source"; "message" and "language"
+	/// are filled in before dispatch is called. source_lang is the sender's
+	/// language if known, empty to detect it. If translate is false the line
+	/// is passed through as is, but still waits behind earlier lines in the
+	/// conversation.
+	void	Submit	( const std::string& conversation
+					, const LLUUID& from_id
+					, const std::string& source_lang
+					, const LLSD& params
+					, const DispatchFn& dispatch
+					, const bool translate = true
+					);
+
+	/// Send batched requests and release lines past the latency cap.
+	void	Pump();
+
+	/// Milliseconds until Pump() has lines to release or requests to send, -1 if none.
+	int		GetNextDeadline() const;
+
+private:
+	struct Line
+	{
+		std::string		mConversation;
+		LLSD			mParams;
+		DispatchFn		mDispatch;
+		F64				mExpires;
+		bool			mReady;
+	};
+	typedef std::map<U32, Line>					LineMap;		// By serial number, so in arrival order
+	typedef std::deque<U32>						SerialList;
+	typedef std::map<std::string, SerialList>	ConversationMap;
+	typedef std::map<LLUUID, SerialList>		DetectWaitMap;
+	typedef std::map<std::string, SerialList>	TranslateWaitMap;	// By cache key
+	typedef std::map<std::string, TranslationBackend::TextList>	BatchMap;		// By source language
+
+	// LRU cache: most recently used at the front of the list
+	//
+	typedef std::pair<std::string, std::string>	CacheEntry;
+	typedef std::list<CacheEntry>				CacheList;
+	typedef std::map<std::string, CacheList::iterator>	CacheIndex;
+
+	TranslationBackendPtr	m_backend;
+	LanguageFn				m_languageCallback;
+	std::string				m_targetLang;
+	F64						m_latencyCap;
+	U32						m_nextSerial;
+
+	LineMap					m_lines;
+	ConversationMap			m_conversations;
+	DetectWaitMap			m_detecting;
+	TranslateWaitMap		m_translating;
+	BatchMap				m_batches;
+	CacheList				m_cache;
+	CacheIndex				m_cacheIndex;
+
+	static std::string	MakeKey( const std::string& text, const std::string& source_lang, const std::string& target_lang );
+	bool				CacheLookup( const std::string& key, std::string& translated );
+	void				CacheStore( const std::string& key, const std::string& translated );
+
+	void	Resolve( const U32 serial, const std::string& source_lang );
+	void	Finish( const U32 serial, const std::string& message, const std::string& language );
+	void	Release( const std::string& conversation );
+	void	FlushBatches();
+
+	void	OnDetect( const LLUUID from_id, bool ok, const std::string& language, bool reliable );
+	void	OnTranslate	( const std::string source_lang
+						, const std::string target_lang
+						, const TranslationBackend::TextList texts
+						, bool ok
+						, const TranslationBackend::TextList& translated
+						);
+};
+
+
+}
+//namespace LLC
+
+#endif // __TRANSLATIONPIPELINE_H__
+
+// vim: ts=4 sw=4 noexpandtab syntax=cpp.doxygen
@@ -0,0 +1,94 @@
+/**
+ * \brief Implements the Uuid methods.
+ *
+ * Copyright (c) 2009-2010 by R. Douglas Barbieri
+ *
+ * The source code in this file ("Source Code") is provided by R. Douglas Barbieri
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL").  Terms of the GPL can be found in doc/GPL-license.txt in this distribution.
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL SOURCE CODE IN THIS DISTRIBUTION IS PROVIDED "AS IS." THE AUTHOR MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ */
+
+#include "UuidImpl.h"
+
+namespace LLC
+{
+
+/**
+ * \brief True if every byte is zero.
+ */
+bool Uuid::IsNull() const
+{
+	return *this == Null();
+}
+
+/**
+ * \brief Formats the ID into a buffer supplied by the caller, without allocating.
+ *
+ * \param buffer [out]	At least STRING_SIZE chars; receives the ID in the usual 8-4-4-4-12 form, null delimited.
+ */
+void Uuid::ToString( char* buffer ) const
+{
+	ToLLUUID( *this ).toString( buffer );
+}
+
+/**
+ * \brief Returns the ID as a String, for the calls that still take one.
+ */
+String Uuid::ToString() const
+{
+	char buffer[STRING_SIZE];
+	ToString( buffer );
+	return String( buffer );
+}
+
+/**
+ * \brief Parses an ID in the usual 8-4-4-4-12 form.
+ *
+ * \param str [in]	Null delimited text.
+ * \return The ID, or a null ID if str is not valid.
+ */
+Uuid Uuid::FromString( const char* str )
+{
+	LLUUID id;
+	if( !id.set( str, FALSE ) )
+	{
+		id.setNull();
+	}
+	return ToUuid( id );
+}
+
+/**
+ * \brief Returns the null ID.
+ */
+Uuid Uuid::Null()
+{
+	Uuid uuid;
+	memset( uuid.m_data, 0, SIZE );
+	return uuid;
+}
+
+
+int CopyToBuffer( const std::string& str, char* buffer, const int size )
+{
+	if( size > 0 )
+	{
+		const int length = llmin( (int) str.size(), size - 1 );
+		memcpy( buffer, str.data(), length );
+		buffer[length] = '\0';
+	}
+	return (int) str.size();
+}
+
+
+}
+//namespace LLC
+
+// vim: ts=4 sw=4 noexpandtab
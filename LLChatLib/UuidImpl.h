@@ -0,0 +1,72 @@
+/**
+ * \brief Conversions between LLC::Uuid and LLUUID.
+ *
+ * Copyright (c) 2009-2010 by R. Douglas Barbieri
+ *
+ * The source code in this file ("Source Code") is provided by R. Douglas Barbieri
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL").  Terms of the GPL can be found in doc/GPL-license.txt in this distribution.
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL SOURCE CODE IN THIS DISTRIBUTION IS PROVIDED "AS IS." THE AUTHOR MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ */
+#ifndef __UUIDIMPL_H__
+#define __UUIDIMPL_H__
+
+#include "LLChatLib.h"
+
+#include "linden_common.h"
+#include "lluuid.h"
+
+#include <string>
+
+
+namespace LLC
+{
+
+
+// Both are the 16 bytes and nothing else, so converting is a copy
+//
+inline Uuid ToUuid( const LLUUID& id )
+{
+	Uuid uuid;
+	memcpy( uuid.m_data, id.mData, Uuid::SIZE );
+	return uuid;
+}
+
+
+inline LLUUID ToLLUUID( const Uuid& uuid )
+{
+	LLUUID id;
+	memcpy( id.mData, uuid.m_data, Uuid::SIZE );
+	return id;
+}
+
+
+inline StringRef ToStringRef( const std::string& str )
+{
+	return StringRef( str.c_str(), (int) str.size() );
+}
+
+
+inline std::string ToStdString( const StringRef& str )
+{
+	return std::string( str.m_data, str.m_length );
+}
+
+
+/// Copies str into buffer, cut to fit and null-terminated. Returns the length
+/// of the whole of str, as snprintf() does.
+int CopyToBuffer( const std::string& str, char* buffer, const int size );
+
+}
+
+#endif //__UUIDIMPL_H__
+
+
+// vim: ts=4 sw=4 noexpandtab syntax=cpp.doxygen
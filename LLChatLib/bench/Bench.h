@@ -0,0 +1,107 @@
+/**
+ * \brief Helpers shared by the llcbench micro-benchmarks
+ *
+ * Copyright (c) 2009-2010 by R. Douglas Barbieri
+ *
+ * The source code in this file ("Source Code") is provided by R. Douglas Barbieri
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL").  Terms of the GPL can be found in doc/GPL-license.txt in this distribution.
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL SOURCE CODE IN THIS DISTRIBUTION IS PROVIDED "AS IS." THE AUTHOR MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ */
+
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+// llcommon
+//
+#include "linden_common.h"
+#include "lluuid.h"
+#include "timing.h"
+
+
+namespace Bench
+{
+
+/// Heap allocations made since the program started. llcbench replaces the
+/// global operator new to count them.
+///
+U64		Allocations();
+
+/// Allocations not yet freed. Grows across a run that leaks.
+///
+S64		LiveAllocations();
+
+/// Wall clock stopwatch, in microseconds.
+///
+class Stopwatch
+{
+public:
+	Stopwatch() : m_start( totalTime() ) {}
+
+	void	Restart()			{ m_start = totalTime(); }
+	U64		Elapsed() const		{ return totalTime() - m_start; }
+
+private:
+	U64		m_start;
+};
+
+/// Small deterministic generator, so every run replays the same pattern.
+///
+class Random
+{
+public:
+	explicit Random( U32 seed = 1 ) : m_state( seed ) {}
+
+	U32		Next()				{ m_state = m_state * 1664525 + 1013904223; return m_state >> 8; }
+	U32		Below( U32 limit )	{ return Next() % limit; }
+
+private:
+	U32		m_state;
+};
+
+/// A random id, for benches that need agents, groups or sessions.
+///
+inline LLUUID MakeId( Random& random )
+{
+	LLUUID id;
+	for( U32 idx = 0; idx < UUID_BYTES; ++idx )
+	{
+		id.mData[idx] = (U8) random.Next();
+	}
+	return id;
+}
+
+/// One line of results: "<bench> <what>: <value> <unit>"
+///
+void	Report( const char* bench, const char* what, F64 value, const char* unit );
+
+/// A run that didn't do the work it was timing. Printed to stderr, and
+/// llcbench exits non-zero, so its figures can't be mistaken for results.
+///
+void	Fail( const char* bench, const char* what );
+
+}
+// namespace Bench
+
+
+// One entry point per benchmark; llcbench.cpp lists them.
+//
+void	BenchTimerWheel();
+void	BenchPacketWindow();
+void	BenchBuddyList();
+void	BenchChatEvent();
+void	BenchLLSDParse();
+void	BenchZeroCode();
+void	BenchDispatch();
+void	BenchStartup();
+
+#endif // __BENCH_H__
+
+// vim: ts=4 sw=4 noexpandtab syntax=cpp.doxygen
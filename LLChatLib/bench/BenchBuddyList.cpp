@@ -0,0 +1,362 @@
+/**
+ * \brief Delivery cost of the buddy list and roster updates, one signal per agent or batched
+ *
+ * Copyright (c) 2009-2010 by R. Douglas Barbieri
+ *
+ * The source code in this file ("Source Code") is provided by R. Douglas Barbieri
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL").  Terms of the GPL can be found in doc/GPL-license.txt in this distribution.
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL SOURCE CODE IN THIS DISTRIBUTION IS PROVIDED "AS IS." THE AUTHOR MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ */
+
+#include "Bench.h"
+
+// Local project
+//
+#include "IdListImpl.h"
+#include "LLChatLib.h"
+#include "NetworkThread.h"
+#include "SPSCQueue.h"
+
+// llinventory
+//
+#include "lluserrelations.h"
+
+// boost
+//
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
+
+// stdc++
+//
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+
+using namespace LLC;
+
+namespace
+{
+
+const U32 BUDDY_COUNT	= 5000;
+const U32 ROSTER_COUNT	= 300;		// Agents in one roster update, half entering and half leaving
+const U32 REPEAT		= 20;
+
+// The shape of the login "buddy-list" option, as LLUserAuth::getOptions() returns it
+//
+typedef std::map<std::string, std::string>	response_t;
+typedef std::vector<response_t>				options_t;
+
+// The per-agent roster signal that RosterDeltaSignal replaced
+//
+typedef boost::signal	< void
+						( String				// session/group id
+						, String				// agent_id
+						, bool					// entering
+						)
+						> GroupChatAgentUpdateSignal;
+
+// Stands in for the network thread's event queue: the signal is bound into a
+// Call on one side, as QueuedSignal does, and fired on the other, as
+// NetworkThread::DispatchEvents() does.
+//
+typedef SPSCQueue<NetworkThread::Call>	EventQueue;
+
+U32 Dispatch( EventQueue& events )
+{
+	U32 fired = 0;
+	NetworkThread::Call call;
+	while( events.Pop( call ) )
+	{
+		call();
+		++fired;
+	}
+	return fired;
+}
+
+options_t MakeBuddyList()
+{
+	Bench::Random random;
+	options_t options;
+	for( U32 idx = 0; idx < BUDDY_COUNT; ++idx )
+	{
+		char rights[8];
+		snprintf( rights, sizeof(rights), "%u", random.Below( 16 ) );
+		response_t option;
+		option["buddy_id"]				= Bench::MakeId( random ).asString();
+		option["buddy_rights_has"]		= rights;
+		option["buddy_rights_given"]	= rights;
+		options.push_back( option );
+	}
+	return options;
+}
+
+// Front-end slots. They read every ID the way SLiteChat does, so the IDs
+// really have to be formatted, and count the ones that arrive intact. A run
+// that delivers fewer than it was given has measured nothing.
+//
+struct Receiver
+{
+	U32		m_count;
+
+	Receiver() : m_count(0) {}
+
+	void OnFriendAdd( String agent_id )
+	{
+		m_count += IsId( agent_id.GetString() );
+	}
+
+	void OnFriendsAdded( IdList agent_ids )
+	{
+		char buffer[IdList::ID_STRING_SIZE];
+		for( int idx = 0; idx < agent_ids.GetCount(); ++idx )
+		{
+			agent_ids.GetId( idx, buffer );
+			m_count += IsId( buffer );
+		}
+	}
+
+	void OnAgentUpdate( String session_id, String agent_id, bool entering )
+	{
+		m_count += IsId( agent_id.GetString() ) && IsId( session_id.GetString() );
+	}
+
+	void OnRosterDelta( String session_id, IdList entered, IdList left )
+	{
+		if( IsId( session_id.GetString() ) )
+		{
+			OnFriendsAdded( entered );
+			OnFriendsAdded( left );
+		}
+	}
+
+	// A formatted, non-null ID. Cheap enough not to show in the figures.
+	//
+	static bool IsId( const char* id )
+	{
+		return strlen( id ) == UUID_STR_LENGTH - 1
+			&& strcmp( id, "00000000-0000-0000-0000-000000000000" ) != 0;
+	}
+};
+
+IdList TakeIdList( IdListImpl::LLUUIDList& ids )
+{
+	if( ids.empty() )
+	{
+		return IdList();
+	}
+	return IdList( boost::shared_ptr<const IdListImpl>( new IdListImpl( ids ) ) );
+}
+
+// What RequestBuddyList() did before: parse every entry, keep an
+// LLRelationship for it and send the GUI one signal per buddy.
+//
+void RunBuddiesPerAgent( const options_t& options, Receiver& receiver, EventQueue& events )
+{
+	Manager::StringSignal signal;
+	signal.connect( boost::bind( &Receiver::OnFriendAdd, &receiver, _1 ) );
+	//
+	typedef std::map<LLUUID, LLRelationship*> buddy_map_t;
+	buddy_map_t list;
+	LLUUID agent_id;
+	S32 has_rights = 0, given_rights = 0;
+	for( options_t::const_iterator it = options.begin(); it != options.end(); ++it )
+	{
+		response_t::const_iterator option_it = it->find( "buddy_id" );
+		if( option_it != it->end() )
+		{
+			agent_id.set( option_it->second );
+		}
+		option_it = it->find( "buddy_rights_has" );
+		if( option_it != it->end() )
+		{
+			has_rights = atoi( option_it->second.c_str() );
+		}
+		option_it = it->find( "buddy_rights_given" );
+		if( option_it != it->end() )
+		{
+			given_rights = atoi( option_it->second.c_str() );
+		}
+		list[agent_id] = new LLRelationship( given_rights, has_rights, false );
+		//
+		events.Push( boost::bind( boost::ref( signal ), String( agent_id.asString().c_str() ) ) );
+	}
+	Dispatch( events );
+	//
+	// The map goes, the relationships stay: the library never freed them
+	// either, and the live allocation count shows it.
+}
+
+// What RequestBuddyList() does now: collect the IDs and send them at once.
+//
+void RunBuddiesBatched( const options_t& options, Receiver& receiver, EventQueue& events )
+{
+	Manager::FriendsAddedSignal signal;
+	signal.connect( boost::bind( &Receiver::OnFriendsAdded, &receiver, _1 ) );
+	//
+	IdListImpl::LLUUIDList buddies;
+	buddies.reserve( options.size() );
+	for( options_t::const_iterator it = options.begin(); it != options.end(); ++it )
+	{
+		response_t::const_iterator option_it = it->find( "buddy_id" );
+		if( option_it == it->end() )
+		{
+			continue;
+		}
+		LLUUID agent_id( option_it->second );
+		if( agent_id.isNull() )
+		{
+			continue;
+		}
+		buddies.push_back( agent_id );
+	}
+	events.Push( boost::bind( boost::ref( signal ), TakeIdList( buddies ) ) );
+	Dispatch( events );
+}
+
+// One ChatterBoxSessionAgentListUpdates, before: a signal per transition.
+//
+void RunRosterPerAgent( const LLUUID& session_id, const std::vector<LLUUID>& agents, Receiver& receiver, EventQueue& events )
+{
+	GroupChatAgentUpdateSignal signal;
+	signal.connect( boost::bind( &Receiver::OnAgentUpdate, &receiver, _1, _2, _3 ) );
+	//
+	for( U32 idx = 0; idx < agents.size(); ++idx )
+	{
+		const std::string session = session_id.asString();
+		const std::string agent = agents[idx].asString();
+		events.Push( boost::bind( boost::ref( signal ), String( session.c_str() ), String( agent.c_str() ), (idx % 2) == 0 ) );
+	}
+	Dispatch( events );
+}
+
+// And now: one RosterDeltaSignal for the whole update.
+//
+void RunRosterBatched( const LLUUID& session_id, const std::vector<LLUUID>& agents, Receiver& receiver, EventQueue& events )
+{
+	Manager::RosterDeltaSignal signal;
+	signal.connect( boost::bind( &Receiver::OnRosterDelta, &receiver, _1, _2, _3 ) );
+	//
+	IdListImpl::LLUUIDList entered;
+	IdListImpl::LLUUIDList left;
+	for( U32 idx = 0; idx < agents.size(); ++idx )
+	{
+		((idx % 2) == 0? entered: left).push_back( agents[idx] );
+	}
+	events.Push( boost::bind( boost::ref( signal ), String( session_id.asString().c_str() ), TakeIdList( entered ), TakeIdList( left ) ) );
+	Dispatch( events );
+}
+
+void Report( const char* what, const U64 elapsed, const U64 allocations, const S64 live, const U32 per )
+{
+	char line[64];
+	snprintf( line, sizeof(line), "%s: per run", what );
+	Bench::Report( "buddies", line, (F64)elapsed / REPEAT, "us" );
+	snprintf( line, sizeof(line), "%s: allocs per agent", what );
+	Bench::Report( "buddies", line, (F64)allocations / (REPEAT * per), "allocs" );
+	snprintf( line, sizeof(line), "%s: left live per run", what );
+	Bench::Report( "buddies", line, (F64)live / REPEAT, "allocs" );
+}
+
+// Every run, warm-up included, has to have delivered every agent
+//
+void CheckDelivered( const char* what, const Receiver& receiver, const U32 per )
+{
+	if( receiver.m_count != per * (REPEAT + 1) )
+	{
+		char line[96];
+		snprintf( line, sizeof(line), "%s: delivered %u of %u agents", what, receiver.m_count, per * (REPEAT + 1) );
+		Bench::Fail( "buddies", line );
+	}
+}
+
+}
+// namespace
+
+
+void BenchBuddyList()
+{
+	const options_t options = MakeBuddyList();
+	EventQueue events;
+	//
+	// Each way is run once before it is timed, so the queue has its spare
+	// nodes and the signal code is warm.
+	//
+	{
+		Receiver receiver;
+		RunBuddiesPerAgent( options, receiver, events );
+		const U64 start_allocations = Bench::Allocations();
+		const S64 start_live = Bench::LiveAllocations();
+		Bench::Stopwatch watch;
+		for( U32 run = 0; run < REPEAT; ++run )
+		{
+			RunBuddiesPerAgent( options, receiver, events );
+		}
+		const U64 elapsed = watch.Elapsed();
+		Report( "5k buddies, signal each", elapsed, Bench::Allocations() - start_allocations, Bench::LiveAllocations() - start_live, BUDDY_COUNT );
+		CheckDelivered( "5k buddies, signal each", receiver, BUDDY_COUNT );
+	}
+	{
+		Receiver receiver;
+		RunBuddiesBatched( options, receiver, events );
+		const U64 start_allocations = Bench::Allocations();
+		const S64 start_live = Bench::LiveAllocations();
+		Bench::Stopwatch watch;
+		for( U32 run = 0; run < REPEAT; ++run )
+		{
+			RunBuddiesBatched( options, receiver, events );
+		}
+		const U64 elapsed = watch.Elapsed();
+		Report( "5k buddies, one list", elapsed, Bench::Allocations() - start_allocations, Bench::LiveAllocations() - start_live, BUDDY_COUNT );
+		CheckDelivered( "5k buddies, one list", receiver, BUDDY_COUNT );
+	}
+
+	Bench::Random random;
+	const LLUUID session_id = Bench::MakeId( random );
+	std::vector<LLUUID> agents;
+	for( U32 idx = 0; idx < ROSTER_COUNT; ++idx )
+	{
+		agents.push_back( Bench::MakeId( random ) );
+	}
+	{
+		Receiver receiver;
+		RunRosterPerAgent( session_id, agents, receiver, events );
+		const U64 start_allocations = Bench::Allocations();
+		const S64 start_live = Bench::LiveAllocations();
+		Bench::Stopwatch watch;
+		for( U32 run = 0; run < REPEAT; ++run )
+		{
+			RunRosterPerAgent( session_id, agents, receiver, events );
+		}
+		const U64 elapsed = watch.Elapsed();
+		Report( "300 roster, signal each", elapsed, Bench::Allocations() - start_allocations, Bench::LiveAllocations() - start_live, ROSTER_COUNT );
+		CheckDelivered( "300 roster, signal each", receiver, ROSTER_COUNT );
+	}
+	{
+		Receiver receiver;
+		RunRosterBatched( session_id, agents, receiver, events );
+		const U64 start_allocations = Bench::Allocations();
+		const S64 start_live = Bench::LiveAllocations();
+		Bench::Stopwatch watch;
+		for( U32 run = 0; run < REPEAT; ++run )
+		{
+			RunRosterBatched( session_id, agents, receiver, events );
+		}
+		const U64 elapsed = watch.Elapsed();
+		Report( "300 roster, one delta", elapsed, Bench::Allocations() - start_allocations, Bench::LiveAllocations() - start_live, ROSTER_COUNT );
+		CheckDelivered( "300 roster, one delta", receiver, ROSTER_COUNT );
+	}
+}
+
+// vim: ts=4 sw=4 noexpandtab syntax=cpp.doxygen
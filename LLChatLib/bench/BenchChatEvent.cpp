@@ -0,0 +1,216 @@
+/**
+ * \brief Allocations per delivered chat line through ManagerImpl, String signals against ChatEvent
+ *
+ * Copyright (c) 2009-2010 by R. Douglas Barbieri
+ *
+ * The source code in this file ("Source Code") is provided by R. Douglas Barbieri
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL").  Terms of the GPL can be found in doc/GPL-license.txt in this distribution.
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL SOURCE CODE IN THIS DISTRIBUTION IS PROVIDED "AS IS." THE AUTHOR MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ */
+
+#include "Bench.h"
+
+// Local project
+//
+#include "LLChatLib.h"
+#include "ManagerImpl.h"
+#include "NetworkThread.h"
+
+// llcommon
+//
+#include "llapr.h"
+#include "llsd.h"
+#include "llthread.h"
+
+// boost
+//
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+
+// stdc++
+//
+#include <cstdio>
+#include <cstring>
+
+
+namespace LLC
+{
+
+// Friend of ManagerImpl and NetworkThread, so the bench can run the real
+// dispatch code without a login, and raise from the front-end thread as if
+// it were the network thread.
+//
+class BenchAccess
+{
+public:
+	static void GroupChatDispatch( ManagerImpl& manager, const LLSD& params )
+	{
+		manager.HandleGroupChatDispatch( params );
+	}
+
+	/// PostEvent() queues on thread while this is set. The thread is never
+	/// started; only its event queue is used.
+	///
+	static void PoseAsNetworkThread( NetworkThread* thread )
+	{
+		NetworkThread::s_instance = thread;
+		NetworkThread::s_threadId = thread? LLThread::currentID(): 0;
+	}
+};
+
+}
+// namespace LLC
+
+
+using namespace LLC;
+
+namespace
+{
+
+const U32 MESSAGE_COUNT	= 100000;
+const char* MESSAGE		= "has anyone seen the sandbox reset notice? it went out an hour early";
+
+// The parameters the translation pipeline hands to HandleGroupChatDispatch()
+//
+LLSD MakeParams()
+{
+	LLUUID group_id;
+	LLUUID from_id;
+	group_id.set( "3f0a8c9e-6f7d-4a51-9a3e-2b7c1d9e8f40" );
+	from_id.set( "b4d51c2a-0e8f-4c7b-8d61-5a2f9e3c7b19" );
+	//
+	LLSD params;
+	params["group_id"]		= group_id;
+	params["from_id"]		= from_id;
+	params["group_name"]	= "Builders Brewery";
+	params["agent_name"]	= "Resident Somebody";
+	params["has_me"]		= false;
+	params["source"]		= MESSAGE;
+	params["message"]		= MESSAGE;
+	params["language"]		= "en";
+	return params;
+}
+
+// Front-end slots: each checks the line arrived whole and keeps nothing
+//
+struct Receiver
+{
+	U32		m_count;
+
+	Receiver() : m_count(0) {}
+
+	void OnGroupChat( String group_id, String group_name, String from_id, bool has_me, String message, String translated, String language )
+	{
+		m_count += strlen( group_id.GetString() ) == UUID_STR_LENGTH - 1
+			&& !strcmp( message.GetString(), MESSAGE );
+	}
+
+	void OnChatEvent( const Manager::ChatEvent& event )
+	{
+		m_count += event.m_groupId != Uuid::Null()
+			&& event.m_message.m_length == (int) strlen( MESSAGE )
+			&& !memcmp( event.m_message.m_data, MESSAGE, event.m_message.m_length );
+	}
+};
+
+enum Path
+{
+	NO_SLOTS,			// Nothing connected: what every path pays before it sends anything
+	STRING_DIRECT,		// GroupChatSignal, fired on the front-end thread
+	STRING_QUEUED,		// GroupChatSignal, raised on the network thread
+	EVENT_DIRECT,		// ChatEventSignal, fired on the front-end thread
+	EVENT_QUEUED		// ChatEventSignal, raised on the network thread
+};
+
+void Deliver( const bool queued, ManagerImpl& manager, NetworkThread& thread, const LLSD& params )
+{
+	if( queued )
+	{
+		BenchAccess::PoseAsNetworkThread( &thread );
+		BenchAccess::GroupChatDispatch( manager, params );
+		BenchAccess::PoseAsNetworkThread( NULL );
+		thread.DispatchEvents();
+	}
+	else
+	{
+		BenchAccess::GroupChatDispatch( manager, params );
+	}
+}
+
+void Run( ManagerImpl& manager, const Path path, const char* what )
+{
+	const LLSD params = MakeParams();
+	NetworkThread thread( manager );
+	Receiver receiver;
+	Connection connection;
+	switch( path )
+	{
+		case NO_SLOTS:
+			break;
+
+		case STRING_DIRECT:
+		case STRING_QUEUED:
+			connection = manager.ConnectGroupChatSignal( boost::bind( &Receiver::OnGroupChat, &receiver, _1, _2, _3, _4, _5, _6, _7 ) );
+			break;
+
+		case EVENT_DIRECT:
+		case EVENT_QUEUED:
+			connection = manager.ConnectChatEventSignal( boost::bind( &Receiver::OnChatEvent, &receiver, _1 ) );
+			break;
+	}
+	const bool queued = (path == STRING_QUEUED || path == EVENT_QUEUED);
+	//
+	Deliver( queued, manager, thread, params );	// Warms up the queue's spare node
+	//
+	const U64 start_allocations = Bench::Allocations();
+	Bench::Stopwatch watch;
+	for( U32 idx = 0; idx < MESSAGE_COUNT; ++idx )
+	{
+		Deliver( queued, manager, thread, params );
+	}
+	const U64 elapsed = watch.Elapsed();
+	const U64 allocations = Bench::Allocations() - start_allocations;
+	connection.disconnect();
+	//
+	char line[96];
+	snprintf( line, sizeof(line), "%s: per line", what );
+	Bench::Report( "chatevent", line, (F64)elapsed * 1000.0 / MESSAGE_COUNT, "ns" );
+	snprintf( line, sizeof(line), "%s: allocs per line", what );
+	Bench::Report( "chatevent", line, (F64)allocations / MESSAGE_COUNT, "allocs" );
+	//
+	const U32 expected = (path == NO_SLOTS)? 0: MESSAGE_COUNT + 1;
+	if( receiver.m_count != expected )
+	{
+		snprintf( line, sizeof(line), "%s: delivered %u of %u lines", what, receiver.m_count, expected );
+		Bench::Fail( "chatevent", line );
+	}
+}
+
+}
+// namespace
+
+
+void BenchChatEvent()
+{
+	// The manager is created the way a front-end creates it, and never logs in
+	//
+	ll_init_apr();
+	boost::shared_ptr<ManagerImpl> manager = ManagerImpl::GetInstance();
+	Run( *manager, NO_SLOTS,		"no slots connected" );
+	Run( *manager, STRING_DIRECT,	"String signal, direct" );
+	Run( *manager, STRING_QUEUED,	"String signal, queued" );
+	Run( *manager, EVENT_DIRECT,	"ChatEvent, direct" );
+	Run( *manager, EVENT_QUEUED,	"ChatEvent, queued" );
+	manager.reset();
+	ManagerImpl::Release();
+}
+
+// vim: ts=4 sw=4 noexpandtab syntax=cpp.doxygen
@@ -0,0 +1,691 @@
+/**
+ * \brief Inbound template dispatch, the map lookup and full decode against the dense table and lazy reader
+ *
+ * Copyright (c) 2009-2010 by R. Douglas Barbieri
+ *
+ * The source code in this file ("Source Code") is provided by R. Douglas Barbieri
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL").  Terms of the GPL can be found in doc/GPL-license.txt in this distribution.
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL SOURCE CODE IN THIS DISTRIBUTION IS PROVIDED "AS IS." THE AUTHOR MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ */
+
+#include "Bench.h"
+
+// llcommon
+//
+#include "llapr.h"
+#include "llstl.h"
+#include "lluuid.h"
+
+// llmath
+//
+#include "v3math.h"
+
+// llmessage
+//
+#include "message.h"
+#include "llmessagetemplate.h"
+#include "llmessagetemplateparser.h"
+#include "lltemplatemessagebuilder.h"
+#include "lltemplatemessagereader.h"
+
+// stdc++
+//
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+
+namespace
+{
+
+const U32 PACKET_COUNT	= 20000;
+const U32 ROUND_COUNT	= 25;
+const char* TEMPLATE_PATH	= "llcbench_message_template.msg";
+const char* CHAT_LINE		= "anyone know when the sandbox resets?";
+
+// The messages a chat client sees standing in a busy region, as they are
+// laid out in message_template.msg. Only the chat, IM, coarse location,
+// ping and ack messages have handlers; the rest are object and avatar
+// traffic the client never looks at.
+//
+const char* TEMPLATES =
+	"version 2.0\n"
+	"{ StartPingCheck High 1 NotTrusted Unencoded\n"
+	"	{ PingID Single { PingID U8 } { OldestUnacked U32 } }\n"
+	"}\n"
+	"{ ObjectUpdate High 12 Trusted Zerocoded\n"
+	"	{ RegionData Single { RegionHandle U64 } { TimeDilation U16 } }\n"
+	"	{ ObjectData Variable { ID U32 } { State U8 } { FullID LLUUID } { CRC U32 } { PCode U8 } { Material U8 }\n"
+	"		{ Scale LLVector3 } { ObjectData Variable 1 } { ParentID U32 } { UpdateFlags U32 }\n"
+	"		{ TextureEntry Variable 2 } { NameValue Variable 2 } }\n"
+	"}\n"
+	"{ ImprovedTerseObjectUpdate High 15 Trusted Unencoded\n"
+	"	{ RegionData Single { RegionHandle U64 } { TimeDilation U16 } }\n"
+	"	{ ObjectData Variable { Data Variable 1 } { TextureEntry Variable 2 } }\n"
+	"}\n"
+	"{ AvatarAnimation High 20 Trusted Unencoded\n"
+	"	{ Sender Single { ID LLUUID } }\n"
+	"	{ AnimationList Variable { AnimID LLUUID } { AnimSequenceID S32 } }\n"
+	"}\n"
+	"{ CoarseLocationUpdate Medium 6 Trusted Unencoded\n"
+	"	{ Location Variable { X U8 } { Y U8 } { Z U8 } }\n"
+	"	{ Index Single { You S16 } { Prey S16 } }\n"
+	"	{ AgentData Variable { AgentID LLUUID } }\n"
+	"}\n"
+	"{ AttachedSound Medium 13 Trusted Unencoded\n"
+	"	{ DataBlock Single { SoundID LLUUID } { ObjectID LLUUID } { OwnerID LLUUID } { Gain F32 } { Flags U8 } }\n"
+	"}\n"
+	"{ ChatFromSimulator Low 139 Trusted Unencoded\n"
+	"	{ ChatData Single { FromName Variable 1 } { SourceID LLUUID } { OwnerID LLUUID } { SourceType U8 }\n"
+	"		{ ChatType U8 } { Audible U8 } { Position LLVector3 } { Message Variable 2 } }\n"
+	"}\n"
+	"{ SimStats Low 140 Trusted Unencoded\n"
+	"	{ Region Single { RegionX U32 } { RegionY U32 } { RegionFlags U32 } { ObjectCapacity U32 } }\n"
+	"	{ Stat Variable { StatID U32 } { StatValue F32 } }\n"
+	"}\n"
+	"{ ImprovedInstantMessage Low 254 NotTrusted Zerocoded\n"
+	"	{ AgentData Single { AgentID LLUUID } { SessionID LLUUID } }\n"
+	"	{ MessageBlock Single { FromGroup BOOL } { ToAgentID LLUUID } { ParentEstateID U32 } { RegionID LLUUID }\n"
+	"		{ Position LLVector3 } { Offline U8 } { Dialog U8 } { ID LLUUID } { Timestamp U32 }\n"
+	"		{ FromAgentName Variable 1 } { Message Variable 2 } { BinaryBucket Variable 2 } }\n"
+	"}\n"
+	"{ PacketAck Fixed 0xFFFFFFFB NotTrusted Unencoded\n"
+	"	{ Packets Variable { ID U32 } }\n"
+	"}\n";
+
+
+/// The reader as it was before the dispatch table: a std::map probe for
+/// the template, then every block and variable copied into an LLMsgData
+/// before the handler runs, whether or not there is one. The warning it
+/// logged for each unhandled message is left out.
+///
+class OldReader
+{
+public:
+	typedef LLTemplateMessageReader::message_template_number_map_t number_map_t;
+
+	explicit OldReader( number_map_t& numbers ) : m_numbers( numbers ), m_data( NULL ) {}
+
+	void Read( const U8* buffer, const S32 size )
+	{
+		const U8* header = buffer + LL_PACKET_ID_SIZE;
+		U32 num = 0;
+		if( header[0] != 255 )
+		{
+			num = header[0];
+		}
+		else if( header[1] != 255 )
+		{
+			num = (255 << 8) | header[1];
+		}
+		else
+		{
+			U16 message_id_U16 = 0;
+			memcpy( &message_id_U16, &header[2], 2 );
+			num = 0xFFFF0000 | ntohs( message_id_U16 );
+		}
+		LLMessageTemplate* temp = get_ptr_in_map( m_numbers, num );
+		if( !temp )
+		{
+			return;
+		}
+		temp->mReceiveCount++;
+		Decode( temp, buffer, size );
+		temp->callHandlerFunc( gMessageSystem );
+		delete m_data;
+		m_data = NULL;
+	}
+
+	void getU8( const char* block, const char* var, U8& u, S32 blocknum = 0 )		{ getData( block, var, &u, sizeof(U8), blocknum ); }
+	void getS16( const char* block, const char* var, S16& d, S32 blocknum = 0 )		{ getData( block, var, &d, sizeof(S16), blocknum ); }
+	void getU32( const char* block, const char* var, U32& d, S32 blocknum = 0 )		{ getData( block, var, &d, sizeof(U32), blocknum ); }
+	void getUUID( const char* block, const char* var, LLUUID& u, S32 blocknum = 0 )	{ getData( block, var, &u.mData[0], sizeof(u.mData), blocknum ); }
+
+	void getString( const char* block, const char* var, std::string& outstr, S32 blocknum = 0 )
+	{
+		char s[MTUBYTES];
+		s[0] = '\0';
+		getData( block, var, s, 0, blocknum, MTUBYTES );
+		s[MTUBYTES - 1] = '\0';
+		outstr = s;
+	}
+
+	S32 getNumberOfBlocks( const char* blockname )
+	{
+		LLMsgData::msg_blk_data_map_t::const_iterator iter = m_data->mMemberBlocks.find( (char*) blockname );
+		return iter == m_data->mMemberBlocks.end()? 0: iter->second->mBlockNumber;
+	}
+
+private:
+	void Decode( const LLMessageTemplate* temp, const U8* buffer, const S32 size )
+	{
+		S32 decode_pos = LL_PACKET_ID_SIZE + (S32) temp->mFrequency + buffer[PHL_OFFSET];
+		m_data = new LLMsgData( temp->mName );
+		for( LLMessageTemplate::message_block_map_t::const_iterator iter = temp->mMemberBlocks.begin();
+			iter != temp->mMemberBlocks.end(); ++iter )
+		{
+			const LLMessageBlock* mbci = *iter;
+			U8 repeat_number = 1;
+			if( mbci->mType == MBT_MULTIPLE )
+			{
+				repeat_number = mbci->mNumber;
+			}
+			else if( mbci->mType == MBT_VARIABLE )
+			{
+				repeat_number = decode_pos < size? buffer[decode_pos++]: 0;
+			}
+			for( S32 i = 0; i < repeat_number; ++i )
+			{
+				LLMsgBlkDataPtr cur_data_block( new LLMsgBlkData( mbci->mName, repeat_number ) );
+				cur_data_block->mName = mbci->mName + i;
+				m_data->addBlock( cur_data_block );
+				for( LLMessageBlock::message_variable_map_t::const_iterator vter = mbci->mMemberVariables.begin();
+					vter != mbci->mMemberVariables.end(); ++vter )
+				{
+					const LLMessageVariable& mvci = **vter;
+					cur_data_block->addVariable( mvci.getName(), mvci.getType() );
+					if( mvci.getType() == MVT_VARIABLE )
+					{
+						const S32 data_size = mvci.getSize();
+						U8 tsizeb = 0;
+						U16 tsizeh = 0;
+						U32 tsize = 0;
+						switch( data_size )
+						{
+							case 1:	htonmemcpy( &tsizeb, &buffer[decode_pos], MVT_U8, 1 );	tsize = tsizeb;	break;
+							case 2:	htonmemcpy( &tsizeh, &buffer[decode_pos], MVT_U16, 2 );	tsize = tsizeh;	break;
+							case 4:	htonmemcpy( &tsize, &buffer[decode_pos], MVT_U32, 4 );	break;
+						}
+						decode_pos += data_size;
+						cur_data_block->addData( mvci.getName(), &buffer[decode_pos], tsize, mvci.getType() );
+						decode_pos += tsize;
+					}
+					else
+					{
+						cur_data_block->addData( mvci.getName(), &buffer[decode_pos], mvci.getSize(), mvci.getType() );
+						decode_pos += mvci.getSize();
+					}
+				}
+			}
+		}
+	}
+
+	void getData( const char* blockname, const char* varname, void* datap, S32 size = 0, S32 blocknum = 0, S32 max_size = S32_MAX )
+	{
+		LLMsgData::msg_blk_data_map_t::const_iterator iter = m_data->mMemberBlocks.find( (char*) blockname + blocknum );
+		if( iter == m_data->mMemberBlocks.end() )
+		{
+			return;
+		}
+		LLMsgVarData& vardata = iter->second->mMemberVarData[(char*) varname];
+		if( !vardata.getName() || (size && size != vardata.getSize()) )
+		{
+			return;
+		}
+		memcpy( datap, vardata.getData(), llmin( max_size, vardata.getSize() ) );
+	}
+
+	number_map_t&	m_numbers;
+	LLMsgData*		m_data;
+};
+
+// The handlers run the same reads against whichever reader is live, the
+// way the client's handlers read through gMessageSystem
+//
+LLTemplateMessageReader*	s_reader	= NULL;
+OldReader*					s_oldReader	= NULL;
+U32							s_handled	= 0;	// Handled messages that read back what was sent
+
+template< class READER >
+bool ReadPing( READER& reader )
+{
+	U8 ping_id = 0;
+	U32 oldest = 0;
+	reader.getU8( _PREHASH_PingID, _PREHASH_PingID, ping_id );
+	reader.getU32( _PREHASH_PingID, _PREHASH_OldestUnacked, oldest );
+	return oldest == ping_id * 3U;
+}
+
+template< class READER >
+bool ReadAcks( READER& reader )
+{
+	const S32 count = reader.getNumberOfBlocks( _PREHASH_Packets );
+	U32 sum = 0;
+	for( S32 idx = 0; idx < count; ++idx )
+	{
+		U32 id = 0;
+		reader.getU32( _PREHASH_Packets, _PREHASH_ID, id, idx );
+		sum += id;
+	}
+	return count > 0 && sum != 0;
+}
+
+template< class READER >
+bool ReadCoarse( READER& reader )
+{
+	const S32 count = reader.getNumberOfBlocks( _PREHASH_Location );
+	S16 you = -1;
+	reader.getS16( _PREHASH_Index, _PREHASH_You, you );
+	bool ok = reader.getNumberOfBlocks( _PREHASH_AgentData ) == count;
+	for( S32 idx = 0; idx < count; ++idx )
+	{
+		U8 x = 0, y = 0, z = 0;
+		LLUUID agent_id;
+		reader.getU8( _PREHASH_Location, _PREHASH_X, x, idx );
+		reader.getU8( _PREHASH_Location, _PREHASH_Y, y, idx );
+		reader.getU8( _PREHASH_Location, _PREHASH_Z, z, idx );
+		reader.getUUID( _PREHASH_AgentData, _PREHASH_AgentID, agent_id, idx );
+		ok = ok && agent_id.notNull() && x == (U8) idx;
+	}
+	return ok && you == 0;
+}
+
+template< class READER >
+bool ReadChat( READER& reader )
+{
+	std::string from_name;
+	std::string message;
+	LLUUID source_id;
+	U8 chat_type = 0;
+	reader.getString( _PREHASH_ChatData, _PREHASH_FromName, from_name );
+	reader.getUUID( _PREHASH_ChatData, _PREHASH_SourceID, source_id );
+	reader.getU8( _PREHASH_ChatData, _PREHASH_ChatType, chat_type );
+	reader.getString( _PREHASH_ChatData, _PREHASH_Message, message );
+	return source_id.notNull() && message == CHAT_LINE;
+}
+
+template< class READER >
+bool ReadIM( READER& reader )
+{
+	LLUUID from_id;
+	LLUUID session_id;
+	U8 dialog = 0;
+	std::string name;
+	std::string message;
+	reader.getUUID( _PREHASH_AgentData, _PREHASH_AgentID, from_id );
+	reader.getU8( _PREHASH_MessageBlock, _PREHASH_Dialog, dialog );
+	reader.getUUID( _PREHASH_MessageBlock, _PREHASH_ID, session_id );
+	reader.getString( _PREHASH_MessageBlock, _PREHASH_FromAgentName, name );
+	reader.getString( _PREHASH_MessageBlock, _PREHASH_Message, message );
+	return from_id.notNull() && message == CHAT_LINE;
+}
+
+void ProcessPing( LLMessageSystem*, void** )	{ s_handled += s_oldReader? ReadPing( *s_oldReader ): ReadPing( *s_reader ); }
+void ProcessAcks( LLMessageSystem*, void** )	{ s_handled += s_oldReader? ReadAcks( *s_oldReader ): ReadAcks( *s_reader ); }
+void ProcessCoarse( LLMessageSystem*, void** )	{ s_handled += s_oldReader? ReadCoarse( *s_oldReader ): ReadCoarse( *s_reader ); }
+void ProcessChat( LLMessageSystem*, void** )	{ s_handled += s_oldReader? ReadChat( *s_oldReader ): ReadChat( *s_reader ); }
+void ProcessIM( LLMessageSystem*, void** )		{ s_handled += s_oldReader? ReadIM( *s_oldReader ): ReadIM( *s_reader ); }
+
+/// Templates parsed from TEMPLATES, keyed the way LLMessageSystem keys them
+///
+struct Templates
+{
+	LLTemplateMessageBuilder::message_template_name_map_t		m_names;
+	LLTemplateMessageReader::message_template_number_map_t	m_numbers;
+
+	Templates()
+	{
+		LLTemplateTokenizer tokens( TEMPLATES );
+		LLTemplateParser parsed( tokens );
+		for( LLTemplateParser::message_iterator iter = parsed.getMessagesBegin(); iter != parsed.getMessagesEnd(); ++iter )
+		{
+			m_names[(*iter)->mName] = *iter;
+			m_numbers[(*iter)->mMessageNumber] = *iter;
+		}
+		m_names[_PREHASH_StartPingCheck]->setHandlerFunc( ProcessPing, NULL );
+		m_names[_PREHASH_PacketAck]->setHandlerFunc( ProcessAcks, NULL );
+		m_names[_PREHASH_CoarseLocationUpdate]->setHandlerFunc( ProcessCoarse, NULL );
+		m_names[_PREHASH_ChatFromSimulator]->setHandlerFunc( ProcessChat, NULL );
+		m_names[_PREHASH_ImprovedInstantMessage]->setHandlerFunc( ProcessIM, NULL );
+	}
+
+	~Templates()
+	{
+		for_each( m_names.begin(), m_names.end(), DeletePairedPointer() );
+	}
+};
+
+enum Kind
+{
+	KIND_TERSE,
+	KIND_OBJECT,
+	KIND_ANIMATION,
+	KIND_SOUND,
+	KIND_SIMSTATS,
+	KIND_COARSE,
+	KIND_ACK,
+	KIND_PING,
+	KIND_CHAT,
+	KIND_IM
+};
+
+// Out of every 100 packets, roughly what a client parked in a busy region receives
+//
+Kind PickKind( Bench::Random& random )
+{
+	const U32 roll = random.Below( 100 );
+	if( roll < 40 )	return KIND_TERSE;
+	if( roll < 55 )	return KIND_OBJECT;
+	if( roll < 63 )	return KIND_ANIMATION;
+	if( roll < 68 )	return KIND_SOUND;
+	if( roll < 70 )	return KIND_SIMSTATS;
+	if( roll < 75 )	return KIND_COARSE;
+	if( roll < 87 )	return KIND_ACK;
+	if( roll < 90 )	return KIND_PING;
+	if( roll < 97 )	return KIND_CHAT;
+	return KIND_IM;
+}
+
+void AddBytes( LLTemplateMessageBuilder& builder, const char* var, Bench::Random& random, const U32 size )
+{
+	std::vector<U8> bytes( size + 1 );
+	for( U32 idx = 0; idx < size; ++idx )
+	{
+		bytes[idx] = (U8) random.Next();
+	}
+	builder.addBinaryData( var, &bytes[0], size );
+}
+
+void BuildPacket( LLTemplateMessageBuilder& builder, const Kind kind, Bench::Random& random )
+{
+	switch( kind )
+	{
+		case KIND_TERSE:
+		{
+			builder.newMessage( _PREHASH_ImprovedTerseObjectUpdate );
+			builder.nextBlock( _PREHASH_RegionData );
+			builder.addU64( _PREHASH_RegionHandle, 0x000f680000100e00ULL );
+			builder.addU16( _PREHASH_TimeDilation, 65535 );
+			const U32 objects = 1 + random.Below( 8 );
+			for( U32 idx = 0; idx < objects; ++idx )
+			{
+				builder.nextBlock( _PREHASH_ObjectData );
+				AddBytes( builder, _PREHASH_Data, random, 44 + 16 * random.Below( 2 ) );
+				AddBytes( builder, _PREHASH_TextureEntry, random, random.Below( 2 )? 0: 80 );
+			}
+			break;
+		}
+		case KIND_OBJECT:
+		{
+			builder.newMessage( _PREHASH_ObjectUpdate );
+			builder.nextBlock( _PREHASH_RegionData );
+			builder.addU64( _PREHASH_RegionHandle, 0x000f680000100e00ULL );
+			builder.addU16( _PREHASH_TimeDilation, 65535 );
+			const U32 objects = 1 + random.Below( 3 );
+			for( U32 idx = 0; idx < objects; ++idx )
+			{
+				builder.nextBlock( _PREHASH_ObjectData );
+				builder.addU32( _PREHASH_ID, random.Next() );
+				builder.addU8( _PREHASH_State, 0 );
+				builder.addUUID( _PREHASH_FullID, Bench::MakeId( random ) );
+				builder.addU32( _PREHASH_CRC, random.Next() );
+				builder.addU8( _PREHASH_PCode, 9 );
+				builder.addU8( _PREHASH_Material, 3 );
+				builder.addVector3( _PREHASH_Scale, LLVector3( 0.5f, 0.5f, 0.5f ) );
+				AddBytes( builder, _PREHASH_ObjectData, random, 60 );
+				builder.addU32( _PREHASH_ParentID, 0 );
+				builder.addU32( _PREHASH_UpdateFlags, random.Next() );
+				AddBytes( builder, _PREHASH_TextureEntry, random, 40 + random.Below( 120 ) );
+				AddBytes( builder, _PREHASH_NameValue, random, 0 );
+			}
+			break;
+		}
+		case KIND_ANIMATION:
+		{
+			builder.newMessage( _PREHASH_AvatarAnimation );
+			builder.nextBlock( _PREHASH_Sender );
+			builder.addUUID( _PREHASH_ID, Bench::MakeId( random ) );
+			const U32 anims = 1 + random.Below( 4 );
+			for( U32 idx = 0; idx < anims; ++idx )
+			{
+				builder.nextBlock( _PREHASH_AnimationList );
+				builder.addUUID( _PREHASH_AnimID, Bench::MakeId( random ) );
+				builder.addS32( _PREHASH_AnimSequenceID, (S32) idx );
+			}
+			break;
+		}
+		case KIND_SOUND:
+		{
+			builder.newMessage( _PREHASH_AttachedSound );
+			builder.nextBlock( _PREHASH_DataBlock );
+			builder.addUUID( _PREHASH_SoundID, Bench::MakeId( random ) );
+			builder.addUUID( _PREHASH_ObjectID, Bench::MakeId( random ) );
+			builder.addUUID( _PREHASH_OwnerID, Bench::MakeId( random ) );
+			builder.addF32( _PREHASH_Gain, 1.f );
+			builder.addU8( _PREHASH_Flags, 0 );
+			break;
+		}
+		case KIND_SIMSTATS:
+		{
+			builder.newMessage( _PREHASH_SimStats );
+			builder.nextBlock( _PREHASH_Region );
+			builder.addU32( _PREHASH_RegionX, 256000 );
+			builder.addU32( _PREHASH_RegionY, 256256 );
+			builder.addU32( _PREHASH_RegionFlags, 0 );
+			builder.addU32( _PREHASH_ObjectCapacity, 15000 );
+			for( U32 idx = 0; idx < 20; ++idx )
+			{
+				builder.nextBlock( _PREHASH_Stat );
+				builder.addU32( _PREHASH_StatID, idx );
+				builder.addF32( _PREHASH_StatValue, (F32) random.Below( 1000 ) );
+			}
+			break;
+		}
+		case KIND_COARSE:
+		{
+			builder.newMessage( _PREHASH_CoarseLocationUpdate );
+			const U32 agents = 1 + random.Below( 40 );
+			for( U32 idx = 0; idx < agents; ++idx )
+			{
+				builder.nextBlock( _PREHASH_Location );
+				builder.addU8( _PREHASH_X, (U8) idx );
+				builder.addU8( _PREHASH_Y, (U8) random.Next() );
+				builder.addU8( _PREHASH_Z, (U8) random.Next() );
+			}
+			builder.nextBlock( _PREHASH_Index );
+			builder.addS16( _PREHASH_You, 0 );
+			builder.addS16( _PREHASH_Prey, -1 );
+			for( U32 idx = 0; idx < agents; ++idx )
+			{
+				builder.nextBlock( _PREHASH_AgentData );
+				builder.addUUID( _PREHASH_AgentID, Bench::MakeId( random ) );
+			}
+			break;
+		}
+		case KIND_ACK:
+		{
+			builder.newMessage( _PREHASH_PacketAck );
+			const U32 acks = 1 + random.Below( 10 );
+			for( U32 idx = 0; idx < acks; ++idx )
+			{
+				builder.nextBlock( _PREHASH_Packets );
+				builder.addU32( _PREHASH_ID, 1 + random.Below( 100000 ) );
+			}
+			break;
+		}
+		case KIND_PING:
+		{
+			const U8 ping_id = (U8) random.Next();
+			builder.newMessage( _PREHASH_StartPingCheck );
+			builder.nextBlock( _PREHASH_PingID );
+			builder.addU8( _PREHASH_PingID, ping_id );
+			builder.addU32( _PREHASH_OldestUnacked, ping_id * 3U );
+			break;
+		}
+		case KIND_CHAT:
+		{
+			builder.newMessage( _PREHASH_ChatFromSimulator );
+			builder.nextBlock( _PREHASH_ChatData );
+			builder.addString( _PREHASH_FromName, "Resident Somebody" );
+			builder.addUUID( _PREHASH_SourceID, Bench::MakeId( random ) );
+			builder.addUUID( _PREHASH_OwnerID, Bench::MakeId( random ) );
+			builder.addU8( _PREHASH_SourceType, 1 );
+			builder.addU8( _PREHASH_ChatType, 1 );
+			builder.addU8( _PREHASH_Audible, 1 );
+			builder.addVector3( _PREHASH_Position, LLVector3( 128.f, 128.f, 22.f ) );
+			builder.addString( _PREHASH_Message, CHAT_LINE );
+			break;
+		}
+		case KIND_IM:
+		{
+			builder.newMessage( _PREHASH_ImprovedInstantMessage );
+			builder.nextBlock( _PREHASH_AgentData );
+			builder.addUUID( _PREHASH_AgentID, Bench::MakeId( random ) );
+			builder.addUUID( _PREHASH_SessionID, LLUUID::null );
+			builder.nextBlock( _PREHASH_MessageBlock );
+			builder.addBOOL( _PREHASH_FromGroup, FALSE );
+			builder.addUUID( _PREHASH_ToAgentID, Bench::MakeId( random ) );
+			builder.addU32( _PREHASH_ParentEstateID, 1 );
+			builder.addUUID( _PREHASH_RegionID, Bench::MakeId( random ) );
+			builder.addVector3( _PREHASH_Position, LLVector3( 128.f, 128.f, 22.f ) );
+			builder.addU8( _PREHASH_Offline, 0 );
+			builder.addU8( _PREHASH_Dialog, 0 );
+			builder.addUUID( _PREHASH_ID, Bench::MakeId( random ) );
+			builder.addU32( _PREHASH_Timestamp, 0 );
+			builder.addString( _PREHASH_FromAgentName, "Resident Somebody" );
+			builder.addString( _PREHASH_Message, CHAT_LINE );
+			AddBytes( builder, _PREHASH_BinaryBucket, random, 1 );
+			break;
+		}
+	}
+}
+
+/// The packets in arrival order, as LLMessageSystem hands them to the
+/// reader: zero coding already expanded, acks already stripped
+///
+struct Corpus
+{
+	std::vector< std::vector<U8> >	m_all;
+	std::vector< std::vector<U8> >	m_unhandled;
+	std::vector< std::vector<U8> >	m_handled;
+
+	explicit Corpus( Templates& templates )
+	{
+		LLTemplateMessageBuilder builder( templates.m_names );
+		Bench::Random random;
+		U8 buffer[MAX_BUFFER_SIZE];
+		for( U32 idx = 0; idx < PACKET_COUNT; ++idx )
+		{
+			const Kind kind = PickKind( random );
+			BuildPacket( builder, kind, random );
+			memset( buffer, 0, LL_PACKET_ID_SIZE );
+			const U32 size = builder.buildMessage( buffer, sizeof(buffer), 0 );
+			m_all.push_back( std::vector<U8>( buffer, buffer + size ) );
+			(kind >= KIND_COARSE? m_handled: m_unhandled).push_back( m_all.back() );
+		}
+	}
+};
+
+enum Path
+{
+	OLD_READER,			// std::map probe, full LLMsgData copy, handler reads by name
+	LAZY_READER			// Dense table probe, offsets worked out on the first get*()
+};
+
+U64 RunPath( const Path path, Templates& templates, const std::vector< std::vector<U8> >& packets, U64& allocations )
+{
+	const LLHost sim( "127.0.0.1", 13005 );
+	OldReader old_reader( templates.m_numbers );
+	LLTemplateMessageReader reader( templates.m_numbers );
+	s_oldReader = path == OLD_READER? &old_reader: NULL;
+	s_reader = &reader;
+	//
+	const U64 start_allocations = Bench::Allocations();
+	Bench::Stopwatch watch;
+	for( U32 round = 0; round < ROUND_COUNT; ++round )
+	{
+		for( size_t idx = 0; idx < packets.size(); ++idx )
+		{
+			const U8* buffer = &packets[idx][0];
+			const S32 size = (S32) packets[idx].size();
+			if( path == OLD_READER )
+			{
+				old_reader.Read( buffer, size );
+				continue;
+			}
+			if( reader.validateMessage( buffer, size, sim ) )
+			{
+				reader.readMessage( buffer, sim );
+			}
+			reader.clearMessage();
+		}
+	}
+	const U64 elapsed = watch.Elapsed();
+	allocations = Bench::Allocations() - start_allocations;
+	s_oldReader = NULL;
+	s_reader = NULL;
+	return elapsed;
+}
+
+void Run( const Path path, const char* what, Templates& templates, const std::vector< std::vector<U8> >& packets, const U32 handled )
+{
+	s_handled = 0;
+	U64 allocations = 0;
+	const U64 elapsed = RunPath( path, templates, packets, allocations );
+	const F64 messages = (F64) packets.size() * ROUND_COUNT;
+	char line[96];
+	snprintf( line, sizeof(line), "%s: per message", what );
+	Bench::Report( "dispatch", line, elapsed * 1000.0 / messages, "ns" );
+	snprintf( line, sizeof(line), "%s: allocations per message", what );
+	Bench::Report( "dispatch", line, allocations / messages, "allocs" );
+	if( s_handled != handled * ROUND_COUNT )
+	{
+		snprintf( line, sizeof(line), "%s: handlers read back %u of %u messages", what, s_handled, handled * ROUND_COUNT );
+		Bench::Fail( "dispatch", line );
+	}
+}
+
+/// LLTemplateMessageReader raises handlers through gMessageSystem, so the
+/// bench needs one; it is started from the same template text, on a spare port
+///
+bool StartMessageSystem()
+{
+	FILE* file = fopen( TEMPLATE_PATH, "w" );
+	if( !file )
+	{
+		return false;
+	}
+	fputs( TEMPLATES, file );
+	fclose( file );
+	ll_init_apr();
+	LLMessageSystem::InitMessageSystem( TEMPLATE_PATH, 0, 1, 0, 0, true, 5.f, 100.f );
+	remove( TEMPLATE_PATH );
+	return true;
+}
+
+}
+// namespace
+
+
+void BenchDispatch()
+{
+	if( !StartMessageSystem() )
+	{
+		Bench::Fail( "dispatch", "couldn't write the message template" );
+		return;
+	}
+	Templates templates;
+	const Corpus corpus( templates );
+	const U32 handled = (U32) corpus.m_handled.size();
+	printf( "%-12s %u packets, %u with a handler\n", "dispatch", PACKET_COUNT, handled );
+	//
+	Run( OLD_READER,	"map + full decode, all",		templates, corpus.m_all,		handled );
+	Run( LAZY_READER,	"table + lazy reader, all",		templates, corpus.m_all,		handled );
+	Run( OLD_READER,	"map + full decode, unhandled",	templates, corpus.m_unhandled,	0 );
+	Run( LAZY_READER,	"table + lazy reader, unhandled",	templates, corpus.m_unhandled,	0 );
+	Run( OLD_READER,	"map + full decode, handled",	templates, corpus.m_handled,	handled );
+	Run( LAZY_READER,	"table + lazy reader, handled",	templates, corpus.m_handled,	handled );
+	//
+	LLMessageSystem::Release();
+}
+
+// vim: ts=4 sw=4 noexpandtab syntax=cpp.doxygen
@@ -0,0 +1,237 @@
+/**
+ * \brief LLSD XML parse rate of event queue responses, through an istream or straight from the buffer
+ *
+ * Copyright (c) 2009-2010 by R. Douglas Barbieri
+ *
+ * The source code in this file ("Source Code") is provided by R. Douglas Barbieri
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL").  Terms of the GPL can be found in doc/GPL-license.txt in this distribution.
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL SOURCE CODE IN THIS DISTRIBUTION IS PROVIDED "AS IS." THE AUTHOR MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ */
+
+#include "Bench.h"
+
+// llcommon
+//
+#include "llsd.h"
+#include "llsdserialize.h"
+
+// llmessage
+//
+#include "llbuffer.h"
+#include "llbufferstream.h"
+
+// stdc++
+//
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+namespace
+{
+
+const U32 CHAT_PAYLOADS		= 64;		// Each with one to four lines
+const U32 ROSTER_PAYLOADS	= 8;		// Each with a whole roster
+const U32 ROSTER_AGENTS		= 300;
+const U32 ROUND_COUNT		= 50;
+const S32 WRITE_SIZE		= 16384;	// What curl hands the write callback at most
+
+// There are no recorded EventQueueGet responses in the tree, so these are
+// built to the shape of the two that chat sees most: ChatterBoxInvitation,
+// which carries every group chat line, and ChatterBoxSessionAgentListUpdates.
+//
+LLSD MakeInvitation( Bench::Random& random )
+{
+	LLSD params;
+	params["id"]			= Bench::MakeId( random );
+	params["from_id"]		= Bench::MakeId( random );
+	params["from_group"]	= false;
+	params["from_name"]		= "Resident Somebody";
+	params["message"]		= "has anyone seen the sandbox reset notice? it went out an hour early";
+	params["timestamp"]		= (S32) random.Next();
+	params["to_id"]			= Bench::MakeId( random );
+	params["type"]			= 17;
+	params["region_id"]		= Bench::MakeId( random );
+	params["ttl"]			= 0;
+	params["offline"]		= 0;
+	params["parent_estate_id"] = 1;
+	params["position"].append( 128.5 );
+	params["position"].append( 97.25 );
+	params["position"].append( 23.0 );
+	params["data"]["binary_bucket"] = LLSD::Binary( 24, 0x2a );
+	//
+	LLSD event;
+	event["message"] = "ChatterBoxInvitation";
+	event["body"]["session_id"] = params["id"];
+	event["body"]["from_name"]	= params["from_name"];
+	event["body"]["instantmessage"]["message_params"] = params;
+	event["body"]["instantmessage"]["agent_params"]["agent_id"]		= params["to_id"];
+	event["body"]["instantmessage"]["agent_params"]["check_estate"]	= 0;
+	event["body"]["instantmessage"]["agent_params"]["god_level"]	= 0;
+	return event;
+}
+
+LLSD MakeRosterUpdate( Bench::Random& random )
+{
+	LLSD event;
+	event["message"] = "ChatterBoxSessionAgentListUpdates";
+	event["body"]["session_id"] = Bench::MakeId( random );
+	for( U32 idx = 0; idx < ROSTER_AGENTS; ++idx )
+	{
+		const std::string agent_id = Bench::MakeId( random ).asString();
+		LLSD& update = event["body"]["agent_updates"][agent_id];
+		update["info"]["can_voice_chat"]	= true;
+		update["info"]["is_moderator"]		= (idx == 0);
+		update["info"]["mutes"]["text"]		= false;
+		update["info"]["mutes"]["voice"]	= false;
+		update["transition"]				= "ENTER";
+		event["body"]["updates"][agent_id]	= "ENTER";
+	}
+	return event;
+}
+
+std::vector<std::string> MakePayloads( const bool roster )
+{
+	Bench::Random random;
+	std::vector<std::string> payloads;
+	const U32 count = roster? ROSTER_PAYLOADS: CHAT_PAYLOADS;
+	for( U32 idx = 0; idx < count; ++idx )
+	{
+		LLSD response;
+		if( roster )
+		{
+			response["events"].append( MakeRosterUpdate( random ) );
+		}
+		else
+		{
+			const U32 lines = 1 + random.Below( 4 );
+			for( U32 line = 0; line < lines; ++line )
+			{
+				response["events"].append( MakeInvitation( random ) );
+			}
+		}
+		response["id"] = (S32) idx;
+		//
+		std::ostringstream ostr;
+		LLSDSerialize::toXML( response, ostr );
+		payloads.push_back( ostr.str() );
+	}
+	return payloads;
+}
+
+// A response buffer as LLCurl::Easy leaves it: the body on one channel, in
+// write-sized pieces
+//
+struct Response
+{
+	LLBufferArray			m_buffer;
+	LLChannelDescriptors	m_channels;
+
+	explicit Response( const std::string& payload )
+		: m_channels( m_buffer.nextChannel() )
+	{
+		for( size_t pos = 0; pos < payload.size(); pos += WRITE_SIZE )
+		{
+			const S32 len = (S32) llmin( payload.size() - pos, (size_t) WRITE_SIZE );
+			m_buffer.append( m_channels.in(), (const U8*) payload.data() + pos, len );
+		}
+	}
+};
+
+enum Path
+{
+	THROUGH_STREAM,		// What LLCurl::Responder::completedRaw() did: fromXML() on an LLBufferStream
+	FROM_BUFFER			// What it does now: ll_sd_from_xml_buffer()
+};
+
+void Run( const Path path, const char* what, const std::vector<std::string>& payloads, const U64 bytes )
+{
+	U64 elapsed = 0;
+	U64 allocations = 0;
+	S32 parsed = 0;
+	for( U32 round = 0; round < ROUND_COUNT; ++round )
+	{
+		// Reading through the stream eats the segments, so every round gets
+		// fresh buffers, filled outside the timing
+		//
+		std::vector<Response*> responses;
+		for( size_t idx = 0; idx < payloads.size(); ++idx )
+		{
+			responses.push_back( new Response( payloads[idx] ) );
+		}
+		//
+		const U64 start_allocations = Bench::Allocations();
+		Bench::Stopwatch watch;
+		for( size_t idx = 0; idx < responses.size(); ++idx )
+		{
+			LLSD content;
+			if( path == THROUGH_STREAM )
+			{
+				LLBufferStream istr( responses[idx]->m_channels, &responses[idx]->m_buffer );
+				parsed += LLSDSerialize::fromXML( content, istr ) > 0;
+			}
+			else
+			{
+				parsed += ll_sd_from_xml_buffer( content, responses[idx]->m_channels, &responses[idx]->m_buffer ) > 0;
+			}
+		}
+		elapsed += watch.Elapsed();
+		allocations += Bench::Allocations() - start_allocations;
+		//
+		for( size_t idx = 0; idx < responses.size(); ++idx )
+		{
+			delete responses[idx];
+		}
+	}
+	//
+	const F64 messages = (F64) payloads.size() * ROUND_COUNT;
+	char line[96];
+	snprintf( line, sizeof(line), "%s: rate", what );
+	Bench::Report( "llsd", line, (F64)(bytes * ROUND_COUNT) / elapsed, "MB/s" );
+	snprintf( line, sizeof(line), "%s: allocs per message", what );
+	Bench::Report( "llsd", line, (F64)allocations / messages, "allocs" );
+	if( parsed != (S32) messages )
+	{
+		snprintf( line, sizeof(line), "%s: parsed %d of %.0f messages", what, parsed, messages );
+		Bench::Fail( "llsd", line );
+	}
+}
+
+void RunBoth( const char* shape, const bool roster )
+{
+	const std::vector<std::string> payloads = MakePayloads( roster );
+	U64 bytes = 0;
+	for( size_t idx = 0; idx < payloads.size(); ++idx )
+	{
+		bytes += payloads[idx].size();
+	}
+	//
+	char what[64];
+	snprintf( what, sizeof(what), "%s: mean message size", shape );
+	Bench::Report( "llsd", what, (F64)bytes / payloads.size(), "bytes" );
+	snprintf( what, sizeof(what), "%s, istream", shape );
+	Run( THROUGH_STREAM, what, payloads, bytes );
+	snprintf( what, sizeof(what), "%s, buffer", shape );
+	Run( FROM_BUFFER, what, payloads, bytes );
+}
+
+}
+// namespace
+
+
+void BenchLLSDParse()
+{
+	RunBoth( "chat lines", false );
+	RunBoth( "roster", true );
+}
+
+// vim: ts=4 sw=4 noexpandtab syntax=cpp.doxygen
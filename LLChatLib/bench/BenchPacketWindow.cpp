@@ -0,0 +1,340 @@
+/**
+ * \brief Reliable packet bookkeeping under a lossy ack pattern
+ *
+ * Copyright (c) 2009-2010 by R. Douglas Barbieri
+ *
+ * The source code in this file ("Source Code") is provided by R. Douglas Barbieri
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL").  Terms of the GPL can be found in doc/GPL-license.txt in this distribution.
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL SOURCE CODE IN THIS DISTRIBUTION IS PROVIDED "AS IS." THE AUTHOR MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ */
+
+#include "Bench.h"
+
+// llmessage
+//
+#include "llpacketack.h"
+#include "llpacketwindow.h"
+#include "message.h"
+#include "net.h"
+
+// stdc++
+//
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#if LL_WINDOWS || LL_MINGW32
+#include <winsock2.h>
+#else
+#include <netinet/in.h>
+#endif
+
+
+namespace
+{
+
+// A group chat burst: 64 reliable packets a tick, acked four ticks later in
+// a shuffled order, with one ack in twenty lost. A packet whose ack was lost
+// is found by the resend scan eight ticks after it went out and is resent,
+// which this replay counts as acked. The IDs start just short of the 2^24
+// wrap so that the replay crosses it.
+//
+const U32 TICK_COUNT		= 4000;
+const U32 BURST				= 64;
+const U32 ACK_DELAY			= 4;
+const U32 RESEND_DELAY		= 8;
+const U32 LOSS_PERCENT		= 5;
+const U32 MESSAGE_BYTES		= 180;
+const TPACKETID FIRST_ID	= LL_PACKET_ID_SPACE - 50000;
+
+struct Replay
+{
+	std::vector<U32>			m_sentTick;		// By sequence number
+	std::vector<TPACKETID>		m_acks;
+	Bench::Random				m_random;
+	U8							m_message[MESSAGE_BYTES];
+	LLReliablePacketParams		m_params;
+	U32							m_resent;
+
+	Replay()
+		: m_resent(0)
+	{
+		m_sentTick.reserve( TICK_COUNT * BURST );
+		memset( m_message, 0, sizeof(m_message) );
+		m_params.set( LLHost(), 3, TRUE, 1.f, NULL, NULL, NULL );
+	}
+
+	TPACKETID	IdOf( U32 seq ) const			{ return (FIRST_ID + seq) & LL_PACKET_ID_MASK; }
+	U32			SeqOf( TPACKETID id ) const		{ return (id - FIRST_ID) & LL_PACKET_ID_MASK; }
+
+	// Stamps the packet ID into the header, where LLReliablePacket reads it
+	//
+	U8* Message( TPACKETID id )
+	{
+		*((U32*)(&m_message[PHL_PACKET_ID])) = htonl( id );
+		return m_message;
+	}
+
+	// The acks that make it back this tick
+	//
+	const std::vector<TPACKETID>& Acks( U32 tick )
+	{
+		m_acks.clear();
+		if( tick >= ACK_DELAY )
+		{
+			const U32 first = (tick - ACK_DELAY) * BURST;
+			for( U32 seq = first; seq < first + BURST; ++seq )
+			{
+				if( m_random.Below( 100 ) >= LOSS_PERCENT )
+				{
+					m_acks.push_back( IdOf( seq ) );
+				}
+			}
+			for( U32 idx = m_acks.size(); idx > 1; --idx )
+			{
+				std::swap( m_acks[idx - 1], m_acks[m_random.Below( idx )] );
+			}
+		}
+		return m_acks;
+	}
+};
+
+// What LLCircuitData did before: a tree node and a new packet per send.
+//
+void RunMap( U64& elapsed, U64& allocations, U32& resent )
+{
+	typedef std::map<TPACKETID, LLReliablePacket*> packet_map;
+	Replay replay;
+	packet_map unacked;
+	//
+	const U64 start_allocations = Bench::Allocations();
+	Bench::Stopwatch watch;
+	U32 seq = 0;
+	for( U32 tick = 0; tick < TICK_COUNT; ++tick )
+	{
+		for( U32 idx = 0; idx < BURST; ++idx, ++seq )
+		{
+			const TPACKETID id = replay.IdOf( seq );
+			replay.m_sentTick.push_back( tick );
+			unacked[id] = new LLReliablePacket( 0, replay.Message( id ), MESSAGE_BYTES, &replay.m_params );
+		}
+		//
+		const std::vector<TPACKETID>& acks = replay.Acks( tick );
+		for( std::vector<TPACKETID>::const_iterator it = acks.begin(); it != acks.end(); ++it )
+		{
+			packet_map::iterator found = unacked.find( *it );
+			if( found != unacked.end() )
+			{
+				delete found->second;
+				unacked.erase( found );
+			}
+		}
+		//
+		for( packet_map::iterator it = unacked.begin(); it != unacked.end(); )
+		{
+			if( tick - replay.m_sentTick[replay.SeqOf( it->first )] >= RESEND_DELAY )
+			{
+				++replay.m_resent;
+				delete it->second;
+				unacked.erase( it++ );
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+	elapsed = watch.Elapsed();
+	allocations = Bench::Allocations() - start_allocations;
+	resent = replay.m_resent;
+	//
+	for( packet_map::iterator it = unacked.begin(); it != unacked.end(); ++it )
+	{
+		delete it->second;
+	}
+}
+
+// What LLCircuitData does now: a ring of packet IDs and a packet pool.
+//
+void RunWindow( U64& elapsed, U64& allocations, U32& resent )
+{
+	Replay replay;
+	LLReliablePacketPool pool;
+	LLPacketIDWindow<LLReliablePacket*> unacked;
+	//
+	const U64 start_allocations = Bench::Allocations();
+	Bench::Stopwatch watch;
+	U32 seq = 0;
+	for( U32 tick = 0; tick < TICK_COUNT; ++tick )
+	{
+		for( U32 idx = 0; idx < BURST; ++idx, ++seq )
+		{
+			const TPACKETID id = replay.IdOf( seq );
+			replay.m_sentTick.push_back( tick );
+			unacked.insert( id, pool.alloc( 0, replay.Message( id ), MESSAGE_BYTES, &replay.m_params ) );
+		}
+		//
+		const std::vector<TPACKETID>& acks = replay.Acks( tick );
+		for( std::vector<TPACKETID>::const_iterator it = acks.begin(); it != acks.end(); ++it )
+		{
+			LLReliablePacket** found = unacked.find( *it );
+			if( found )
+			{
+				pool.release( *found );
+				unacked.erase( *it );
+			}
+		}
+		//
+		for( S32 off = unacked.firstOffset(); off >= 0; off = unacked.nextOffset( off + 1 ) )
+		{
+			const TPACKETID id = unacked.idAt( off );
+			if( tick - replay.m_sentTick[replay.SeqOf( id )] >= RESEND_DELAY )
+			{
+				++replay.m_resent;
+				pool.release( unacked.at( off ) );
+				unacked.erase( id );
+			}
+		}
+		unacked.trim();
+	}
+	elapsed = watch.Elapsed();
+	allocations = Bench::Allocations() - start_allocations;
+	resent = replay.m_resent;
+	//
+	for( S32 off = unacked.firstOffset(); off >= 0; off = unacked.nextOffset( off + 1 ) )
+	{
+		pool.release( unacked.at( off ) );
+	}
+}
+
+// Duplicate suppression on the receiving side: every reliable ID is looked
+// up, then remembered, and IDs well behind the newest are forgotten.
+//
+const U32 RECEIVED_COUNT	= 256000;
+const U32 DUPLICATE_PERCENT	= 3;
+const U32 REMEMBER_SPAN		= 1024;
+
+TPACKETID ReceivedId( Bench::Random& random, U32 seq )
+{
+	// Mostly in order, sometimes a little late, now and then a repeat
+	//
+	U32 back = 0;
+	if( random.Below( 100 ) < DUPLICATE_PERCENT )
+	{
+		back = 1 + random.Below( 64 );
+	}
+	else if( random.Below( 10 ) == 0 )
+	{
+		back = random.Below( 4 );
+	}
+	return (FIRST_ID + seq - llmin( back, seq )) & LL_PACKET_ID_MASK;
+}
+
+void RunReceivedMap( U64& elapsed, U64& allocations, U32& duplicates )
+{
+	Bench::Random random;
+	std::map<TPACKETID, U64> received;
+	duplicates = 0;
+	//
+	const U64 start_allocations = Bench::Allocations();
+	Bench::Stopwatch watch;
+	for( U32 seq = 0; seq < RECEIVED_COUNT; ++seq )
+	{
+		const TPACKETID id = ReceivedId( random, seq );
+		if( received.find( id ) != received.end() )
+		{
+			++duplicates;
+			continue;
+		}
+		received[id] = seq;
+		//
+		// The map is ordered by raw ID, so across the wrap the old entries
+		// can't be cut off by key; they have to be found by age.
+		//
+		if( (seq % BURST) == 0 )
+		{
+			for( std::map<TPACKETID, U64>::iterator it = received.begin(); it != received.end(); )
+			{
+				if( seq - it->second > REMEMBER_SPAN )
+				{
+					received.erase( it++ );
+				}
+				else
+				{
+					++it;
+				}
+			}
+		}
+	}
+	elapsed = watch.Elapsed();
+	allocations = Bench::Allocations() - start_allocations;
+}
+
+void RunReceivedWindow( U64& elapsed, U64& allocations, U32& duplicates )
+{
+	Bench::Random random;
+	LLPacketIDWindow<U64> received;
+	duplicates = 0;
+	//
+	const U64 start_allocations = Bench::Allocations();
+	Bench::Stopwatch watch;
+	for( U32 seq = 0; seq < RECEIVED_COUNT; ++seq )
+	{
+		const TPACKETID id = ReceivedId( random, seq );
+		if( received.find( id ) )
+		{
+			++duplicates;
+			continue;
+		}
+		received.insert( id, seq );
+		//
+		if( (seq % BURST) == 0 && seq > REMEMBER_SPAN )
+		{
+			received.eraseBefore( (FIRST_ID + seq - REMEMBER_SPAN) & LL_PACKET_ID_MASK );
+		}
+	}
+	elapsed = watch.Elapsed();
+	allocations = Bench::Allocations() - start_allocations;
+}
+
+}
+// namespace
+
+
+void BenchPacketWindow()
+{
+	const F64 packets = TICK_COUNT * BURST;
+	U64 elapsed;
+	U64 allocations;
+	U32 count;
+	//
+	RunMap( elapsed, allocations, count );
+	Bench::Report( "packets", "std::map + new, send/ack/scan per packet", (F64)elapsed * 1000.0 / packets, "ns" );
+	Bench::Report( "packets", "std::map + new, allocations per packet", (F64)allocations / packets, "allocs" );
+	Bench::Report( "packets", "std::map + new, resent", (F64)count, "packets" );
+	//
+	RunWindow( elapsed, allocations, count );
+	Bench::Report( "packets", "window + pool, send/ack/scan per packet", (F64)elapsed * 1000.0 / packets, "ns" );
+	Bench::Report( "packets", "window + pool, allocations per packet", (F64)allocations / packets, "allocs" );
+	Bench::Report( "packets", "window + pool, resent", (F64)count, "packets" );
+	//
+	RunReceivedMap( elapsed, allocations, count );
+	Bench::Report( "packets", "std::map, duplicate check per packet", (F64)elapsed * 1000.0 / RECEIVED_COUNT, "ns" );
+	Bench::Report( "packets", "std::map, allocations per packet", (F64)allocations / RECEIVED_COUNT, "allocs" );
+	Bench::Report( "packets", "std::map, duplicates", (F64)count, "packets" );
+	//
+	RunReceivedWindow( elapsed, allocations, count );
+	Bench::Report( "packets", "window, duplicate check per packet", (F64)elapsed * 1000.0 / RECEIVED_COUNT, "ns" );
+	Bench::Report( "packets", "window, allocations per packet", (F64)allocations / RECEIVED_COUNT, "allocs" );
+	Bench::Report( "packets", "window, duplicates", (F64)count, "packets" );
+}
+
+// vim: ts=4 sw=4 noexpandtab syntax=cpp.doxygen
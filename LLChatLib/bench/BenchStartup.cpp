@@ -0,0 +1,167 @@
+/**
+ * \brief Startup cost of reading avatar_lad.xml, the full tree against the header-only parse
+ *
+ * Copyright (c) 2009-2010 by R. Douglas Barbieri
+ *
+ * The source code in this file ("Source Code") is provided by R. Douglas Barbieri
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL").  Terms of the GPL can be found in doc/GPL-license.txt in this distribution.
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL SOURCE CODE IN THIS DISTRIBUTION IS PROVIDED "AS IS." THE AUTHOR MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ */
+
+#include "Bench.h"
+
+// Local project
+//
+#include "AvatarHeaderParser.h"
+
+// llxml
+//
+#include "llxmltree.h"
+
+// stdc++
+//
+#include <cstdio>
+#include <string>
+
+// CMakeLists.txt points this at doc/character in the source tree
+//
+#ifndef LLCBENCH_CHARACTER_DIR
+#define LLCBENCH_CHARACTER_DIR "doc/character"
+#endif
+
+
+using namespace LLC;
+
+namespace
+{
+
+const U32 REPEAT = 50;
+
+/// What StartMessagingSystem() takes from the file's root element
+///
+struct Header
+{
+	std::string	m_name;
+	std::string	m_version;
+	S32			m_wearableDefVersion;
+
+	Header() : m_wearableDefVersion(0) {}
+
+	bool operator==( const Header& other ) const
+	{
+		return m_name == other.m_name
+			&& m_version == other.m_version
+			&& m_wearableDefVersion == other.m_wearableDefVersion;
+	}
+};
+
+enum Path
+{
+	FULL_TREE,		// LLXmlTree of the whole file, as startup did and LLVOAvatar::initClass still does
+	HEADER_ONLY		// AvatarHeaderParser, stopping after the root element
+};
+
+/// One startup's worth of work. The tree is handed back so the caller can
+/// see what keeping it (as LLVOAvatar::sXMLTree did) holds on to.
+///
+bool Parse( const Path path, const std::string& file, LLXmlTree& tree, Header& header )
+{
+	if( path == HEADER_ONLY )
+	{
+		AvatarHeaderParser parser;
+		if( !parser.ParseHeader( file ) )
+		{
+			return false;
+		}
+		header.m_name				= parser.GetName();
+		header.m_version			= parser.GetVersion();
+		header.m_wearableDefVersion	= parser.GetWearableDefVersion();
+		return true;
+	}
+	//
+	if( !tree.parseFile( file, FALSE ) || !tree.getRoot() )
+	{
+		return false;
+	}
+	LLXmlTreeNode* root = tree.getRoot();
+	static LLStdStringHandle version_string = LLXmlTree::addAttributeString( "version" );
+	static LLStdStringHandle wearable_definition_version_string = LLXmlTree::addAttributeString( "wearable_definition_version" );
+	header.m_name = root->hasName( "linden_avatar" )? "linden_avatar": "";
+	root->getFastAttributeString( version_string, header.m_version );
+	header.m_wearableDefVersion = 1;
+	root->getFastAttributeS32( wearable_definition_version_string, header.m_wearableDefVersion );
+	return true;
+}
+
+bool Run( const Path path, const char* what, const std::string& file, Header& header )
+{
+	// The first parse pays for whatever the process hasn't touched yet;
+	// the rest show the steady cost with the file in the page cache
+	//
+	Bench::Stopwatch watch;
+	S64 held = 0;
+	{
+		LLXmlTree tree;
+		if( !Parse( path, file, tree, header ) )
+		{
+			return false;
+		}
+		const U64 first = watch.Elapsed();
+		char line[96];
+		snprintf( line, sizeof(line), "%s: first parse", what );
+		Bench::Report( "startup", line, (F64) first, "us" );
+	}
+	//
+	const U64 start_allocations = Bench::Allocations();
+	watch.Restart();
+	for( U32 idx = 0; idx < REPEAT; ++idx )
+	{
+		LLXmlTree tree;
+		const S64 live = Bench::LiveAllocations();
+		Header again;
+		Parse( path, file, tree, again );
+		held = Bench::LiveAllocations() - live;
+	}
+	const U64 elapsed = watch.Elapsed();
+	const U64 allocations = Bench::Allocations() - start_allocations;
+	//
+	char line[96];
+	snprintf( line, sizeof(line), "%s: per parse", what );
+	Bench::Report( "startup", line, (F64) elapsed / REPEAT, "us" );
+	snprintf( line, sizeof(line), "%s: allocations per parse", what );
+	Bench::Report( "startup", line, (F64) allocations / REPEAT, "allocs" );
+	snprintf( line, sizeof(line), "%s: held once parsed", what );
+	Bench::Report( "startup", line, (F64) held, "allocs" );
+	return true;
+}
+
+}
+// namespace
+
+
+void BenchStartup()
+{
+	const std::string file = LLCBENCH_CHARACTER_DIR "/avatar_lad.xml";
+	Header full;
+	Header header;
+	if( !Run( FULL_TREE, "full tree", file, full )
+		|| !Run( HEADER_ONLY, "header only", file, header ) )
+	{
+		Bench::Fail( "startup", ("couldn't parse " + file).c_str() );
+		return;
+	}
+	if( !(header == full) || header.m_name != "linden_avatar" )
+	{
+		Bench::Fail( "startup", "the header parse disagrees with the full tree" );
+	}
+}
+
+// vim: ts=4 sw=4 noexpandtab syntax=cpp.doxygen
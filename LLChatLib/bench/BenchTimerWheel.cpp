@@ -0,0 +1,145 @@
+/**
+ * \brief Per-tick cost of LLTimerWheel with 10k armed timers
+ *
+ * Copyright (c) 2009-2010 by R. Douglas Barbieri
+ *
+ * The source code in this file ("Source Code") is provided by R. Douglas Barbieri
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL").  Terms of the GPL can be found in doc/GPL-license.txt in this distribution.
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL SOURCE CODE IN THIS DISTRIBUTION IS PROVIDED "AS IS." THE AUTHOR MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ */
+
+#include "Bench.h"
+
+// llcommon
+//
+#include "lltimerwheel.h"
+
+// stdc++
+//
+#include <list>
+
+
+namespace
+{
+
+const U32 TIMER_COUNT		= 10000;
+const U32 TICK_COUNT		= 60000;		// One minute of 1ms ticks
+const U32 MAX_PERIOD_USECS	= 10000000;		// Timers rearm 1ms to 10s out
+const U64 TICK_USECS		= 1000;
+
+struct WheelTimer : public LLTimerWheel::Entry
+{
+};
+
+// What LLEventTimer::updateClass() used to do: look at every timer, every tick.
+//
+struct ListTimer
+{
+	U64		m_expiry;
+};
+
+U64 NextExpiry( Bench::Random& random, U64 now )
+{
+	return now + TICK_USECS + random.Below( MAX_PERIOD_USECS );
+}
+
+}
+// namespace
+
+
+void BenchTimerWheel()
+{
+	// The clock is driven by hand, so only the bookkeeping is timed.
+	//
+	{
+		Bench::Random random;
+		LLTimerWheel wheel( 0, TICK_USECS );
+		WheelTimer* timers = new WheelTimer[TIMER_COUNT];	// Entries can't be copied
+		for( U32 idx = 0; idx < TIMER_COUNT; ++idx )
+		{
+			wheel.arm( timers[idx], NextExpiry( random, 0 ) );
+		}
+		//
+		U64 fired = 0;
+		Bench::Stopwatch watch;
+		for( U32 tick = 1; tick <= TICK_COUNT; ++tick )
+		{
+			const U64 now = tick * TICK_USECS;
+			wheel.advance( now );
+			while( LLTimerWheel::Entry* entry = wheel.popExpired() )
+			{
+				wheel.arm( *entry, NextExpiry( random, now ) );
+				++fired;
+			}
+		}
+		const U64 elapsed = watch.Elapsed();
+		//
+		Bench::Report( "timerwheel", "wheel, 10k timers: per tick", (F64)elapsed / TICK_COUNT, "us" );
+		Bench::Report( "timerwheel", "wheel, 10k timers: fired", (F64)fired, "timers" );
+		delete [] timers;
+	}
+
+	{
+		Bench::Random random;
+		std::list<ListTimer> timers;
+		for( U32 idx = 0; idx < TIMER_COUNT; ++idx )
+		{
+			ListTimer timer = { NextExpiry( random, 0 ) };
+			timers.push_back( timer );
+		}
+		//
+		U64 fired = 0;
+		Bench::Stopwatch watch;
+		for( U32 tick = 1; tick <= TICK_COUNT; ++tick )
+		{
+			const U64 now = tick * TICK_USECS;
+			for( std::list<ListTimer>::iterator it = timers.begin(); it != timers.end(); ++it )
+			{
+				if( it->m_expiry <= now )
+				{
+					it->m_expiry = NextExpiry( random, now );
+					++fired;
+				}
+			}
+		}
+		const U64 elapsed = watch.Elapsed();
+		//
+		Bench::Report( "timerwheel", "list walk, 10k timers: per tick", (F64)elapsed / TICK_COUNT, "us" );
+		Bench::Report( "timerwheel", "list walk, 10k timers: fired", (F64)fired, "timers" );
+	}
+
+	{
+		// Arming and cancelling are meant to be O(1) however full it is
+		//
+		Bench::Random random;
+		LLTimerWheel wheel( 0, TICK_USECS );
+		WheelTimer* timers = new WheelTimer[TIMER_COUNT];	// Entries can't be copied
+		for( U32 idx = 0; idx < TIMER_COUNT; ++idx )
+		{
+			wheel.arm( timers[idx], NextExpiry( random, 0 ) );
+		}
+		//
+		const U32 ops = 1000000;
+		Bench::Stopwatch watch;
+		for( U32 op = 0; op < ops; ++op )
+		{
+			WheelTimer& timer = timers[random.Below( TIMER_COUNT )];
+			wheel.cancel( timer );
+			wheel.arm( timer, NextExpiry( random, 0 ) );
+		}
+		const U64 elapsed = watch.Elapsed();
+		//
+		Bench::Report( "timerwheel", "wheel, 10k timers: cancel + arm", (F64)elapsed * 1000.0 / ops, "ns" );
+		delete [] timers;
+	}
+}
+
+// vim: ts=4 sw=4 noexpandtab syntax=cpp.doxygen
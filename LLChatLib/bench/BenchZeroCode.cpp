@@ -0,0 +1,388 @@
+/**
+ * \brief Template packet throughput of zero coding, the old byte loops against the kernels
+ *
+ * Copyright (c) 2009-2010 by R. Douglas Barbieri
+ *
+ * The source code in this file ("Source Code") is provided by R. Douglas Barbieri
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL").  Terms of the GPL can be found in doc/GPL-license.txt in this distribution.
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL SOURCE CODE IN THIS DISTRIBUTION IS PROVIDED "AS IS." THE AUTHOR MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ */
+
+#include "Bench.h"
+
+// llmessage
+//
+#include "llzerocode.h"
+
+// stdc++
+//
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+
+namespace
+{
+
+const U32 PACKET_COUNT	= 4096;
+const U32 ROUND_COUNT	= 50;
+const S32 MAX_BODY		= 1200;		// Template bodies stay under the MTU
+const S32 MAX_CODED		= 2 * MAX_BODY;
+
+// The bodies chat sees, minus the packet id field: chat and IM text, which
+// has almost no zeroes; agent and object updates, which are mostly floats,
+// flags and padding with short zero runs; and the odd mostly empty block.
+//
+enum Shape
+{
+	SHAPE_TEXT,
+	SHAPE_UPDATE,
+	SHAPE_SPARSE,
+	SHAPE_COUNT
+};
+
+struct Packet
+{
+	std::vector<U8>		m_body;
+	std::vector<S32>	m_pieces;	// Variable sizes, the way the template builder holds the body
+};
+
+Packet MakePacket( Bench::Random& random )
+{
+	Packet packet;
+	const Shape shape = (Shape) random.Below( SHAPE_COUNT );
+	S32 size = 0;
+	U32 zero_percent = 0;
+	U32 max_run = 1;
+	switch( shape )
+	{
+		case SHAPE_TEXT:	size = 60 + random.Below( 400 );	zero_percent = 2;	max_run = 2;	break;
+		case SHAPE_UPDATE:	size = 80 + random.Below( 900 );	zero_percent = 40;	max_run = 12;	break;
+		default:			size = 30 + random.Below( 300 );	zero_percent = 85;	max_run = 300;	break;
+	}
+	while( (S32) packet.m_body.size() < size )
+	{
+		if( random.Below( 100 ) < zero_percent )
+		{
+			const U32 run = 1 + random.Below( max_run );
+			packet.m_body.insert( packet.m_body.end(), run, 0 );
+		}
+		else
+		{
+			packet.m_body.push_back( (U8)(1 + random.Below( 255 )) );
+		}
+	}
+	packet.m_body.resize( size );
+	//
+	for( S32 left = size; left > 0; )
+	{
+		static const S32 VARIABLE_SIZES[] = { 1, 2, 4, 4, 8, 12, 16, 16, 32 };
+		const S32 piece = llmin( left, VARIABLE_SIZES[random.Below( sizeof(VARIABLE_SIZES) / sizeof(VARIABLE_SIZES[0]) )] );
+		packet.m_pieces.push_back( piece );
+		left -= piece;
+	}
+	return packet;
+}
+
+// What LLTemplateMessageBuilder's zero_code() did: always code the whole
+// body, counting the gain as it goes, and only then decide.
+//
+S32 OldEncode( const U8* inptr, S32 count, U8* outptr, S32& net_gain )
+{
+	U8* const out = outptr;
+	U8 num_zeroes = 0;
+	net_gain = 0;
+	while( count-- )
+	{
+		if( !(*inptr) )
+		{
+			if( num_zeroes )
+			{
+				if( ++num_zeroes > 254 )
+				{
+					*outptr++ = num_zeroes;
+					num_zeroes = 0;
+				}
+				net_gain--;
+			}
+			else
+			{
+				*outptr++ = 0;
+				net_gain++;
+				num_zeroes = 1;
+			}
+			inptr++;
+		}
+		else
+		{
+			if( num_zeroes )
+			{
+				*outptr++ = num_zeroes;
+				num_zeroes = 0;
+			}
+			*outptr++ = *inptr++;
+		}
+	}
+	if( num_zeroes )
+	{
+		*outptr++ = num_zeroes;
+	}
+	return (S32)(outptr - out);
+}
+
+// What LLMessageSystem::zeroCodeExpand() did, less the overflow handling
+//
+S32 OldExpand( const U8* inptr, S32 count, U8* out, S32 out_max )
+{
+	U8* outptr = out;
+	while( count-- )
+	{
+		if( outptr > out + out_max - 1 )
+		{
+			return -1;
+		}
+		if( !((*outptr++ = *inptr++)) )
+		{
+			while( (count--) && !(*inptr) )
+			{
+				*outptr++ = *inptr++;
+				if( outptr > out + out_max - 256 )
+				{
+					return -1;
+				}
+				memset( outptr, 0, 255 );
+				outptr += 255;
+			}
+			if( count < 0 )
+			{
+				break;
+			}
+			if( outptr > out + out_max - *inptr )
+			{
+				return -1;
+			}
+			memset( outptr, 0, (*inptr) - 1 );
+			outptr += ((*inptr) - 1);
+			inptr++;
+		}
+	}
+	return (S32)(outptr - out);
+}
+
+struct Corpus
+{
+	std::vector<Packet>				m_packets;
+	std::vector< std::vector<U8> >	m_coded;	// Coded bodies, for the packets where coding pays
+	U64								m_bytes;
+	U64								m_codedBytes;
+
+	Corpus() : m_bytes(0), m_codedBytes(0)
+	{
+		Bench::Random random;
+		U8 out[MAX_CODED];
+		for( U32 idx = 0; idx < PACKET_COUNT; ++idx )
+		{
+			m_packets.push_back( MakePacket( random ) );
+			const std::vector<U8>& body = m_packets.back().m_body;
+			m_bytes += body.size();
+			S32 net_gain;
+			const S32 size = OldEncode( &body[0], (S32) body.size(), out, net_gain );
+			if( net_gain < 0 )
+			{
+				m_coded.push_back( std::vector<U8>( out, out + size ) );
+				m_codedBytes += size;
+			}
+		}
+	}
+};
+
+/// Every path has to agree with the old loops, or its figures mean nothing
+///
+bool Verify( const Corpus& corpus )
+{
+	U8 out[MAX_CODED];
+	U8 back[MAX_CODED];
+	for( size_t idx = 0; idx < corpus.m_packets.size(); ++idx )
+	{
+		const Packet& packet = corpus.m_packets[idx];
+		const U8* body = &packet.m_body[0];
+		const S32 size = (S32) packet.m_body.size();
+		//
+		S32 net_gain;
+		const S32 old_size = OldEncode( body, size, out, net_gain );
+		if( ll_zero_code_encoded_size( body, size ) != old_size )
+		{
+			return false;
+		}
+		LLZeroCodeSizer sizer;
+		const U8* piece = body;
+		for( size_t pdx = 0; pdx < packet.m_pieces.size(); ++pdx )
+		{
+			sizer.add( piece, packet.m_pieces[pdx] );
+			piece += packet.m_pieces[pdx];
+		}
+		if( sizer.getRawSize() != size || sizer.getCodedSize() != old_size )
+		{
+			return false;
+		}
+		//
+		const S32 coded = ll_zero_code_encode( body, size, out, size - 1 );
+		if( (coded >= 0) != (net_gain < 0) )
+		{
+			return false;
+		}
+		if( coded >= 0
+			&& (ll_zero_code_expand( out, coded, back, MAX_BODY ) != size || memcmp( back, body, size )) )
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+enum Path
+{
+	OLD_ENCODE,			// zero_code(): code it all, then look at the gain
+	KERNEL_ENCODE,		// ll_zero_code_encode(), giving up once it stops paying
+	OLD_EXPAND,
+	KERNEL_EXPAND,
+	TRIAL_SIZE,			// zeroCodeAdjustCurrentSendTotal(): build, then code into the void
+	KERNEL_SIZE,		// ll_zero_code_encoded_size() over the built body
+	SIZER_SIZE			// LLZeroCodeSizer over the builder's variables, nothing built
+};
+
+U64 RunPath( const Path path, const Corpus& corpus, U64& check )
+{
+	U8 out[MAX_CODED];
+	U8 built[MAX_BODY];
+	Bench::Stopwatch watch;
+	for( U32 round = 0; round < ROUND_COUNT; ++round )
+	{
+		switch( path )
+		{
+			case OLD_ENCODE:
+			case KERNEL_ENCODE:
+				for( size_t idx = 0; idx < corpus.m_packets.size(); ++idx )
+				{
+					const std::vector<U8>& body = corpus.m_packets[idx].m_body;
+					S32 net_gain = 0;
+					if( path == OLD_ENCODE )
+					{
+						check += OldEncode( &body[0], (S32) body.size(), out, net_gain );
+					}
+					else
+					{
+						check += ll_zero_code_encode( &body[0], (S32) body.size(), out, (S32) body.size() - 1 );
+					}
+				}
+				break;
+
+			case OLD_EXPAND:
+			case KERNEL_EXPAND:
+				for( size_t idx = 0; idx < corpus.m_coded.size(); ++idx )
+				{
+					const std::vector<U8>& coded = corpus.m_coded[idx];
+					if( path == OLD_EXPAND )
+					{
+						check += OldExpand( &coded[0], (S32) coded.size(), out, MAX_CODED );
+					}
+					else
+					{
+						check += ll_zero_code_expand( &coded[0], (S32) coded.size(), out, MAX_CODED );
+					}
+				}
+				break;
+
+			case TRIAL_SIZE:
+			case KERNEL_SIZE:
+			case SIZER_SIZE:
+				for( size_t idx = 0; idx < corpus.m_packets.size(); ++idx )
+				{
+					const Packet& packet = corpus.m_packets[idx];
+					if( path == SIZER_SIZE )
+					{
+						LLZeroCodeSizer sizer;
+						const U8* piece = &packet.m_body[0];
+						for( size_t pdx = 0; pdx < packet.m_pieces.size(); ++pdx )
+						{
+							sizer.add( piece, packet.m_pieces[pdx] );
+							piece += packet.m_pieces[pdx];
+						}
+						check += sizer.getCodedSize();
+						continue;
+					}
+					//
+					// The others need the body built first, variable by variable
+					//
+					S32 size = 0;
+					const U8* piece = &packet.m_body[0];
+					for( size_t pdx = 0; pdx < packet.m_pieces.size(); ++pdx )
+					{
+						memcpy( built + size, piece, packet.m_pieces[pdx] );
+						size += packet.m_pieces[pdx];
+						piece += packet.m_pieces[pdx];
+					}
+					if( path == TRIAL_SIZE )
+					{
+						S32 net_gain;
+						check += OldEncode( built, size, out, net_gain );
+					}
+					else
+					{
+						check += ll_zero_code_encoded_size( built, size );
+					}
+				}
+				break;
+		}
+	}
+	return watch.Elapsed();
+}
+
+void Report( const char* what, const U64 elapsed, const U64 bytes, const U32 packets )
+{
+	char line[64];
+	snprintf( line, sizeof(line), "%s: rate", what );
+	Bench::Report( "zerocode", line, (F64)(bytes * ROUND_COUNT) / elapsed, "MB/s" );
+	snprintf( line, sizeof(line), "%s: per packet", what );
+	Bench::Report( "zerocode", line, (F64)elapsed * 1000.0 / ((F64) packets * ROUND_COUNT), "ns" );
+}
+
+}
+// namespace
+
+
+void BenchZeroCode()
+{
+	const Corpus corpus;
+	printf( "%-12s kernels: %s, %u packets, %u coded\n", "zerocode", ll_zero_code_kernel_name(), PACKET_COUNT, (U32) corpus.m_coded.size() );
+	if( !Verify( corpus ) )
+	{
+		Bench::Fail( "zerocode", "kernels disagree with the old loops" );
+		return;
+	}
+	//
+	const U32 packets = (U32) corpus.m_packets.size();
+	const U32 coded = (U32) corpus.m_coded.size();
+	U64 check = 0;
+	Report( "old loop, encode",			RunPath( OLD_ENCODE,	corpus, check ), corpus.m_bytes,		packets );
+	Report( "kernels, encode",			RunPath( KERNEL_ENCODE,	corpus, check ), corpus.m_bytes,		packets );
+	Report( "old loop, expand",			RunPath( OLD_EXPAND,	corpus, check ), corpus.m_codedBytes,	coded );
+	Report( "kernels, expand",			RunPath( KERNEL_EXPAND,	corpus, check ), corpus.m_codedBytes,	coded );
+	Report( "size, build + trial encode",	RunPath( TRIAL_SIZE,	corpus, check ), corpus.m_bytes,		packets );
+	Report( "size, build + kernel",		RunPath( KERNEL_SIZE,	corpus, check ), corpus.m_bytes,		packets );
+	Report( "size, by variable",		RunPath( SIZER_SIZE,	corpus, check ), corpus.m_bytes,		packets );
+	if( !check )
+	{
+		Bench::Fail( "zerocode", "nothing was coded" );
+	}
+}
+
+// vim: ts=4 sw=4 noexpandtab syntax=cpp.doxygen
@@ -0,0 +1,155 @@
+/**
+ * \brief Runs the LLChatLib micro-benchmarks
+ *
+ * Copyright (c) 2009-2010 by R. Douglas Barbieri
+ *
+ * The source code in this file ("Source Code") is provided by R. Douglas Barbieri
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL").  Terms of the GPL can be found in doc/GPL-license.txt in this distribution.
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL SOURCE CODE IN THIS DISTRIBUTION IS PROVIDED "AS IS." THE AUTHOR MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ */
+
+#include "Bench.h"
+
+// stdc++
+//
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+
+namespace
+{
+
+U64 g_allocations = 0;
+U64 g_frees = 0;
+U32 g_failures = 0;
+
+struct BenchEntry
+{
+	const char*	m_name;
+	void		(*m_run)();
+};
+
+const BenchEntry BENCHES[] =
+{
+	{ "timerwheel",		&BenchTimerWheel },
+	{ "packets",		&BenchPacketWindow },
+	{ "buddies",		&BenchBuddyList },
+	{ "chatevent",		&BenchChatEvent },
+	{ "llsd",			&BenchLLSDParse },
+	{ "zerocode",		&BenchZeroCode },
+	{ "dispatch",		&BenchDispatch },
+	{ "startup",		&BenchStartup },
+};
+
+const size_t BENCH_COUNT = sizeof(BENCHES) / sizeof(BENCHES[0]);
+
+}
+// namespace
+
+
+// Counting every allocation in the process is what lets the benchmarks
+// report allocations per message without a heap profiler.
+//
+void* operator new( size_t size ) throw(std::bad_alloc)
+{
+	++g_allocations;
+	void* ptr = malloc( size? size: 1 );
+	if( !ptr )
+	{
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void* operator new[]( size_t size ) throw(std::bad_alloc)
+{
+	return operator new( size );
+}
+
+void operator delete( void* ptr ) throw()
+{
+	if( ptr )
+	{
+		++g_frees;
+	}
+	free( ptr );
+}
+
+void operator delete[]( void* ptr ) throw()
+{
+	operator delete( ptr );
+}
+
+
+U64 Bench::Allocations()
+{
+	return g_allocations;
+}
+
+
+S64 Bench::LiveAllocations()
+{
+	return (S64)(g_allocations - g_frees);
+}
+
+
+void Bench::Report( const char* bench, const char* what, F64 value, const char* unit )
+{
+	printf( "%-12s %-40s %12.3f %s\n", bench, what, value, unit );
+	fflush( stdout );
+}
+
+
+void Bench::Fail( const char* bench, const char* what )
+{
+	++g_failures;
+	fflush( stdout );
+	fprintf( stderr, "%-12s FAILED: %s\n", bench, what );
+}
+
+
+int main( int argc, char* argv[] )
+{
+	for( int arg = 1; arg < argc; ++arg )
+	{
+		bool known = false;
+		for( size_t idx = 0; idx < BENCH_COUNT && !known; ++idx )
+		{
+			known = !strcmp( argv[arg], BENCHES[idx].m_name );
+		}
+		if( !known )
+		{
+			fprintf( stderr, "Unknown benchmark: %s\n", argv[arg] );
+			fprintf( stderr, "Usage: %s [benchmark...]\n", argv[0] );
+			return 1;
+		}
+	}
+	//
+	// With no arguments everything runs; otherwise just the ones named.
+	//
+	for( size_t idx = 0; idx < BENCH_COUNT; ++idx )
+	{
+		bool wanted = (argc < 2);
+		for( int arg = 1; arg < argc && !wanted; ++arg )
+		{
+			wanted = !strcmp( argv[arg], BENCHES[idx].m_name );
+		}
+		if( wanted )
+		{
+			BENCHES[idx].m_run();
+		}
+	}
+	return g_failures? 1: 0;
+}
+
+// vim: ts=4 sw=4 noexpandtab syntax=cpp.doxygen
@@ -1562,6 +1562,37 @@ void CProcessor::GetStandardProcessorExtensions()
 	CPUInfo._Ext.HT_HyterThreadingSiblings = (ebxreg >> 16) & 0xFF;
 	CPUInfo._Ext.TM_ThermalMonitor								= CheckBit(edxreg, 29);
 	CPUInfo._Ext.IA64_Intel64BitArchitecture					= CheckBit(edxreg, 30);
+
+	// AVX2 is only usable if the OS saves the YMM registers as well, so
+	// require OSXSAVE/AVX in CPUID 1 and XMM|YMM state enabled in XCR0
+	// before looking at the CPUID 7 feature bit.
+	CPUInfo._Ext.AVX2_AdvancedVectorExtensions2 = false;
+	if (CPUInfo.MaxSupportedLevel >= 7)
+	{
+		unsigned long ecxreg, xcr0reg, ebx7reg;
+		__asm
+		{
+			mov eax, 1
+			cpuid
+			mov ecxreg, ecx
+		}
+		if (CheckBit(ecxreg, 27) && CheckBit(ecxreg, 28))
+		{
+			__asm
+			{
+				xor ecx, ecx
+				_emit 0x0f				// xgetbv
+				_emit 0x01
+				_emit 0xd0
+				mov xcr0reg, eax
+				mov eax, 7
+				xor ecx, ecx
+				cpuid
+				mov ebx7reg, ebx
+			}
+			CPUInfo._Ext.AVX2_AdvancedVectorExtensions2 = ((xcr0reg & 0x6) == 0x6) && CheckBit(ebx7reg, 5);
+		}
+	}
 #endif
 }
 
@@ -2086,6 +2117,7 @@ const ProcessorInfo *CProcessor::GetCPUInfo()
 	CPUInfo._Ext.MMX_MultimediaExtensions = hasFeature("hw.optional.mmx");
 	CPUInfo._Ext.SSE_StreamingSIMD_Extensions = hasFeature("hw.optional.sse");
 	CPUInfo._Ext.SSE2_StreamingSIMD2_Extensions = hasFeature("hw.optional.sse2");
+	CPUInfo._Ext.AVX2_AdvancedVectorExtensions2 = hasFeature("hw.optional.avx2_0");
 	CPUInfo._Ext.Altivec_Extensions = false;
 	CPUInfo._Ext.AA64_AMD64BitArchitecture = hasFeature("hw.optional.x86_64");
 
@@ -2241,6 +2273,7 @@ bool CProcessor::CPUInfoToText(char *strBuffer, unsigned int uiMaxLen)
 	BOOLADD("SS     Self Snoop:                                 ", CPUInfo._Ext.SS_SelfSnoop);
 	BOOLADD("SSE    Streaming SIMD Extensions:                  ", CPUInfo._Ext.SSE_StreamingSIMD_Extensions);
 	BOOLADD("SSE2   Streaming SIMD 2 Extensions:                ", CPUInfo._Ext.SSE2_StreamingSIMD2_Extensions);
+	BOOLADD("AVX2   Advanced Vector Extensions 2:               ", CPUInfo._Ext.AVX2_AdvancedVectorExtensions2);
 	BOOLADD("ALTVEC Altivec Extensions:                         ", CPUInfo._Ext.Altivec_Extensions);
 	BOOLADD("TM     Thermal Monitor:                            ", CPUInfo._Ext.TM_ThermalMonitor);
 	BOOLADD("TSC    Time Stamp Counter:                         ", CPUInfo._Ext.TSC_TimeStampCounter);
@@ -89,6 +89,7 @@ struct ProcessorExtensions
 	bool FXSR_FastStreamingSIMD_ExtensionsSaveRestore;
 	bool SSE_StreamingSIMD_Extensions;
 	bool SSE2_StreamingSIMD2_Extensions;
+	bool AVX2_AdvancedVectorExtensions2;
 	bool Altivec_Extensions;
 	bool SS_SelfSnoop;
 	bool HT_HyperThreading;
@@ -359,6 +359,28 @@ public:
 	 */
 	LLSDXMLParser();
 
+	/** 
+	 * @brief Feed the parser the next piece of a document in memory.
+	 *
+	 * The bytes go to expat where they lie, so a document held in
+	 * several buffers can be parsed without an istream or a copy to
+	 * join them up. Pieces may split anywhere, even inside a tag.
+	 * Call reset() before the first piece of a new document.
+	 * @param buf The next bytes of the document.
+	 * @param len The number of bytes at buf.
+	 * @return Returns false once the document is known to be bad.
+	 */
+	bool parseChunk(const char* buf, S32 len);
+
+	/** 
+	 * @brief Finish a document fed in with parseChunk().
+	 *
+	 * @param data[out] The newly parse structured data.
+	 * @return Returns the number of LLSD objects parsed into
+	 * data. Returns PARSE_FAILURE (-1) on parse failure.
+	 */
+	S32 finishParse(LLSD& data);
+
 protected:
 	/** 
 	 * @brief Call this method to parse a stream for LLSD.
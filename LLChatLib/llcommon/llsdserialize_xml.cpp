@@ -266,6 +266,9 @@ public:
 	S32 parseLines(std::istream& input, LLSD& data);
 
 	void parsePart(const char *buf, int len);
+
+	bool parseChunk(const char* buf, int len);
+	S32 finishParse(LLSD& data);
 	
 	void reset();
 
@@ -544,6 +547,34 @@ LLSDXMLParser::Impl::findAttribute(const XML_Char* name, const XML_Char** pairs)
 	return NULL;
 }
 
+bool LLSDXMLParser::Impl::parseChunk(const char* buf, int len)
+{
+	// Anything after </llsd> is none of our business
+	if (mGracefullStop || buf == NULL || len <= 0)
+	{
+		return true;
+	}
+	XML_Status status = XML_Parse(mParser, buf, len, false);
+	return status != XML_STATUS_ERROR || mGracefullStop;
+}
+
+S32 LLSDXMLParser::Impl::finishParse(LLSD& data)
+{
+	if (!mGracefullStop)
+	{
+		XML_Status status = XML_Parse(mParser, NULL, 0, true);
+		if (status == XML_STATUS_ERROR && !mGracefullStop)
+		{
+			llinfos << "LLSDXMLParser::Impl::finishParse: XML_STATUS_ERROR: "
+					<< XML_ErrorString(XML_GetErrorCode(mParser)) << llendl;
+			data = LLSD();
+			return LLSDParser::PARSE_FAILURE;
+		}
+	}
+	data = mResult;
+	return mParseCount;
+}
+
 void LLSDXMLParser::Impl::parsePart(const char* buf, int len)
 {
 	if ( buf != NULL 
@@ -763,16 +794,17 @@ void LLSDXMLParser::Impl::endElementHandler(const XML_Char* name)
 			value = mCurrentContent;
 			break;
 		
+		// Convert directly rather than through a temporary string LLSD
 		case ELEMENT_UUID:
-			value = LLSD(mCurrentContent).asUUID();
+			value = LLUUID(mCurrentContent);
 			break;
 		
 		case ELEMENT_DATE:
-			value = LLSD(mCurrentContent).asDate();
+			value = LLDate(mCurrentContent);
 			break;
 		
 		case ELEMENT_URI:
-			value = LLSD(mCurrentContent).asURI();
+			value = LLURI(mCurrentContent);
 			break;
 		
 		case ELEMENT_BINARY:
@@ -914,6 +946,16 @@ void LLSDXMLParser::parsePart(const char *buf, int len)
 	impl.parsePart(buf, len);
 }
 
+bool LLSDXMLParser::parseChunk(const char* buf, S32 len)
+{
+	return impl.parseChunk(buf, len);
+}
+
+S32 LLSDXMLParser::finishParse(LLSD& data)
+{
+	return impl.finishParse(data);
+}
+
 // virtual
 S32 LLSDXMLParser::doParse(std::istream& input, LLSD& data) const
 {
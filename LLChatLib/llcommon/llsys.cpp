@@ -392,6 +392,7 @@ LLCPUInfo::LLCPUInfo()
 	// proc.WriteInfoTextFile("procInfo.txt");
 	mHasSSE = info->_Ext.SSE_StreamingSIMD_Extensions;
 	mHasSSE2 = info->_Ext.SSE2_StreamingSIMD2_Extensions;
+	mHasAVX2 = info->_Ext.AVX2_AdvancedVectorExtensions2;
 	mHasAltivec = info->_Ext.Altivec_Extensions;
 	mCPUMhz = (S32)(proc.GetCPUFrequency(50)/1000000.0);
 	mFamily.assign( info->strFamily );
@@ -441,6 +442,7 @@ LLCPUInfo::LLCPUInfo()
 	LLStringUtil::toLower(flags);
 	mHasSSE = ( flags.find( " sse " ) != std::string::npos );
 	mHasSSE2 = ( flags.find( " sse2 " ) != std::string::npos );
+	mHasAVX2 = ( flags.find( " avx2 " ) != std::string::npos );
 	
 	F64 mhz;
 	if (LLStringUtil::convertToF64(cpuinfo["cpu mhz"], mhz)
@@ -469,6 +471,11 @@ bool LLCPUInfo::hasSSE2() const
 	return mHasSSE2;
 }
 
+bool LLCPUInfo::hasAVX2() const
+{
+	return mHasAVX2;
+}
+
 S32 LLCPUInfo::getMhz() const
 {
 	return mCPUMhz;
@@ -517,6 +524,7 @@ void LLCPUInfo::stream(std::ostream& s) const
 	// CPU's attributes regardless of platform
 	s << "->mHasSSE:     " << (U32)mHasSSE << std::endl;
 	s << "->mHasSSE2:    " << (U32)mHasSSE2 << std::endl;
+	s << "->mHasAVX2:    " << (U32)mHasAVX2 << std::endl;
 	s << "->mHasAltivec: " << (U32)mHasAltivec << std::endl;
 	s << "->mCPUMhz:     " << mCPUMhz << std::endl;
 	s << "->mCPUString:  " << mCPUString << std::endl;
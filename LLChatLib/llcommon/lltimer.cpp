@@ -561,52 +561,63 @@ void secondsToTimecodeString(F32 current_time, std::string& tcstring)
 //
 //////////////////////////////////////////////////////////////////////////////
 
-std::list<LLEventTimer*> LLEventTimer::sActiveList;
+//static
+LLTimerWheel& LLEventTimer::getWheel()
+{
+	static LLTimerWheel wheel(totalTime());
+	return wheel;
+}
 
 LLEventTimer::LLEventTimer(F32 period)
 : mEventTimer()
 {
 	mPeriod = period;
-	sActiveList.push_back(this);
+	arm();
 }
 
 LLEventTimer::LLEventTimer(const LLDate& time)
 : mEventTimer()
 {
 	mPeriod = (F32)(time.secondsSinceEpoch() - LLDate::now().secondsSinceEpoch());
-	sActiveList.push_back(this);
+	arm();
 }
 
 
 LLEventTimer::~LLEventTimer() 
 {
-	sActiveList.remove(this);
+	// The wheel entry takes itself off the wheel
+}
+
+void LLEventTimer::arm()
+{
+	getWheel().arm(*this, totalTime() + (U64)(llmax(mPeriod, 0.f) * SEC_TO_MICROSEC));
+}
+
+//static
+BOOL LLEventTimer::getNextTickTime(U64& usecs)
+{
+	return getWheel().getNextExpiry(usecs);
 }
 
 void LLEventTimer::updateClass() 
 {
-	std::list<LLEventTimer*> completed_timers;
-	for (std::list<LLEventTimer*>::iterator iter = sActiveList.begin(); iter != sActiveList.end(); ) 
+	// Only the timers that are due come off the wheel.  A tick() may create
+	// or delete other timers, so they are taken one at a time.
+	LLTimerWheel& wheel = getWheel();
+	wheel.advance(totalTime());
+	while (LLTimerWheel::Entry* entry = wheel.popExpired())
 	{
-		LLEventTimer* timer = *iter++;
-		F32 et = timer->mEventTimer.getElapsedTimeF32();
-		if (timer->mEventTimer.getStarted() && et > timer->mPeriod) {
+		LLEventTimer* timer = static_cast<LLEventTimer*>(entry);
+		if (timer->mEventTimer.getStarted())
+		{
 			timer->mEventTimer.reset();
 			if ( timer->tick() )
 			{
-				completed_timers.push_back( timer );
+				delete timer;
+				continue;
 			}
 		}
-	}
-
-	if ( completed_timers.size() > 0 )
-	{
-		for (std::list<LLEventTimer*>::iterator completed_iter = completed_timers.begin(); 
-			 completed_iter != completed_timers.end(); 
-			 completed_iter++ ) 
-		{
-			delete *completed_iter;
-		}
+		timer->arm();
 	}
 }
 
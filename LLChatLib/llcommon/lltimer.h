@@ -40,6 +40,7 @@
 
 #include "stdtypes.h"
 #include "lldate.h"
+#include "lltimerwheel.h"
 
 #include <string>
 #include <list>
@@ -171,7 +172,7 @@ void microsecondsToTimecodeString(U64 current_time, std::string& tcstring);
 void secondsToTimecodeString(F32 current_time, std::string& tcstring);
 
 // class for scheduling a function to be called at a given frequency (approximate, inprecise)
-class LLEventTimer 
+class LLEventTimer : protected LLTimerWheel::Entry
 {
 public:
 	LLEventTimer(F32 period);	// period is the amount of time between each call to tick() in seconds
@@ -184,13 +185,19 @@ public:
 
 	static void updateClass();
 
+	// Time, as totalTime(), at which updateClass() next has a timer to tick.
+	// FALSE if there are no timers.
+	static BOOL getNextTickTime(U64& usecs);
+
 protected:
 	LLTimer mEventTimer;
 	F32 mPeriod;
 
 private:
-	//list of active timers
-	static std::list<LLEventTimer*> sActiveList; // TODO should this be a vector
+	void arm();
+
+	// active timers, by when they are next due
+	static LLTimerWheel& getWheel();
 };
 
 #endif
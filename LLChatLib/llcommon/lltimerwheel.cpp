@@ -0,0 +1,303 @@
+/**
+ * @file lltimerwheel.cpp
+ * @brief Hierarchical timer wheel
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ *
+ * Copyright (c) 2009, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "lltimerwheel.h"
+
+#if LL_MSVC
+#include <intrin.h>
+#endif
+
+// Where an entry goes depends on the highest bit in which its tick differs
+// from the current one.  With tick T at level L, T agrees with the current
+// tick above level L and has a larger digit at level L.  So every entry at a
+// level expires after every entry at the levels below it, and a level's
+// occupied buckets all lie ahead of the current digit: the first set bit is
+// the next bucket to come due, with no wrap to worry about.  The clock only
+// ever jumps to the start of the next occupied bucket, or to a time before
+// it, which keeps that true for the entries it does not touch.
+
+LLTimerWheel::Entry::Entry()
+:	mWheel(NULL),
+	mTick(0),
+	mBucket(0)
+{
+	mPrev = mNext = NULL;
+}
+
+LLTimerWheel::Entry::~Entry()
+{
+	if (mWheel)
+	{
+		mWheel->cancel(*this);
+	}
+}
+
+
+LLTimerWheel::LLTimerWheel(U64 now_usecs, U64 resolution_usecs)
+:	mNow(now_usecs / llmax(resolution_usecs, (U64)1)),
+	mResolution(llmax(resolution_usecs, (U64)1)),
+	mCount(0)
+{
+	for (U32 bucket = 0; bucket < BUCKET_COUNT; ++bucket)
+	{
+		mBuckets[bucket].mPrev = mBuckets[bucket].mNext = &mBuckets[bucket];
+	}
+	for (U32 level = 0; level < LEVELS; ++level)
+	{
+		mOccupied[level] = 0;
+	}
+}
+
+LLTimerWheel::~LLTimerWheel()
+{
+	// Let go of whatever is left, so the entries don't reach back in here
+	// when they are destroyed
+	for (U32 bucket = 0; bucket < BUCKET_COUNT; ++bucket)
+	{
+		Link& head = mBuckets[bucket];
+		while (head.mNext != &head)
+		{
+			Entry* entry = static_cast<Entry*>(head.mNext);
+			unlink(entry);
+			entry->mWheel = NULL;
+		}
+	}
+}
+
+void LLTimerWheel::arm(Entry& entry, U64 expiry_usecs)
+{
+	if (entry.mWheel)
+	{
+		entry.mWheel->cancel(entry);
+	}
+
+	U64 tick = (expiry_usecs + mResolution - 1) / mResolution;
+	entry.mTick = llmax(tick, mNow + 1);
+	entry.mWheel = this;
+	++mCount;
+	place(&entry);
+}
+
+void LLTimerWheel::cancel(Entry& entry)
+{
+	if (entry.mWheel != this)
+	{
+		return;
+	}
+	unlink(&entry);
+	entry.mWheel = NULL;
+	--mCount;
+}
+
+void LLTimerWheel::advance(U64 now_usecs)
+{
+	const U64 target = now_usecs / mResolution;
+	U32 bucket;
+	U64 start;
+	while (findNextBucket(bucket, start) && start <= target)
+	{
+		// Everything in the bucket is either due now or goes down a level.
+		// Overflow entries may go straight back on the overflow list, so
+		// take the bucket's contents off it first.
+		mNow = start;
+		Link pending;
+		splice(bucket, pending);
+		while (pending.mNext != &pending)
+		{
+			Entry* entry = static_cast<Entry*>(pending.mNext);
+			pending.mNext = entry->mNext;
+			place(entry);
+		}
+	}
+	mNow = llmax(mNow, target);
+}
+
+LLTimerWheel::Entry* LLTimerWheel::popExpired()
+{
+	Link& head = mBuckets[BUCKET_EXPIRED];
+	if (head.mNext == &head)
+	{
+		return NULL;
+	}
+	Entry* entry = static_cast<Entry*>(head.mNext);
+	cancel(*entry);
+	return entry;
+}
+
+BOOL LLTimerWheel::getNextExpiry(U64& expiry_usecs) const
+{
+	const Link& expired = mBuckets[BUCKET_EXPIRED];
+	if (expired.mNext != &expired)
+	{
+		expiry_usecs = mNow * mResolution;
+		return TRUE;
+	}
+
+	U32 bucket;
+	U64 start;
+	if (!findNextBucket(bucket, start))
+	{
+		return FALSE;
+	}
+
+	// A bottom level bucket holds a single tick.  Above that the bucket
+	// only gives a lower bound, so find its earliest entry.
+	U64 tick = bucket < SLOTS ? start : earliestTick(mBuckets[bucket]);
+	expiry_usecs = tick * mResolution;
+	return TRUE;
+}
+
+void LLTimerWheel::place(Entry* entry)
+{
+	const U64 tick = entry->mTick;
+	if (tick <= mNow)
+	{
+		link(entry, BUCKET_EXPIRED);
+		return;
+	}
+
+	const U64 diff = tick ^ mNow;
+	if (diff >> RANGE_BITS)
+	{
+		link(entry, BUCKET_OVERFLOW);
+		return;
+	}
+
+	U32 level = 0;
+	while (diff >> ((level + 1) * SLOT_BITS))
+	{
+		++level;
+	}
+	const U32 slot = (U32)(tick >> (level * SLOT_BITS)) & SLOT_MASK;
+	link(entry, level * SLOTS + slot);
+	mOccupied[level] |= (U64)1 << slot;
+}
+
+void LLTimerWheel::link(Entry* entry, U32 bucket)
+{
+	Link& head = mBuckets[bucket];
+	entry->mBucket = bucket;
+	entry->mPrev = head.mPrev;
+	entry->mNext = &head;
+	head.mPrev->mNext = entry;
+	head.mPrev = entry;
+}
+
+void LLTimerWheel::unlink(Entry* entry)
+{
+	entry->mPrev->mNext = entry->mNext;
+	entry->mNext->mPrev = entry->mPrev;
+	entry->mPrev = entry->mNext = NULL;
+
+	const U32 bucket = entry->mBucket;
+	if (bucket < BUCKET_EXPIRED && mBuckets[bucket].mNext == &mBuckets[bucket])
+	{
+		mOccupied[bucket / SLOTS] &= ~((U64)1 << (bucket % SLOTS));
+	}
+}
+
+// Moves the whole of a bucket onto an unlinked list, singly linked through
+// mNext and ending at the list head.
+void LLTimerWheel::splice(U32 bucket, Link& list)
+{
+	Link& head = mBuckets[bucket];
+	if (head.mNext == &head)
+	{
+		list.mNext = &list;
+		return;
+	}
+	list.mNext = head.mNext;
+	head.mPrev->mNext = &list;
+	head.mPrev = head.mNext = &head;
+	if (bucket < BUCKET_EXPIRED)
+	{
+		mOccupied[bucket / SLOTS] &= ~((U64)1 << (bucket % SLOTS));
+	}
+}
+
+// The next bucket to come due and the tick it starts at.
+BOOL LLTimerWheel::findNextBucket(U32& bucket, U64& start) const
+{
+	for (U32 level = 0; level < LEVELS; ++level)
+	{
+		if (mOccupied[level])
+		{
+			const U32 slot = firstSetBit(mOccupied[level]);
+			const U32 shift = level * SLOT_BITS;
+			bucket = level * SLOTS + slot;
+			start = ((mNow >> (shift + SLOT_BITS)) << (shift + SLOT_BITS)) | ((U64)slot << shift);
+			return TRUE;
+		}
+	}
+
+	const Link& overflow = mBuckets[BUCKET_OVERFLOW];
+	if (overflow.mNext != &overflow)
+	{
+		// Sorted again once the top level comes round
+		bucket = BUCKET_OVERFLOW;
+		start = ((mNow >> RANGE_BITS) + 1) << RANGE_BITS;
+		return TRUE;
+	}
+	return FALSE;
+}
+
+// static
+U64 LLTimerWheel::earliestTick(const Link& head)
+{
+	U64 tick = static_cast<const Entry*>(head.mNext)->mTick;
+	for (const Link* link = head.mNext->mNext; link != &head; link = link->mNext)
+	{
+		tick = llmin(tick, static_cast<const Entry*>(link)->mTick);
+	}
+	return tick;
+}
+
+// static
+U32 LLTimerWheel::firstSetBit(U64 bits)
+{
+	U32 word = (U32)bits;
+	U32 base = 0;
+	if (!word)
+	{
+		word = (U32)(bits >> 32);
+		base = 32;
+	}
+#if LL_MSVC
+	unsigned long index;
+	_BitScanForward(&index, word);
+	return base + (U32)index;
+#else
+	return base + (U32)__builtin_ctz(word);
+#endif
+}
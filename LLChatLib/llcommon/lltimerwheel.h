@@ -0,0 +1,142 @@
+/**
+ * @file lltimerwheel.h
+ * @brief Hierarchical timer wheel
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ *
+ * Copyright (c) 2009, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLTIMERWHEEL_H
+#define LL_LLTIMERWHEEL_H
+
+#include "stdtypes.h"
+
+// Timers kept in a hierarchical wheel.  Time is counted in ticks of a fixed
+// resolution; each level has 64 buckets, and a level's bucket spans a whole
+// turn of the level below.  A timer goes in the lowest level whose bucket
+// tells it apart from the current tick, so arming and cancelling are O(1),
+// and advancing the clock touches only the buckets that come due: their
+// timers either expire or drop down a level.  A bitmap of occupied buckets
+// per level lets advance() and getNextExpiry() skip empty ones.  Timers more
+// than 64^4 ticks out wait on an overflow list until the top level turns.
+//
+// Timers are intrusive: derive from LLTimerWheel::Entry.  Expired entries
+// are handed back one at a time, so the caller may arm, cancel or delete any
+// entry, including others that are due, while it works through them.
+//
+//	wheel.advance(totalTime());
+//	while (LLTimerWheel::Entry* entry = wheel.popExpired())
+//		static_cast<MyTimer*>(entry)->fire();
+//
+// Not thread safe.
+
+class LLTimerWheel
+{
+private:
+	struct Link
+	{
+		Link* mPrev;
+		Link* mNext;
+	};
+
+public:
+	class Entry : private Link
+	{
+	public:
+		Entry();
+		~Entry();	// Cancels the entry
+
+		bool isArmed() const	{ return mWheel != NULL; }
+
+	private:
+		friend class LLTimerWheel;
+
+		LLTimerWheel*	mWheel;
+		U64				mTick;		// When it expires
+		U32				mBucket;
+
+		// Forbidden
+		Entry(const Entry&);
+		Entry& operator=(const Entry&);
+	};
+
+	// now_usecs starts the clock, in the same units as totalTime().
+	explicit LLTimerWheel(U64 now_usecs, U64 resolution_usecs = 1000);
+	~LLTimerWheel();
+
+	// (Re)arms entry to expire at expiry_usecs, rounded up to the next tick.
+	// An entry armed for a time already passed expires on the next tick.
+	void	arm(Entry& entry, U64 expiry_usecs);
+	void	cancel(Entry& entry);
+
+	// Moves the clock forward and sets aside every entry that is now due.
+	void	advance(U64 now_usecs);
+
+	// The next entry set aside by advance(), or NULL.  It is no longer armed.
+	Entry*	popExpired();
+
+	// When the next entry comes due, in time that advance() will pick it up.
+	// FALSE if nothing is armed.
+	BOOL	getNextExpiry(U64& expiry_usecs) const;
+
+	S32		size() const		{ return mCount; }
+	bool	empty() const		{ return mCount == 0; }
+
+private:
+	enum
+	{
+		SLOT_BITS	= 6,
+		SLOTS		= 1 << SLOT_BITS,
+		SLOT_MASK	= SLOTS - 1,
+		LEVELS		= 4,
+		RANGE_BITS	= SLOT_BITS * LEVELS,
+
+		BUCKET_EXPIRED	= LEVELS * SLOTS,
+		BUCKET_OVERFLOW,
+		BUCKET_COUNT
+	};
+
+	void	place(Entry* entry);
+	void	unlink(Entry* entry);
+	void	link(Entry* entry, U32 bucket);
+	void	splice(U32 bucket, Link& list);
+	BOOL	findNextBucket(U32& bucket, U64& start) const;
+	static U64	earliestTick(const Link& head);
+	static U32	firstSetBit(U64 bits);
+
+	Link	mBuckets[BUCKET_COUNT];
+	U64		mOccupied[LEVELS];
+	U64		mNow;				// Current tick
+	U64		mResolution;		// Microseconds per tick
+	S32		mCount;
+
+	// Forbidden
+	LLTimerWheel(const LLTimerWheel&);
+	LLTimerWheel& operator=(const LLTimerWheel&);
+};
+
+#endif // LL_LLTIMERWHEEL_H
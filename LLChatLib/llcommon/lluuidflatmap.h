@@ -0,0 +1,225 @@
+/** 
+ * @file lluuidflatmap.h
+ * @brief Open-addressed hash map keyed by LLUUID.
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLUUIDFLATMAP_H
+#define LL_LLUUIDFLATMAP_H
+
+#include <utility>
+#include <vector>
+
+#include "stdtypes.h"
+#include "lluuid.h"
+
+// Values live contiguously in a vector; the table itself is an array of
+// 8 byte slots (hash, index) probed linearly, so a lookup usually costs
+// one cache line of slots plus the key compare.  UUIDs are random bytes,
+// so folding the four words together is all the hashing needed.
+//
+// find() never inserts, unlike std::map::operator[].  Pointers and
+// references to values are invalidated by any insert or erase.
+//
+//	LLUUIDFlatMap<Info> infos;
+//	infos.findOrInsert(id).mCount++;
+//	if (const Info* info = infos.find(id)) { ... }
+//	for (LLUUIDFlatMap<Info>::const_iterator it = infos.begin(); it != infos.end(); ++it)
+//		use(it->first, it->second);
+
+template <class DATA>
+class LLUUIDFlatMap
+{
+public:
+	typedef std::pair<LLUUID, DATA>						value_type;
+	typedef typename std::vector<value_type>::iterator			iterator;
+	typedef typename std::vector<value_type>::const_iterator	const_iterator;
+
+	LLUUIDFlatMap() : mMask(0) {}
+
+	DATA* find(const LLUUID& id)
+	{
+		S32 index = findIndex(id);
+		return index < 0 ? NULL : &mValues[index].second;
+	}
+
+	const DATA* find(const LLUUID& id) const
+	{
+		S32 index = findIndex(id);
+		return index < 0 ? NULL : &mValues[index].second;
+	}
+
+	// Returns the value for id, default constructing it if needed.
+	DATA& findOrInsert(const LLUUID& id)
+	{
+		S32 index = findIndex(id);
+		if (index >= 0)
+		{
+			return mValues[index].second;
+		}
+
+		// Keep the table at most half full.
+		if ((mValues.size() + 1) * 2 > mSlots.size())
+		{
+			rehash(mSlots.empty() ? MIN_SLOTS : (U32)mSlots.size() * 2);
+		}
+
+		U32 hash = hashOf(id);
+		U32 slot = hash & mMask;
+		while (mSlots[slot].mIndex)
+		{
+			slot = (slot + 1) & mMask;
+		}
+		mValues.push_back(value_type(id, DATA()));
+		mSlots[slot].mHash = hash;
+		mSlots[slot].mIndex = (U32)mValues.size();
+		return mValues.back().second;
+	}
+
+	// Returns true if id was present.
+	bool erase(const LLUUID& id)
+	{
+		if (mSlots.empty())
+		{
+			return false;
+		}
+		U32 slot = findSlot(id);
+		if (!mSlots[slot].mIndex)
+		{
+			return false;
+		}
+
+		// Move the last value into the hole and repoint its slot.
+		U32 index = mSlots[slot].mIndex - 1;
+		U32 last = (U32)mValues.size() - 1;
+		if (index != last)
+		{
+			U32 moved = findSlot(mValues[last].first);
+			mValues[index] = mValues[last];
+			mSlots[moved].mIndex = index + 1;
+		}
+		mValues.pop_back();
+
+		// Backward-shift the rest of the probe run over the freed slot
+		// so no tombstones are needed.
+		U32 hole = slot;
+		for (U32 next = (hole + 1) & mMask; mSlots[next].mIndex; next = (next + 1) & mMask)
+		{
+			U32 home = mSlots[next].mHash & mMask;
+			if (((next - home) & mMask) >= ((next - hole) & mMask))
+			{
+				mSlots[hole] = mSlots[next];
+				hole = next;
+			}
+		}
+		mSlots[hole].mHash = 0;
+		mSlots[hole].mIndex = 0;
+		return true;
+	}
+
+	void clear()
+	{
+		mValues.clear();
+		mSlots.clear();
+		mMask = 0;
+	}
+
+	S32 size() const				{ return (S32)mValues.size(); }
+	bool empty() const				{ return mValues.empty(); }
+
+	iterator begin()				{ return mValues.begin(); }
+	iterator end()					{ return mValues.end(); }
+	const_iterator begin() const	{ return mValues.begin(); }
+	const_iterator end() const		{ return mValues.end(); }
+
+private:
+	enum { MIN_SLOTS = 16 };
+
+	struct Slot
+	{
+		U32 mHash;
+		U32 mIndex;		// 1-based index into mValues; 0 is empty
+
+		Slot() : mHash(0), mIndex(0) {}
+	};
+
+	static U32 hashOf(const LLUUID& id)
+	{
+		return id.getCRC32();
+	}
+
+	// Slot holding id, or the empty slot that ends its probe run.
+	U32 findSlot(const LLUUID& id) const
+	{
+		U32 hash = hashOf(id);
+		U32 slot = hash & mMask;
+		while (mSlots[slot].mIndex)
+		{
+			if (mSlots[slot].mHash == hash
+				&& mValues[mSlots[slot].mIndex - 1].first == id)
+			{
+				break;
+			}
+			slot = (slot + 1) & mMask;
+		}
+		return slot;
+	}
+
+	S32 findIndex(const LLUUID& id) const
+	{
+		if (mSlots.empty())
+		{
+			return -1;
+		}
+		return (S32)mSlots[findSlot(id)].mIndex - 1;
+	}
+
+	void rehash(U32 slot_count)
+	{
+		mSlots.assign(slot_count, Slot());
+		mMask = slot_count - 1;
+		for (U32 i = 0; i < (U32)mValues.size(); ++i)
+		{
+			U32 hash = hashOf(mValues[i].first);
+			U32 slot = hash & mMask;
+			while (mSlots[slot].mIndex)
+			{
+				slot = (slot + 1) & mMask;
+			}
+			mSlots[slot].mHash = hash;
+			mSlots[slot].mIndex = i + 1;
+		}
+	}
+
+	std::vector<value_type>	mValues;
+	std::vector<Slot>		mSlots;
+	U32						mMask;
+};
+
+#endif // LL_LLUUIDFLATMAP_H
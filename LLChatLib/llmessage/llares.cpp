@@ -545,6 +545,37 @@ bail:
 	return nsds > 0;
 }
 
+S32 LLAres::getWaitFds(std::vector<S32>& read_fds, std::vector<S32>& write_fds)
+{
+	int socks[ARES_GETSOCK_MAXNUM];
+	int bitmask = ares_getsock(chan_, socks, ARES_GETSOCK_MAXNUM);
+
+	if (bitmask == 0)
+	{
+		return -1;
+	}
+
+	for (int i = 0; i < ARES_GETSOCK_MAXNUM; i++)
+	{
+		if (ARES_GETSOCK_READABLE(bitmask, i))
+		{
+			read_fds.push_back(socks[i]);
+		}
+		if (ARES_GETSOCK_WRITABLE(bitmask, i))
+		{
+			write_fds.push_back(socks[i]);
+		}
+	}
+
+	timeval tv;
+	if (ares_timeout(chan_, NULL, &tv) == NULL)
+	{
+		return -1;
+	}
+
+	return (S32)(tv.tv_sec * 1000 + (tv.tv_usec + 999) / 1000);
+}
+
 bool LLAres::processAll()
 {
 	bool anyProcessed = false, ret;
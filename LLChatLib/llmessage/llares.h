@@ -414,6 +414,17 @@ public:
 	 * @return whether any responses were processed
 	 */
 	bool processAll();
+
+	/**
+	 * Collect the sockets the resolver is currently waiting on, so that
+	 * an external event loop can sleep until one of them is ready.
+	 *
+	 * @param read_fds sockets to watch for readability (appended)
+	 * @param write_fds sockets to watch for writability (appended)
+	 * @return milliseconds until the next query timeout, or -1 if no
+	 * query is outstanding
+	 */
+	S32 getWaitFds(std::vector<S32>& read_fds, std::vector<S32>& write_fds);
 	
 	/**
 	 * Expand a DNS-encoded compressed string into a normal string.
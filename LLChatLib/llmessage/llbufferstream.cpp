@@ -37,6 +37,7 @@
 
 #include "llbuffer.h"
 #include "llmemtype.h"
+#include "llsdserialize.h"
 
 static const S32 DEFAULT_OUTPUT_SEGMENT_SIZE = 1024 * 4;
 
@@ -348,3 +349,27 @@ LLBufferStream::~LLBufferStream()
 {
 	LLMemType m1(LLMemType::MTYPE_IO_BUFFER);
 }
+
+
+S32 ll_sd_from_xml_buffer(
+	LLSD& sd,
+	const LLChannelDescriptors& channels,
+	LLBufferArray* buffer)
+{
+	LLMemType m1(LLMemType::MTYPE_IO_BUFFER);
+	LLPointer<LLSDXMLParser> parser = new LLSDXMLParser;
+	LLBufferArray::segment_iterator_t it = buffer->beginSegment();
+	LLBufferArray::segment_iterator_t end = buffer->endSegment();
+	for( ; it != end; ++it)
+	{
+		if(!(*it).isOnChannel(channels.in()))
+		{
+			continue;
+		}
+		if(!parser->parseChunk((const char*)(*it).data(), (*it).size()))
+		{
+			break;
+		}
+	}
+	return parser->finishParse(sd);
+}
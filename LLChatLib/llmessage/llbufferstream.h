@@ -155,4 +155,23 @@ protected:
 };
 
 
+class LLSD;
+
+/** 
+ * @brief Parse LLSD XML straight out of the buffer segments on the
+ * in() channel.
+ *
+ * Prefer this to LLSDSerialize::fromXML() on an LLBufferStream for
+ * responses: each segment goes to the parser as it is, where the
+ * stream hands it over a character at a time.
+ * @param sd[out] The parsed structured data.
+ * @return Returns the number of LLSD objects parsed into sd, or
+ * LLSDParser::PARSE_FAILURE (-1) on failure.
+ */
+S32 ll_sd_from_xml_buffer(
+	LLSD& sd,
+	const LLChannelDescriptors& channels,
+	LLBufferArray* buffer);
+
+
 #endif // LL_LLBUFFERSTREAM_H
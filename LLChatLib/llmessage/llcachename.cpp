@@ -38,10 +38,13 @@
 #include "lldbstrings.h"
 #include "llframetimer.h"
 #include "llhost.h"
+#include "llnamecachefile.h"
 #include "llrand.h"
 #include "llsdserialize.h"
 #include "lluuid.h"
+#include "lluuidflatmap.h"
 #include "message.h"
+#include "net.h"
 
 // Constants
 static const std::string CN_WAITING("(Loading...)"); // *TODO: translate
@@ -56,13 +59,29 @@ static const std::string FIRST("first");
 static const std::string LAST("last");
 static const std::string NAME("name");
 
-// We track name requests in flight for up to this long.
-// We won't re-request a name during this time
-const U32 PENDING_TIMEOUT_SECS = 5 * 60;
+// Requests are held back this long for more IDs to share the packet,
+// unless there are already enough to fill one.
+const F64 REQUEST_COALESCE_SECS = 0.25;
+const S32 REQUEST_IDS_PER_PACKET = (MTUBYTES - 32) / UUID_BYTES;
+
+// An unanswered request is sent again after this long, doubling each
+// time.  After the last attempt the ID goes in the negative cache and
+// is not asked about again until that expires.
+const F64 REQUEST_RETRY_SECS = 5.0;
+const S32 REQUEST_MAX_ATTEMPTS = 4;
+const U32 NEGATIVE_CACHE_SECS = 10 * 60;
+
+// How often in-flight requests are checked for retries.
+const F32 SECS_BETWEEN_RETRY_SCAN = 1.0f;
 
 // File version number
 const S32 CN_FILE_VERSION = 2;
 
+// Names served from the cache file are re-requested in the background
+// once they are older than this, and ignored altogether past the expiry.
+const U32 CACHE_FILE_REFRESH_SECS = 24 * 60 * 60;
+const U32 CACHE_FILE_EXPIRE_SECS = 30 * 24 * 60 * 60;
+
 // Globals
 //LLCacheName* gCacheName = NULL;
 
@@ -84,10 +103,23 @@ public:
 };
 
 LLCacheNameEntry::LLCacheNameEntry()
+	: mIsGroup(false), mCreateTime(0)
 {
 }
 
 
+// A name we have asked upstream about, or are about to.
+class PendingRequest
+{
+public:
+	PendingRequest() : mRetryTime(0.0), mAttempts(0), mIsGroup(false) {}
+
+	F64		mRetryTime;		// 0 while waiting in an ask queue
+	S32		mAttempts;
+	bool	mIsGroup;
+};
+
+
 class PendingReply
 {
 public:
@@ -186,10 +218,11 @@ void ReplySender::flush()
 }
 
 
-typedef std::set<LLUUID>					AskQueue;
+typedef std::vector<LLUUID>					AskQueue;
 typedef std::vector<PendingReply>			ReplyQueue;
-typedef std::map<LLUUID,U32>				PendingQueue;
-typedef std::map<LLUUID, LLCacheNameEntry*> Cache;
+typedef LLUUIDFlatMap<PendingRequest>		PendingQueue;
+typedef LLUUIDFlatMap<U32>					NegativeCache;	// expiry, unix time
+typedef LLUUIDFlatMap<LLCacheNameEntry>		Cache;
 typedef std::vector<LLCacheNameCallback>	Observers;
 
 class LLCacheName::Impl
@@ -204,24 +237,44 @@ public:
 	AskQueue			mAskNameQueue;
 	AskQueue			mAskGroupQueue;
 		// UUIDs to ask our upstream host about
-	
+	F64					mAskSince;
+		// when the first of them was queued
+
 	PendingQueue		mPendingQueue;
-		// UUIDs that have been requested but are not in cache yet.
+		// UUIDs that are queued or in flight; each is asked about once
+
+	NegativeCache		mNegativeCache;
+		// UUIDs upstream never answered for
 
 	ReplyQueue			mReplyQueue;
 		// requests awaiting replies from us
+	bool				mRepliesReady;
+		// an entry arrived that something in mReplyQueue may want
 
 	Observers			mObservers;
 
 	LLFrameTimer		mProcessTimer;
+	LLFrameTimer		mRetryTimer;
+
+	LLCacheName::Stats	mStats;
+
+	LLNameCacheFile		mCacheFile;
+	std::vector<LLUUID>	mFileHits;
+		// names promoted from the cache file, for observers
+
 
 	Impl(LLMessageSystem* msg);
 	~Impl();
 
 	void processPendingAsks();
 	void processPendingReplies();
+	void processRetries();
 	void sendRequest(const char* msg_name, const AskQueue& queue);
-	bool isRequestPending(const LLUUID& id);
+	bool requestName(const LLUUID& id, bool is_group);
+	bool isNegative(const LLUUID& id);
+	LLCacheNameEntry* lookup(const LLUUID& id);
+	LLCacheNameEntry* findEntry(const LLUUID& id);
+	void notifyFileHits();
 
 	// Message system callbacks.
 	void processUUIDRequest(LLMessageSystem* msg, bool isGroup);
@@ -241,6 +294,7 @@ public:
 /// ---------------------------------------------------------------------------
 
 LLCacheName* LLCacheName::mInstance = NULL;
+std::string LLCacheName::sCacheFileName;
 
 LLCacheName* LLCacheName::getInstance()
 {
@@ -278,7 +332,7 @@ LLCacheName::~LLCacheName()
 }
 
 LLCacheName::Impl::Impl(LLMessageSystem* msg)
-	: mMsg(msg), mUpstreamHost(LLHost::invalid)
+	: mMsg(msg), mUpstreamHost(LLHost::invalid), mAskSince(0.0), mRepliesReady(false)
 {
 	mMsg->setHandlerFuncFast(
 		_PREHASH_UUIDNameRequest, handleUUIDNameRequest, (void**)this);
@@ -288,15 +342,25 @@ LLCacheName::Impl::Impl(LLMessageSystem* msg)
 		_PREHASH_UUIDGroupNameRequest, handleUUIDGroupNameRequest, (void**)this);
 	mMsg->setHandlerFuncFast(
 		_PREHASH_UUIDGroupNameReply, handleUUIDGroupNameReply, (void**)this);
+
+	if (!sCacheFileName.empty())
+	{
+		mCacheFile.open(sCacheFileName);
+	}
 }
 
 
 LLCacheName::Impl::~Impl()
 {
-	for_each(mCache.begin(), mCache.end(), DeletePairedPointer());
 }
 
 
+//static
+void LLCacheName::setCacheFile(const std::string& filename)
+{
+	sCacheFileName = filename;
+}
+
 void LLCacheName::setUpstream(const LLHost& upstream_host)
 {
 	impl.mUpstreamHost = upstream_host;
@@ -406,12 +470,11 @@ void LLCacheName::importFile(LLFILE* fp)
 		// Don't load entries that are more than a week old
 		if (create_time < delete_before_time) continue;
 
-		LLCacheNameEntry* entry = new LLCacheNameEntry();
-		entry->mIsGroup = false;
-		entry->mCreateTime = create_time;
-		entry->mFirstName = firstname;
-		entry->mLastName = lastname;
-		impl.mCache[id] = entry;
+		LLCacheNameEntry& entry = impl.mCache.findOrInsert(id);
+		entry.mIsGroup = false;
+		entry.mCreateTime = create_time;
+		entry.mFirstName = firstname;
+		entry.mLastName = lastname;
 
 		count++;
 	}
@@ -442,12 +505,11 @@ bool LLCacheName::importFile(std::istream& istr)
 		U32 ctime = (U32)agent[CTIME].asInteger();
 		if(ctime < delete_before_time) continue;
 
-		LLCacheNameEntry* entry = new LLCacheNameEntry();
-		entry->mIsGroup = false;
-		entry->mCreateTime = ctime;
-		entry->mFirstName = agent[FIRST].asString();
-		entry->mLastName = agent[LAST].asString();
-		impl.mCache[id] = entry;
+		LLCacheNameEntry& entry = impl.mCache.findOrInsert(id);
+		entry.mIsGroup = false;
+		entry.mCreateTime = ctime;
+		entry.mFirstName = agent[FIRST].asString();
+		entry.mLastName = agent[LAST].asString();
 		++count;
 	}
 	llinfos << "LLCacheName loaded " << count << " agent names" << llendl;
@@ -463,11 +525,10 @@ bool LLCacheName::importFile(std::istream& istr)
 		U32 ctime = (U32)group[CTIME].asInteger();
 		if(ctime < delete_before_time) continue;
 
-		LLCacheNameEntry* entry = new LLCacheNameEntry();
-		entry->mIsGroup = true;
-		entry->mCreateTime = ctime;
-		entry->mGroupName = group[NAME].asString();
-		impl.mCache[id] = entry;
+		LLCacheNameEntry& entry = impl.mCache.findOrInsert(id);
+		entry.mIsGroup = true;
+		entry.mCreateTime = ctime;
+		entry.mGroupName = group[NAME].asString();
 		++count;
 	}
 	llinfos << "LLCacheName loaded " << count << " group names" << llendl;
@@ -482,10 +543,9 @@ void LLCacheName::exportFile(std::ostream& ostr)
 	for( ; iter != end; ++iter)
 	{
 		// Only write entries for which we have valid data.
-		LLCacheNameEntry* entry = iter->second;
-		if(!entry
-		   || (std::string::npos != entry->mFirstName.find('?'))
-		   || (std::string::npos != entry->mGroupName.find('?')))
+		const LLCacheNameEntry& entry = iter->second;
+		if((std::string::npos != entry.mFirstName.find('?'))
+		   || (std::string::npos != entry.mGroupName.find('?')))
 		{
 			continue;
 		}
@@ -493,16 +553,16 @@ void LLCacheName::exportFile(std::ostream& ostr)
 		// store it
 		LLUUID id = iter->first;
 		std::string id_str = id.asString();
-		if(!entry->mFirstName.empty() && !entry->mLastName.empty())
+		if(!entry.mFirstName.empty() && !entry.mLastName.empty())
 		{
-			data[AGENTS][id_str][FIRST] = entry->mFirstName;
-			data[AGENTS][id_str][LAST] = entry->mLastName;
-			data[AGENTS][id_str][CTIME] = (S32)entry->mCreateTime;
+			data[AGENTS][id_str][FIRST] = entry.mFirstName;
+			data[AGENTS][id_str][LAST] = entry.mLastName;
+			data[AGENTS][id_str][CTIME] = (S32)entry.mCreateTime;
 		}
-		else if(entry->mIsGroup && !entry->mGroupName.empty())
+		else if(entry.mIsGroup && !entry.mGroupName.empty())
 		{
-			data[GROUPS][id_str][NAME] = entry->mGroupName;
-			data[GROUPS][id_str][CTIME] = (S32)entry->mCreateTime;
+			data[GROUPS][id_str][NAME] = entry.mGroupName;
+			data[GROUPS][id_str][CTIME] = (S32)entry.mCreateTime;
 		}
 	}
 
@@ -519,7 +579,7 @@ BOOL LLCacheName::getName(const LLUUID& id, std::string& first, std::string& las
 		return FALSE;
 	}
 
-	LLCacheNameEntry* entry = get_ptr_in_map(impl.mCache, id );
+	LLCacheNameEntry* entry = impl.lookup(id);
 	if (entry)
 	{
 		first = entry->mFirstName;
@@ -530,10 +590,7 @@ BOOL LLCacheName::getName(const LLUUID& id, std::string& first, std::string& las
 	{
 		first = CN_WAITING;
 		last.clear();
-		if (!impl.isRequestPending(id))
-		{
-			impl.mAskNameQueue.insert(id);
-		}	
+		impl.requestName(id, false);
 		return FALSE;
 	}
 
@@ -555,7 +612,7 @@ BOOL LLCacheName::getGroupName(const LLUUID& id, std::string& group)
 		return FALSE;
 	}
 
-	LLCacheNameEntry* entry = get_ptr_in_map(impl.mCache,id);
+	LLCacheNameEntry* entry = impl.lookup(id);
 	if (entry && entry->mGroupName.empty())
 	{
 		// COUNTER-HACK to combat James' HACK in exportFile()...
@@ -573,10 +630,7 @@ BOOL LLCacheName::getGroupName(const LLUUID& id, std::string& group)
 	else 
 	{
 		group = CN_WAITING;
-		if (!impl.isRequestPending(id))
-		{
-			impl.mAskGroupQueue.insert(id);
-		}
+		impl.requestName(id, true);
 		return FALSE;
 	}
 }
@@ -590,33 +644,25 @@ void LLCacheName::get(const LLUUID& id, BOOL is_group, LLCacheNameCallback callb
 		callback(id, CN_NOBODY, "", is_group, user_data);
 	}
 
-	LLCacheNameEntry* entry = get_ptr_in_map(impl.mCache, id );
+	LLCacheNameEntry* entry = impl.lookup(id);
 	if (entry)
 	{
 		// id found in map therefore we can call the callback immediately.
-		if (entry->mIsGroup)
+		// The callback may add to the cache, which moves entries, so
+		// hand it a copy.
+		LLCacheNameEntry found = *entry;
+		if (found.mIsGroup)
 		{
-			callback(id, entry->mGroupName, "", entry->mIsGroup, user_data);
+			callback(id, found.mGroupName, "", found.mIsGroup, user_data);
 		}
 		else
 		{
-			callback(id, entry->mFirstName, entry->mLastName, entry->mIsGroup, user_data);
+			callback(id, found.mFirstName, found.mLastName, found.mIsGroup, user_data);
 		}
 	}
-	else
+	else if (impl.requestName(id, is_group))
 	{
 		// id not found in map so we must queue the callback call until available.
-		if (!impl.isRequestPending(id))
-		{
-			if (is_group)
-			{
-				impl.mAskGroupQueue.insert(id);
-			}
-			else
-			{
-				impl.mAskNameQueue.insert(id);
-			}
-		}
 		impl.mReplyQueue.push_back(PendingReply(id, callback, user_data));
 	}
 }
@@ -629,6 +675,9 @@ void LLCacheName::processPending()
 		return;
 	}
 
+	// Names served from the cache file need no upstream host.
+	impl.notifyFileHits();
+
 	if(!impl.mUpstreamHost.isOk())
 	{
 		lldebugs << "LLCacheName::processPending() - bad upstream host."
@@ -636,61 +685,75 @@ void LLCacheName::processPending()
 		return;
 	}
 
+	if(impl.mRetryTimer.checkExpirationAndReset(SECS_BETWEEN_RETRY_SCAN))
+	{
+		impl.processRetries();
+	}
 	impl.processPendingAsks();
-	impl.processPendingReplies();
+	if(impl.mRepliesReady)
+	{
+		impl.processPendingReplies();
+	}
 }
 
 void LLCacheName::deleteEntriesOlderThan(S32 secs)
 {
 	U32 now = (U32)time(NULL);
 	U32 expire_time = now - secs;
-	for(Cache::iterator iter = impl.mCache.begin(); iter != impl.mCache.end(); )
+
+	// Erasing from a flat map moves entries around, so collect first.
+	// The two are kept apart: an ID can be in both, when a refresh of a
+	// stale entry from the file cache gives up, and each copy expires on
+	// its own.
+	std::vector<LLUUID> expired;
+	for(Cache::const_iterator iter = impl.mCache.begin(); iter != impl.mCache.end(); ++iter)
 	{
-		Cache::iterator curiter = iter++;
-		LLCacheNameEntry* entry = curiter->second;
-		if (entry->mCreateTime < expire_time)
+		if (iter->second.mCreateTime < expire_time)
 		{
-			delete entry;
-			impl.mCache.erase(curiter);
+			expired.push_back(iter->first);
 		}
 	}
-
-	// These are pending requests that we never heard back from.
-	U32 pending_expire_time = now - PENDING_TIMEOUT_SECS;
-	for(PendingQueue::iterator p_iter = impl.mPendingQueue.begin();
-		p_iter != impl.mPendingQueue.end(); )
+	std::vector<LLUUID> expired_negative;
+	for(NegativeCache::const_iterator n_iter = impl.mNegativeCache.begin();
+		n_iter != impl.mNegativeCache.end(); ++n_iter)
 	{
-		PendingQueue::iterator p_curitor = p_iter++;
- 
-		if (p_curitor->second < pending_expire_time)
+		if (n_iter->second < now)
 		{
-			impl.mPendingQueue.erase(p_curitor);
+			expired_negative.push_back(n_iter->first);
 		}
 	}
+	for(std::vector<LLUUID>::const_iterator it = expired.begin(); it != expired.end(); ++it)
+	{
+		impl.mCache.erase(*it);
+	}
+	for(std::vector<LLUUID>::const_iterator it = expired_negative.begin(); it != expired_negative.end(); ++it)
+	{
+		impl.mNegativeCache.erase(*it);
+	}
 }
 
 
 void LLCacheName::dump()
 {
-	for (Cache::iterator iter = impl.mCache.begin(),
+	for (Cache::const_iterator iter = impl.mCache.begin(),
 			 end = impl.mCache.end();
 		 iter != end; iter++)
 	{
-		LLCacheNameEntry* entry = iter->second;
-		if (entry->mIsGroup)
+		const LLCacheNameEntry& entry = iter->second;
+		if (entry.mIsGroup)
 		{
 			llinfos
 				<< iter->first << " = (group) "
-				<< entry->mGroupName
-				<< " @ " << entry->mCreateTime
+				<< entry.mGroupName
+				<< " @ " << entry.mCreateTime
 				<< llendl;
 		}
 		else
 		{
 			llinfos
 				<< iter->first << " = "
-				<< entry->mFirstName << " " << entry->mLastName
-				<< " @ " << entry->mCreateTime
+				<< entry.mFirstName << " " << entry.mLastName
+				<< " @ " << entry.mCreateTime
 				<< llendl;
 		}
 	}
@@ -698,14 +761,56 @@ void LLCacheName::dump()
 
 void LLCacheName::dumpStats()
 {
-	llinfos << "Queue sizes: "
-			<< " Cache=" << impl.mCache.size()
-			<< " AskName=" << impl.mAskNameQueue.size()
-			<< " AskGroup=" << impl.mAskGroupQueue.size()
-			<< " Pending=" << impl.mPendingQueue.size()
-			<< " Reply=" << impl.mReplyQueue.size()
-			<< " Observers=" << impl.mObservers.size()
-			<< llendl;
+	llinfos << "LLCacheName stats: " << LLSDNotationStreamer(getStatsLLSD()) << llendl;
+}
+
+LLCacheName::Stats LLCacheName::getStats() const
+{
+	Stats stats = impl.mStats;
+	stats.mCached = impl.mCache.size();
+	// The ask queues are not pruned when a reply beats the request out, so
+	// count from the pending requests themselves
+	stats.mQueued = 0;
+	stats.mInFlight = 0;
+	for (PendingQueue::const_iterator it = impl.mPendingQueue.begin(); it != impl.mPendingQueue.end(); ++it)
+	{
+		if (it->second.mRetryTime != 0.0)
+		{
+			++stats.mInFlight;
+		}
+		else
+		{
+			++stats.mQueued;
+		}
+	}
+	stats.mNegative = impl.mNegativeCache.size();
+	stats.mReplyQueue = (S32)impl.mReplyQueue.size();
+	return stats;
+}
+
+LLSD LLCacheName::getStatsLLSD() const
+{
+	Stats stats = getStats();
+
+	LLSD sd;
+	sd["lookups"]			= (S32)stats.mLookups;
+	sd["hits"]				= (S32)stats.mHits;
+	sd["negative_hits"]		= (S32)stats.mNegativeHits;
+	sd["hit_rate"]			= stats.mLookups ? (F64)stats.mHits / (F64)stats.mLookups : 0.0;
+	sd["ids_requested"]		= (S32)stats.mIDsRequested;
+	sd["retries"]			= (S32)stats.mRetries;
+	sd["given_up"]			= (S32)stats.mGivenUp;
+	sd["replies"]			= (S32)stats.mReplies;
+	sd["packets_sent"]		= (S32)stats.mPacketsSent;
+	sd["bytes_sent"]		= (S32)stats.mBytesSent;
+	sd["cached"]			= stats.mCached;
+	sd["queued"]			= stats.mQueued;
+	sd["in_flight"]			= stats.mInFlight;
+	sd["negative"]			= stats.mNegative;
+	sd["reply_queue"]		= stats.mReplyQueue;
+	sd["file_count"]		= (S32)impl.mCacheFile.getCount();
+	sd["file_capacity"]		= (S32)impl.mCacheFile.getCapacity();
+	return sd;
 }
 
 //static 
@@ -716,44 +821,122 @@ std::string LLCacheName::getDefaultName()
 
 void LLCacheName::Impl::processPendingAsks()
 {
+	if (mAskNameQueue.empty() && mAskGroupQueue.empty())
+	{
+		return;
+	}
+
+	// Hold on to a trickle of asks for a moment so a burst of new
+	// speakers goes out in a few full packets rather than many small ones.
+	if ((S32)mAskNameQueue.size() < REQUEST_IDS_PER_PACKET
+		&& (S32)mAskGroupQueue.size() < REQUEST_IDS_PER_PACKET
+		&& LLFrameTimer::getTotalSeconds() - mAskSince < REQUEST_COALESCE_SECS)
+	{
+		return;
+	}
+
 	sendRequest(_PREHASH_UUIDNameRequest, mAskNameQueue);
 	sendRequest(_PREHASH_UUIDGroupNameRequest, mAskGroupQueue);
 	mAskNameQueue.clear();
 	mAskGroupQueue.clear();
 }
 
+void LLCacheName::Impl::processRetries()
+{
+	const F64 now = LLFrameTimer::getTotalSeconds();
+
+	std::vector<LLUUID> given_up;
+	for (PendingQueue::iterator it = mPendingQueue.begin(); it != mPendingQueue.end(); ++it)
+	{
+		PendingRequest& request = it->second;
+		if (request.mRetryTime == 0.0 || request.mRetryTime > now)
+		{
+			// Still queued, or not yet due
+			continue;
+		}
+
+		if (request.mAttempts >= REQUEST_MAX_ATTEMPTS)
+		{
+			given_up.push_back(it->first);
+			continue;
+		}
+
+		AskQueue& queue = request.mIsGroup ? mAskGroupQueue : mAskNameQueue;
+		if (mAskNameQueue.empty() && mAskGroupQueue.empty())
+		{
+			mAskSince = now;
+		}
+		queue.push_back(it->first);
+		request.mRetryTime = 0.0;
+		mStats.mRetries++;
+	}
+
+	if (given_up.empty())
+	{
+		return;
+	}
+
+	const U32 expires = (U32)time(NULL) + NEGATIVE_CACHE_SECS;
+	for (std::vector<LLUUID>::const_iterator it = given_up.begin(); it != given_up.end(); ++it)
+	{
+		mPendingQueue.erase(*it);
+		mNegativeCache.findOrInsert(*it) = expires;
+		mStats.mGivenUp++;
+	}
+
+	// Nobody is going to answer these, so stop holding callbacks for them.
+	for (ReplyQueue::iterator it = mReplyQueue.begin(); it != mReplyQueue.end(); ++it)
+	{
+		if (mNegativeCache.find(it->mID))
+		{
+			it->done();
+		}
+	}
+	mReplyQueue.erase(
+		remove_if(mReplyQueue.begin(), mReplyQueue.end(),
+			std::mem_fun_ref(&PendingReply::isDone)),
+		mReplyQueue.end());
+}
+
 void LLCacheName::Impl::processPendingReplies()
 {
-	ReplyQueue::iterator it = mReplyQueue.begin();
-	ReplyQueue::iterator end = mReplyQueue.end();
-	
+	mRepliesReady = false;
+
+	// Callbacks may queue more replies, so only walk the ones there now.
+	const size_t count = mReplyQueue.size();
+
 	// First call all the callbacks, because they might send messages.
-	for(; it != end; ++it)
+	for(size_t i = 0; i < count; ++i)
 	{
-		LLCacheNameEntry* entry = get_ptr_in_map(mCache, it->mID);
+		const PendingReply reply = mReplyQueue[i];
+		LLCacheNameEntry* entry = mCache.find(reply.mID);
 		if(!entry) continue;
 
-		if (it->mCallback)
+		if (reply.mCallback)
 		{
-			if (!entry->mIsGroup)
+			// A callback may add to the cache, which moves entries.
+			const LLCacheNameEntry found = *entry;
+			if (!found.mIsGroup)
 			{
-				(it->mCallback)(it->mID,
-					entry->mFirstName, entry->mLastName,
-					FALSE, it->mData);
+				(reply.mCallback)(reply.mID,
+					found.mFirstName, found.mLastName,
+					FALSE, reply.mData);
 			}
 			else {
-				(it->mCallback)(it->mID,
-					entry->mGroupName, "",
-					TRUE, it->mData);
+				(reply.mCallback)(reply.mID,
+					found.mGroupName, "",
+					TRUE, reply.mData);
 			}
 		}
 	}
 
 	// Forward on all replies, if needed.
 	ReplySender sender(mMsg);
-	for (it = mReplyQueue.begin(); it != end; ++it)
+	ReplyQueue::iterator it = mReplyQueue.begin();
+	ReplyQueue::iterator end = mReplyQueue.begin() + count;
+	for (; it != end; ++it)
 	{
-		LLCacheNameEntry* entry = get_ptr_in_map(mCache, it->mID);
+		LLCacheNameEntry* entry = mCache.find(it->mID);
 		if(!entry) continue;
 
 		if (it->mHost.isOk())
@@ -780,11 +963,22 @@ void LLCacheName::Impl::sendRequest(
 		return;		
 	}
 
+	const F64 now = LLFrameTimer::getTotalSeconds();
+
 	bool start_new_message = true;
 	AskQueue::const_iterator it = queue.begin();
 	AskQueue::const_iterator end = queue.end();
 	for(; it != end; ++it)
 	{
+		PendingRequest* request = mPendingQueue.find(*it);
+		if(!request || request->mRetryTime != 0.0)
+		{
+			// Answered or given up on since it was queued
+			continue;
+		}
+		request->mAttempts++;
+		request->mRetryTime = now + REQUEST_RETRY_SECS * (F64)(1 << (request->mAttempts - 1));
+
 		if(start_new_message)
 		{
 			start_new_message = false;
@@ -792,16 +986,19 @@ void LLCacheName::Impl::sendRequest(
 		}
 		mMsg->nextBlockFast(_PREHASH_UUIDNameBlock);
 		mMsg->addUUIDFast(_PREHASH_ID, (*it));
+		mStats.mIDsRequested++;
 
 		if(mMsg->isSendFullFast(_PREHASH_UUIDNameBlock))
 		{
 			start_new_message = true;
-			mMsg->sendReliable(mUpstreamHost);
+			mStats.mBytesSent += mMsg->sendReliable(mUpstreamHost);
+			mStats.mPacketsSent++;
 		}
 	}
 	if(!start_new_message)
 	{
-		mMsg->sendReliable(mUpstreamHost);
+		mStats.mBytesSent += mMsg->sendReliable(mUpstreamHost);
+		mStats.mPacketsSent++;
 	}
 }
 
@@ -817,20 +1014,134 @@ void LLCacheName::Impl::notifyObservers(const LLUUID& id,
 	}
 }
 
-bool LLCacheName::Impl::isRequestPending(const LLUUID& id)
+LLCacheNameEntry* LLCacheName::Impl::lookup(const LLUUID& id)
 {
+	mStats.mLookups++;
+	LLCacheNameEntry* entry = findEntry(id);
+	if (entry)
+	{
+		mStats.mHits++;
+	}
+	else if (isNegative(id))
+	{
+		mStats.mNegativeHits++;
+	}
+	return entry;
+}
+
+LLCacheNameEntry* LLCacheName::Impl::findEntry(const LLUUID& id)
+{
+	LLCacheNameEntry* entry = mCache.find(id);
+	if (entry)
+	{
+		return entry;
+	}
+
+	const LLNameCacheFile::Record* record = mCacheFile.find(id);
+	if (!record)
+	{
+		return NULL;
+	}
+
 	U32 now = (U32)time(NULL);
-	U32 expire_time = now - PENDING_TIMEOUT_SECS;
+	U32 age = now - record->mCreateTime;
+	if (record->mCreateTime > now || age > CACHE_FILE_EXPIRE_SECS)
+	{
+		return NULL;
+	}
+
+	// Promote the record to the in-memory cache; later lookups and the
+	// reply queue only ever see mCache.
+	entry = &mCache.findOrInsert(id);
+	entry->mIsGroup = record->mIsGroup != 0;
+	entry->mCreateTime = record->mCreateTime;
+	if (entry->mIsGroup)
+	{
+		entry->mGroupName = record->getGroupName();
+	}
+	else
+	{
+		entry->mFirstName = record->getFirstName();
+		entry->mLastName = record->getLastName();
+	}
+	mFileHits.push_back(id);
+	mRepliesReady = true;
 
-	PendingQueue::iterator iter = mPendingQueue.find(id);
+	if (age > CACHE_FILE_REFRESH_SECS)
+	{
+		requestName(id, entry->mIsGroup);
+	}
+	return entry;
+}
+
+void LLCacheName::Impl::notifyFileHits()
+{
+	// Observers may look up more names, so work on a copy.
+	std::vector<LLUUID> hits;
+	hits.swap(mFileHits);
+	for (std::vector<LLUUID>::const_iterator it = hits.begin();
+		 it != hits.end(); ++it)
+	{
+		LLCacheNameEntry* entry = mCache.find(*it);
+		if (!entry)
+		{
+			continue;
+		}
+		const LLCacheNameEntry found = *entry;
+		if (!found.mIsGroup)
+		{
+			notifyObservers(*it, found.mFirstName, found.mLastName, FALSE);
+		}
+		else
+		{
+			notifyObservers(*it, found.mGroupName, "", TRUE);
+		}
+	}
+}
 
-	if (iter == mPendingQueue.end()
-		|| (iter->second < expire_time) )
+// Queue id for the next request unless it is already queued or in
+// flight.  Returns false if upstream is known not to have it.
+bool LLCacheName::Impl::requestName(const LLUUID& id, bool is_group)
+{
+	if (isNegative(id))
 	{
-		mPendingQueue[id] = now;
 		return false;
 	}
+	if (mPendingQueue.find(id))
+	{
+		return true;
+	}
+
+	PendingRequest& request = mPendingQueue.findOrInsert(id);
+	request.mIsGroup = is_group;
 
+	if (mAskNameQueue.empty() && mAskGroupQueue.empty())
+	{
+		mAskSince = LLFrameTimer::getTotalSeconds();
+	}
+	if (is_group)
+	{
+		mAskGroupQueue.push_back(id);
+	}
+	else
+	{
+		mAskNameQueue.push_back(id);
+	}
+	return true;
+}
+
+bool LLCacheName::Impl::isNegative(const LLUUID& id)
+{
+	U32* expires = mNegativeCache.find(id);
+	if (!expires)
+	{
+		return false;
+	}
+	if (*expires < (U32)time(NULL))
+	{
+		mNegativeCache.erase(id);
+		return false;
+	}
 	return true;
 }
 	
@@ -852,7 +1163,7 @@ void LLCacheName::Impl::processUUIDRequest(LLMessageSystem* msg, bool isGroup)
 	{
 		LLUUID id;
 		msg->getUUIDFast(_PREHASH_UUIDNameBlock, _PREHASH_ID, id, i);
-		LLCacheNameEntry* entry = get_ptr_in_map(mCache, id);
+		LLCacheNameEntry* entry = findEntry(id);
 		if(entry)
 		{
 			if (isGroup != entry->mIsGroup)
@@ -869,20 +1180,8 @@ void LLCacheName::Impl::processUUIDRequest(LLMessageSystem* msg, bool isGroup)
 				sender.send(id, *entry, fromHost);
 			}
 		}
-		else
+		else if (requestName(id, isGroup))
 		{
-			if (!isRequestPending(id))
-			{
-				if (isGroup)
-				{
-					mAskGroupQueue.insert(id);
-				}
-				else
-				{
-					mAskNameQueue.insert(id);
-				}
-			}
-			
 			mReplyQueue.push_back(PendingReply(id, fromHost));
 		}
 	}
@@ -897,14 +1196,12 @@ void LLCacheName::Impl::processUUIDReply(LLMessageSystem* msg, bool isGroup)
 	{
 		LLUUID id;
 		msg->getUUIDFast(_PREHASH_UUIDNameBlock, _PREHASH_ID, id, i);
-		LLCacheNameEntry* entry = get_ptr_in_map(mCache, id);
-		if (!entry)
-		{
-			entry = new LLCacheNameEntry;
-			mCache[id] = entry;
-		}
+		LLCacheNameEntry* entry = &mCache.findOrInsert(id);
 
 		mPendingQueue.erase(id);
+		mNegativeCache.erase(id);
+		mRepliesReady = true;
+		mStats.mReplies++;
 
 		entry->mIsGroup = isGroup;
 		entry->mCreateTime = (U32)time(NULL);
@@ -921,11 +1218,22 @@ void LLCacheName::Impl::processUUIDReply(LLMessageSystem* msg, bool isGroup)
 
 		if (!isGroup)
 		{
-			notifyObservers(id, entry->mFirstName, entry->mLastName, FALSE);
+			mCacheFile.store(id, entry->mCreateTime, false, entry->mFirstName, entry->mLastName);
+		}
+		else
+		{
+			mCacheFile.store(id, entry->mCreateTime, true, entry->mGroupName, LLStringUtil::null);
+		}
+
+		// Observers may look up other names, which can move entries.
+		const LLCacheNameEntry found = *entry;
+		if (!isGroup)
+		{
+			notifyObservers(id, found.mFirstName, found.mLastName, FALSE);
 		}
 		else
 		{
-			notifyObservers(id, entry->mGroupName, "", TRUE);
+			notifyObservers(id, found.mGroupName, "", TRUE);
 		}
 	}
 }
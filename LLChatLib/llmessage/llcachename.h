@@ -35,6 +35,7 @@
 
 class LLMessageSystem;
 class LLHost;
+class LLSD;
 class LLUUID;
 
 // agent_id/group_id, first_name, last_name, is_group, user_data
@@ -73,6 +74,12 @@ public:
 	bool importFile(std::istream& istr);
 	void exportFile(std::ostream& ostr);
 
+	// Backs every cache created from now on with a memory-mapped file
+	// (see LLNameCacheFile).  Names found there are served without a
+	// request and refreshed in the background once they get old; every
+	// reply is written straight back to the file.
+	static void setCacheFile(const std::string& filename);
+
 	// If available, copies the first and last name into the strings provided.
 	// first must be at least DB_FIRST_NAME_BUF_SIZE characters.
 	// last must be at least DB_LAST_NAME_BUF_SIZE characters.
@@ -104,9 +111,35 @@ public:
 	// Expire entries created more than "secs" seconds ago.
 	void deleteEntriesOlderThan(S32 secs);
 
+	// Counters since startup, plus the current queue sizes.
+	struct Stats
+	{
+		Stats() : mLookups(0), mHits(0), mNegativeHits(0), mIDsRequested(0),
+				  mRetries(0), mGivenUp(0), mReplies(0), mPacketsSent(0),
+				  mBytesSent(0), mCached(0), mQueued(0), mInFlight(0),
+				  mNegative(0), mReplyQueue(0) {}
+
+		U32 mLookups;		// getName(), getGroupName() and get() calls
+		U32 mHits;			// ...answered from the cache
+		U32 mNegativeHits;	// ...for IDs upstream never answered
+		U32 mIDsRequested;	// IDs sent upstream, retries included
+		U32 mRetries;
+		U32 mGivenUp;		// IDs moved to the negative cache
+		U32 mReplies;		// IDs answered by upstream
+		U32 mPacketsSent;
+		U32 mBytesSent;
+		S32 mCached;
+		S32 mQueued;		// waiting to be sent
+		S32 mInFlight;		// sent, waiting for a reply
+		S32 mNegative;
+		S32 mReplyQueue;
+	};
+	Stats getStats() const;
+	LLSD getStatsLLSD() const;	// as getStats(), with the hit rate, for tools
+
 	// Debugging
 	void dump();		// Dumps the contents of the cache
-	void dumpStats();	// Dumps the sizes of the cache and associated queues.
+	void dumpStats();	// Dumps getStatsLLSD() in notation format.
 
 	static std::string getDefaultName();
 
@@ -115,6 +148,7 @@ private:
 	LLCacheName(LLMessageSystem* msg, const LLHost& upstream_host);
 
 	static LLCacheName* mInstance;
+	static std::string sCacheFileName;
 
 	class Impl;
 	Impl& impl;
@@ -67,8 +67,9 @@ const S32 PING_START_BLOCK = 3;		// How many pings behind we have to be to consi
 const S32 PING_RELEASE_BLOCK = 2;	// How many pings behind we have to be to consider ourself unblocked.
 
 const F32 TARGET_PERIOD_LENGTH = 5.f;	// seconds
-const F32 LL_DUPLICATE_SUPPRESSION_TIMEOUT = 60.f; //seconds - this can be long, as time-based cleanup is
-													// only done when wrapping packetids, now...
+
+const U32 MAX_LOST_PACKET_SPAN = 1 << 16;		// packet IDs tracked behind the newest potentially lost one
+const U32 MAX_DUPLICATE_PACKET_SPAN = 1 << 18;	// packet IDs kept for duplicate suppression
 
 LLCircuitData::LLCircuitData(const LLHost &host, TPACKETID in_id, 
 							 const F32 circuit_heartbeat_interval, const F32 circuit_timeout)
@@ -89,6 +90,8 @@ LLCircuitData::LLCircuitData(const LLHost &host, TPACKETID in_id,
 	mLastPingID(0),
 	mPingDelay(INITIAL_PING_VALUE_MSEC), 
 	mPingDelayAveraged((F32)INITIAL_PING_VALUE_MSEC), 
+	mPotentialLostPackets(MAX_LOST_PACKET_SPAN),
+	mRecentlyReceivedReliablePackets(MAX_DUPLICATE_PACKET_SPAN),
 	mUnackedPacketCount(0),
 	mUnackedPacketBytes(0),
 	mLocalEndPointID(),
@@ -135,35 +138,12 @@ LLCircuitData::~LLCircuitData()
 	// Clean up all pending transfers.
 	gTransferManager.cleanupConnection(mHost);
 
-	// remove all pending reliable messages on this circuit
+	// remove all pending reliable messages on this circuit, including
+	// the ones on their final retry
 	std::vector<TPACKETID> doomed;
-	reliable_iter iter;
-	reliable_iter end = mUnackedPackets.end();
-	for(iter = mUnackedPackets.begin(); iter != end; ++iter)
+	for (S32 off = mReliablePackets.firstOffset(); off >= 0; off = mReliablePackets.nextOffset(off + 1))
 	{
-		packetp = iter->second;
-		gMessageSystem->mFailedResendPackets++;
-		if(gMessageSystem->mVerboseLog)
-		{
-			doomed.push_back(packetp->mPacketID);
-		}
-		if (packetp->mCallback)
-		{
-			packetp->mCallback(packetp->mCallbackData,LL_ERR_CIRCUIT_GONE);
-		}
-
-		// Update stats
-		mUnackedPacketCount--;
-		mUnackedPacketBytes -= packetp->mBufferLength;
-
-		delete packetp;
-	}
-
-	// remove all pending final retry reliable messages on this circuit
-	end = mFinalRetryPackets.end();
-	for(iter = mFinalRetryPackets.begin(); iter != end; ++iter)
-	{
-		packetp = iter->second;
+		packetp = mReliablePackets.at(off);
 		gMessageSystem->mFailedResendPackets++;
 		if(gMessageSystem->mVerboseLog)
 		{
@@ -180,6 +160,7 @@ LLCircuitData::~LLCircuitData()
 
 		delete packetp;
 	}
+	mReliablePackets.clear();
 
 	// log aborted reliable packets for this circuit.
 	if(gMessageSystem->mVerboseLog && !doomed.empty())
@@ -195,47 +176,10 @@ LLCircuitData::~LLCircuitData()
 
 void LLCircuitData::ackReliablePacket(TPACKETID packet_num)
 {
-	reliable_iter iter;
-	LLReliablePacket *packetp;
-
-	iter = mUnackedPackets.find(packet_num);
-	if (iter != mUnackedPackets.end())
-	{
-		packetp = iter->second;
-
-		if(gMessageSystem->mVerboseLog)
-		{
-			std::ostringstream str;
-			str << "MSG: <- " << packetp->mHost << "\tRELIABLE ACKED:\t"
-				<< packetp->mPacketID;
-			llinfos << str.str() << llendl;
-		}
-		if (packetp->mCallback)
-		{
-			if (packetp->mTimeout < 0.f)   // negative timeout will always return timeout even for successful ack, for debugging
-			{
-				packetp->mCallback(packetp->mCallbackData,LL_ERR_TCP_TIMEOUT);					
-			}
-			else
-			{
-				packetp->mCallback(packetp->mCallbackData,LL_ERR_NOERR);
-			}
-		}
-
-		// Update stats
-		mUnackedPacketCount--;
-		mUnackedPacketBytes -= packetp->mBufferLength;
-
-		// Cleanup
-		delete packetp;
-		mUnackedPackets.erase(iter);
-		return;
-	}
-
-	iter = mFinalRetryPackets.find(packet_num);
-	if (iter != mFinalRetryPackets.end())
+	LLReliablePacket **entry = mReliablePackets.find(packet_num);
+	if (entry)
 	{
-		packetp = iter->second;
+		LLReliablePacket *packetp = *entry;
 		// llinfos << "Packet " << packet_num << " removed from the pending list" << llendl;
 		if(gMessageSystem->mVerboseLog)
 		{
@@ -261,12 +205,13 @@ void LLCircuitData::ackReliablePacket(TPACKETID packet_num)
 		mUnackedPacketBytes -= packetp->mBufferLength;
 
 		// Cleanup
-		delete packetp;
-		mFinalRetryPackets.erase(iter);
+		mReliablePackets.erase(packet_num);
+		mReliablePackets.trim();
+		mReliablePacketPool.release(packetp);
 	}
 	else
 	{
-		// Couldn't find this packet on either of the unacked lists.
+		// Couldn't find this packet on the unacked list.
 		// maybe it's a duplicate ack?
 	}
 }
@@ -280,119 +225,95 @@ S32 LLCircuitData::resendUnackedPackets(const F64 now)
 
 
 	//
-	// Theoretically we should search through the list for the packet with the oldest
-	// packet ID, as otherwise when we WRAP we will resend reliable packets out of order.
-	// Since resends are ALREADY out of order, and wrapping is highly rare (16+million packets),
-	// I'm not going to worry about this for now - djs
+	// Packets are walked in packet ID order, wrap included, so resends go
+	// out oldest first.  Packets on their final retry are not resent, only
+	// checked for expiry.
 	//
 
-	reliable_iter iter;
 	BOOL have_resend_overflow = FALSE;
-	for (iter = mUnackedPackets.begin(); iter != mUnackedPackets.end();)
+	BOOL stop_resending = FALSE;
+	for (S32 off = mReliablePackets.firstOffset(); off >= 0; off = mReliablePackets.nextOffset(off + 1))
 	{
-		packetp = iter->second;
+		packetp = mReliablePackets.at(off);
 
-		// Only check overflow if we haven't had one yet.
-		if (!have_resend_overflow)
+		if (packetp->mRetries && !stop_resending)
 		{
-			have_resend_overflow = mThrottles.checkOverflow(TC_RESEND, 0);
-		}
-
-		if (have_resend_overflow)
-		{
-			// We've exceeded our bandwidth for resends.
-			// Time to stop trying to send them.
+			// Only check overflow if we haven't had one yet.
+			if (!have_resend_overflow)
+			{
+				have_resend_overflow = mThrottles.checkOverflow(TC_RESEND, 0);
+			}
 
-			// If we have too many unacked packets, we need to start dropping expired ones.
-			if (mUnackedPacketBytes > 512000)
+			if (have_resend_overflow)
 			{
-				if (now > packetp->mExpirationTime)
+				// We've exceeded our bandwidth for resends.
+				// Time to stop trying to send them.
+
+				// If we have too many unacked packets, we need to start dropping expired ones.
+				if (mUnackedPacketBytes > 512000)
 				{
-					// This circuit has overflowed.  Do not retry.  Do not pass go.
-					packetp->mRetries = 0;
-					// Remove it from this list and add it to the final list.
-					mUnackedPackets.erase(iter++);
-					mFinalRetryPackets[packetp->mPacketID] = packetp;
+					if (now > packetp->mExpirationTime)
+					{
+						// This circuit has overflowed.  Do not retry.  Do not pass go.
+						// It is now on its final retry, and already expired.
+						packetp->mRetries = 0;
+					}
 				}
 				else
 				{
-					++iter;
+					if (mUnackedPacketBytes > 256000 && !(getPacketsOut() % 1024))
+					{
+						// Warn if we've got a lot of resends waiting.
+						llwarns << mHost << " has " << mUnackedPacketBytes 
+								<< " bytes of reliable messages waiting" << llendl;
+					}
+					// Stop resending.  There are less than 512000 unacked packets.
+					// Keep walking to expire the ones on their final retry.
+					stop_resending = TRUE;
 				}
-				// Move on to the next unacked packet.
-				continue;
 			}
-			
-			if (mUnackedPacketBytes > 256000 && !(getPacketsOut() % 1024))
+			else if (now > packetp->mExpirationTime)
 			{
-				// Warn if we've got a lot of resends waiting.
-				llwarns << mHost << " has " << mUnackedPacketBytes 
-						<< " bytes of reliable messages waiting" << llendl;
-			}
-			// Stop resending.  There are less than 512000 unacked packets.
-			break;
-		}
-
-		if (now > packetp->mExpirationTime)
-		{
-			packetp->mRetries--;
-			
-			// retry		
-			mCurrentResendCount++;
+				packetp->mRetries--;
+				
+				// retry		
+				mCurrentResendCount++;
 
-			gMessageSystem->mResentPackets++;
+				gMessageSystem->mResentPackets++;
 
-			if(gMessageSystem->mVerboseLog)
-			{
-				std::ostringstream str;
-				str << "MSG: -> " << packetp->mHost
-					<< "\tRESENDING RELIABLE:\t" << packetp->mPacketID;
-				llinfos << str.str() << llendl;
-			}
+				if(gMessageSystem->mVerboseLog)
+				{
+					std::ostringstream str;
+					str << "MSG: -> " << packetp->mHost
+						<< "\tRESENDING RELIABLE:\t" << packetp->mPacketID;
+					llinfos << str.str() << llendl;
+				}
 
-			packetp->mBuffer[0] |= LL_RESENT_FLAG;  // tag packet id as being a resend	
+				packetp->mBuffer[0] |= LL_RESENT_FLAG;  // tag packet id as being a resend	
 
-			gMessageSystem->mPacketRing.sendPacket(packetp->mSocket, 
-											   (char *)packetp->mBuffer, packetp->mBufferLength, 
-											   packetp->mHost);
+				gMessageSystem->mPacketRing.sendPacket(packetp->mSocket, 
+												   (char *)packetp->mBuffer, packetp->mBufferLength, 
+												   packetp->mHost);
 
-			mThrottles.throttleOverflow(TC_RESEND, packetp->mBufferLength * 8.f);
+				mThrottles.throttleOverflow(TC_RESEND, packetp->mBufferLength * 8.f);
 
-			// The new method, retry time based on ping
-			if (packetp->mPingBasedRetry)
-			{
-				packetp->mExpirationTime = now + llmax(LL_MINIMUM_RELIABLE_TIMEOUT_SECONDS, (LL_RELIABLE_TIMEOUT_FACTOR * getPingDelayAveraged()));
-			}
-			else
-			{
-				// custom, constant retry time
-				packetp->mExpirationTime = now + packetp->mTimeout;
-			}
+				// The new method, retry time based on ping
+				if (packetp->mPingBasedRetry)
+				{
+					packetp->mExpirationTime = now + llmax(LL_MINIMUM_RELIABLE_TIMEOUT_SECONDS, (LL_RELIABLE_TIMEOUT_FACTOR * getPingDelayAveraged()));
+				}
+				else
+				{
+					// custom, constant retry time
+					packetp->mExpirationTime = now + packetp->mTimeout;
+				}
 
-			if (!packetp->mRetries)
-			{
-				// Last resend, remove it from this list and add it to the final list.
-				mUnackedPackets.erase(iter++);
-				mFinalRetryPackets[packetp->mPacketID] = packetp;
-			}
-			else
-			{
-				// Don't remove it yet, it still gets to try to resend at least once.
-				++iter;
+				// If that was the last resend, the packet is now on its final retry.
+				resent_packets++;
 			}
-			resent_packets++;
-		}
-		else
-		{
-			// Don't need to do anything with this packet, keep iterating.
-			++iter;
 		}
-	}
-
 
-	for (iter = mFinalRetryPackets.begin(); iter != mFinalRetryPackets.end();)
-	{
-		packetp = iter->second;
-		if (now > packetp->mExpirationTime)
+		if (!packetp->mRetries && now > packetp->mExpirationTime)
 		{
 			// fail (too many retries)
 			//llinfos << "Packet " << packetp->mPacketID << " removed from the pending list: exceeded retry limit" << llendl;
@@ -400,39 +321,44 @@ S32 LLCircuitData::resendUnackedPackets(const F64 now)
 			//{
 			//	llinfos << "Packet name " << packetp->mMessageName << llendl;
 			//}
-			gMessageSystem->mFailedResendPackets++;
+			failReliablePacket(off);
+		}
+	}
+	mReliablePackets.trim();
 
-			if(gMessageSystem->mVerboseLog)
-			{
-				std::ostringstream str;
-				str << "MSG: -> " << packetp->mHost << "\tABORTING RELIABLE:\t"
-					<< packetp->mPacketID;
-				llinfos << str.str() << llendl;
-			}
+	return mUnackedPacketCount;
+}
 
-			if (packetp->mCallback)
-			{
-				packetp->mCallback(packetp->mCallbackData,LL_ERR_TCP_TIMEOUT);
-			}
 
-			// Update stats
-			mUnackedPacketCount--;
-			mUnackedPacketBytes -= packetp->mBufferLength;
+void LLCircuitData::failReliablePacket(S32 offset)
+{
+	LLReliablePacket *packetp = mReliablePackets.at(offset);
+	gMessageSystem->mFailedResendPackets++;
 
-			mFinalRetryPackets.erase(iter++);
-			delete packetp;
-		}
-		else
-		{
-			++iter;
-		}
+	if(gMessageSystem->mVerboseLog)
+	{
+		std::ostringstream str;
+		str << "MSG: -> " << packetp->mHost << "\tABORTING RELIABLE:\t"
+			<< packetp->mPacketID;
+		llinfos << str.str() << llendl;
 	}
 
-	return mUnackedPacketCount;
+	if (packetp->mCallback)
+	{
+		packetp->mCallback(packetp->mCallbackData,LL_ERR_TCP_TIMEOUT);
+	}
+
+	// Update stats
+	mUnackedPacketCount--;
+	mUnackedPacketBytes -= packetp->mBufferLength;
+
+	mReliablePackets.erase(mReliablePackets.idAt(offset));
+	mReliablePacketPool.release(packetp);
 }
 
 
-LLCircuit::LLCircuit(const F32 circuit_heartbeat_interval, const F32 circuit_timeout) : mLastCircuit(NULL),  
+LLCircuit::LLCircuit(const F32 circuit_heartbeat_interval, const F32 circuit_timeout) :
+	mPingWheel(totalTime()), mLastCircuit(NULL),  
 	mHeartbeatInterval(circuit_heartbeat_interval), mHeartbeatTimeout(circuit_timeout)
 {
 }
@@ -453,7 +379,7 @@ LLCircuitData *LLCircuit::addCircuitData(const LLHost &host, TPACKETID in_id)
 	llinfos << "LLCircuit::addCircuitData for " << host << llendl;
 	LLCircuitData *tempp = new LLCircuitData(host, in_id, mHeartbeatInterval, mHeartbeatTimeout);
 	mCircuitData.insert(circuit_data_map::value_type(host, tempp));
-	mPingSet.insert(tempp);
+	schedulePing(tempp, tempp->mNextPingSendTime);
 
 	mLastCircuit = tempp;
 	return tempp;
@@ -469,15 +395,7 @@ void LLCircuit::removeCircuitData(const LLHost &host)
 		LLCircuitData *cdp = it->second;
 		mCircuitData.erase(it);
 
-		LLCircuit::ping_set_t::iterator psit = mPingSet.find(cdp);
-		if (psit != mPingSet.end())
-        {
-		    mPingSet.erase(psit);
-		}
-		else
-		{
-			llwarns << "Couldn't find entry for next ping in ping set!" << llendl;
-		}
+		mPingWheel.cancel(*cdp);
 
 		// Clean up from optimization maps
 		mUnackedCircuitMap.erase(host);
@@ -571,19 +489,21 @@ void LLCircuitData::addReliablePacket(S32 mSocket, U8 *buf_ptr, S32 buf_len, LLR
 {
 	LLReliablePacket *packet_info;
 
-	packet_info = new LLReliablePacket(mSocket, buf_ptr, buf_len, params);
+	packet_info = mReliablePacketPool.alloc(mSocket, buf_ptr, buf_len, params);
 
 	mUnackedPacketCount++;
 	mUnackedPacketBytes += packet_info->mBufferLength;
 
-	if (params && params->mRetries)
-	{
-		mUnackedPackets[packet_info->mPacketID] = packet_info;
-	}
-	else
+	// The window only spans so many IDs; whatever is still unacked that far
+	// back would be dropped by the insert, so time it out properly first.
+	U32 dropped = mReliablePackets.dropsBefore(packet_info->mPacketID);
+	for (S32 off = mReliablePackets.firstOffset(); off >= 0 && (U32)off < dropped; off = mReliablePackets.nextOffset(off + 1))
 	{
-		mFinalRetryPackets[packet_info->mPacketID] = packet_info;
+		failReliablePacket(off);
 	}
+
+	// Packets without retries go straight to their final retry.
+	mReliablePackets.insert(packet_info->mPacketID, packet_info);
 }
 
 
@@ -606,7 +526,7 @@ void LLCircuit::resendUnackedPackets(S32& unacked_list_length, S32& unacked_list
 
 BOOL LLCircuitData::isDuplicateResend(TPACKETID packetnum)
 {
-	return (mRecentlyReceivedReliablePackets.find(packetnum) != mRecentlyReceivedReliablePackets.end());
+	return (mRecentlyReceivedReliablePackets.find(packetnum) != NULL);
 }
 
 
@@ -717,7 +637,7 @@ void LLCircuitData::checkPacketInID(TPACKETID id, BOOL receive_resent)
 		const U8 width = 24;
 		gap = LLModularMath::subtract<width>(mPacketsInID, id);
 
-		if (mPotentialLostPackets.find(id) != mPotentialLostPackets.end())
+		if (mPotentialLostPackets.find(id) != NULL)
 		{
 			if(gMessageSystem->mVerboseLog)
 			{
@@ -727,6 +647,7 @@ void LLCircuitData::checkPacketInID(TPACKETID id, BOOL receive_resent)
 			}
 			//			llinfos << "removing potential lost: " << id << llendl;
 			mPotentialLostPackets.erase(id);
+			mPotentialLostPackets.trim();
 		}
 		else if (!receive_resent) // don't freak out over out-of-order reliable resends
 		{
@@ -746,7 +667,7 @@ void LLCircuitData::checkPacketInID(TPACKETID id, BOOL receive_resent)
 					}
 
 //						llinfos << "adding potential lost: " << index << llendl;
-					mPotentialLostPackets[index] = time;
+					mPotentialLostPackets.insert(index, time);
 					index++;
 					index = index % LL_MAX_OUT_PACKET_ID;
 					gap_count++;
@@ -786,69 +707,57 @@ void LLCircuitData::checkPacketInID(TPACKETID id, BOOL receive_resent)
 void LLCircuit::updateWatchDogTimers(LLMessageSystem *msgsys)
 {
 	F64 cur_time = LLMessageSystem::getMessageTimeSeconds();
-	S32 count = mPingSet.size();
-	S32 cur = 0;
 
-	// Only process each circuit once at most, stop processing if no circuits
-	while((cur < count) && !mPingSet.empty())
+	// Only the circuits that are due come off the wheel, each at most once,
+	// since they all go back on in the future.
+	mPingWheel.advance(LLMessageSystem::getMessageTimeUsecs());
+	while (LLTimerWheel::Entry* entry = mPingWheel.popExpired())
 	{
-		cur++;
-
-		LLCircuit::ping_set_t::iterator psit = mPingSet.begin();
-		LLCircuitData *cdp = *psit;
+		LLCircuitData *cdp = static_cast<LLCircuitData*>(entry);
 
 		if (!cdp->mbAlive)
 		{
 			// We suspect that this case should never happen, given how
 			// the alive status is set.
 			// Skip over dead circuits, just add the ping interval and push it to the back
-			// Always remember to remove it from the set before changing the sorting
-			// key (mNextPingSendTime)
-			mPingSet.erase(psit);
-			cdp->mNextPingSendTime = cur_time + mHeartbeatInterval;
-			mPingSet.insert(cdp);
+			schedulePing(cdp, cur_time + mHeartbeatInterval);
 			continue;
 		}
-		else
+
+		// Update watchdog timers
+		if (cdp->updateWatchDogTimers(msgsys))
 		{
-			// Check to see if this needs a ping
-			if (cur_time < cdp->mNextPingSendTime)
-			{
-				// This circuit doesn't need a ping, break out because
-				// we have a sorted list, thus no more circuits need pings
-				break;
-			}
+			// Randomize our pings a bit by doing some up to 5% early or late
+			F64 dt = 0.95f*mHeartbeatInterval + ll_frand(0.1f*mHeartbeatInterval);
+			schedulePing(cdp, cur_time + dt);
 
-			// Update watchdog timers
-			if (cdp->updateWatchDogTimers(msgsys))
-            {
-				// Randomize our pings a bit by doing some up to 5% early or late
-				F64 dt = 0.95f*mHeartbeatInterval + ll_frand(0.1f*mHeartbeatInterval);
-
-				// Remove it, and reinsert it with the new next ping time.
-				// Always remove before changing the sorting key.
-				mPingSet.erase(psit);
-				cdp->mNextPingSendTime = cur_time + dt;
-				mPingSet.insert(cdp);
-    
-			    // Update our throttles
-			    cdp->mThrottles.dynamicAdjust();
-    
-			    // Update some stats, this is not terribly important
-			    cdp->checkPeriodTime();
-			}
-			else
-			{
-				// This mPingSet.erase isn't necessary, because removing the circuit will
-				// remove the ping set.
-				//mPingSet.erase(psit);
-				removeCircuitData(cdp->mHost);
-			}
+			// Update our throttles
+			cdp->mThrottles.dynamicAdjust();
+
+			// Update some stats, this is not terribly important
+			cdp->checkPeriodTime();
+		}
+		else
+		{
+			removeCircuitData(cdp->mHost);
 		}
 	}
 }
 
 
+BOOL LLCircuit::getNextPingTime(U64& usecs) const
+{
+	return mPingWheel.getNextExpiry(usecs);
+}
+
+
+void LLCircuit::schedulePing(LLCircuitData* cdp, F64 ping_time)
+{
+	cdp->mNextPingSendTime = ping_time;
+	mPingWheel.arm(*cdp, (U64)(ping_time * USEC_PER_SEC));
+}
+
+
 BOOL LLCircuitData::updateWatchDogTimers(LLMessageSystem *msgsys)
 {
 	F64 cur_time = LLMessageSystem::getMessageTimeSeconds();
@@ -867,92 +776,21 @@ BOOL LLCircuitData::updateWatchDogTimers(LLMessageSystem *msgsys)
 	// for the packet that it was out of order with was received BEFORE
 	// the ping was sent.
 
-	// Find the current oldest reliable packetID
-	// This is to handle the case if we actually manage to wrap our
-	// packet IDs - the oldest will actually have a higher packet ID
-	// than the current.
-	BOOL wrapped = FALSE;
-	reliable_iter iter;
-	iter = mUnackedPackets.upper_bound(getPacketOutID());
-	if (iter == mUnackedPackets.end())
+	// Find the current oldest reliable packetID.  The unacked packets are
+	// kept in packet ID order with wrapping taken into account, so this is
+	// simply the first one.
+	TPACKETID packet_id;
+	if (mReliablePackets.empty())
 	{
-		// Nothing AFTER this one, so we want the lowest packet ID
-		// then.
-		iter = mUnackedPackets.begin();
-		wrapped = TRUE;
-	}
-
-	TPACKETID packet_id = 0;
-
-	// Check against the "final" packets
-	BOOL wrapped_final = FALSE;
-	reliable_iter iter_final;
-	iter_final = mFinalRetryPackets.upper_bound(getPacketOutID());
-	if (iter_final == mFinalRetryPackets.end())
-	{
-		iter_final = mFinalRetryPackets.begin();
-		wrapped_final = TRUE;
-	}
-
-	//llinfos << mHost << " - unacked count " << mUnackedPackets.size() << llendl;
-	//llinfos << mHost << " - final count " << mFinalRetryPackets.size() << llendl;
-	if (wrapped != wrapped_final)
-	{
-		// One of the "unacked" or "final" lists hasn't wrapped.  Whichever one
-		// hasn't has the oldest packet.
-		if (!wrapped)
-		{
-			// Hasn't wrapped, so the one on the
-			// unacked packet list is older
-			packet_id = iter->first;
-			//llinfos << mHost << ": nowrapped unacked" << llendl;
-		}
-		else
-		{
-			packet_id = iter_final->first;
-			//llinfos << mHost << ": nowrapped final" << llendl;
-		}
+		// Wow!  No unacked packets at all!
+		// Send the ID of the last packet we sent out.
+		// This will flush all of the destination's
+		// unacked packets, theoretically.
+		packet_id = getPacketOutID();
 	}
 	else
 	{
-		// They both wrapped, we can just use the minimum of the two.
-		if ((iter == mUnackedPackets.end()) && (iter_final == mFinalRetryPackets.end()))
-		{
-			// Wow!  No unacked packets at all!
-			// Send the ID of the last packet we sent out.
-			// This will flush all of the destination's
-			// unacked packets, theoretically.
-			//llinfos << mHost << ": No unacked!" << llendl;
-			packet_id = getPacketOutID();
-		}
-		else
-		{
-			BOOL had_unacked = FALSE;
-			if (iter != mUnackedPackets.end())
-			{
-				// Unacked list has the lowest so far
-				packet_id = iter->first;
-				had_unacked = TRUE;
-				//llinfos << mHost << ": Unacked" << llendl;
-			}
-
-			if (iter_final != mFinalRetryPackets.end())
-			{
-				// Use the lowest of the unacked list and the final list
-				if (had_unacked)
-				{
-					// Both had a packet, use the lowest.
-					packet_id = llmin(packet_id, iter_final->first);
-					//llinfos << mHost << ": Min of unacked/final" << llendl;
-				}
-				else
-				{
-					// Only the final had a packet, use it.
-					packet_id = iter_final->first;
-					//llinfos << mHost << ": Final!" << llendl;
-				}
-			}
-		}
+		packet_id = mReliablePackets.idAt(mReliablePackets.firstOffset());
 	}
 
 	// Send off the another ping.
@@ -967,13 +805,12 @@ BOOL LLCircuitData::updateWatchDogTimers(LLMessageSystem *msgsys)
 	// Check to see if anything on our lost list is old enough to
 	// be considered lost
 
-	LLCircuitData::packet_time_map::iterator it;
 	U64 timeout = (U64)(1000000.0*llmin(LL_MAX_LOST_TIMEOUT, getPingDelayAveraged() * LL_LOST_TIMEOUT_FACTOR));
 
 	U64 mt_usec = LLMessageSystem::getMessageTimeUsecs();
-	for (it = mPotentialLostPackets.begin(); it != mPotentialLostPackets.end(); )
+	for (S32 off = mPotentialLostPackets.firstOffset(); off >= 0; off = mPotentialLostPackets.nextOffset(off + 1))
 	{
-		U64 delta_t_usec = mt_usec - (*it).second;
+		U64 delta_t_usec = mt_usec - mPotentialLostPackets.at(off);
 		if (delta_t_usec > timeout)
 		{
 			// let's call this one a loss!
@@ -983,16 +820,13 @@ BOOL LLCircuitData::updateWatchDogTimers(LLMessageSystem *msgsys)
 			{
 				std::ostringstream str;
 				str << "MSG: <- " << mHost << "\tLOST PACKET:\t"
-					<< (*it).first;
+					<< mPotentialLostPackets.idAt(off);
 				llinfos << str.str() << llendl;
 			}
-			mPotentialLostPackets.erase(it++);
-		}
-		else
-		{
-			++it;
+			mPotentialLostPackets.erase(mPotentialLostPackets.idAt(off));
 		}
 	}
+	mPotentialLostPackets.trim();
 
 	return TRUE;
 }
@@ -1006,43 +840,12 @@ void LLCircuitData::clearDuplicateList(TPACKETID oldest_id)
 
 	//llinfos << mHost << ": clearing before oldest " << oldest_id << llendl;
 	//llinfos << "Recent list before: " << mRecentlyReceivedReliablePackets.size() << llendl;
-	if (oldest_id < mHighestPacketID)
-	{
-		// Clean up everything with a packet ID less than oldest_id.
-		packet_time_map::iterator pit_start;
-		packet_time_map::iterator pit_end;
-		pit_start = mRecentlyReceivedReliablePackets.begin();
-		pit_end = mRecentlyReceivedReliablePackets.lower_bound(oldest_id);
-		mRecentlyReceivedReliablePackets.erase(pit_start, pit_end);
-	}
 
-	// Do timeout checks on everything with an ID > mHighestPacketID.
-	// This should be empty except for wrapping IDs.  Thus, this should be
-	// highly rare.
-	U64 mt_usec = LLMessageSystem::getMessageTimeUsecs();
+	// The list is ordered by packet ID with wrapping taken into account, so
+	// wrapped IDs need no separate time based cleanup.  IDs before the
+	// start of the list are ignored.
+	mRecentlyReceivedReliablePackets.eraseBefore(oldest_id);
 
-	packet_time_map::iterator pit;
-	for(pit = mRecentlyReceivedReliablePackets.upper_bound(mHighestPacketID);
-		pit != mRecentlyReceivedReliablePackets.end(); )
-	{
-		// Validate that the packet ID seems far enough away
-		if ((pit->first - mHighestPacketID) < 100)
-		{
-			llwarns << "Probably incorrectly timing out non-wrapped packets!" << llendl;
-		}
-		U64 delta_t_usec = mt_usec - (*pit).second;
-		F64 delta_t_sec = delta_t_usec * SEC_PER_USEC;
-		if (delta_t_sec > LL_DUPLICATE_SUPPRESSION_TIMEOUT)
-		{
-			// enough time has elapsed we're not likely to get a duplicate on this one
-			llinfos << "Clearing " << pit->first << " from recent list" << llendl;
-			mRecentlyReceivedReliablePackets.erase(pit++);
-		}
-		else
-		{
-			++pit;
-		}
-	}
 	//llinfos << "Recent list after: " << mRecentlyReceivedReliablePackets.size() << llendl;
 }
 
@@ -1095,9 +898,14 @@ void LLCircuit::sendAcks()
 	{
 		cd = (*it).second;
 
+		// Let the acks ride on packets already waiting to go out
+		gMessageSystem->piggybackAcks(cd);
+
 		S32 count = (S32)cd->mAcks.size();
 		if(count > 0)
 		{
+			gMessageSystem->mAcksStandalone += count;
+
 			// send the packet acks
 			S32 acks_this_packet = 0;
 			for(S32 i = 0; i < count; ++i)
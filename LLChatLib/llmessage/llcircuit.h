@@ -40,10 +40,12 @@
 #include "llerror.h"
 
 #include "lltimer.h"
+#include "lltimerwheel.h"
 #include "timing.h"
 #include "net.h"
 #include "llhost.h"
 #include "llpacketack.h"
+#include "llpacketwindow.h"
 #include "lluuid.h"
 #include "llthrottle.h"
 #include "llstat.h"
@@ -79,7 +81,8 @@ class LLSD;
 //
 
 
-class LLCircuitData
+// On its LLCircuit's ping wheel, due at mNextPingSendTime.
+class LLCircuitData : protected LLTimerWheel::Entry
 {
 public:
 	LLCircuitData(const LLHost &host, TPACKETID in_id, 
@@ -139,23 +142,6 @@ public:
 
 	LLThrottleGroup &getThrottleGroup()		{	return mThrottles; }
 
-	class less
-	{
-	public:
-		bool operator()(const LLCircuitData* lhs, const LLCircuitData* rhs) const
-		{
-			if (lhs->getNextPingSendTime() < rhs->getNextPingSendTime())
-			{
-				return true;
-			}
-			else if (lhs->getNextPingSendTime() > rhs->getNextPingSendTime())
-			{
-				return false;
-			}
-			else return lhs > rhs;
-		}
-	};
-
 	//
 	// Debugging stuff (not necessary for operation)
 	//
@@ -182,6 +168,9 @@ protected:
 	BOOL			updateWatchDogTimers(LLMessageSystem *msgsys);	// Return FALSE if the circuit is dead and should be cleaned up
 
 	void			addReliablePacket(S32 mSocket, U8 *buf_ptr, S32 buf_len, LLReliablePacketParams *params);
+	// Gives up on the reliable packet at offset in mReliablePackets: runs
+	// its callback with LL_ERR_TCP_TIMEOUT, erases it and releases it.
+	void			failReliablePacket(S32 offset);
 	BOOL			isDuplicateResend(TPACKETID packetnum);
 	// Call this method when a reliable message comes in - this will
 	// correctly place the packet in the correct list to be acked
@@ -239,17 +228,20 @@ protected:
 	U32		mPingDelay;             // raw ping delay
 	F32		mPingDelayAveraged;     // averaged ping delay (fast attack/slow decay)
 
-	typedef std::map<TPACKETID, U64> packet_time_map;
+	// Receive side state, indexed by packet ID
+	typedef LLPacketIDWindow<U64> packet_time_map;
 
 	packet_time_map							mPotentialLostPackets;
 	packet_time_map							mRecentlyReceivedReliablePackets;
 	std::vector<TPACKETID> mAcks;
 
-	typedef std::map<TPACKETID, LLReliablePacket *> reliable_map;
-	typedef reliable_map::iterator					reliable_iter;
+	// Reliable packets we sent that have not been acked yet, in ID order.
+	// Packets with no retries left (mRetries == 0) are on their final
+	// attempt and only wait to be acked or to time out.
+	typedef LLPacketIDWindow<LLReliablePacket *> reliable_map;
 
-	reliable_map							mUnackedPackets;
-	reliable_map							mFinalRetryPackets;
+	reliable_map							mReliablePackets;
+	LLReliablePacketPool					mReliablePacketPool;
 
 	S32										mUnackedPacketCount;
 	S32										mUnackedPacketBytes;
@@ -307,6 +299,10 @@ public:
 	void		    updateWatchDogTimers(LLMessageSystem *msgsys);
 	void			resendUnackedPackets(S32& unacked_list_length, S32& unacked_list_size);
 
+	// Message time, in microseconds, at which updateWatchDogTimers() next
+	// has a circuit to ping.  FALSE if there are no circuits.
+	BOOL			getNextPingTime(U64& usecs) const;
+
 	// this method is called during the message system processAcks()
 	// to send out any acks that did not get sent already. 
 	void sendAcks();
@@ -339,8 +335,9 @@ public:
 protected:
 	circuit_data_map mCircuitData;
 
-	typedef std::set<LLCircuitData *, LLCircuitData::less> ping_set_t; // Circuits sorted by next ping time
-	ping_set_t mPingSet;
+	LLTimerWheel mPingWheel; // Circuits by next ping time
+
+	void schedulePing(LLCircuitData* cdp, F64 ping_time);
 
 	// This variable points to the last circuit data we found to
 	// optimize the many, many times we call findCircuit. This may be
@@ -70,16 +70,23 @@
 
 	Furthermore, it would behoove us to keep track of which
 	hosts an easy handle was used for and pick an easy handle
-	that matches the next request.  This code does not current
-	do this.
+	that matches the next request.  Rather than that, every easy
+	handle is attached to one share handle holding the DNS cache,
+	TLS sessions and, where libcurl supports it, the connection
+	cache, so any pooled handle can pick up a live connection to
+	any host.  Easy handles are pooled globally, not per multi,
+	since most multis live for a single request.
  */
 
 //////////////////////////////////////////////////////////////////////////////
 
-static const S32 EASY_HANDLE_POOL_SIZE		= 5;
+static const S32 EASY_HANDLE_POOL_SIZE		= 16;
 static const S32 MULTI_PERFORM_CALL_REPEAT	= 5;
 static const S32 CURL_REQUEST_TIMEOUT = 30; // seconds
-static const S32 MAX_ACTIVE_REQUEST_COUNT = 100;
+static const S32 DEFAULT_MAX_HOST_REQUESTS = 8;
+// curl has transfers in flight but no socket yet (e.g. resolving);
+// libcurl recommends polling again after this many milliseconds.
+static const S32 CURL_NO_SOCKET_WAIT_MSECS = 100;
 
 // DEBUG //
 S32 gCurlEasyCount = 0;
@@ -91,6 +98,17 @@ S32 gCurlMultiCount = 0;
 std::vector<LLMutex*> LLCurl::sSSLMutex;
 std::string LLCurl::sCAPath;
 std::string LLCurl::sCAFile;
+CURLSH* LLCurl::sShareHandle = NULL;
+std::vector<LLMutex*> LLCurl::sShareMutex;
+S32 LLCurl::sMaxHostRequests = DEFAULT_MAX_HOST_REQUESTS;
+U32 LLCurl::sNewConnections = 0;
+U32 LLCurl::sReusedConnections = 0;
+
+// Requests in flight per "scheme://host:port"
+typedef std::map<std::string, S32> curl_host_slot_map_t;
+static curl_host_slot_map_t sHostSlots;
+// Set when a request had to wait for a host slot, cleared by getWaitFds()
+static bool sHostSlotWaiting = false;
 
 //static
 void LLCurl::setCAPath(const std::string& path)
@@ -149,8 +167,7 @@ void LLCurl::Responder::completedRaw(
 	const LLIOPipe::buffer_ptr_t& buffer)
 {
 	LLSD content;
-	LLBufferStream istr(channels, buffer.get());
-	LLSDSerialize::fromXML(content, istr);
+	ll_sd_from_xml_buffer(content, channels, buffer.get());
 	completed(status, reason, content);
 }
 
@@ -202,6 +219,7 @@ private:
 	
 public:
 	static LLCurl::EasyPtr getEasy();
+	static void releaseEasy(LLCurl::EasyPtr easy);
 	~Easy();
 
 	CURL* getCurlHandle() const { return mCurlEasyHandle; }
@@ -221,6 +239,7 @@ public:
 	
 	U32 report(CURLcode);
 	void getTransferInfo(LLCurl::TransferInfo* info);
+	void countConnections();
 
 	void prepRequest(const std::string& url, ResponderPtr, bool post = false);
 	
@@ -257,8 +276,18 @@ LLCurl::Easy::Easy()
 	mErrorBuffer[0] = 0;
 }
 
+// Easy handles ready for reuse, shared by every multi
+static std::vector<LLCurl::EasyPtr> sEasyFreeList;
+
 LLCurl::EasyPtr LLCurl::Easy::getEasy()
 {
+	if (!sEasyFreeList.empty())
+	{
+		EasyPtr easy = sEasyFreeList.back();
+		sEasyFreeList.pop_back();
+		return easy;
+	}
+
 	EasyPtr easy( new Easy() );
 	easy->mCurlEasyHandle = curl_easy_init();
 	if (!easy->mCurlEasyHandle)
@@ -269,13 +298,27 @@ LLCurl::EasyPtr LLCurl::Easy::getEasy()
 		return EasyPtr();
 	}
 	
-	// set no DMS caching as default for all easy handles. This prevents them adopting a
-	// multi handles cache if they are added to one.
-	curl_easy_setopt(easy->mCurlEasyHandle, CURLOPT_DNS_CACHE_TIMEOUT, 0);
+	// DNS, TLS sessions and connections come from the share handle, so
+	// they outlive both this handle and whichever multi it is added to.
+	// curl_easy_reset() leaves the share in place.
+	if (sShareHandle)
+	{
+		curl_easy_setopt(easy->mCurlEasyHandle, CURLOPT_SHARE, sShareHandle);
+	}
 	++gCurlEasyCount;
 	return easy;
 }
 
+//static
+void LLCurl::Easy::releaseEasy(EasyPtr easy)
+{
+	if (sEasyFreeList.size() < EASY_HANDLE_POOL_SIZE)
+	{
+		easy->resetState();
+		sEasyFreeList.push_back(easy);
+	}
+}
+
 LLCurl::Easy::~Easy()
 {
 	curl_easy_cleanup(mCurlEasyHandle);
@@ -306,6 +349,12 @@ void LLCurl::Easy::resetState()
 	
 	mHeaderOutput.str("");
 	mHeaderOutput.clear();
+
+	// Nothing refers to these after the reset
+	for_each(mStrings.begin(), mStrings.end(), DeletePointerArray());
+	mStrings.clear();
+
+	mResponder = NULL;
 }
 
 void LLCurl::Easy::setErrorBuffer()
@@ -342,11 +391,28 @@ void LLCurl::Easy::getTransferInfo(LLCurl::TransferInfo* info)
 	curl_easy_getinfo(mCurlEasyHandle, CURLINFO_SPEED_DOWNLOAD, &info->mSpeedDownload);
 }
 
+void LLCurl::Easy::countConnections()
+{
+	long connects = 0;
+	if (curl_easy_getinfo(mCurlEasyHandle, CURLINFO_NUM_CONNECTS, &connects) == CURLE_OK)
+	{
+		if (connects > 0)
+		{
+			sNewConnections += connects;
+		}
+		else
+		{
+			++sReusedConnections;
+		}
+	}
+}
+
 U32 LLCurl::Easy::report(CURLcode code)
 {
 	U32 responseCode = 0;	
 	std::string responseReason;
 	
+	countConnections();
 	if (code == CURLE_OK)
 	{
 		curl_easy_getinfo(mCurlEasyHandle, CURLINFO_RESPONSE_CODE, &responseCode);
@@ -485,12 +551,16 @@ public:
 	bool addEasy(EasyPtr easy);
 	
 	void removeEasy(EasyPtr easy);
+	// Takes the handle out of curl's multi but keeps it allocated here
+	void removeHandle(EasyPtr easy);
 
 	S32 process();
 	S32 perform();
 	
 	CURLMsg* info_read(S32* msgs_in_queue);
 
+	S32 getWaitFds(std::vector<S32>& read_fds, std::vector<S32>& write_fds);
+
 	S32 mQueued;
 	S32 mErrorCount;
 	
@@ -503,10 +573,13 @@ private:
 	easy_active_list_t mEasyActiveList;
 	typedef std::map<CURL*, EasyPtr> easy_active_map_t;
 	easy_active_map_t mEasyActiveMap;
-	typedef std::set<EasyPtr> easy_free_list_t;
-	easy_free_list_t mEasyFreeList;
 };
 
+// Every live multi handle, so that LLCurl::getWaitFds() can find them
+// without the owners (LLCurlRequest, LLCurlEasyRequest) registering.
+typedef std::set<LLCurl::Multi*> curl_multi_registry_t;
+static curl_multi_registry_t sLiveMultis;
+
 LLCurl::Multi::Multi()
 	: mQueued(0),
 	  mErrorCount(0)
@@ -518,7 +591,12 @@ LLCurl::Multi::Multi()
 		mCurlMultiHandle = curl_multi_init();
 	}
 	llassert_always(mCurlMultiHandle);
+#if LIBCURL_VERSION_NUM >= 0x071e00
+	// Transfers to a host past the limit queue inside curl
+	curl_multi_setopt(mCurlMultiHandle, CURLMOPT_MAX_HOST_CONNECTIONS, (long)sMaxHostRequests);
+#endif
 	++gCurlMultiCount;
+	sLiveMultis.insert(this);
 }
 
 LLCurl::Multi::~Multi()
@@ -533,13 +611,10 @@ LLCurl::Multi::~Multi()
 	}
 	mEasyActiveList.clear();
 	mEasyActiveMap.clear();
-	
-	// Clean up freed
-	//for_each(mEasyFreeList.begin(), mEasyFreeList.end(), DeletePointer());	
-	mEasyFreeList.clear();
 
 	curl_multi_cleanup(mCurlMultiHandle);
 	--gCurlMultiCount;
+	sLiveMultis.erase(this);
 }
 
 CURLMsg* LLCurl::Multi::info_read(S32* msgs_in_queue)
@@ -566,6 +641,52 @@ S32 LLCurl::Multi::perform()
 	return q;
 }
 
+S32 LLCurl::Multi::getWaitFds(std::vector<S32>& read_fds, std::vector<S32>& write_fds)
+{
+	if (mEasyActiveList.empty())
+	{
+		return -1;
+	}
+
+	fd_set read_set, write_set, exc_set;
+	FD_ZERO(&read_set);
+	FD_ZERO(&write_set);
+	FD_ZERO(&exc_set);
+	int max_fd = -1;
+	curl_multi_fdset(mCurlMultiHandle, &read_set, &write_set, &exc_set, &max_fd);
+
+#if LL_WINDOWS
+	for (u_int i = 0; i < read_set.fd_count; ++i)
+	{
+		read_fds.push_back((S32)read_set.fd_array[i]);
+	}
+	for (u_int i = 0; i < write_set.fd_count; ++i)
+	{
+		write_fds.push_back((S32)write_set.fd_array[i]);
+	}
+#else
+	for (int fd = 0; fd <= max_fd; ++fd)
+	{
+		if (FD_ISSET(fd, &read_set))
+		{
+			read_fds.push_back(fd);
+		}
+		if (FD_ISSET(fd, &write_set))
+		{
+			write_fds.push_back(fd);
+		}
+	}
+#endif
+
+	long timeout = -1;
+	curl_multi_timeout(mCurlMultiHandle, &timeout);
+	if (max_fd == -1 && mQueued > 0 && (timeout < 0 || timeout > CURL_NO_SOCKET_WAIT_MSECS))
+	{
+		timeout = CURL_NO_SOCKET_WAIT_MSECS;
+	}
+	return (S32)timeout;
+}
+
 S32 LLCurl::Multi::process()
 {
 	perform();
@@ -605,17 +726,7 @@ S32 LLCurl::Multi::process()
 
 LLCurl::EasyPtr LLCurl::Multi::allocEasy()
 {
-	EasyPtr easy;
-
-	if (mEasyFreeList.empty())
-	{
-		easy = Easy::getEasy();
-	}
-	else
-	{
-		easy = *(mEasyFreeList.begin());
-		mEasyFreeList.erase(easy);
-	}
+	EasyPtr easy = Easy::getEasy();
 	if (easy)
 	{
 		mEasyActiveList.insert(easy);
@@ -639,11 +750,7 @@ void LLCurl::Multi::easyFree(EasyPtr easy)
 {
 	mEasyActiveList.erase(easy);
 	mEasyActiveMap.erase(easy->getCurlHandle());
-	if (mEasyFreeList.size() < EASY_HANDLE_POOL_SIZE)
-	{
-		easy->resetState();
-		mEasyFreeList.insert(easy);
-	}
+	Easy::releaseEasy(easy);
 }
 
 void LLCurl::Multi::removeEasy(EasyPtr easy)
@@ -652,6 +759,66 @@ void LLCurl::Multi::removeEasy(EasyPtr easy)
 	easyFree(easy);
 }
 
+void LLCurl::Multi::removeHandle(EasyPtr easy)
+{
+	curl_multi_remove_handle(mCurlMultiHandle, easy->getCurlHandle());
+}
+
+//static
+S32 LLCurl::getWaitFds(std::vector<S32>& read_fds, std::vector<S32>& write_fds)
+{
+	// A request waiting for a host slot tries again on the next pump
+	S32 wait_msecs = sHostSlotWaiting ? CURL_NO_SOCKET_WAIT_MSECS : -1;
+	sHostSlotWaiting = false;
+	for (curl_multi_registry_t::iterator iter = sLiveMultis.begin();
+		 iter != sLiveMultis.end(); ++iter)
+	{
+		S32 multi_msecs = (*iter)->getWaitFds(read_fds, write_fds);
+		if (multi_msecs >= 0 && (wait_msecs < 0 || multi_msecs < wait_msecs))
+		{
+			wait_msecs = multi_msecs;
+		}
+	}
+	return wait_msecs;
+}
+
+// "scheme://host:port" part of a URL, used to count requests per host
+static std::string host_slot_key(const std::string& url)
+{
+	std::string::size_type start = url.find("://");
+	start = (start == std::string::npos) ? 0 : start + 3;
+	std::string::size_type end = url.find_first_of("/?#", start);
+	return url.substr(0, end);
+}
+
+//static
+bool LLCurl::acquireHostSlot(const std::string& url)
+{
+	S32& count = sHostSlots[host_slot_key(url)];
+	if (count >= sMaxHostRequests)
+	{
+		sHostSlotWaiting = true;
+		return false;
+	}
+	++count;
+	return true;
+}
+
+//static
+void LLCurl::releaseHostSlot(const std::string& url)
+{
+	curl_host_slot_map_t::iterator iter = sHostSlots.find(host_slot_key(url));
+	if (iter == sHostSlots.end())
+	{
+		llwarns << "Releasing a request slot that was never taken: " << url << llendl;
+		return;
+	}
+	if (--iter->second <= 0)
+	{
+		sHostSlots.erase(iter);
+	}
+}
+
 //static
 std::string LLCurl::strerror(CURLcode errorcode)
 {
@@ -670,8 +837,7 @@ std::string LLCurl::strerror(CURLcode errorcode)
 // For generating a simple request for data
 // using one multi and one easy per request 
 
-LLCurlRequest::LLCurlRequest() :
-	mActiveRequestCount(0)
+LLCurlRequest::LLCurlRequest()
 {
 }
 
@@ -685,19 +851,19 @@ void LLCurlRequest::addMulti()
 	LLCurl::MultiPtr multi( new LLCurl::Multi() );
 	mMultiSet.insert(multi);
 	mActiveMulti = multi;
-	mActiveRequestCount = 0;
 }
 
 LLCurl::EasyPtr LLCurlRequest::allocEasy()
 {
+	// The multi limits connections per host itself (see
+	// LLCurl::getMaxHostRequests()), so a new one is only needed once
+	// the current one has seen errors.
 	if (!mActiveMulti ||
-		mActiveRequestCount	>= MAX_ACTIVE_REQUEST_COUNT ||
 		mActiveMulti->mErrorCount > 0)
 	{
 		addMulti();
 	}
 	llassert_always(mActiveMulti);
-	++mActiveRequestCount;
 	LLCurl::EasyPtr easy = mActiveMulti->allocEasy();
 	return easy;
 }
@@ -809,6 +975,12 @@ LLCurlEasyRequest::LLCurlEasyRequest()
 
 LLCurlEasyRequest::~LLCurlEasyRequest()
 {
+	// Hand the easy handle back for the next request; its connection
+	// stays in the shared cache.
+	if (mEasy)
+	{
+		mMulti->removeEasy(mEasy);
+	}
 	mMulti.reset();
 	mEasy.reset();
 }
@@ -893,7 +1065,7 @@ void LLCurlEasyRequest::requestComplete()
 	mRequestSent = false;
 	if (mEasy)
 	{
-		mMulti->removeEasy(mEasy);
+		mMulti->removeHandle(mEasy);
 	}
 }
 
@@ -951,6 +1123,7 @@ CURLMsg* LLCurlEasyRequest::info_read(S32* q, LLCurl::TransferInfo* info)
 		CURLMsg* curlmsg = mMulti->info_read(q);
 		if (curlmsg && curlmsg->msg == CURLMSG_DONE)
 		{
+			mEasy->countConnections();
 			if (info)
 			{
 				mEasy->getTransferInfo(info);
@@ -989,6 +1162,18 @@ unsigned long LLCurl::ssl_thread_id(void)
 }
 #endif
 
+//static
+void LLCurl::share_lock_callback(CURL* handle, curl_lock_data data, curl_lock_access access, void* user)
+{
+	sShareMutex[data]->lock();
+}
+
+//static
+void LLCurl::share_unlock_callback(CURL* handle, curl_lock_data data, void* user)
+{
+	sShareMutex[data]->unlock();
+}
+
 void LLCurl::initClass()
 {
 	// Do not change this "unless you are familiar with and mean to control 
@@ -1005,10 +1190,48 @@ void LLCurl::initClass()
 	CRYPTO_set_id_callback(&LLCurl::ssl_thread_id);
 	CRYPTO_set_locking_callback(&LLCurl::ssl_locking_callback);
 #endif
+
+	sShareHandle = curl_share_init();
+	if (sShareHandle)
+	{
+		for (S32 i = 0; i < CURL_LOCK_DATA_LAST; i++)
+		{
+			sShareMutex.push_back(new LLMutex(gAPRPoolp));
+		}
+		curl_share_setopt(sShareHandle, CURLSHOPT_LOCKFUNC, &LLCurl::share_lock_callback);
+		curl_share_setopt(sShareHandle, CURLSHOPT_UNLOCKFUNC, &LLCurl::share_unlock_callback);
+		curl_share_setopt(sShareHandle, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+		curl_share_setopt(sShareHandle, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#if LIBCURL_VERSION_NUM >= 0x073900
+		curl_share_setopt(sShareHandle, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+#endif
+	}
+	else
+	{
+		llwarns << "curl_share_init() failed, connections will not be shared" << llendl;
+	}
 }
 
 void LLCurl::cleanupClass()
 {
+	// The share can't go while easy handles still use it
+	sEasyFreeList.clear();
+	if (sShareHandle)
+	{
+		if (curl_share_cleanup(sShareHandle) != CURLSHE_OK)
+		{
+			// Still attached to a live easy handle, which may yet call
+			// the lock callbacks; leave the share and its mutexes be.
+			llwarns << "curl share handle still in use at cleanup" << llendl;
+		}
+		else
+		{
+			sShareHandle = NULL;
+			for_each(sShareMutex.begin(), sShareMutex.end(), DeletePointer());
+			sShareMutex.clear();
+		}
+	}
+
 #if SAFE_SSL
 	CRYPTO_set_locking_callback(NULL);
 	for_each(sSSLMutex.begin(), sSSLMutex.end(), DeletePointer());
@@ -155,6 +155,37 @@ public:
 	 */
 	static const std::string& getCAPath() { return sCAPath; }
 
+	/**
+	 * @ brief Collect the sockets of every live multi handle so that an
+	 * external event loop can sleep until curl has work to do.
+	 *
+	 * Descriptors are appended to read_fds/write_fds.
+	 * @return milliseconds until curl wants to be driven again, -1 if
+	 * no transfer is in progress.
+	 */
+	static S32 getWaitFds(std::vector<S32>& read_fds, std::vector<S32>& write_fds);
+
+	/**
+	 * @ brief Reserve one of the request slots for the host of url.
+	 *
+	 * Requests to one host beyond getMaxHostRequests() wait for a slot
+	 * instead of each opening a connection of their own.  Every
+	 * successful call must be matched by releaseHostSlot().
+	 * @return false if the host is at its limit; try again later.
+	 */
+	static bool acquireHostSlot(const std::string& url);
+	static void releaseHostSlot(const std::string& url);
+
+	static void setMaxHostRequests(S32 count) { sMaxHostRequests = count; }
+	static S32 getMaxHostRequests() { return sMaxHostRequests; }
+
+	/**
+	 * @ brief Completed transfers that had to open a connection, and
+	 * those that reused one from the shared connection cache.
+	 */
+	static U32 getNewConnectionCount() { return sNewConnections; }
+	static U32 getReusedConnectionCount() { return sReusedConnections; }
+
 	/**
 	 * @ brief Initialize LLCurl class
 	 */
@@ -177,9 +208,22 @@ public:
 	static void ssl_locking_callback(int mode, int type, const char *file, int line);
 	static unsigned long ssl_thread_id(void);
 
+	// Share handle callbacks
+	static void share_lock_callback(CURL* handle, curl_lock_data data, curl_lock_access access, void* user);
+	static void share_unlock_callback(CURL* handle, curl_lock_data data, void* user);
+
 private:
 	static std::string sCAPath;
 	static std::string sCAFile;
+
+	// DNS cache, TLS sessions and (with libcurl 7.57 or later) live
+	// connections, shared by every easy handle.
+	static CURLSH* sShareHandle;
+	static std::vector<LLMutex*> sShareMutex;	// one per curl_lock_data
+
+	static S32 sMaxHostRequests;
+	static U32 sNewConnections;
+	static U32 sReusedConnections;
 };
 
 namespace boost
@@ -210,7 +254,6 @@ private:
 	typedef std::set<LLCurl::MultiPtr> curlmulti_set_t;
 	curlmulti_set_t mMultiSet;
 	LLCurl::MultiPtr mActiveMulti;
-	S32 mActiveRequestCount;
 };
 
 class LLCurlEasyRequest
@@ -370,6 +370,11 @@ public:
 		mUserData = user_data;
 	}
 
+	BOOL hasHandlerFunc() const
+	{
+		return mHandlerFunc != NULL;
+	}
+
 	BOOL callHandlerFunc(LLMessageSystem *msgsystem) const
 	{
 		if (mHandlerFunc)
@@ -0,0 +1,419 @@
+/** 
+ * @file llnamecachefile.cpp
+ * @brief Memory-mapped, persistent store for LLCacheName.
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llnamecachefile.h"
+
+#include "apr_file_io.h"
+#include "apr_mmap.h"
+
+// linden library includes
+#include "llerror.h"
+
+static const char NAME_CACHE_MAGIC[4] = { 'L', 'L', 'N', 'C' };
+static const U32 NAME_CACHE_VERSION = 1;
+
+// Slots in a new file; the table doubles whenever it becomes half full.
+static const U32 NAME_CACHE_INITIAL_SLOTS = 1024;
+
+// Times to chase the file when its owner replaces it while we open it.
+static const S32 NAME_CACHE_OPEN_ATTEMPTS = 3;
+
+LLNameCacheFile::LLNameCacheFile()
+:	mFile(NULL),
+	mMap(NULL),
+	mHeader(NULL),
+	mRecords(NULL)
+{
+}
+
+LLNameCacheFile::~LLNameCacheFile()
+{
+	close();
+}
+
+bool LLNameCacheFile::open(const std::string& filename)
+{
+	close();
+	mFilename = filename;
+
+	for (S32 attempt = 0; ; ++attempt)
+	{
+		apr_status_t status = apr_file_open(
+			&mFile,
+			filename.c_str(),
+			APR_READ | APR_WRITE | APR_CREATE | APR_BINARY,
+			APR_OS_DEFAULT,
+			mPool.getAPRPool());
+		if (ll_apr_warn_status(status))
+		{
+			llwarns << "Unable to open name cache " << filename << llendl;
+			mFile = NULL;
+			return false;
+		}
+
+		if (apr_file_lock(mFile, APR_FLOCK_EXCLUSIVE | APR_FLOCK_NONBLOCK) != APR_SUCCESS)
+		{
+			llinfos << "Name cache " << filename
+					<< " is in use by another process, keeping names in memory" << llendl;
+			close();
+			return false;
+		}
+
+		// The owner may have renamed a new table over the file between our
+		// open and our lock, leaving us holding the one it let go of.
+		if (isCurrentFile())
+		{
+			break;
+		}
+		close();
+		if (attempt + 1 >= NAME_CACHE_OPEN_ATTEMPTS)
+		{
+			llwarns << "Name cache " << filename << " keeps being replaced" << llendl;
+			return false;
+		}
+	}
+
+	apr_finfo_t finfo;
+	apr_off_t file_size = 0;
+	if (apr_file_info_get(&finfo, APR_FINFO_SIZE, mFile) == APR_SUCCESS)
+	{
+		file_size = finfo.size;
+	}
+
+	// Only the header is read up front; the records are used in place.
+	if (file_size >= (apr_off_t)sizeof(Header))
+	{
+		Header header;
+		apr_size_t bytes = sizeof(header);
+		if (apr_file_read(mFile, &header, &bytes) == APR_SUCCESS
+			&& bytes == sizeof(header)
+			&& !memcmp(header.mMagic, NAME_CACHE_MAGIC, sizeof(NAME_CACHE_MAGIC))
+			&& header.mVersion == NAME_CACHE_VERSION
+			&& header.mRecordSize == sizeof(Record)
+			&& header.mSlotCount >= NAME_CACHE_INITIAL_SLOTS
+			&& !(header.mSlotCount & (header.mSlotCount - 1))
+			&& header.mUsedCount * 2 <= header.mSlotCount
+			&& file_size == (apr_off_t)(sizeof(Header) + (apr_size_t)header.mSlotCount * sizeof(Record)))
+		{
+			if (mapFile(header.mSlotCount))
+			{
+				if (checkRecords())
+				{
+					llinfos << "LLNameCacheFile mapped " << mHeader->mUsedCount
+							<< " names from " << filename << llendl;
+					return true;
+				}
+				// Dropped first, so the reset below doesn't copy them
+				unmapFile();
+			}
+		}
+		llinfos << "LLNameCacheFile resetting " << filename << llendl;
+	}
+
+	if (!replaceFile(NAME_CACHE_INITIAL_SLOTS))
+	{
+		llwarns << "Unable to create name cache " << filename << llendl;
+		close();
+		return false;
+	}
+	return true;
+}
+
+void LLNameCacheFile::close()
+{
+	unmapFile();
+	if (mFile)
+	{
+		apr_file_close(mFile);
+		mFile = NULL;
+	}
+}
+
+const LLNameCacheFile::Record* LLNameCacheFile::find(const LLUUID& id) const
+{
+	if (!isOpen())
+	{
+		return NULL;
+	}
+	const Record* record = findSlot(id);
+	return record->mCreateTime ? record : NULL;
+}
+
+void LLNameCacheFile::store(const LLUUID& id, U32 create_time, bool is_group,
+							const std::string& first, const std::string& last)
+{
+	if (!isOpen())
+	{
+		return;
+	}
+
+	Record* record = findSlot(id);
+	if (!record->mCreateTime)
+	{
+		if ((mHeader->mUsedCount + 1) * 2 > mHeader->mSlotCount)
+		{
+			if (!grow())
+			{
+				return;
+			}
+			record = findSlot(id);
+		}
+		++mHeader->mUsedCount;
+	}
+
+	Record fresh;
+	memset(&fresh, 0, sizeof(fresh));
+	memcpy(fresh.mID, id.mData, UUID_BYTES);		/* Flawfinder: ignore */
+	fresh.mCreateTime = llmax(create_time, (U32)1);
+	fresh.mIsGroup = is_group;
+	if (is_group)
+	{
+		size_t len = llmin(first.size(), sizeof(fresh.mName) - 1);
+		memcpy(fresh.mName, first.data(), len);		/* Flawfinder: ignore */
+	}
+	else
+	{
+		size_t first_len = llmin(first.size(), (size_t)DB_FIRST_NAME_BUF_SIZE - 1);
+		size_t last_len = llmin(last.size(), (size_t)DB_LAST_NAME_BUF_SIZE - 1);
+		memcpy(fresh.mName, first.data(), first_len);		/* Flawfinder: ignore */
+		memcpy(fresh.mName + first_len + 1, last.data(), last_len);		/* Flawfinder: ignore */
+	}
+	*record = fresh;
+}
+
+U32 LLNameCacheFile::getCount() const
+{
+	return mHeader ? mHeader->mUsedCount : 0;
+}
+
+U32 LLNameCacheFile::getCapacity() const
+{
+	return mHeader ? mHeader->mSlotCount : 0;
+}
+
+// Whether the file we hold is still the one at mFilename.  If either side
+// can't say, assume it is.
+bool LLNameCacheFile::isCurrentFile()
+{
+	apr_finfo_t held;
+	apr_finfo_t named;
+	held.valid = named.valid = 0;
+	apr_file_info_get(&held, APR_FINFO_IDENT, mFile);
+	apr_status_t status = apr_stat(&named, mFilename.c_str(), APR_FINFO_IDENT, mPool.getAPRPool());
+	if (status != APR_SUCCESS && status != APR_INCOMPLETE)
+	{
+		return false;
+	}
+	if ((held.valid & APR_FINFO_IDENT) != APR_FINFO_IDENT
+		|| (named.valid & APR_FINFO_IDENT) != APR_FINFO_IDENT)
+	{
+		return true;
+	}
+	return held.inode == named.inode && held.device == named.device;
+}
+
+bool LLNameCacheFile::mapFile(U32 slot_count)
+{
+	unmapFile();
+
+	apr_size_t size = sizeof(Header) + (apr_size_t)slot_count * sizeof(Record);
+	apr_status_t status = apr_mmap_create(
+		&mMap, mFile, 0, size, APR_MMAP_READ | APR_MMAP_WRITE, mPool.getAPRPool());
+	if (ll_apr_warn_status(status))
+	{
+		mMap = NULL;
+		return false;
+	}
+
+	mHeader = (Header*)mMap->mm;
+	mRecords = (Record*)(mHeader + 1);
+	return true;
+}
+
+// A mapped file is trusted only if every occupied record holds terminated
+// names and the header counts them right.  Too many occupied slots would
+// leave findSlot() no empty one to stop at.
+bool LLNameCacheFile::checkRecords() const
+{
+	U32 used = 0;
+	for (U32 i = 0; i < mHeader->mSlotCount; ++i)
+	{
+		const Record& record = mRecords[i];
+		if (!record.mCreateTime)
+		{
+			continue;
+		}
+		size_t len = strnlen(record.mName, sizeof(record.mName));
+		if (len == sizeof(record.mName))
+		{
+			return false;
+		}
+		if (!record.mIsGroup)
+		{
+			size_t room = sizeof(record.mName) - len - 1;
+			if (strnlen(record.mName + len + 1, room) == room)
+			{
+				return false;
+			}
+		}
+		++used;
+	}
+	return used == mHeader->mUsedCount;
+}
+
+void LLNameCacheFile::unmapFile()
+{
+	if (mMap)
+	{
+		apr_mmap_delete(mMap);
+		mMap = NULL;
+	}
+	mHeader = NULL;
+	mRecords = NULL;
+}
+
+// Writes a table of slot_count slots, holding whatever records are mapped
+// now, to a new file and renames it over mFilename.  Cutting the mapped
+// file short instead would fault anyone still reading past the new end.
+bool LLNameCacheFile::replaceFile(U32 slot_count)
+{
+	const std::string new_filename = mFilename + ".new";
+	apr_size_t size = sizeof(Header) + (apr_size_t)slot_count * sizeof(Record);
+
+	apr_file_t* file = NULL;
+	apr_status_t status = apr_file_open(
+		&file,
+		new_filename.c_str(),
+		APR_READ | APR_WRITE | APR_CREATE | APR_TRUNCATE | APR_BINARY,
+		APR_OS_DEFAULT,
+		mPool.getAPRPool());
+	if (ll_apr_warn_status(status))
+	{
+		return false;
+	}
+
+	// Locked before it takes the old file's place, and extended from empty
+	// so that every slot reads back as free.
+	apr_mmap_t* map = NULL;
+	if (ll_apr_warn_status(apr_file_lock(file, APR_FLOCK_EXCLUSIVE | APR_FLOCK_NONBLOCK))
+		|| ll_apr_warn_status(apr_file_trunc(file, (apr_off_t)size))
+		|| ll_apr_warn_status(apr_mmap_create(
+			&map, file, 0, size, APR_MMAP_READ | APR_MMAP_WRITE, mPool.getAPRPool())))
+	{
+		apr_file_close(file);
+		apr_file_remove(new_filename.c_str(), mPool.getAPRPool());
+		return false;
+	}
+
+	Header* header = (Header*)map->mm;
+	Record* records = (Record*)(header + 1);
+	memcpy(header->mMagic, NAME_CACHE_MAGIC, sizeof(NAME_CACHE_MAGIC));	/* Flawfinder: ignore */
+	header->mVersion = NAME_CACHE_VERSION;
+	header->mRecordSize = sizeof(Record);
+	header->mSlotCount = slot_count;
+	header->mUsedCount = 0;
+	if (mRecords)
+	{
+		LLUUID id;
+		for (U32 i = 0; i < mHeader->mSlotCount; ++i)
+		{
+			if (mRecords[i].mCreateTime)
+			{
+				memcpy(id.mData, mRecords[i].mID, UUID_BYTES);		/* Flawfinder: ignore */
+				*findSlot(records, slot_count, id) = mRecords[i];
+				++header->mUsedCount;
+			}
+		}
+	}
+
+	status = apr_file_rename(new_filename.c_str(), mFilename.c_str(), mPool.getAPRPool());
+	if (status != APR_SUCCESS && mFile)
+	{
+		// Windows won't replace a file that is open and mapped; let go of
+		// the old one and try again.
+		unmapFile();
+		apr_file_close(mFile);
+		mFile = NULL;
+		status = apr_file_rename(new_filename.c_str(), mFilename.c_str(), mPool.getAPRPool());
+	}
+	if (ll_apr_warn_status(status))
+	{
+		apr_mmap_delete(map);
+		apr_file_close(file);
+		apr_file_remove(new_filename.c_str(), mPool.getAPRPool());
+		return false;
+	}
+
+	close();
+	mFile = file;
+	mMap = map;
+	mHeader = header;
+	mRecords = records;
+	return true;
+}
+
+bool LLNameCacheFile::grow()
+{
+	U32 slot_count = mHeader->mSlotCount * 2;
+	if (!replaceFile(slot_count))
+	{
+		llwarns << "Unable to grow name cache to " << slot_count
+				<< " slots" << llendl;
+		close();
+		return false;
+	}
+	return true;
+}
+
+LLNameCacheFile::Record* LLNameCacheFile::findSlot(const LLUUID& id) const
+{
+	return findSlot(mRecords, mHeader->mSlotCount, id);
+}
+
+// static
+LLNameCacheFile::Record* LLNameCacheFile::findSlot(Record* records, U32 slot_count, const LLUUID& id)
+{
+	// Linear probing; the table is never more than half full, so an
+	// empty slot always ends the walk.
+	U32 mask = slot_count - 1;
+	for (U32 i = id.getCRC32() & mask; ; i = (i + 1) & mask)
+	{
+		Record* record = records + i;
+		if (!record->mCreateTime
+			|| !memcmp(record->mID, id.mData, UUID_BYTES))
+		{
+			return record;
+		}
+	}
+}
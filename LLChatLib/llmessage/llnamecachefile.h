@@ -0,0 +1,122 @@
+/** 
+ * @file llnamecachefile.h
+ * @brief Memory-mapped, persistent store for LLCacheName.
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLNAMECACHEFILE_H
+#define LL_LLNAMECACHEFILE_H
+
+#include "llapr.h"
+#include "lldbstrings.h"
+#include "lluuid.h"
+
+struct apr_file_t;
+struct apr_mmap_t;
+
+// An open-addressed hash table of fixed size records, kept in a file
+// and mapped into memory.  Opening it costs one mmap and one pass over
+// the records to check them, nothing is copied, lookups read the mapping
+// directly and every store is written into its slot in place, so the
+// file is always current.
+//
+// Several viewers may share the cache directory, so the file is held
+// under an exclusive lock; whoever finds it taken keeps its names in
+// memory.  The mapped file is never resized: the table grows by writing
+// a bigger copy beside it and renaming that over it.
+//
+// The file is private to this machine: integers are native endian and a
+// file with a different magic, version or record size is discarded.
+class LLNameCacheFile
+{
+public:
+	struct Record
+	{
+		U8		mID[UUID_BYTES];
+		U32		mCreateTime;	// unix time_t; 0 marks an empty slot
+		U8		mIsGroup;
+		U8		mPad[3];
+		// "first\0last\0" for agents, "group name\0" for groups
+		char	mName[DB_FIRST_NAME_BUF_SIZE + DB_LAST_NAME_BUF_SIZE];
+
+		const char* getFirstName() const	{ return mName; }
+		const char* getLastName() const		{ return mName + strnlen(mName, sizeof(mName)) + 1; }
+		const char* getGroupName() const	{ return mName; }
+	};
+
+	LLNameCacheFile();
+	~LLNameCacheFile();
+
+	// Locks and maps filename, creating or resetting it if it is missing
+	// or not a cache file of this version.  Returns false if the file is
+	// locked by another process or could not be mapped, in which case the
+	// cache stays memory-only.
+	bool open(const std::string& filename);
+	void close();
+	bool isOpen() const { return mRecords != NULL; }
+
+	// Returns the stored record for id, or NULL.
+	const Record* find(const LLUUID& id) const;
+
+	// Adds or replaces the record for id, growing the table as needed.
+	void store(const LLUUID& id, U32 create_time, bool is_group,
+			   const std::string& first, const std::string& last);
+
+	U32 getCount() const;
+	U32 getCapacity() const;
+
+private:
+	struct Header
+	{
+		char	mMagic[4];
+		U32		mVersion;
+		U32		mRecordSize;
+		U32		mSlotCount;		// always a power of two
+		U32		mUsedCount;
+		U32		mPad[3];
+	};
+
+	bool isCurrentFile();
+	bool mapFile(U32 slot_count);
+	bool checkRecords() const;
+	void unmapFile();
+	bool replaceFile(U32 slot_count);
+	bool grow();
+	Record* findSlot(const LLUUID& id) const;
+	static Record* findSlot(Record* records, U32 slot_count, const LLUUID& id);
+
+	std::string		mFilename;
+	LLAPRPool		mPool;
+	apr_file_t*		mFile;
+	apr_mmap_t*		mMap;
+	Header*			mHeader;
+	Record*			mRecords;
+};
+
+#endif // LL_LLNAMECACHEFILE_H
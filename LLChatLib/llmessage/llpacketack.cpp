@@ -49,7 +49,17 @@ LLReliablePacket::LLReliablePacket(
 	S32 buf_len,
 	LLReliablePacketParams* params) :
 	mBuffer(NULL),
-	mBufferLength(0)
+	mBufferLength(0),
+	mBufferCapacity(0)
+{
+	init(socket, buf_ptr, buf_len, params);
+}
+
+void LLReliablePacket::init(
+	S32 socket,
+	U8* buf_ptr,
+	S32 buf_len,
+	LLReliablePacketParams* params)
 {
 	if (params)
 	{
@@ -63,6 +73,7 @@ LLReliablePacket::LLReliablePacket(
 	}
 	else
 	{
+		mHost.invalidate();
 		mRetries = 0;
 		mPingBasedRetry = TRUE;
 		mTimeout = 0.f;
@@ -75,9 +86,15 @@ LLReliablePacket::LLReliablePacket(
 	mPacketID = ntohl(*((U32*)(&buf_ptr[PHL_PACKET_ID])));
 
 	mSocket = socket;
+	mBufferLength = 0;
 	if (mRetries)
 	{
-		mBuffer = new U8[buf_len];
+		if (buf_len > mBufferCapacity)
+		{
+			delete [] mBuffer;
+			mBufferCapacity = llmax(buf_len, MTUBYTES);
+			mBuffer = new U8[mBufferCapacity];
+		}
 		if (mBuffer != NULL)
 		{
 			memcpy(mBuffer,buf_ptr,buf_len);	/*Flawfinder: ignore*/
@@ -86,3 +103,51 @@ LLReliablePacket::LLReliablePacket(
 			
 	}
 }
+
+
+// Enough for a burst of reliable traffic without holding on to memory
+// for circuits that have gone quiet.
+const S32 MAX_FREE_RELIABLE_PACKETS = 256;
+
+LLReliablePacketPool::LLReliablePacketPool()
+{
+}
+
+LLReliablePacketPool::~LLReliablePacketPool()
+{
+	for (std::vector<LLReliablePacket*>::iterator iter = mFree.begin(); iter != mFree.end(); ++iter)
+	{
+		delete *iter;
+	}
+	mFree.clear();
+}
+
+LLReliablePacket* LLReliablePacketPool::alloc(
+	S32 socket,
+	U8* buf_ptr,
+	S32 buf_len,
+	LLReliablePacketParams* params)
+{
+	if (mFree.empty())
+	{
+		return new LLReliablePacket(socket, buf_ptr, buf_len, params);
+	}
+
+	LLReliablePacket* packetp = mFree.back();
+	mFree.pop_back();
+	packetp->init(socket, buf_ptr, buf_len, params);
+	return packetp;
+}
+
+void LLReliablePacketPool::release(LLReliablePacket* packetp)
+{
+	if ((S32)mFree.size() >= MAX_FREE_RELIABLE_PACKETS)
+	{
+		delete packetp;
+		return;
+	}
+	packetp->mCallback = NULL;
+	packetp->mCallbackData = NULL;
+	packetp->mMessageName = NULL;
+	mFree.push_back(packetp);
+}
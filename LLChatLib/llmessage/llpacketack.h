@@ -33,6 +33,8 @@
 #ifndef LL_LLPACKETACK_H
 #define LL_LLPACKETACK_H
 
+#include <vector>
+
 #include "llhost.h"
 
 class LLReliablePacketParams
@@ -98,7 +100,16 @@ public:
 		mBuffer = NULL;
 	};
 
+	// Sets the packet up for a new message.  The buffer from the previous
+	// message is kept if it is large enough.
+	void init(
+		S32 socket,
+		U8* buf_ptr,
+		S32 buf_len,
+		LLReliablePacketParams* params);
+
 	friend class LLCircuitData;
+	friend class LLReliablePacketPool;
 protected:
 	S32 mSocket;
 	LLHost mHost;
@@ -111,11 +122,32 @@ protected:
 
 	U8* mBuffer;
 	S32 mBufferLength;
+	S32 mBufferCapacity;
 
 	TPACKETID mPacketID;
 
 	F64 mExpirationTime;
 };
 
+// Free list of reliable packets for one circuit.  Every reliable send
+// needs a packet and a copy of the message until it is acked, so packets
+// are handed back here instead of being deleted and their buffers reused.
+class LLReliablePacketPool
+{
+public:
+	LLReliablePacketPool();
+	~LLReliablePacketPool();
+
+	LLReliablePacket* alloc(
+		S32 socket,
+		U8* buf_ptr,
+		S32 buf_len,
+		LLReliablePacketParams* params);
+	void release(LLReliablePacket* packetp);
+
+private:
+	std::vector<LLReliablePacket*> mFree;
+};
+
 #endif
 
@@ -53,14 +53,44 @@ LLPacketRing::LLPacketRing () :
 	mInBufferLength(0),
 	mOutBufferLength(0),
 	mDropPercentage(0.0f),
-	mPacketsToDrop(0x0)
+	mPacketsToDrop(0x0),
+	mUseBatchedReceive(TRUE),
+	mBatchSlab(NULL),
+	mBatchCount(0),
+	mBatchNext(0),
+	mBatchReceiveCalls(0),
+	mBatchReceivePackets(0),
+	mBatchEmptyCalls(0),
+	mSendBatchOpen(FALSE),
+	mSendBatchSocket(-1),
+	mSendSlab(NULL),
+	mSendBatchCount(0),
+	mSendBatchFailures(0),
+	mSendSyscalls(0),
+	mSendPackets(0)
 {
+	mBatchSlab = new U8[RECEIVE_BATCH_SIZE * NET_BUFFER_SIZE];
+	for (S32 i = 0; i < RECEIVE_BATCH_SIZE; i++)
+	{
+		mBatchSizes[i] = 0;
+	}
+
+	mSendSlab = new U8[SEND_BATCH_SIZE * NET_BUFFER_SIZE];
+	for (S32 i = 0; i < SEND_BATCH_SIZE; i++)
+	{
+		mSendBatch[i].mData = mSendSlab + i * NET_BUFFER_SIZE;
+		mSendBatch[i].mSize = 0;
+	}
 }
 
 ///////////////////////////////////////////////////////////
 LLPacketRing::~LLPacketRing ()
 {
 	cleanup();
+	delete [] mBatchSlab;
+	mBatchSlab = NULL;
+	delete [] mSendSlab;
+	mSendSlab = NULL;
 }
 	
 ///////////////////////////////////////////////////////////
@@ -114,6 +144,38 @@ void LLPacketRing::setOutBandwidth(const F32 bps)
 {
 	mOutThrottle.setRate(bps);
 }
+
+void LLPacketRing::setUseBatchedReceive(const BOOL use_batch)
+{
+	mUseBatchedReceive = use_batch;
+}
+
+F32 LLPacketRing::getAverageBatchSize() const
+{
+	if (!mBatchReceiveCalls)
+	{
+		return 0.f;
+	}
+	return (F32)mBatchReceivePackets / (F32)mBatchReceiveCalls;
+}
+
+F32 LLPacketRing::getAverageSendBatchSize() const
+{
+	if (!mSendSyscalls)
+	{
+		return 0.f;
+	}
+	return (F32)mSendPackets / (F32)mSendSyscalls;
+}
+
+void LLPacketRing::resetBatchStats()
+{
+	mBatchReceiveCalls = 0;
+	mBatchReceivePackets = 0;
+	mBatchEmptyCalls = 0;
+	mSendSyscalls = 0;
+	mSendPackets = 0;
+}
 ///////////////////////////////////////////////////////////
 S32 LLPacketRing::receiveFromRing (S32 socket, char *datap)
 {
@@ -242,11 +304,123 @@ S32 LLPacketRing::receivePacket (S32 socket, char *datap)
 	return packet_size;
 }
 
+///////////////////////////////////////////////////////////
+S32 LLPacketRing::receivePacketBatched (S32 socket, U8 **datap)
+{
+	if (mBatchNext >= mBatchCount)
+	{
+		mBatchNext = 0;
+		mBatchCount = 0;
+
+		if (mUseInThrottle || !mUseBatchedReceive)
+		{
+			// The throttle simulation queues copies anyway, use the old path
+			*datap = mBatchSlab;
+			return receivePacket(socket, (char *)mBatchSlab);
+		}
+
+		char *buffers[RECEIVE_BATCH_SIZE];
+		for (S32 i = 0; i < RECEIVE_BATCH_SIZE; i++)
+		{
+			buffers[i] = (char *)mBatchSlab + i * NET_BUFFER_SIZE;
+		}
+
+		S32 count = receive_packet_batch(socket, buffers, mBatchSizes, mBatchSenders, RECEIVE_BATCH_SIZE);
+		if (count <= 0)
+		{
+			mBatchEmptyCalls++;
+			*datap = mBatchSlab;
+			return 0;
+		}
+
+		mBatchCount = count;
+		mBatchReceiveCalls++;
+		mBatchReceivePackets += count;
+	}
+
+	S32 slot = mBatchNext++;
+	S32 packet_size = mBatchSizes[slot];
+	*datap = mBatchSlab + slot * NET_BUFFER_SIZE;
+	mLastSender = mBatchSenders[slot];
+
+	if (packet_size)
+	{
+		if (mDropPercentage && (ll_frand(100.f) < mDropPercentage))
+		{
+			mPacketsToDrop++;
+		}
+
+		if (mPacketsToDrop)
+		{
+			packet_size = 0;
+			mPacketsToDrop--;
+		}
+	}
+
+	return packet_size;
+}
+
+///////////////////////////////////////////////////////////
+void LLPacketRing::beginSendBatch()
+{
+	mSendBatchOpen = TRUE;
+}
+
+S32 LLPacketRing::flushSendBatch()
+{
+	sendBatch();
+	mSendBatchOpen = FALSE;
+
+	S32 failures = mSendBatchFailures;
+	mSendBatchFailures = 0;
+	return failures;
+}
+
+void LLPacketRing::sendBatch()
+{
+	if (!mSendBatchCount)
+	{
+		return;
+	}
+
+	char *buffers[SEND_BATCH_SIZE];
+	S32 sizes[SEND_BATCH_SIZE];
+	LLHost hosts[SEND_BATCH_SIZE];
+	for (S32 i = 0; i < mSendBatchCount; i++)
+	{
+		buffers[i] = (char *)mSendBatch[i].mData;
+		sizes[i] = mSendBatch[i].mSize;
+		hosts[i] = mSendBatch[i].mHost;
+	}
+
+	S32 sent = send_packet_batch(mSendBatchSocket, buffers, sizes, hosts, mSendBatchCount, mSendSyscalls);
+	mSendPackets += mSendBatchCount;
+	mSendBatchFailures += mSendBatchCount - sent;
+	mSendBatchCount = 0;
+}
+
 BOOL LLPacketRing::sendPacket(int h_socket, char * send_buffer, S32 buf_size, LLHost host)
 {
 	BOOL status = TRUE;
+	if (!mUseOutThrottle && mSendBatchOpen && buf_size <= NET_BUFFER_SIZE)
+	{
+		if (mSendBatchCount == SEND_BATCH_SIZE || (mSendBatchCount && h_socket != mSendBatchSocket))
+		{
+			sendBatch();
+		}
+
+		QueuedSend& queued = mSendBatch[mSendBatchCount++];
+		memcpy(queued.mData, send_buffer, buf_size);		/* Flawfinder: ignore */
+		queued.mSize = buf_size;
+		queued.mHost = host;
+		mSendBatchSocket = h_socket;
+		return TRUE;
+	}
+
 	if (!mUseOutThrottle)
 	{
+		mSendSyscalls++;
+		mSendPackets++;
 		return send_packet(h_socket, send_buffer, buf_size, host.getAddress(), host.getPort() );
 	}
 	else
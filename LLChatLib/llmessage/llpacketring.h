@@ -41,6 +41,10 @@
 #include "net.h"
 #include "llthrottle.h"
 
+// Number of datagrams drained from the socket per batched receive
+const S32 RECEIVE_BATCH_SIZE = 32;
+// Number of datagrams held back per batched send
+const S32 SEND_BATCH_SIZE = 32;
 
 class LLPacketRing
 {
@@ -59,12 +63,45 @@ public:
 	S32  receivePacket (S32 socket, char *datap);
 	S32  receiveFromRing (S32 socket, char *datap);
 
+	// Hands out the next packet without copying it; *datap points into
+	// the ring's receive slab and stays valid until the next call.
+	// Refills the slab with a single batched receive when it runs dry.
+	S32  receivePacketBatched (S32 socket, U8 **datap);
+	void setUseBatchedReceive(const BOOL use_batch);
+	BOOL hasBatchedPackets() const				{ return mBatchNext < mBatchCount; }
+
 	BOOL sendPacket(int h_socket, char * send_buffer, S32 buf_size, LLHost host);
 
+	// While a send batch is open, sendPacket() copies packets into the
+	// send slab and flushSendBatch() hands them to the kernel together.
+	// Returns the number of packets that could not be sent.
+	void beginSendBatch();
+	S32  flushSendBatch();
+	BOOL isSendBatchOpen() const				{ return mSendBatchOpen; }
+
+	// Packets waiting in the send slab. mData has room for NET_BUFFER_SIZE bytes.
+	struct QueuedSend
+	{
+		LLHost	mHost;
+		U8*		mData;
+		S32		mSize;
+	};
+	S32  getQueuedSendCount() const				{ return mSendBatchCount; }
+	QueuedSend& getQueuedSend(S32 index)		{ return mSendBatch[index]; }
+
 	inline LLHost getLastSender();
 
 	S32 getAndResetActualInBits()				{ S32 bits = mActualBitsIn; mActualBitsIn = 0; return bits;}
 	S32 getAndResetActualOutBits()				{ S32 bits = mActualBitsOut; mActualBitsOut = 0; return bits;}
+
+	U32 getBatchReceiveCalls() const			{ return mBatchReceiveCalls; }
+	U32 getBatchReceivePackets() const			{ return mBatchReceivePackets; }
+	U32 getBatchEmptyCalls() const				{ return mBatchEmptyCalls; }
+	F32 getAverageBatchSize() const;
+	U32 getSendSyscalls() const					{ return mSendSyscalls; }
+	U32 getSendPackets() const					{ return mSendPackets; }
+	F32 getAverageSendBatchSize() const;
+	void resetBatchStats();
 protected:
 	BOOL mUseInThrottle;
 	BOOL mUseOutThrottle;
@@ -86,6 +123,31 @@ protected:
 	std::queue<LLPacketBuffer *> mSendQueue;
 
 	LLHost mLastSender;
+
+	// Batched receive
+	BOOL mUseBatchedReceive;
+	U8*  mBatchSlab;								// RECEIVE_BATCH_SIZE buffers of NET_BUFFER_SIZE
+	S32  mBatchSizes[RECEIVE_BATCH_SIZE];
+	LLHost mBatchSenders[RECEIVE_BATCH_SIZE];
+	S32  mBatchCount;								// Packets in the slab
+	S32  mBatchNext;								// Next one to hand out
+
+	U32  mBatchReceiveCalls;						// Receives that returned packets
+	U32  mBatchReceivePackets;						// Packets those receives returned
+	U32  mBatchEmptyCalls;							// Receives that found nothing waiting
+
+	// Batched send
+	BOOL mSendBatchOpen;
+	int  mSendBatchSocket;
+	U8*  mSendSlab;									// SEND_BATCH_SIZE buffers of NET_BUFFER_SIZE
+	QueuedSend mSendBatch[SEND_BATCH_SIZE];
+	S32  mSendBatchCount;
+	S32  mSendBatchFailures;						// Failures from flushes forced by a full slab
+
+	U32  mSendSyscalls;								// System calls made to send packets
+	U32  mSendPackets;								// Packets handed to those calls
+
+	void sendBatch();
 };
 
 
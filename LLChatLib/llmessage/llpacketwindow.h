@@ -0,0 +1,300 @@
+/** 
+ * @file llpacketwindow.h
+ * @brief Ring of per-packet state indexed by packet ID
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLPACKETWINDOW_H
+#define LL_LLPACKETWINDOW_H
+
+#include <algorithm>
+#include <vector>
+
+#include "stdtypes.h"
+#include "llpreprocessor.h"
+
+#if LL_MSVC
+#include <intrin.h>
+#endif
+
+const U32 LL_PACKET_ID_SPACE = 0x01000000;			// packet IDs are 24 bits on the wire
+const U32 LL_PACKET_ID_MASK = LL_PACKET_ID_SPACE - 1;
+const U32 LL_PACKET_ID_HALF = LL_PACKET_ID_SPACE >> 1;
+
+// Per-circuit state keyed by packet ID.  IDs on a circuit are dense and go
+// up by one per packet (modulo 2^24), so instead of a tree the entries live
+// in a ring indexed by the low bits of the ID, with a bitmap of occupied
+// slots.  Lookup, insert and erase are O(1); walking the entries in ID order
+// skips 32 empty slots per bitmap word.
+//
+// The window covers the IDs [mBase, mBase + mSpan), wrap included.  It grows
+// by doubling to take IDs on either side, up to max_span IDs; inserting past
+// that drops the oldest entries (see dropsBefore()), and an ID more than
+// max_span behind the newest one is ignored.
+//
+// Offsets from firstOffset()/nextOffset() are relative to the base, so they
+// stay valid across insert() and erase(), which never move the base forward.
+// Only trim(), eraseBefore() and clear() do.
+//
+//	for (S32 off = window.firstOffset(); off >= 0; off = window.nextOffset(off + 1))
+//		use(window.idAt(off), window.at(off));
+
+template <class DATA>
+class LLPacketIDWindow
+{
+public:
+	explicit LLPacketIDWindow(U32 max_span = LL_PACKET_ID_HALF)
+	:	mMask(0), mBase(0), mSpan(0), mCount(0), mMaxSpan(max_span)
+	{
+	}
+
+	bool empty() const		{ return mCount == 0; }
+	S32 size() const		{ return mCount; }
+
+	DATA* find(TPACKETID id)
+	{
+		U32 off = distance(id);
+		if (off >= mSpan)
+		{
+			return NULL;
+		}
+		U32 slot = id & mMask;
+		return isSet(slot) ? &mSlots[slot] : NULL;
+	}
+
+	void insert(TPACKETID id, const DATA& data)
+	{
+		id &= LL_PACKET_ID_MASK;
+		if (mCount == 0)
+		{
+			mBase = id;
+			mSpan = 0;
+		}
+
+		U32 off = distance(id);
+		if (off < LL_PACKET_ID_HALF)
+		{
+			if (off >= mSpan)
+			{
+				if (off >= mMaxSpan)
+				{
+					eraseBefore((id - mMaxSpan + 1) & LL_PACKET_ID_MASK);
+					if (mCount == 0)
+					{
+						mBase = id;
+						mSpan = 0;
+					}
+					off = distance(id);
+				}
+				reserve(off + 1);
+				mSpan = off + 1;
+			}
+		}
+		else
+		{
+			// Before the base: extend the window backwards
+			U32 back = LL_PACKET_ID_SPACE - off;
+			if (mSpan + back > mMaxSpan)
+			{
+				return;
+			}
+			reserve(mSpan + back);
+			mBase = id;
+			mSpan += back;
+		}
+
+		U32 slot = id & mMask;
+		if (!isSet(slot))
+		{
+			mBits[slot >> 5] |= 1U << (slot & 31);
+			mCount++;
+		}
+		mSlots[slot] = data;
+	}
+
+	bool erase(TPACKETID id)
+	{
+		if (distance(id) >= mSpan)
+		{
+			return false;
+		}
+		U32 slot = id & mMask;
+		if (!isSet(slot))
+		{
+			return false;
+		}
+		mBits[slot >> 5] &= ~(1U << (slot & 31));
+		mSlots[slot] = DATA();
+		mCount--;
+		return true;
+	}
+
+	// Number of offsets from the base that insert(id) would drop to keep
+	// the window within max_span; 0 if it would drop nothing.  Callers
+	// that own what the entries point to release those first.
+	U32 dropsBefore(TPACKETID id) const
+	{
+		if (mCount == 0)
+		{
+			return 0;
+		}
+		U32 off = distance(id & LL_PACKET_ID_MASK);
+		if (off >= LL_PACKET_ID_HALF || off < mMaxSpan)
+		{
+			return 0;
+		}
+		return off - mMaxSpan + 1;
+	}
+
+	// Drops every entry older than id.
+	void eraseBefore(TPACKETID id)
+	{
+		id &= LL_PACKET_ID_MASK;
+		U32 off = distance(id);
+		if (off >= LL_PACKET_ID_HALF)
+		{
+			// id is already before the window
+			return;
+		}
+		if (off >= mSpan)
+		{
+			clear();
+			mBase = id;
+			return;
+		}
+		for (S32 cur = firstOffset(); cur >= 0 && (U32)cur < off; cur = nextOffset(cur + 1))
+		{
+			erase(idAt(cur));
+		}
+		mBase = id;
+		mSpan -= off;
+		trim();
+	}
+
+	// Moves the base up to the oldest entry.
+	void trim()
+	{
+		S32 off = firstOffset();
+		if (off < 0)
+		{
+			mSpan = 0;
+			return;
+		}
+		mBase = (mBase + off) & LL_PACKET_ID_MASK;
+		mSpan -= off;
+	}
+
+	void clear()
+	{
+		for (S32 cur = firstOffset(); cur >= 0; cur = nextOffset(cur + 1))
+		{
+			mSlots[(mBase + cur) & mMask] = DATA();
+		}
+		std::fill(mBits.begin(), mBits.end(), 0);
+		mSpan = 0;
+		mCount = 0;
+	}
+
+	S32 firstOffset() const		{ return nextOffset(0); }
+
+	// First occupied offset at or after offset, -1 if none.
+	S32 nextOffset(U32 offset) const
+	{
+		while (offset < mSpan)
+		{
+			U32 slot = (mBase + offset) & mMask;
+			U32 word = mBits[slot >> 5] >> (slot & 31);
+			if (word)
+			{
+				offset += firstSetBit(word);
+				return offset < mSpan ? (S32)offset : -1;
+			}
+			offset += 32 - (slot & 31);
+		}
+		return -1;
+	}
+
+	TPACKETID idAt(U32 offset) const	{ return (mBase + offset) & LL_PACKET_ID_MASK; }
+	DATA& at(U32 offset)				{ return mSlots[(mBase + offset) & mMask]; }
+
+private:
+	U32 distance(TPACKETID id) const	{ return (id - mBase) & LL_PACKET_ID_MASK; }
+	bool isSet(U32 slot) const			{ return (mBits[slot >> 5] >> (slot & 31)) & 1; }
+
+	static U32 firstSetBit(U32 word)
+	{
+#if LL_MSVC
+		unsigned long index;
+		_BitScanForward(&index, word);
+		return (U32)index;
+#else
+		return (U32)__builtin_ctz(word);
+#endif
+	}
+
+	// Makes room for span IDs from the base.  The ring size is a power of
+	// two, so IDs keep their slot across the 2^24 wrap, but they have to be
+	// placed again when it grows.
+	void reserve(U32 span)
+	{
+		U32 capacity = mMask + 1;
+		if (!mSlots.empty() && span <= capacity)
+		{
+			return;
+		}
+		U32 new_capacity = mSlots.empty() ? 64 : capacity;
+		while (new_capacity < span)
+		{
+			new_capacity <<= 1;
+		}
+
+		std::vector<DATA> slots(new_capacity);
+		std::vector<U32> bits(new_capacity >> 5, 0);
+		U32 new_mask = new_capacity - 1;
+		for (S32 cur = firstOffset(); cur >= 0; cur = nextOffset(cur + 1))
+		{
+			U32 id = idAt(cur);
+			slots[id & new_mask] = mSlots[id & mMask];
+			bits[(id & new_mask) >> 5] |= 1U << (id & 31);
+		}
+		mSlots.swap(slots);
+		mBits.swap(bits);
+		mMask = new_mask;
+	}
+
+	std::vector<DATA>	mSlots;
+	std::vector<U32>	mBits;
+	U32					mMask;
+	TPACKETID			mBase;
+	U32					mSpan;
+	S32					mCount;
+	U32					mMaxSpan;
+};
+
+#endif
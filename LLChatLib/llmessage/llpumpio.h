@@ -447,6 +447,16 @@ public:
 		return mRunningChains.size();
 	}
 
+	/** 
+	 * @brief Return true if callbacks or new chains are queued for the
+	 * next <code>pump()</code>/<code>callback()</code>, meaning the
+	 * caller should not sleep.
+	 */
+	bool hasPendingWork() const
+	{
+		return !mPendingCallbacks.empty() || !mPendingChains.empty();
+	}
+
 
 private:
 	static LLPumpIO*	mInstance;
@@ -36,6 +36,7 @@
 
 #include "llmessagetemplate.h"
 #include "llquaternion.h"
+#include "llzerocode.h"
 #include "u64.h"
 #include "v3dmath.h"
 #include "v3math.h"
@@ -505,77 +506,37 @@ static S32 zero_code(U8 **data, U32 *data_size)
 	// coding can potentially increase the size of the send data.
 	static U8 encodedSendBuffer[2 * MAX_BUFFER_SIZE];
 
-	S32 count = *data_size;
-	
-	S32 net_gain = 0;
-	U8 num_zeroes = 0;
-	
-	U8 *inptr = (U8 *)*data;
-	U8 *outptr = (U8 *)encodedSendBuffer;
-
-// skip the packet id field
-
-	for (U32 ii = 0; ii < LL_PACKET_ID_SIZE ; ++ii)
-	{
-		count--;
-		*outptr++ = *inptr++;
-	}
-
-// build encoded packet, keeping track of net size gain
-
-// sequential zero bytes are encoded as 0 [U8 count] 
-// with 0 0 [count] representing wrap (>256 zeroes)
-
-	while (count--)
+	S32 body_size = (S32)*data_size - LL_PACKET_ID_SIZE;
+	if (body_size <= 0)
 	{
-		if (!(*inptr))   // in a zero count
-		{
-			if (num_zeroes)
-			{
-				if (++num_zeroes > 254)
-				{
-					*outptr++ = num_zeroes;
-					num_zeroes = 0;
-				}
-				net_gain--;   // subseqent zeroes save one
-			}
-			else
-			{
-				*outptr++ = 0;
-				net_gain++;  // starting a zero count adds one
-				num_zeroes = 1;
-			}
-			inptr++;
-		}
-		else
-		{
-			if (num_zeroes)
-			{
-				*outptr++ = num_zeroes;
-				num_zeroes = 0;
-			}
-			*outptr++ = *inptr++;
-		}
+		return 0;
 	}
 
-	if (num_zeroes)
+	// Encode straight into the send buffer, giving up as soon as the
+	// coded body stops being smaller than the original.
+	S32 encoded_size = ll_zero_code_encode(
+		*data + LL_PACKET_ID_SIZE,
+		body_size,
+		encodedSendBuffer + LL_PACKET_ID_SIZE,
+		body_size - 1);
+	if (encoded_size < 0)
 	{
-		*outptr++ = num_zeroes;
+		return 0;
 	}
 
-	if (net_gain < 0)
-	{
-		// TODO: babbage: reinstate stat collecting...
-		//mCompressedPacketsOut++;
-		//mUncompressedBytesOut += *data_size;
+	S32 net_gain = encoded_size - body_size;
 
-		*data = encodedSendBuffer;
-		*data_size += net_gain;
-		encodedSendBuffer[0] |= LL_ZERO_CODE_FLAG;          // set the head bit to indicate zero coding
+	// TODO: babbage: reinstate stat collecting...
+	//mCompressedPacketsOut++;
+	//mUncompressedBytesOut += *data_size;
 
-		//mCompressedBytesOut += *data_size;
+	// skip the packet id field
+	memcpy(encodedSendBuffer, *data, LL_PACKET_ID_SIZE);		/* Flawfinder: ignore */
+	*data = encodedSendBuffer;
+	*data_size += net_gain;
+	encodedSendBuffer[0] |= LL_ZERO_CODE_FLAG;          // set the head bit to indicate zero coding
 
-	}
+	//mCompressedBytesOut += *data_size;
 	//mTotalBytesOut += *data_size;
 
 	return(net_gain);
@@ -829,6 +790,117 @@ U32 LLTemplateMessageBuilder::buildMessage(
 	return result;
 }
 
+// walks a block the way buildBlock() lays it out, feeding the sizer
+// instead of a buffer
+static void measureBlock(LLZeroCodeSizer& sizer, const LLMessageBlock* template_data, LLMsgData* message_data)
+{
+	LLMsgData::msg_blk_data_map_t::const_iterator block_iter = message_data->mMemberBlocks.find(template_data->mName);
+	LLMsgBlkDataPtr mbci = block_iter->second;
+
+	S32 block_count = mbci->mBlockNumber;
+	if (template_data->mType == MBT_VARIABLE)
+	{
+		U8 temp_block_number = (U8)mbci->mBlockNumber;
+		sizer.add(&temp_block_number, sizeof(U8));
+	}
+
+	while(block_count > 0)
+	{
+		for (LLMsgBlkData::msg_var_data_map_t::const_iterator iter = mbci->mMemberVarData.begin();
+			 iter != mbci->mMemberVarData.end(); iter++)
+		{
+			const LLMsgVarData& mvci = *iter;
+			if (mvci.getSize() == -1)
+			{
+				// buildMessage() will complain about this one
+				continue;
+			}
+
+			S32 data_size = mvci.getDataSize();
+			if(data_size > 0)
+			{
+				U8 size_bytes[4];
+				S32 size = mvci.getSize();
+				U8 sizeb;
+				U16 sizeh;
+				switch(data_size)
+				{
+				case 1:
+					sizeb = size;
+					htonmemcpy(size_bytes, &sizeb, MVT_U8, 1);
+					break;
+				case 2:
+					sizeh = size;
+					htonmemcpy(size_bytes, &sizeh, MVT_U16, 2);
+					break;
+				case 4:
+					htonmemcpy(size_bytes, &size, MVT_S32, 4);
+					break;
+				default:
+					data_size = 0;
+					break;
+				}
+				sizer.add(size_bytes, data_size);
+			}
+
+			if(mvci.getData() != NULL)
+			{
+				sizer.add((const U8*)mvci.getData(), mvci.getSize());
+			}
+		}
+
+		--block_count;
+		++block_iter;
+		if (block_iter != message_data->mMemberBlocks.end())
+		{
+			mbci = block_iter->second;
+		}
+	}
+}
+
+void LLTemplateMessageBuilder::measureZeroCode(S32& body_size, S32& coded_size) const
+{
+	LLZeroCodeSizer sizer;
+	if (mCurrentSMessageTemplate)
+	{
+		U8 message_number[4];
+		S32 number_size = 0;
+		switch(mCurrentSMessageTemplate->mFrequency)
+		{
+		case MFT_HIGH:
+			message_number[number_size++] = (U8)mCurrentSMessageTemplate->mMessageNumber;
+			break;
+		case MFT_MEDIUM:
+			message_number[number_size++] = 255;
+			message_number[number_size++] = (U8)(mCurrentSMessageTemplate->mMessageNumber & 255);
+			break;
+		case MFT_LOW:
+		{
+			U16 message_num = htons((U16)(mCurrentSMessageTemplate->mMessageNumber & 0xFFFF));
+			message_number[number_size++] = 255;
+			message_number[number_size++] = 255;
+			memcpy(&message_number[number_size], &message_num, sizeof(U16));	/*Flawfinder: ignore*/
+			number_size += sizeof(U16);
+			break;
+		}
+		default:
+			break;
+		}
+		sizer.add(message_number, number_size);
+
+		for(LLMessageTemplate::message_block_map_t::const_iterator
+				iter = mCurrentSMessageTemplate->mMemberBlocks.begin(),
+				end = mCurrentSMessageTemplate->mMemberBlocks.end();
+			 iter != end;
+			++iter)
+		{
+			measureBlock(sizer, *iter, mCurrentSMessageData);
+		}
+	}
+	body_size = sizer.getRawSize();
+	coded_size = sizer.getCodedSize();
+}
+
 void LLTemplateMessageBuilder::copyFromMessageData(const LLMsgData& data)
 {
 	// copy the blocks
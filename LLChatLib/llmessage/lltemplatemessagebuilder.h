@@ -103,6 +103,10 @@ public:
 	virtual void copyFromMessageData(const LLMsgData& data);
 	virtual void copyFromLLSD(const LLSD&);
 
+	// Sizes the body buildMessage() would write, plain and zero coded,
+	// without building it.
+	void measureZeroCode(S32& body_size, S32& coded_size) const;
+
 private:
 	void addData(const char* varname, const void* data, 
 					 EMsgVariableType type, S32 size);
@@ -50,8 +50,11 @@ LLTemplateMessageReader::LLTemplateMessageReader(message_template_number_map_t&
 	mReceiveSize(0),
 	mCurrentRMessageTemplate(NULL),
 	mCurrentRMessageData(NULL),
-	mMessageNumbers(number_template_map)
+	mMessageNumbers(number_template_map),
+	mCurrentRBuffer(NULL),
+	mOffsetsDecoded(FALSE)
 {
+	buildDispatchTable();
 }
 
 //virtual 
@@ -68,204 +71,440 @@ void LLTemplateMessageReader::clearMessage()
 	mCurrentRMessageTemplate = NULL;
 	delete mCurrentRMessageData;
 	mCurrentRMessageData = NULL;
+	mCurrentRBuffer = NULL;
+	mOffsetsDecoded = FALSE;
 }
 
-void LLTemplateMessageReader::getData(const char *blockname, const char *varname, void *datap, S32 size, S32 blocknum, S32 max_size)
+// The message template file is parsed once at startup, so flatten the
+// number map into arrays: one per frequency, plus one for the fixed
+// 0xFFFFFFxx messages so the low frequency table stays small.
+void LLTemplateMessageReader::buildDispatchTable()
 {
-	// is there a message ready to go?
-	if (mReceiveSize == -1)
+	mHighTemplates.assign(256, NULL);
+	mMediumTemplates.assign(256, NULL);
+	mFixedTemplates.assign(256, NULL);
+	mLowTemplates.clear();
+
+	for (message_template_number_map_t::const_iterator iter = mMessageNumbers.begin();
+		 iter != mMessageNumbers.end(); ++iter)
 	{
-		llerrs << "No message waiting for decode 2!" << llendl;
-		return;
+		U32 num = iter->first;
+		if (num < 256)
+		{
+			mHighTemplates[num] = iter->second;
+		}
+		else if ((num & 0xFFFFFF00) == 0xFF00)
+		{
+			mMediumTemplates[num & 0xFF] = iter->second;
+		}
+		else if ((num & 0xFFFFFF00) == 0xFFFFFF00)
+		{
+			mFixedTemplates[num & 0xFF] = iter->second;
+		}
+		else if ((num & 0xFFFF0000) == 0xFFFF0000)
+		{
+			U32 id = num & 0xFFFF;
+			if (id >= mLowTemplates.size())
+			{
+				mLowTemplates.resize(id + 1, NULL);
+			}
+			mLowTemplates[id] = iter->second;
+		}
+		else
+		{
+			llwarns << "Message #" << std::hex << num << std::dec
+				<< " has no valid frequency encoding" << llendl;
+		}
 	}
+}
 
-	if (!mCurrentRMessageData)
+inline LLMessageTemplate* LLTemplateMessageReader::lookupTemplate(U32 num) const
+{
+	if (num < 256)
 	{
-		llerrs << "Invalid mCurrentMessageData in getData!" << llendl;
-		return;
+		return mHighTemplates[num];
 	}
+	if ((num & 0xFFFFFF00) == 0xFF00)
+	{
+		return mMediumTemplates[num & 0xFF];
+	}
+	if ((num & 0xFFFFFF00) == 0xFFFFFF00)
+	{
+		return mFixedTemplates[num & 0xFF];
+	}
+	U32 id = num & 0xFFFF;
+	return id < mLowTemplates.size() ? mLowTemplates[id] : NULL;
+}
 
-	char *bnamep = (char *)blockname + blocknum; // this works because it's just a hash.  The bnamep is never derefference
-	char *vnamep = (char *)varname; 
-
-	LLMsgData::msg_blk_data_map_t::const_iterator iter = mCurrentRMessageData->mMemberBlocks.find(bnamep);
-
-	if (iter == mCurrentRMessageData->mMemberBlocks.end())
+// Walk the template once, recording where each variable lives in the
+// packet. Nothing is copied; get*() reads straight out of the buffer.
+void LLTemplateMessageReader::decodeOffsets()
+{
+	if (mOffsetsDecoded)
 	{
-		llerrs << "Block " << blockname << " #" << blocknum
-			<< " not in message " << mCurrentRMessageData->mName << llendl;
 		return;
 	}
+	mOffsetsDecoded = TRUE;
+	mBlockOffsets.clear();
+	mVarOffsets.clear();
 
-	LLMsgBlkDataPtr msg_block_data = iter->second;
-	LLMsgVarData& vardata = msg_block_data->mMemberVarData[vnamep];
+	// The offset tells us how may bytes to skip after the end of the
+	// message name.
+	U8 offset = mCurrentRBuffer[PHL_OFFSET];
+	S32 decode_pos = LL_PACKET_ID_SIZE + (S32)(mCurrentRMessageTemplate->mFrequency) + offset;
 
-	if (!vardata.getName())
+	LLMessageTemplate::message_block_map_t::const_iterator iter;
+	for(iter = mCurrentRMessageTemplate->mMemberBlocks.begin();
+		iter != mCurrentRMessageTemplate->mMemberBlocks.end();
+		++iter)
 	{
-		llerrs << "Variable "<< vnamep << " not in message "
-			<< mCurrentRMessageData->mName<< " block " << bnamep << llendl;
-		return;
+		LLMessageBlock* mbci = *iter;
+		S32 repeat_number = 0;
+
+		// how many of this block?
+		if (mbci->mType == MBT_SINGLE)
+		{
+			// just one
+			repeat_number = 1;
+		}
+		else if (mbci->mType == MBT_MULTIPLE)
+		{
+			// a known number
+			repeat_number = mbci->mNumber;
+		}
+		else if (mbci->mType == MBT_VARIABLE)
+		{
+			// need to read the number from the message
+			// repeat number is a single byte
+			if (decode_pos >= mReceiveSize)
+			{
+				// hetgrid says that missing variable blocks at end of
+				// message are legal, default to 0 repeats
+				repeat_number = 0;
+			}
+			else
+			{
+				repeat_number = mCurrentRBuffer[decode_pos];
+				decode_pos++;
+			}
+		}
+		else
+		{
+			llerrs << "Unknown block type" << llendl;
+			return;
+		}
+
+		BlockOffsets block;
+		block.mFirstVar = (S32)mVarOffsets.size();
+		block.mRepeat = repeat_number;
+		block.mVarCount = (S32)mbci->mMemberVariables.size();
+		mBlockOffsets.push_back(block);
+
+		for (S32 i = 0; i < repeat_number; i++)
+		{
+			for (LLMessageBlock::message_variable_map_t::const_iterator var_iter = 
+					 mbci->mMemberVariables.begin();
+				 var_iter != mbci->mMemberVariables.end(); var_iter++)
+			{
+				const LLMessageVariable& mvci = **var_iter;
+				VarOffsets var;
+				var.mType = mvci.getType();
+
+				if (mvci.getType() == MVT_VARIABLE)
+				{
+					// variable, get the number of bytes to read from the template
+					S32 data_size = mvci.getSize();
+					U8 tsizeb = 0;
+					U16 tsizeh = 0;
+					U32 tsize = 0;
+
+					if ((decode_pos + data_size) > mReceiveSize)
+					{
+						logRanOffEndOfPacket(mCurrentRSender, decode_pos, data_size);
+
+						// default to 0 length variable blocks
+						tsize = 0;
+					}
+					else
+					{
+						switch(data_size)
+						{
+						case 1:
+							htonmemcpy(&tsizeb, &mCurrentRBuffer[decode_pos], MVT_U8, 1);
+							tsize = tsizeb;
+							break;
+						case 2:
+							htonmemcpy(&tsizeh, &mCurrentRBuffer[decode_pos], MVT_U16, 2);
+							tsize = tsizeh;
+							break;
+						case 4:
+							htonmemcpy(&tsize, &mCurrentRBuffer[decode_pos], MVT_U32, 4);
+							break;
+						default:
+							llerrs << "Attempting to read variable field with unknown size of " << data_size << llendl;
+							break;
+						}
+					}
+					decode_pos += data_size;
+
+					if (decode_pos + (S32)tsize > mReceiveSize)
+					{
+						logRanOffEndOfPacket(mCurrentRSender, decode_pos, tsize);
+						tsize = llmax(0, mReceiveSize - decode_pos);
+					}
+
+					var.mOffset = decode_pos;
+					var.mSize = tsize;
+					decode_pos += tsize;
+				}
+				else
+				{
+					// fixed!
+					if ((decode_pos + mvci.getSize()) > mReceiveSize)
+					{
+						logRanOffEndOfPacket(mCurrentRSender, decode_pos, mvci.getSize());
+
+						// default to 0s.
+						var.mOffset = -1;
+					}
+					else
+					{
+						var.mOffset = decode_pos;
+					}
+					var.mSize = mvci.getSize();
+					decode_pos += mvci.getSize();
+				}
+
+				mVarOffsets.push_back(var);
+			}
+		}
 	}
+}
 
-	if (size && size != vardata.getSize())
+// A message made only of variable blocks may arrive with none of them
+BOOL LLTemplateMessageReader::isEmptyMessage()
+{
+	if (mCurrentRMessageTemplate->mMemberBlocks.empty())
 	{
-		llerrs << "Msg " << mCurrentRMessageData->mName 
-			<< " variable " << vnamep
-			<< " is size " << vardata.getSize()
-			<< " but copying into buffer of size " << size
-			<< llendl;
-		return;
+		return FALSE;
 	}
 
-
-	const S32 vardata_size = vardata.getSize();
-	if( max_size >= vardata_size )
-	{   
-		switch( vardata_size )
-		{ 
-		case 1:
-			*((U8*)datap) = *((U8*)vardata.getData());
-			break;
-		case 2:
-			*((U16*)datap) = *((U16*)vardata.getData());
-			break;
-		case 4:
-			*((U32*)datap) = *((U32*)vardata.getData());
-			break;
-		case 8:
-			((U32*)datap)[0] = ((U32*)vardata.getData())[0];
-			((U32*)datap)[1] = ((U32*)vardata.getData())[1];
-			break;
-		default:
-			memcpy(datap, vardata.getData(), vardata_size);
-			break;
+	LLMessageTemplate::message_block_map_t::const_iterator iter;
+	for(iter = mCurrentRMessageTemplate->mMemberBlocks.begin();
+		iter != mCurrentRMessageTemplate->mMemberBlocks.end();
+		++iter)
+	{
+		if ((*iter)->mType != MBT_VARIABLE)
+		{
+			return FALSE;
 		}
 	}
-	else
+
+	decodeOffsets();
+	for (std::vector<BlockOffsets>::const_iterator block_iter = mBlockOffsets.begin();
+		 block_iter != mBlockOffsets.end(); ++block_iter)
 	{
-		llwarns << "Msg " << mCurrentRMessageData->mName 
-			<< " variable " << vnamep
-			<< " is size " << vardata.getSize()
-			<< " but truncated to max size of " << max_size
-			<< llendl;
+		if (block_iter->mRepeat)
+		{
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
 
-		memcpy(datap, vardata.getData(), max_size);
+const LLTemplateMessageReader::BlockOffsets* LLTemplateMessageReader::findBlockOffsets(const char *blockname)
+{
+	decodeOffsets();
+
+	const LLMessageTemplate::message_block_map_t& blocks = mCurrentRMessageTemplate->mMemberBlocks;
+	LLMessageTemplate::message_block_map_t::const_iterator iter = blocks.find((char *)blockname);
+	if (iter == blocks.end())
+	{
+		return NULL;
 	}
+	S32 block_index = (S32)(iter - blocks.begin());
+	if (block_index >= (S32)mBlockOffsets.size())
+	{
+		return NULL;
+	}
+	return &mBlockOffsets[block_index];
 }
 
-S32 LLTemplateMessageReader::getNumberOfBlocks(const char *blockname)
+const LLTemplateMessageReader::VarOffsets* LLTemplateMessageReader::findVarOffsets(const char *blockname, S32 blocknum, const char *varname)
 {
-	// is there a message ready to go?
-	if (mReceiveSize == -1)
+	const BlockOffsets* block = findBlockOffsets(blockname);
+	if (!block || blocknum < 0 || blocknum >= block->mRepeat)
 	{
-		llerrs << "No message waiting for decode 3!" << llendl;
-		return -1;
+		llerrs << "Block " << blockname << " #" << blocknum
+			<< " not in message " << mCurrentRMessageTemplate->mName << llendl;
+		return NULL;
 	}
 
-	if (!mCurrentRMessageData)
+	const LLMessageBlock* mbci = mCurrentRMessageTemplate->getBlock((char *)blockname);
+	LLMessageBlock::message_variable_map_t::const_iterator iter = mbci->mMemberVariables.find(varname);
+	if (iter == mbci->mMemberVariables.end())
 	{
-		llerrs << "Invalid mCurrentRMessageData in getData!" << llendl;
-		return -1;
+		llerrs << "Variable "<< varname << " not in message "
+			<< mCurrentRMessageTemplate->mName << " block " << blockname << llendl;
+		return NULL;
 	}
+	S32 var_index = (S32)(iter - mbci->mMemberVariables.begin());
 
-	char *bnamep = (char *)blockname; 
+	return &mVarOffsets[block->mFirstVar + blocknum * block->mVarCount + var_index];
+}
 
-	LLMsgData::msg_blk_data_map_t::const_iterator iter = mCurrentRMessageData->mMemberBlocks.find(bnamep);
-	
-	if (iter == mCurrentRMessageData->mMemberBlocks.end())
+// Only copyToBuilder() still wants the old map-of-blocks form
+void LLTemplateMessageReader::buildMessageData()
+{
+	if (mCurrentRMessageData)
 	{
-		return 0;
+		return;
 	}
+	decodeOffsets();
+
+	mCurrentRMessageData = new LLMsgData(mCurrentRMessageTemplate->mName);
 
-	return (iter->second)->mBlockNumber;
+	S32 block_index = 0;
+	LLMessageTemplate::message_block_map_t::const_iterator iter;
+	for(iter = mCurrentRMessageTemplate->mMemberBlocks.begin();
+		iter != mCurrentRMessageTemplate->mMemberBlocks.end();
+		++iter, ++block_index)
+	{
+		LLMessageBlock* mbci = *iter;
+		const BlockOffsets& block = mBlockOffsets[block_index];
+
+		for (S32 i = 0; i < block.mRepeat; i++)
+		{
+			// build new name to prevent collisions
+			LLMsgBlkDataPtr cur_data_block( new LLMsgBlkData(mbci->mName, block.mRepeat) );
+			cur_data_block->mName = mbci->mName + i;
+			mCurrentRMessageData->addBlock(cur_data_block);
+
+			S32 var_index = 0;
+			for (LLMessageBlock::message_variable_map_t::const_iterator var_iter = 
+					 mbci->mMemberVariables.begin();
+				 var_iter != mbci->mMemberVariables.end(); var_iter++, var_index++)
+			{
+				const LLMessageVariable& mvci = **var_iter;
+				const VarOffsets& var = mVarOffsets[block.mFirstVar + i * block.mVarCount + var_index];
+
+				cur_data_block->addVariable(mvci.getName(), mvci.getType());
+				if (var.mOffset < 0)
+				{
+					std::vector<U8> data(var.mSize);
+					cur_data_block->addData(mvci.getName(), &(data[0]), var.mSize, mvci.getType());
+				}
+				else
+				{
+					cur_data_block->addData(mvci.getName(), &mCurrentRBuffer[var.mOffset], var.mSize, mvci.getType());
+				}
+			}
+		}
+	}
 }
 
-S32 LLTemplateMessageReader::getSize(const char *blockname, const char *varname)
+void LLTemplateMessageReader::getData(const char *blockname, const char *varname, void *datap, S32 size, S32 blocknum, S32 max_size)
 {
 	// is there a message ready to go?
-	if (mReceiveSize == -1)
+	if (mReceiveSize == -1 || !mCurrentRBuffer)
 	{
-		llerrs << "No message waiting for decode 4!" << llendl;
-		return -1;
+		llerrs << "No message waiting for decode 2!" << llendl;
+		return;
 	}
 
-	if (!mCurrentRMessageData)
+	const VarOffsets* var = findVarOffsets(blockname, blocknum, varname);
+	if (!var)
 	{
-		llerrs << "Invalid mCurrentRMessageData in getData!" << llendl;
-		return -1;
+		return;
 	}
 
-	char *bnamep = (char *)blockname; 
-
-	LLMsgData::msg_blk_data_map_t::const_iterator iter = mCurrentRMessageData->mMemberBlocks.find(bnamep);
-	
-	if (iter == mCurrentRMessageData->mMemberBlocks.end())
+	if (size && size != var->mSize)
 	{
-		llerrs << "Block " << bnamep << " not in message "
-			<< mCurrentRMessageData->mName << llendl;
-		return -1;
+		llerrs << "Msg " << mCurrentRMessageTemplate->mName 
+			<< " variable " << varname
+			<< " is size " << var->mSize
+			<< " but copying into buffer of size " << size
+			<< llendl;
+		return;
 	}
 
-	char *vnamep = (char *)varname; 
+	if (var->mOffset < 0)
+	{
+		memset(datap, 0, llmin(var->mSize, max_size));
+		return;
+	}
 
-	LLMsgBlkDataPtr msg_data = iter->second;
-	LLMsgVarData& vardata = msg_data->mMemberVarData[vnamep];
-	
-	if (!vardata.getName())
+	const U8* src = &mCurrentRBuffer[var->mOffset];
+	if( max_size >= var->mSize )
 	{
-		llerrs << "Variable " << varname << " not in message "
-			<< mCurrentRMessageData->mName << " block " << bnamep << llendl;
-		return -1;
+		htonmemcpy(datap, src, var->mType, var->mSize);
 	}
+	else
+	{
+		llwarns << "Msg " << mCurrentRMessageTemplate->mName 
+			<< " variable " << varname
+			<< " is size " << var->mSize
+			<< " but truncated to max size of " << max_size
+			<< llendl;
+
+		memcpy(datap, src, max_size);
+	}
+}
 
-	if (mCurrentRMessageTemplate->mMemberBlocks[bnamep]->mType != MBT_SINGLE)
+S32 LLTemplateMessageReader::getNumberOfBlocks(const char *blockname)
+{
+	// is there a message ready to go?
+	if (mReceiveSize == -1 || !mCurrentRBuffer)
 	{
-		llerrs << "Block " << bnamep << " isn't type MBT_SINGLE,"
-			" use getSize with blocknum argument!" << llendl;
+		llerrs << "No message waiting for decode 3!" << llendl;
 		return -1;
 	}
 
-	return vardata.getSize();
+	const BlockOffsets* block = findBlockOffsets(blockname);
+	return block ? block->mRepeat : 0;
 }
 
-S32 LLTemplateMessageReader::getSize(const char *blockname, S32 blocknum, const char *varname)
+S32 LLTemplateMessageReader::getSize(const char *blockname, const char *varname)
 {
 	// is there a message ready to go?
-	if (mReceiveSize == -1)
+	if (mReceiveSize == -1 || !mCurrentRBuffer)
 	{
-		llerrs << "No message waiting for decode 5!" << llendl;
+		llerrs << "No message waiting for decode 4!" << llendl;
 		return -1;
 	}
 
-	if (!mCurrentRMessageData)
+	const VarOffsets* var = findVarOffsets(blockname, 0, varname);
+	if (!var)
 	{
-		llerrs << "Invalid mCurrentRMessageData in getData!" << llendl;
 		return -1;
 	}
 
-	char *bnamep = (char *)blockname + blocknum; 
-	char *vnamep = (char *)varname; 
+	if (mCurrentRMessageTemplate->getBlock((char *)blockname)->mType != MBT_SINGLE)
+	{
+		llerrs << "Block " << blockname << " isn't type MBT_SINGLE,"
+			" use getSize with blocknum argument!" << llendl;
+		return -1;
+	}
+
+	return var->mSize;
+}
 
-	LLMsgData::msg_blk_data_map_t::const_iterator iter = mCurrentRMessageData->mMemberBlocks.find(bnamep);
-	
-	if (iter == mCurrentRMessageData->mMemberBlocks.end())
+S32 LLTemplateMessageReader::getSize(const char *blockname, S32 blocknum, const char *varname)
+{
+	// is there a message ready to go?
+	if (mReceiveSize == -1 || !mCurrentRBuffer)
 	{
-		llerrs << "Block " << bnamep << " not in message "
-			<< mCurrentRMessageData->mName << llendl;
+		llerrs << "No message waiting for decode 5!" << llendl;
 		return -1;
 	}
 
-	LLMsgBlkDataPtr msg_data = iter->second;
-	LLMsgVarData& vardata = msg_data->mMemberVarData[vnamep];
-	
-	if (!vardata.getName())
+	const VarOffsets* var = findVarOffsets(blockname, blocknum, varname);
+	if (!var)
 	{
-		llerrs << "Variable " << vnamep << " not in message "
-			<<  mCurrentRMessageData->mName << " block " << bnamep << llendl;
 		return -1;
 	}
 
-	return vardata.getSize();
+	return var->mSize;
 }
 
 void LLTemplateMessageReader::getBinaryData(const char *blockname, 
@@ -498,7 +737,7 @@ BOOL LLTemplateMessageReader::decodeTemplate(
 		return(FALSE);
 	}
 
-	LLMessageTemplate* temp = get_ptr_in_map(mMessageNumbers,num);
+	LLMessageTemplate* temp = lookupTemplate(num);
 	if (temp)
 	{
 		*msg_template = temp;
@@ -539,174 +778,29 @@ BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender
 	llassert( mReceiveSize >= 0 );
 	llassert( mCurrentRMessageTemplate);
 	llassert( !mCurrentRMessageData );
-	delete mCurrentRMessageData; // just to make sure
 
-	// The offset tells us how may bytes to skip after the end of the
-	// message name.
-	U8 offset = buffer[PHL_OFFSET];
-	S32 decode_pos = LL_PACKET_ID_SIZE + (S32)(mCurrentRMessageTemplate->mFrequency) + offset;
-
-	// create base working data set
-	mCurrentRMessageData = new LLMsgData(mCurrentRMessageTemplate->mName);
+	// Offsets are only worked out if the handler asks for a variable
+	mCurrentRBuffer = buffer;
+	mCurrentRSender = sender;
+	mOffsetsDecoded = FALSE;
 
 #if 0
 	std::cout << "Message Received: " << mCurrentRMessageTemplate->mName << std::endl;
 #endif
-	
-	// loop through the template building the data structure as we go
-	LLMessageTemplate::message_block_map_t::const_iterator iter;
-	for(iter = mCurrentRMessageTemplate->mMemberBlocks.begin();
-		iter != mCurrentRMessageTemplate->mMemberBlocks.end();
-		++iter)
-	{
-		LLMessageBlock* mbci = *iter;
-		U8	repeat_number;
-		S32	i;
-
-		// how many of this block?
-
-		if (mbci->mType == MBT_SINGLE)
-		{
-			// just one
-			repeat_number = 1;
-		}
-		else if (mbci->mType == MBT_MULTIPLE)
-		{
-			// a known number
-			repeat_number = mbci->mNumber;
-		}
-		else if (mbci->mType == MBT_VARIABLE)
-		{
-			// need to read the number from the message
-			// repeat number is a single byte
-			if (decode_pos >= mReceiveSize)
-			{
-				// commented out - hetgrid says that missing variable blocks
-				// at end of message are legal
-				// logRanOffEndOfPacket(sender, decode_pos, 1);
-
-				// default to 0 repeats
-				repeat_number = 0;
-			}
-			else
-			{
-				repeat_number = buffer[decode_pos];
-				decode_pos++;
-			}
-		}
-		else
-		{
-			llerrs << "Unknown block type" << llendl;
-			return FALSE;
-		}
-
-		LLMsgBlkDataPtr cur_data_block;
-
-		// now loop through the block
-		for (i = 0; i < repeat_number; i++)
-		{
-			if (i)
-			{
-				// build new name to prevent collisions
-				// TODO: This should really change to a vector
-				cur_data_block.reset( new LLMsgBlkData(mbci->mName, repeat_number) );
-				cur_data_block->mName = mbci->mName + i;
-			}
-			else
-			{
-				cur_data_block.reset( new LLMsgBlkData(mbci->mName, repeat_number) );
-			}
-
-			// add the block to the message
-			mCurrentRMessageData->addBlock(cur_data_block);
-
-			// now read the variables
-			for (LLMessageBlock::message_variable_map_t::const_iterator iter = 
-					 mbci->mMemberVariables.begin();
-				 iter != mbci->mMemberVariables.end(); iter++)
-			{
-				const LLMessageVariable& mvci = **iter;
-
-				// ok, build out the variables
-				// add variable block
-				cur_data_block->addVariable(mvci.getName(), mvci.getType());
-
-				// what type of variable?
-				if (mvci.getType() == MVT_VARIABLE)
-				{
-					// variable, get the number of bytes to read from the template
-					S32 data_size = mvci.getSize();
-					U8 tsizeb = 0;
-					U16 tsizeh = 0;
-					U32 tsize = 0;
-
-					if ((decode_pos + data_size) > mReceiveSize)
-					{
-						logRanOffEndOfPacket(sender, decode_pos, data_size);
-
-						// default to 0 length variable blocks
-						tsize = 0;
-					}
-					else
-					{
-						switch(data_size)
-						{
-						case 1:
-							htonmemcpy(&tsizeb, &buffer[decode_pos], MVT_U8, 1);
-							tsize = tsizeb;
-							break;
-						case 2:
-							htonmemcpy(&tsizeh, &buffer[decode_pos], MVT_U16, 2);
-							tsize = tsizeh;
-							break;
-						case 4:
-							htonmemcpy(&tsize, &buffer[decode_pos], MVT_U32, 4);
-							break;
-						default:
-							llerrs << "Attempting to read variable field with unknown size of " << data_size << llendl;
-							break;
-						}
-					}
-					decode_pos += data_size;
 
-					cur_data_block->addData(mvci.getName(), &buffer[decode_pos], tsize, mvci.getType());
-					decode_pos += tsize;
-				}
-				else
-				{
-					// fixed!
-					// so, copy data pointer and set data size to fixed size
-					if ((decode_pos + mvci.getSize()) > mReceiveSize)
-					{
-						logRanOffEndOfPacket(sender, decode_pos, mvci.getSize());
-
-						// default to 0s.
-						U32 size = mvci.getSize();
-						std::vector<U8> data(size);
-						memset(&(data[0]), '\0', size);
-						cur_data_block->addData(mvci.getName(), &(data[0]), 
-												size, mvci.getType());
-					}
-					else
-					{
-						cur_data_block->addData(mvci.getName(), 
-												&buffer[decode_pos], 
-												mvci.getSize(), 
-												mvci.getType());
-					}
-					decode_pos += mvci.getSize();
-				}
-			}
-		}
-	}
-
-	if (mCurrentRMessageData->mMemberBlocks.empty()
-		&& !mCurrentRMessageTemplate->mMemberBlocks.empty())
+	if (isEmptyMessage())
 	{
 		lldebugs << "Empty message '" << mCurrentRMessageTemplate->mName << "' (no blocks)" << llendl;
 		return FALSE;
 	}
 
+	if (!mCurrentRMessageTemplate->hasHandlerFunc())
+	{
+		// Most object updates land here in a chat client; they cost no more than the template lookup
+		lldebugs << "Message from " << sender << " with no handler function received: " << mCurrentRMessageTemplate->mName << llendl;
+		return TRUE;
+	}
+
 	{
 		static LLTimer decode_timer;
 
@@ -811,9 +905,10 @@ bool LLTemplateMessageReader::isUdpBanned() const
 //virtual 
 void LLTemplateMessageReader::copyToBuilder(LLMessageBuilder& builder) const
 {
-	if(NULL == mCurrentRMessageTemplate)
+	if(NULL == mCurrentRMessageTemplate || NULL == mCurrentRBuffer)
     {
         return;
     }
+	const_cast<LLTemplateMessageReader*>(this)->buildMessageData();
 	builder.copyFromMessageData(*mCurrentRMessageData);
 }
@@ -34,8 +34,11 @@
 #define LL_LLTEMPLATEMESSAGEREADER_H
 
 #include "llmessagereader.h"
+#include "llhost.h"
+#include "llmsgvariabletype.h"
 
 #include <map>
+#include <vector>
 
 class LLMessageTemplate;
 class LLMsgData;
@@ -114,6 +117,32 @@ public:
 	
 private:
 
+	// Where one variable of the current message sits in the receive buffer
+	struct VarOffsets
+	{
+		S32					mOffset;		// -1 if the packet ran out first; reads as zeros
+		S32					mSize;
+		EMsgVariableType	mType;
+	};
+
+	// Variables of a block, repeated mRepeat times, start at mFirstVar
+	struct BlockOffsets
+	{
+		S32					mFirstVar;
+		S32					mRepeat;
+		S32					mVarCount;
+	};
+
+	void buildDispatchTable();
+	inline LLMessageTemplate* lookupTemplate(U32 num) const;
+
+	void decodeOffsets();
+	BOOL isEmptyMessage();
+	const VarOffsets* findVarOffsets(const char *blockname, S32 blocknum, 
+									 const char *varname);
+	const BlockOffsets* findBlockOffsets(const char *blockname);
+	void buildMessageData();
+
 	void getData(const char *blockname, const char *varname, void *datap, 
 				 S32 size = 0, S32 blocknum = 0, S32 max_size = S32_MAX);
 
@@ -126,8 +155,22 @@ private:
 
 	S32	mReceiveSize;
 	LLMessageTemplate* mCurrentRMessageTemplate;
-	LLMsgData* mCurrentRMessageData;
+	LLMsgData* mCurrentRMessageData;		// Only built for copyToBuilder()
 	message_template_number_map_t& mMessageNumbers;
+
+	// Dense message number -> template tables, see buildDispatchTable()
+	typedef std::vector<LLMessageTemplate*> template_table_t;
+	template_table_t mHighTemplates;
+	template_table_t mMediumTemplates;
+	template_table_t mLowTemplates;
+	template_table_t mFixedTemplates;
+
+	// Offsets are worked out on the first get*() call of each message
+	const U8* mCurrentRBuffer;
+	LLHost mCurrentRSender;
+	BOOL mOffsetsDecoded;
+	std::vector<BlockOffsets> mBlockOffsets;
+	std::vector<VarOffsets> mVarOffsets;
 };
 
 #endif // LL_LLTEMPLATEMESSAGEREADER_H
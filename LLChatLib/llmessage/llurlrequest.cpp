@@ -63,6 +63,7 @@ class LLURLRequestDetail
 public:
 	LLURLRequestDetail();
 	~LLURLRequestDetail();
+	void releaseHostSlot();
 	std::string mURL;
 	LLCurlEasyRequest* mCurlRequest;
 	LLBufferArray* mResponseBuffer;
@@ -71,6 +72,7 @@ public:
 	U32 mBodyLimit;
 	S32 mByteAccumulator;
 	bool mIsBodyLimitSet;
+	bool mHasHostSlot;
 };
 
 LLURLRequestDetail::LLURLRequestDetail() :
@@ -79,7 +81,8 @@ LLURLRequestDetail::LLURLRequestDetail() :
 	mLastRead(NULL),
 	mBodyLimit(0),
 	mByteAccumulator(0),
-	mIsBodyLimitSet(false)
+	mIsBodyLimitSet(false),
+	mHasHostSlot(false)
 {
 	LLMemType m1(LLMemType::MTYPE_IO_URL_REQUEST);
 	mCurlRequest = new LLCurlEasyRequest();
@@ -88,11 +91,21 @@ LLURLRequestDetail::LLURLRequestDetail() :
 LLURLRequestDetail::~LLURLRequestDetail()
 {
 	LLMemType m1(LLMemType::MTYPE_IO_URL_REQUEST);
+	releaseHostSlot();
 	delete mCurlRequest;
 	mResponseBuffer = NULL;
 	mLastRead = NULL;
 }
 
+void LLURLRequestDetail::releaseHostSlot()
+{
+	if(mHasHostSlot)
+	{
+		LLCurl::releaseHostSlot(mURL);
+		mHasHostSlot = false;
+	}
+}
+
 
 /**
  * class LLURLRequest
@@ -243,6 +256,17 @@ LLIOPipe::EStatus LLURLRequest::process_impl(
 			return STATUS_BREAK;
 		}
 
+		// Wait our turn if this host already has as many requests
+		// in flight as we allow.
+		if(!mDetail->mHasHostSlot)
+		{
+			if(!LLCurl::acquireHostSlot(mDetail->mURL))
+			{
+				return STATUS_BREAK;
+			}
+			mDetail->mHasHostSlot = true;
+		}
+
 		// *FIX: bit of a hack, but it should work. The configure and
 		// callback method expect this information to be ready.
 		mDetail->mResponseBuffer = buffer.get();
@@ -289,6 +313,7 @@ LLIOPipe::EStatus LLURLRequest::process_impl(
 			}
 
 			mState = STATE_HAVE_RESPONSE;
+			mDetail->releaseHostSlot();
 			switch(result)
 			{
 				case CURLE_OK:
@@ -0,0 +1,451 @@
+/** 
+ * @file llzerocode.cpp
+ * @brief Scalar, SSE2 and AVX2 zero-run coding kernels.
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llzerocode.h"
+
+#include "llerror.h"
+#include "llprocessor.h"
+#include "llsys.h"
+
+#if LL_X86 && (LL_MSVC || defined(__SSE2__))
+#define LL_ZERO_CODE_SSE2 1
+#endif
+
+// The AVX2 kernels need the compiler to accept AVX2 intrinsics in a
+// function built for it alone; the rest of the library stays generic.
+#if LL_ZERO_CODE_SSE2 && ((LL_MSVC && _MSC_VER >= 1700) || (LL_GNUC && (GCC_VERSION >= 40900 || defined(__clang__))))
+#define LL_ZERO_CODE_AVX2 1
+#endif
+
+#if LL_ZERO_CODE_SSE2
+#include <emmintrin.h>
+#endif
+#if LL_ZERO_CODE_AVX2
+#include <immintrin.h>
+#endif
+#if LL_MSVC
+#include <intrin.h>
+#endif
+
+#if LL_GNUC
+#define LL_ZERO_CODE_TARGET(isa) __attribute__((target(isa)))
+#else
+#define LL_ZERO_CODE_TARGET(isa)
+#endif
+
+namespace
+{
+	// Each Scan policy finds the first zero (or non-zero) byte in
+	// [p, end), returning end if there is none.  The coding loops below
+	// are written once against this interface and instantiated per ISA.
+	struct ScalarScan
+	{
+		static inline const U8* findZero(const U8* p, const U8* end)
+		{
+			while (p < end && *p)
+			{
+				++p;
+			}
+			return p;
+		}
+
+		static inline const U8* findNonZero(const U8* p, const U8* end)
+		{
+			while (p < end && !*p)
+			{
+				++p;
+			}
+			return p;
+		}
+	};
+
+#if LL_ZERO_CODE_SSE2
+	inline U32 first_set_bit(U32 mask)
+	{
+#if LL_MSVC
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return (U32)index;
+#else
+		return (U32)__builtin_ctz(mask);
+#endif
+	}
+
+	struct SSE2Scan
+	{
+		static inline const U8* findZero(const U8* p, const U8* end)
+		{
+			const __m128i zero = _mm_setzero_si128();
+			for (; end - p >= 16; p += 16)
+			{
+				__m128i bytes = _mm_loadu_si128((const __m128i*)p);
+				U32 mask = (U32)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, zero));
+				if (mask)
+				{
+					return p + first_set_bit(mask);
+				}
+			}
+			return ScalarScan::findZero(p, end);
+		}
+
+		static inline const U8* findNonZero(const U8* p, const U8* end)
+		{
+			const __m128i zero = _mm_setzero_si128();
+			for (; end - p >= 16; p += 16)
+			{
+				__m128i bytes = _mm_loadu_si128((const __m128i*)p);
+				U32 mask = ~(U32)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, zero)) & 0xFFFF;
+				if (mask)
+				{
+					return p + first_set_bit(mask);
+				}
+			}
+			return ScalarScan::findNonZero(p, end);
+		}
+	};
+#endif // LL_ZERO_CODE_SSE2
+
+#if LL_ZERO_CODE_AVX2
+	struct AVX2Scan
+	{
+		LL_ZERO_CODE_TARGET("avx2")
+		static inline const U8* findZero(const U8* p, const U8* end)
+		{
+			const __m256i zero = _mm256_setzero_si256();
+			for (; end - p >= 32; p += 32)
+			{
+				__m256i bytes = _mm256_loadu_si256((const __m256i*)p);
+				U32 mask = (U32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, zero));
+				if (mask)
+				{
+					return p + first_set_bit(mask);
+				}
+			}
+			return SSE2Scan::findZero(p, end);
+		}
+
+		LL_ZERO_CODE_TARGET("avx2")
+		static inline const U8* findNonZero(const U8* p, const U8* end)
+		{
+			const __m256i zero = _mm256_setzero_si256();
+			for (; end - p >= 32; p += 32)
+			{
+				__m256i bytes = _mm256_loadu_si256((const __m256i*)p);
+				U32 mask = ~(U32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, zero));
+				if (mask)
+				{
+					return p + first_set_bit(mask);
+				}
+			}
+			return SSE2Scan::findNonZero(p, end);
+		}
+	};
+#endif // LL_ZERO_CODE_AVX2
+
+	// The loops are force-inlined into the per-ISA entry points so the
+	// AVX2 scans are compiled inside a function that targets AVX2.
+	template <class Scan>
+	LL_FORCE_INLINE S32 encode_loop(const U8* in, S32 in_size, U8* out, S32 out_max)
+	{
+		const U8* end = in + in_size;
+		U8* outptr = out;
+		U8* out_end = out + out_max;
+		while (in < end)
+		{
+			const U8* zeroes = Scan::findZero(in, end);
+			S32 literal = (S32)(zeroes - in);
+			if (literal > out_end - outptr)
+			{
+				return -1;
+			}
+			memcpy(outptr, in, literal);		/* Flawfinder: ignore */
+			outptr += literal;
+			if (zeroes == end)
+			{
+				break;
+			}
+
+			in = Scan::findNonZero(zeroes, end);
+			S32 run = (S32)(in - zeroes);
+			while (run > 0)
+			{
+				if (out_end - outptr < 2)
+				{
+					return -1;
+				}
+				U8 count = (U8)llmin(run, 255);
+				*outptr++ = 0;
+				*outptr++ = count;
+				run -= count;
+			}
+		}
+		return (S32)(outptr - out);
+	}
+
+	template <class Scan>
+	LL_FORCE_INLINE S32 expand_loop(const U8* in, S32 in_size, U8* out, S32 out_max)
+	{
+		const U8* end = in + in_size;
+		U8* outptr = out;
+		U8* out_end = out + out_max;
+		while (in < end)
+		{
+			const U8* zeroes = Scan::findZero(in, end);
+			S32 literal = (S32)(zeroes - in);
+			if (literal > out_end - outptr)
+			{
+				return -1;
+			}
+			memcpy(outptr, in, literal);		/* Flawfinder: ignore */
+			outptr += literal;
+			if (zeroes == end)
+			{
+				break;
+			}
+
+			// 0 [count] is count zeroes; every extra 0 before the count
+			// adds 256.  A packet that ends mid-run keeps what it has.
+			in = zeroes + 1;
+			S32 run = 1;
+			while (in < end && !*in)
+			{
+				run += 256;
+				++in;
+			}
+			if (in < end)
+			{
+				run += *in++ - 1;
+			}
+			if (run > out_end - outptr)
+			{
+				return -1;
+			}
+			memset(outptr, 0, run);
+			outptr += run;
+		}
+		return (S32)(outptr - out);
+	}
+
+	template <class Scan>
+	LL_FORCE_INLINE S32 encoded_size_loop(const U8* in, S32 in_size)
+	{
+		const U8* end = in + in_size;
+		S32 size = 0;
+		while (in < end)
+		{
+			const U8* zeroes = Scan::findZero(in, end);
+			size += (S32)(zeroes - in);
+			if (zeroes == end)
+			{
+				break;
+			}
+			in = Scan::findNonZero(zeroes, end);
+			size += 2 * (((S32)(in - zeroes) + 254) / 255);
+		}
+		return size;
+	}
+
+	struct ZeroCodeKernels
+	{
+		S32 (*mEncode)(const U8* in, S32 in_size, U8* out, S32 out_max);
+		S32 (*mExpand)(const U8* in, S32 in_size, U8* out, S32 out_max);
+		S32 (*mEncodedSize)(const U8* in, S32 in_size);
+		const char* mName;
+	};
+
+	S32 encode_scalar(const U8* in, S32 in_size, U8* out, S32 out_max)
+	{
+		return encode_loop<ScalarScan>(in, in_size, out, out_max);
+	}
+
+	S32 expand_scalar(const U8* in, S32 in_size, U8* out, S32 out_max)
+	{
+		return expand_loop<ScalarScan>(in, in_size, out, out_max);
+	}
+
+	S32 encoded_size_scalar(const U8* in, S32 in_size)
+	{
+		return encoded_size_loop<ScalarScan>(in, in_size);
+	}
+
+	const ZeroCodeKernels sScalarKernels =
+	{
+		encode_scalar, expand_scalar, encoded_size_scalar, "scalar"
+	};
+
+#if LL_ZERO_CODE_SSE2
+	S32 encode_sse2(const U8* in, S32 in_size, U8* out, S32 out_max)
+	{
+		return encode_loop<SSE2Scan>(in, in_size, out, out_max);
+	}
+
+	S32 expand_sse2(const U8* in, S32 in_size, U8* out, S32 out_max)
+	{
+		return expand_loop<SSE2Scan>(in, in_size, out, out_max);
+	}
+
+	S32 encoded_size_sse2(const U8* in, S32 in_size)
+	{
+		return encoded_size_loop<SSE2Scan>(in, in_size);
+	}
+
+	const ZeroCodeKernels sSSE2Kernels =
+	{
+		encode_sse2, expand_sse2, encoded_size_sse2, "sse2"
+	};
+#endif
+
+#if LL_ZERO_CODE_AVX2
+	LL_ZERO_CODE_TARGET("avx2")
+	S32 encode_avx2(const U8* in, S32 in_size, U8* out, S32 out_max)
+	{
+		return encode_loop<AVX2Scan>(in, in_size, out, out_max);
+	}
+
+	LL_ZERO_CODE_TARGET("avx2")
+	S32 expand_avx2(const U8* in, S32 in_size, U8* out, S32 out_max)
+	{
+		return expand_loop<AVX2Scan>(in, in_size, out, out_max);
+	}
+
+	LL_ZERO_CODE_TARGET("avx2")
+	S32 encoded_size_avx2(const U8* in, S32 in_size)
+	{
+		return encoded_size_loop<AVX2Scan>(in, in_size);
+	}
+
+	const ZeroCodeKernels sAVX2Kernels =
+	{
+		encode_avx2, expand_avx2, encoded_size_avx2, "avx2"
+	};
+#endif
+
+	const ZeroCodeKernels& select_kernels()
+	{
+		const ZeroCodeKernels* kernels = &sScalarKernels;
+#if LL_ZERO_CODE_SSE2
+		LLCPUInfo cpu_info;
+		if (cpu_info.hasSSE2())
+		{
+			kernels = &sSSE2Kernels;
+		}
+#if LL_ZERO_CODE_AVX2
+		if (cpu_info.hasAVX2())
+		{
+			kernels = &sAVX2Kernels;
+		}
+#endif
+#endif
+		LL_INFOS("Messaging") << "Using " << kernels->mName
+			<< " zero-code kernels" << LL_ENDL;
+		return *kernels;
+	}
+
+	const ZeroCodeKernels& get_kernels()
+	{
+		static const ZeroCodeKernels& sKernels = select_kernels();
+		return sKernels;
+	}
+}
+
+S32 ll_zero_code_encode(const U8* in, S32 in_size, U8* out, S32 out_max)
+{
+	return get_kernels().mEncode(in, in_size, out, out_max);
+}
+
+S32 ll_zero_code_expand(const U8* in, S32 in_size, U8* out, S32 out_max)
+{
+	return get_kernels().mExpand(in, in_size, out, out_max);
+}
+
+S32 ll_zero_code_encoded_size(const U8* in, S32 in_size)
+{
+	return get_kernels().mEncodedSize(in, in_size);
+}
+
+const char* ll_zero_code_kernel_name()
+{
+	return get_kernels().mName;
+}
+
+void LLZeroCodeSizer::add(const U8* data, S32 size)
+{
+	if (size <= 0)
+	{
+		return;
+	}
+	mRawSize += size;
+
+	// Trim the zeroes at either end, which may join runs in the pieces
+	// before and after, and leave the middle to the kernel.
+	const U8* end = data + size;
+	const U8* first = data;
+	while (first < end && !*first)
+	{
+		++first;
+	}
+	if (first == end)
+	{
+		mRun += size;
+		return;
+	}
+	const U8* last = end;
+	while (!last[-1])
+	{
+		--last;
+	}
+	mCodedSize += runSize(mRun + (S32)(first - data));
+	mRun = (S32)(end - last);
+
+	// Most template variables are a few bytes long, too short for the
+	// kernels to beat a plain walk through them.
+	if (last - first < 32)
+	{
+		S32 run = 0;
+		for (const U8* p = first; p < last; ++p)
+		{
+			if (*p)
+			{
+				mCodedSize += runSize(run) + 1;
+				run = 0;
+			}
+			else
+			{
+				++run;
+			}
+		}
+		return;
+	}
+	mCodedSize += ll_zero_code_encoded_size(first, (S32)(last - first));
+}
@@ -0,0 +1,82 @@
+/** 
+ * @file llzerocode.h
+ * @brief Zero-run coding kernels for template messages.
+ *
+ * $LicenseInfo:firstyear=2009&license=viewergpl$
+ * 
+ * Copyright (c) 2009, Linden Research, Inc.
+ * 
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ * 
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLZEROCODE_H
+#define LL_LLZEROCODE_H
+
+// Template messages flagged LL_ZERO_CODE_FLAG carry each run of zero
+// bytes as 0 [count], count 1..255, splitting longer runs.  On the
+// receive side a 0 immediately following a 0 stands for 256 zeroes.
+// These routines operate on the message body only -- callers copy the
+// LL_PACKET_ID_SIZE header themselves.
+//
+// Each entry point binds, on first use, to AVX2 or SSE2 kernels when
+// LLCPUInfo reports support, falling back to a portable scalar loop.
+
+// Encodes in_size bytes from in into out.  Returns the encoded size, or
+// -1 as soon as the output would grow past out_max bytes, so a caller
+// can pass in_size - 1 to decide in a single pass whether coding pays.
+S32 ll_zero_code_encode(const U8* in, S32 in_size, U8* out, S32 out_max);
+
+// Expands in_size coded bytes from in into out.  Returns the expanded
+// size, or -1 if the expansion would exceed out_max bytes.
+S32 ll_zero_code_expand(const U8* in, S32 in_size, U8* out, S32 out_max);
+
+// Returns the size in_size bytes would have once encoded, without
+// writing anything.
+S32 ll_zero_code_encoded_size(const U8* in, S32 in_size);
+
+// Name of the kernel set in use: "avx2", "sse2" or "scalar".
+const char* ll_zero_code_kernel_name();
+
+// Measures a body handed over piece by piece, as the template builder
+// holds it, without assembling it first.  A zero run that spans pieces
+// is counted as the one run it becomes once built.
+class LLZeroCodeSizer
+{
+public:
+	LLZeroCodeSizer() : mRawSize(0), mCodedSize(0), mRun(0) {}
+
+	void add(const U8* data, S32 size);
+
+	S32 getRawSize() const { return mRawSize; }
+	S32 getCodedSize() const { return mCodedSize + runSize(mRun); }
+
+private:
+	static S32 runSize(S32 run) { return 2 * ((run + 254) / 255); }
+
+	S32 mRawSize;
+	S32 mCodedSize;
+	S32 mRun;		// zeroes at the end of what has been added so far
+};
+
+#endif // LL_LLZEROCODE_H
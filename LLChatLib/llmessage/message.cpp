@@ -77,6 +77,7 @@
 #include "lltransfermanager.h"
 #include "lluuid.h"
 #include "llxfermanager.h"
+#include "llzerocode.h"
 #include "timing.h"
 #include "llquaternion.h"
 #include "u64.h"
@@ -348,6 +349,8 @@ LLMessageSystem::LLMessageSystem(const std::string& filename, U32 port,
 	mbProtected = TRUE;
 
 	mSendPacketFailureCount = 0;
+	mAcksPiggybacked = 0;
+	mAcksStandalone = 0;
 
 	mCircuitPrintFreq = 60.f;		// seconds
 
@@ -404,6 +407,7 @@ LLMessageSystem::LLMessageSystem(const std::string& filename, U32 port,
 	mMaxMessageCounts = 200; // >= 0 means dump warnings
 	mMaxMessageTime   = 1.f;
 
+	mTrueReceiveBuffer = NULL;
 	mTrueReceiveSize = 0;
 }
 
@@ -622,9 +626,10 @@ BOOL LLMessageSystem::checkMessages( S64 frame_count )
 		S32 acks = 0;
 		S32 true_rcv_size = 0;
 
-		U8* buffer = mTrueReceiveBuffer;
+		U8* buffer = NULL;
 		
-		mTrueReceiveSize = mPacketRing.receivePacket(mSocket, (char *)mTrueReceiveBuffer);
+		mTrueReceiveSize = mPacketRing.receivePacketBatched(mSocket, &buffer);
+		mTrueReceiveBuffer = buffer;
 		// If you want to dump all received packets into SecondLife.log, uncomment this
 		//dumpPacketToLog();
 		
@@ -916,7 +921,7 @@ BOOL LLMessageSystem::checkMessages( S64 frame_count )
 				if (cdp && recv_reliable)
 				{
 					// Add to the recently received list for duplicate suppression
-					cdp->mRecentlyReceivedReliablePackets[mCurrentRecvPacketID] = getMessageTimeUsecs();
+					cdp->mRecentlyReceivedReliablePackets.insert(mCurrentRecvPacketID, getMessageTimeUsecs());
 
 					// Put it onto the list of packets to be acked
 					cdp->collectRAck(mCurrentRecvPacketID);
@@ -1040,6 +1045,69 @@ void LLMessageSystem::processAcks()
 	}
 }
 
+void LLMessageSystem::beginSendBatch()
+{
+	mPacketRing.beginSendBatch();
+}
+
+void LLMessageSystem::flushSendBatch()
+{
+	mSendPacketFailureCount += mPacketRing.flushSendBatch();
+}
+
+S32 LLMessageSystem::piggybackAcks(LLCircuitData* cdp)
+{
+	if (!cdp || cdp->mAcks.empty() || !mPacketRing.isSendBatchOpen())
+	{
+		return 0;
+	}
+
+	const S32 MAX_ACKS = 255;	// the count has to fit in the trailing byte
+	S32 appended = 0;
+	S32 queued_count = mPacketRing.getQueuedSendCount();
+	for (S32 i = 0; i < queued_count && appended < (S32)cdp->mAcks.size(); i++)
+	{
+		LLPacketRing::QueuedSend& queued = mPacketRing.getQueuedSend(i);
+		if (queued.mHost != cdp->mHost)
+		{
+			continue;
+		}
+
+		// Packets that already carry acks get theirs extended
+		S32 length = queued.mSize;
+		S32 existing = 0;
+		if (queued.mData[0] & LL_ACK_FLAG)
+		{
+			existing = queued.mData[--length];
+		}
+
+		S32 space_left = (MTUBYTES - length - 1) / (S32)sizeof(TPACKETID);
+		S32 append_count = llmin(space_left, MAX_ACKS - existing);
+		append_count = llmin(append_count, (S32)cdp->mAcks.size() - appended);
+		if (append_count <= 0)
+		{
+			continue;
+		}
+
+		for (S32 j = 0; j < append_count; j++)
+		{
+			TPACKETID packet_id = htonl(cdp->mAcks[appended + j]);
+			memcpy(&queued.mData[length], &packet_id, sizeof(TPACKETID));	/* Flawfinder: ignore */
+			length += sizeof(TPACKETID);
+		}
+		queued.mData[length++] = (U8)(existing + append_count);
+		queued.mData[0] |= LL_ACK_FLAG;
+
+		cdp->addBytesOut(length - queued.mSize);
+		queued.mSize = length;
+		appended += append_count;
+	}
+
+	cdp->mAcks.erase(cdp->mAcks.begin(), cdp->mAcks.begin() + appended);
+	mAcksPiggybacked += appended;
+	return appended;
+}
+
 void LLMessageSystem::copyMessageRtoS()
 {
 	// NOTE: babbage: switch builder to match reader to avoid
@@ -1415,6 +1483,7 @@ S32 LLMessageSystem::sendMessage(const LLHost &host)
 		U8 count = (U8)append_ack_count;
 		buf_ptr[buffer_length++] = count;
 		is_ack_appended = TRUE;
+		mAcksPiggybacked += append_ack_count;
 	}
 
 	BOOL success;
@@ -2670,6 +2739,14 @@ void LLMessageSystem::summarizeLogs(std::ostream& str)
 	str << buffer << std::endl;
 	tmp_str = U64_to_str(savings/(mPacketsIn+1));
 	buffer = llformat( "Avg overall comp savings:  %20s (%5.2f : 1)", tmp_str.c_str(), ((F32) mTotalBytesIn + (F32) savings)/((F32) mTotalBytesIn + 1.f));
+	str << buffer << std::endl;
+	buffer = llformat( "Avg packets per receive:   %20.2f (%u receives, %u empty)", mPacketRing.getAverageBatchSize(), mPacketRing.getBatchReceiveCalls(), mPacketRing.getBatchEmptyCalls());
+	str << buffer << std::endl;
+	buffer = llformat( "Avg packets per send:      %20.2f (%u sends)", mPacketRing.getAverageSendBatchSize(), mPacketRing.getSendSyscalls());
+	str << buffer << std::endl;
+	buffer = llformat( "Acks piggybacked:          %20u", mAcksPiggybacked);
+	str << buffer << std::endl;
+	buffer = llformat( "Acks sent standalone:      %20u", mAcksStandalone);
 
 	// Outgoing
 	str << buffer << std::endl << std::endl << "Outgoing:" << std::endl;
@@ -2834,7 +2911,6 @@ U32 LLMessageSystem::getListenPort( void ) const
 	return mPort;
 }
 
-// TODO: babbage: remove this horror!
 S32 LLMessageSystem::zeroCodeAdjustCurrentSendTotal()
 {
 	if(mMessageBuilder == mLLSDMessageBuilder)
@@ -2843,64 +2919,19 @@ S32 LLMessageSystem::zeroCodeAdjustCurrentSendTotal()
 		return 0;
 	}
 	
-	if (! mMessageBuilder->isBuilt())
-	{
-		mSendSize = mMessageBuilder->buildMessage(
-			mSendBuffer,
-			MAX_BUFFER_SIZE,
-			0);
-	}
-	// TODO: babbage: remove this horror
-	mMessageBuilder->setBuilt(FALSE);
-
-	S32 count = mSendSize;
-	
-	S32 net_gain = 0;
-	U8 num_zeroes = 0;
-	
-	U8 *inptr = (U8 *)mSendBuffer;
-
-// skip the packet id field
-
-	for (U32 ii = 0; ii < LL_PACKET_ID_SIZE; ++ii)
+	// measure only, the packet id field is never coded
+	S32 body_size = 0;
+	S32 coded_size = 0;
+	if (mMessageBuilder->isBuilt())
 	{
-		count--;
-		inptr++;
+		body_size = llmax(mSendSize - LL_PACKET_ID_SIZE, 0);
+		coded_size = ll_zero_code_encoded_size(mSendBuffer + LL_PACKET_ID_SIZE, body_size);
 	}
-
-// don't actually build, just test
-
-// sequential zero bytes are encoded as 0 [U8 count] 
-// with 0 0 [count] representing wrap (>256 zeroes)
-
-	while (count--)
+	else
 	{
-		if (!(*inptr))   // in a zero count
-		{
-			if (num_zeroes)
-			{
-				if (++num_zeroes > 254)
-				{
-					num_zeroes = 0;
-				}
-				net_gain--;   // subseqent zeroes save one
-			}
-			else
-			{
-				net_gain++;  // starting a zero count adds one
-				num_zeroes = 1;
-			}
-			inptr++;
-		}
-		else
-		{
-			if (num_zeroes)
-			{
-				num_zeroes = 0;
-			}
-			inptr++;
-		}
+		mTemplateMessageBuilder->measureZeroCode(body_size, coded_size);
 	}
+	S32 net_gain = coded_size - body_size;
 	if (net_gain < 0)
 	{
 		return net_gain;
@@ -2935,72 +2966,26 @@ S32 LLMessageSystem::zeroCodeExpand(U8** data, S32* data_size)
 	
 	*data[0] &= (~LL_ZERO_CODE_FLAG);
 
-	S32 count = (*data_size);  
-	
-	U8 *inptr = (U8 *)*data;
-	U8 *outptr = (U8 *)mEncodedRecvBuffer;
-
-// skip the packet id field
-
-	for (U32 ii = 0; ii < LL_PACKET_ID_SIZE; ++ii)
-	{
-		count--;
-		*outptr++ = *inptr++;
-	}
-
-// reconstruct encoded packet, keeping track of net size gain
-
-// sequential zero bytes are encoded as 0 [U8 count] 
-// with 0 0 [count] representing wrap (>256 zeroes)
+	// the packet id field is sent as is
+	S32 header_size = llmin(in_size, (S32)LL_PACKET_ID_SIZE);
+	memcpy(mEncodedRecvBuffer, *data, header_size);		/* Flawfinder: ignore */
 
-	while (count--)
+	S32 body_size = ll_zero_code_expand(
+		*data + header_size,
+		in_size - header_size,
+		mEncodedRecvBuffer + header_size,
+		MAX_BUFFER_SIZE - header_size);
+	if (body_size < 0)
 	{
-		if (outptr > (&mEncodedRecvBuffer[MAX_BUFFER_SIZE-1]))
-		{
-			LL_WARNS("Messaging") << "attempt to write past reasonable encoded buffer size 1" << llendl;
-			callExceptionFunc(MX_WROTE_PAST_BUFFER_SIZE);
-			outptr = mEncodedRecvBuffer;					
-			break;
-		}
-		if (!((*outptr++ = *inptr++)))
-		{
-			while (((count--)) && (!(*inptr)))
-			{
-				*outptr++ = *inptr++;
-  				if (outptr > (&mEncodedRecvBuffer[MAX_BUFFER_SIZE-256]))
-  				{
-  					LL_WARNS("Messaging") << "attempt to write past reasonable encoded buffer size 2" << llendl;
-					callExceptionFunc(MX_WROTE_PAST_BUFFER_SIZE);
-					outptr = mEncodedRecvBuffer;
-					count = -1;
-					break;
-  				}
-				memset(outptr,0,255);
-				outptr += 255;
-			}
-			
-			if (count < 0)
-			{
-				break;
-			}
-
-			else
-			{
-  				if (outptr > (&mEncodedRecvBuffer[MAX_BUFFER_SIZE-(*inptr)]))
-				{
-  					LL_WARNS("Messaging") << "attempt to write past reasonable encoded buffer size 3" << llendl;
-					callExceptionFunc(MX_WROTE_PAST_BUFFER_SIZE);
-					outptr = mEncodedRecvBuffer;					
-				}
-				memset(outptr,0,(*inptr) - 1);
-				outptr += ((*inptr) - 1);
-				inptr++;
-			}
-		}		
+		LL_WARNS("Messaging") << "attempt to write past reasonable encoded buffer size" << llendl;
+		callExceptionFunc(MX_WROTE_PAST_BUFFER_SIZE);
+		*data = mEncodedRecvBuffer;
+		*data_size = 0;
+		return(in_size);
 	}
 	
 	*data = mEncodedRecvBuffer;
-	*data_size = (S32)(outptr - mEncodedRecvBuffer);
+	*data_size = header_size + body_size;
 	mUncompressedBytesIn += *data_size;
 
 	return(in_size);
@@ -280,6 +280,8 @@ public:
 	std::map<U32, U64>			mCircuitCodeToIPPort;
 	U32					mOurCircuitCode;
 	S32					mSendPacketFailureCount;
+	U32					mAcksPiggybacked;			// acks appended to outgoing packets
+	U32					mAcksStandalone;			// acks sent in their own PacketAck message
 	S32					mUnackedListDepth;
 	S32					mUnackedListSize;
 	S32					mDSMaxListDepth;
@@ -343,6 +345,13 @@ public:
 	BOOL	checkMessages( S64 frame_count = 0 );
 	void	processAcks();
 
+	// Hold outgoing packets until flushSendBatch(), so they leave in as
+	// few system calls as possible and pending acks can ride along.
+	void	beginSendBatch();
+	void	flushSendBatch();
+	// Append cdp's pending acks to packets queued for it; returns how many fit.
+	S32		piggybackAcks(LLCircuitData* cdp);
+
 	BOOL	isMessageFast(const char *msg);
 	BOOL	isMessage(const char *msg)
 	{
@@ -723,7 +732,7 @@ private:
 	LLMessagePollInfo						*mPollInfop;
 
 	U8	mEncodedRecvBuffer[MAX_BUFFER_SIZE];
-	U8	mTrueReceiveBuffer[MAX_BUFFER_SIZE];
+	U8*	mTrueReceiveBuffer;		// Points into mPacketRing's receive slab
 	S32	mTrueReceiveSize;
 
 	// Must be valid during decode
@@ -110,6 +110,39 @@ U32 get_sender_port()
 	return ntohs(stSrcAddr.sin_port);
 }
 
+// One recvfrom() per packet, for platforms without recvmmsg()
+static S32 receive_packet_loop(int hSocket, char ** receiveBuffers, S32 * sizes, LLHost * senders, S32 max_packets)
+{
+	S32 count = 0;
+	while (count < max_packets)
+	{
+		S32 size = receive_packet(hSocket, receiveBuffers[count]);
+		if (size <= 0)
+		{
+			break;
+		}
+		sizes[count] = size;
+		senders[count] = get_sender();
+		count++;
+	}
+	return count;
+}
+
+// One sendto() per packet, for platforms without sendmmsg()
+static S32 send_packet_loop(int hSocket, char ** sendBuffers, const S32 * sizes, const LLHost * recipients, S32 count, U32& syscalls)
+{
+	S32 sent = 0;
+	for (S32 i = 0; i < count; i++)
+	{
+		syscalls++;
+		if (send_packet(hSocket, sendBuffers[i], sizes[i], recipients[i].getAddress(), recipients[i].getPort()))
+		{
+			sent++;
+		}
+	}
+	return sent;
+}
+
 const char* u32_to_ip_string(U32 ip)
 {
 	static char buffer[MAXADDRSTR];	 /* Flawfinder: ignore */ 
@@ -323,6 +356,16 @@ S32 receive_packet(int hSocket, char * receiveBuffer)
 	return nRet;
 }
 
+S32 receive_packet_batch(int hSocket, char ** receiveBuffers, S32 * sizes, LLHost * senders, S32 max_packets)
+{
+	return receive_packet_loop(hSocket, receiveBuffers, sizes, senders, max_packets);
+}
+
+S32 send_packet_batch(int hSocket, char ** sendBuffers, const S32 * sizes, const LLHost * recipients, S32 count, U32& syscalls)
+{
+	return send_packet_loop(hSocket, sendBuffers, sizes, recipients, count, syscalls);
+}
+
 // Returns TRUE on success.
 BOOL send_packet(int hSocket, const char *sendBuffer, int size, U32 recipient, int nPort)
 {
@@ -493,6 +536,131 @@ int receive_packet(int hSocket, char * receiveBuffer)
 	return nRet;
 }
 
+#if LL_LINUX
+// recvmmsg() needs glibc 2.12 and kernel 2.6.33, sendmmsg() glibc 2.14 and
+// kernel 3.0; fall back when they are missing
+static BOOL sHaveRecvMMsg = TRUE;
+static BOOL sHaveSendMMsg = TRUE;
+#endif
+
+S32 receive_packet_batch(int hSocket, char ** receiveBuffers, S32 * sizes, LLHost * senders, S32 max_packets)
+{
+#if LL_LINUX
+	if (sHaveRecvMMsg)
+	{
+		const S32 MAX_BATCH = 64;
+		struct mmsghdr msgs[MAX_BATCH];
+		struct iovec iovecs[MAX_BATCH];
+		struct sockaddr_in addrs[MAX_BATCH];
+
+		if (max_packets > MAX_BATCH)
+		{
+			max_packets = MAX_BATCH;
+		}
+
+		memset(msgs, 0, sizeof(msgs[0]) * max_packets);
+		for (S32 i = 0; i < max_packets; i++)
+		{
+			iovecs[i].iov_base = receiveBuffers[i];
+			iovecs[i].iov_len = NET_BUFFER_SIZE;
+			msgs[i].msg_hdr.msg_iov = &iovecs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+			msgs[i].msg_hdr.msg_name = &addrs[i];
+			msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+		}
+
+		int nRet = recvmmsg(hSocket, msgs, max_packets, MSG_DONTWAIT, NULL);
+		if (nRet < 0)
+		{
+			if (errno == ENOSYS)
+			{
+				llinfos << "recvmmsg() not supported, receiving one packet per call" << llendl;
+				sHaveRecvMMsg = FALSE;
+			}
+			else
+			{
+				// EAGAIN (nothing waiting) or a transient error, same as receive_packet()
+				return 0;
+			}
+		}
+		else
+		{
+			for (S32 i = 0; i < nRet; i++)
+			{
+				sizes[i] = msgs[i].msg_len;
+				senders[i] = LLHost(addrs[i].sin_addr.s_addr, ntohs(addrs[i].sin_port));
+			}
+			if (nRet > 0)
+			{
+				// Keep get_sender() in step for anyone still using it
+				stSrcAddr = addrs[nRet - 1];
+			}
+			return nRet;
+		}
+	}
+#endif
+	return receive_packet_loop(hSocket, receiveBuffers, sizes, senders, max_packets);
+}
+
+S32 send_packet_batch(int hSocket, char ** sendBuffers, const S32 * sizes, const LLHost * recipients, S32 count, U32& syscalls)
+{
+#if LL_LINUX
+	const S32 MAX_BATCH = 64;
+	S32 sent = 0;
+	S32 offset = 0;
+	while (sHaveSendMMsg && offset < count)
+	{
+		struct mmsghdr msgs[MAX_BATCH];
+		struct iovec iovecs[MAX_BATCH];
+		struct sockaddr_in addrs[MAX_BATCH];
+
+		S32 batch = llmin(count - offset, MAX_BATCH);
+		memset(msgs, 0, sizeof(msgs[0]) * batch);
+		memset(addrs, 0, sizeof(addrs[0]) * batch);
+		for (S32 i = 0; i < batch; i++)
+		{
+			const LLHost& host = recipients[offset + i];
+			addrs[i].sin_family = AF_INET;
+			addrs[i].sin_addr.s_addr = host.getAddress();
+			addrs[i].sin_port = htons(host.getPort());
+			iovecs[i].iov_base = sendBuffers[offset + i];
+			iovecs[i].iov_len = sizes[offset + i];
+			msgs[i].msg_hdr.msg_iov = &iovecs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+			msgs[i].msg_hdr.msg_name = &addrs[i];
+			msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+		}
+
+		syscalls++;
+		int nRet = sendmmsg(hSocket, msgs, batch, 0);
+		if (nRet > 0)
+		{
+			sent += nRet;
+			offset += nRet;
+		}
+		else if (nRet < 0 && errno == ENOSYS)
+		{
+			llinfos << "sendmmsg() not supported, sending one packet per call" << llendl;
+			sHaveSendMMsg = FALSE;
+		}
+		else
+		{
+			// Let send_packet() deal with the retries and report the
+			// error for the packet at the head of the batch
+			sent += send_packet_loop(hSocket, &sendBuffers[offset], &sizes[offset], &recipients[offset], 1, syscalls);
+			offset++;
+		}
+	}
+	if (offset < count)
+	{
+		sent += send_packet_loop(hSocket, &sendBuffers[offset], &sizes[offset], &recipients[offset], count - offset, syscalls);
+	}
+	return sent;
+#else
+	return send_packet_loop(hSocket, sendBuffers, sizes, recipients, count, syscalls);
+#endif
+}
+
 BOOL send_packet(int hSocket, const char * sendBuffer, int size, U32 recipient, int nPort)
 {
 	int		ret;
@@ -49,8 +49,17 @@ void	end_net(S32& socket_out);
 // returns size of packet or -1 in case of error
 S32		receive_packet(int hSocket, char * receiveBuffer);
 
+// Receives up to max_packets datagrams, each into its own NET_BUFFER_SIZE buffer.
+// Fills in sizes[] and senders[] and returns the number of packets, 0 if none waiting.
+// Uses a single recvmmsg() call where the platform has it.
+S32		receive_packet_batch(int hSocket, char ** receiveBuffers, S32 * sizes, LLHost * senders, S32 max_packets);
+
 BOOL	send_packet(int hSocket, const char *sendBuffer, int size, U32 recipient, int nPort);	// Returns TRUE on success.
 
+// Sends count packets, using a single sendmmsg() call where the platform has it.
+// Returns the number of packets sent; syscalls is incremented by the number of system calls made.
+S32		send_packet_batch(int hSocket, char ** sendBuffers, const S32 * sizes, const LLHost * recipients, S32 count, U32& syscalls);
+
 //void	get_sender(char * tmp);
 LLHost  get_sender();
 U32		get_sender_port();
@@ -45,7 +45,12 @@
 #include <sys/file.h>
 #endif
     
+#include "apr_file_io.h"
+#include "apr_mmap.h"
+
 #include "llvfs.h"
+#include "llapr.h"
+#include "llcrc.h"
 #include "llstl.h"
     
 const S32 FILE_BLOCK_MASK = 0x000003FF;	 // 1024-byte blocks
@@ -135,7 +140,7 @@ public:
 	}
 
 	#ifdef LL_LITTLE_ENDIAN
-	inline void swizzleCopy(void *dst, void *src, int size) { memcpy(dst, src, size); /* Flawfinder: ignore */}
+	inline void swizzleCopy(void *dst, const void *src, int size) { memcpy(dst, src, size); /* Flawfinder: ignore */}
 
 	#else
 	
@@ -149,15 +154,15 @@ public:
 		return(	((x >> 8)  & 0x000000FF) | ((x << 8)  & 0x0000FF00) );
 	}
 	
-	inline void swizzleCopy(void *dst, void *src, int size) 
+	inline void swizzleCopy(void *dst, const void *src, int size) 
 	{
 		if(size == 4)
 		{
-			((U32*)dst)[0] = swizzle32(((U32*)src)[0]); 
+			((U32*)dst)[0] = swizzle32(((const U32*)src)[0]); 
 		}
 		else if(size == 2)
 		{
-			((U16*)dst)[0] = swizzle16(((U16*)src)[0]); 
+			((U16*)dst)[0] = swizzle16(((const U16*)src)[0]); 
 		}
 		else
 		{
@@ -168,8 +173,13 @@ public:
 	
 	#endif
 
+	// Each index entry ends with a CRC of the fields before it, so an entry
+	// that was damaged on disk can be told apart from a good one.  It says
+	// nothing about the data the entry points at; a VFS opened with
+	// remove_after_crash is thrown away after an unclean exit instead.
 	void serialize(U8 *buffer)
 	{
+		U8 *start = buffer;
 		swizzleCopy(buffer, &mLocation, 4);
 		buffer += 4;
 		swizzleCopy(buffer, &mLength, 4);
@@ -182,10 +192,15 @@ public:
 		swizzleCopy(buffer, &temp_type, 2);
 		buffer += 2;
 		swizzleCopy(buffer, &mSize, 4);
+		buffer += 4;
+		U32 crc = computeCRC(start);
+		swizzleCopy(buffer, &crc, 4);
 	}
     
-	void deserialize(U8 *buffer, const S32 index_loc)
+	// Returns FALSE if the stored CRC doesn't match the entry.
+	BOOL deserialize(const U8 *buffer, const S32 index_loc)
 	{
+		const U8 *start = buffer;
 		mIndexLocation = index_loc;
     
 		swizzleCopy(&mLocation, buffer, 4);
@@ -201,6 +216,17 @@ public:
 		mFileType = (LLAssetType::EType)temp_type;
 		buffer += 2;
 		swizzleCopy(&mSize, buffer, 4);
+		buffer += 4;
+		U32 crc;
+		swizzleCopy(&crc, buffer, 4);
+		return crc == computeCRC(start) ? TRUE : FALSE;
+	}
+
+	static U32 computeCRC(const U8 *buffer)
+	{
+		LLCRC crc;
+		crc.update(buffer, SERIAL_SIZE - 4);
+		return crc.getCRC();
 	}
     
 	static BOOL insertLRU(LLVFSFileBlock* const& first,
@@ -230,7 +256,76 @@ struct LLVFSFileBlock_less
 };
 
 
-const S32 LLVFSFileBlock::SERIAL_SIZE = 34;
+const S32 LLVFSFileBlock::SERIAL_SIZE = 38;
+
+// Read-only view of an index file for the scan at open, so the index is
+// not copied into a heap buffer first.  Falls back to reading it from the
+// already open stream when the file can't be mapped.
+class LLVFSIndexView
+{
+public:
+	LLVFSIndexView()
+	:	mFile(NULL),
+		mMap(NULL),
+		mBuffer(NULL),
+		mData(NULL),
+		mSize(0)
+	{
+	}
+
+	~LLVFSIndexView()
+	{
+		close();
+	}
+
+	void open(const std::string& filename, LLFILE* fp, size_t size)
+	{
+		if (size
+			&& apr_file_open(&mFile, filename.c_str(), APR_READ | APR_BINARY, APR_OS_DEFAULT, mPool.getAPRPool()) == APR_SUCCESS
+			&& apr_mmap_create(&mMap, mFile, 0, size, APR_MMAP_READ, mPool.getAPRPool()) == APR_SUCCESS)
+		{
+			mData = (const U8*)mMap->mm;
+			mSize = size;
+			return;
+		}
+		mMap = NULL;
+
+		mBuffer = new U8[size];
+		fseek(fp, 0, SEEK_SET);
+		mSize = fread(mBuffer, 1, size, fp);
+		mData = mBuffer;
+	}
+
+	// Must be called before the index file is removed.
+	void close()
+	{
+		if (mMap)
+		{
+			apr_mmap_delete(mMap);
+			mMap = NULL;
+		}
+		if (mFile)
+		{
+			apr_file_close(mFile);
+			mFile = NULL;
+		}
+		delete[] mBuffer;
+		mBuffer = NULL;
+		mData = NULL;
+		mSize = 0;
+	}
+
+	const U8* getData() const	{ return mData; }
+	size_t getSize() const		{ return mSize; }
+
+private:
+	LLAPRPool	mPool;
+	apr_file_t*	mFile;
+	apr_mmap_t*	mMap;
+	U8*			mBuffer;
+	const U8*	mData;
+	size_t		mSize;
+};
      
     
 LLVFS::LLVFS(const std::string& index_filename, const std::string& data_filename, const BOOL read_only, const U32 presize, const BOOL remove_after_crash)
@@ -354,18 +449,27 @@ LLVFS::LLVFS(const std::string& index_filename, const std::string& data_filename
 		(mIndexFP = openAndLock(mIndexFilename, file_mode, mReadOnly))
 		)
 	{	
-		U8 *buffer = new U8[fbuf.st_size];
-		size_t nread = fread(buffer, 1, fbuf.st_size, mIndexFP);
+		LLVFSIndexView index;
+		index.open(mIndexFilename, mIndexFP, fbuf.st_size);
+		const U8 *buffer = index.getData();
+		size_t nread = index.getSize();
     
-		U8 *tmp_ptr = buffer;
+		const U8 *tmp_ptr = buffer;
     
 		std::vector<LLVFSFileBlock*> files_by_loc;
 		
-		while (tmp_ptr < buffer + nread)
+		while (tmp_ptr + LLVFSFileBlock::SERIAL_SIZE <= buffer + nread)
 		{
 			LLVFSFileBlock *block = new LLVFSFileBlock();
     
-			block->deserialize(tmp_ptr, (S32)(tmp_ptr - buffer));
+			if (!block->deserialize(tmp_ptr, (S32)(tmp_ptr - buffer)) && block->mLength)
+			{
+				// Torn or damaged entry, most likely from going down in the
+				// middle of updating it.  Only this file is lost; the entry
+				// is reused and its data space becomes free.
+				LL_WARNS("VFS") << "VFS: dropping damaged index entry at " << (S32)(tmp_ptr - buffer) << LL_ENDL;
+				block->mLength = 0;
+			}
     
 			// Do sanity check on this block.
 			// Note that this skips zero size blocks, which helps VFS
@@ -389,9 +493,9 @@ LLVFS::LLVFS(const std::string& index_filename, const std::string& data_filename
 				LL_WARNS("VFS") << "Length: " << block->mLength << "\tLocation: " << block->mLocation << "\tSize: " << block->mSize << LL_ENDL;
 				LL_WARNS("VFS") << "File has bad data - VFS removed" << LL_ENDL;
 
-				delete[] buffer;
 				delete block;
 
+				index.close();
 				unlockAndClose( mIndexFP );
 				mIndexFP = NULL;
 				LLFile::remove( mIndexFilename );
@@ -414,7 +518,13 @@ LLVFS::LLVFS(const std::string& index_filename, const std::string& data_filename
     
 			tmp_ptr += LLVFSFileBlock::SERIAL_SIZE;
 		}
-		delete[] buffer;
+
+		if (tmp_ptr < buffer + nread)
+		{
+			// Partial entry at the end; the next new entry overwrites it
+			// so later appends stay aligned.
+			mIndexHoles.push_back((S32)(tmp_ptr - buffer));
+		}
 
 		std::sort(
 			files_by_loc.begin(),
@@ -491,6 +601,7 @@ LLVFS::LLVFS(const std::string& index_filename, const std::string& data_filename
 				if (length < 0 || loc < 0 || (U32)loc > data_size)
 				{
 					// Invalid VFS
+					index.close();
 					unlockAndClose( mIndexFP );
 					mIndexFP = NULL;
 					LLFile::remove( mIndexFilename );
@@ -47,6 +47,11 @@
 
 #include "ManagerImpl.h"
 
+// stdc++
+//
+#include <algorithm>
+#include <iterator>
+
 class LLCapHTTPSender : public LLHTTPSender
 {
 public:
@@ -145,6 +150,7 @@ LLViewerRegion::LLViewerRegion( U64 regionHandle
 	mOriginGlobal = from_region_handle(regionHandle); 
 
 	initStats();
+	memset( mGridStart, 0, sizeof(mGridStart) );
 }
 
 
@@ -511,6 +517,8 @@ public:
 				agents_it++;
 			}
 		}
+
+		region->coarseLocationsUpdated();
 	}
 };
 
@@ -583,7 +591,54 @@ void LLViewerRegion::updateCoarseLocations(LLMessageSystem* msg)
 		}
 	}
 
-	LLC::ManagerImpl::GetInstance()->UpdateLocalAvatars();
+	coarseLocationsUpdated();
+}
+
+
+void LLViewerRegion::coarseLocationsUpdated()
+{
+	// Counting sort into the grid: count per cell, turn the counts into
+	// start offsets, then drop each avatar into place.  mAvatarCell and
+	// mGridAvatars keep their capacity, so once a region has been busy
+	// this doesn't allocate.
+	const S32 count = mMapAvatars.count();
+	const S32 id_count = mMapAvatarIDs.count();
+	const S32 cells = AVATAR_GRID_WIDTH * AVATAR_GRID_WIDTH;
+
+	S32 cell_count[AVATAR_GRID_WIDTH * AVATAR_GRID_WIDTH];
+	memset( cell_count, 0, sizeof(cell_count) );
+
+	std::vector<U8>& avatar_cell = mAvatarCell;
+	avatar_cell.resize( count );
+	for( S32 i = 0; i < count; i++ )
+	{
+		const U32 pos = mMapAvatars.get(i);
+		const U32 x = (pos >> 16) & 0xFF;
+		const U32 y = (pos >> 8) & 0xFF;
+		const U8 cell = (U8)(((y >> AVATAR_GRID_SHIFT) * AVATAR_GRID_WIDTH) + (x >> AVATAR_GRID_SHIFT));
+		avatar_cell[i] = cell;
+		cell_count[cell]++;
+	}
+
+	U16 start = 0;
+	for( S32 cell = 0; cell < cells; cell++ )
+	{
+		mGridStart[cell] = start;
+		start += (U16)cell_count[cell];
+	}
+	mGridStart[cells] = start;
+
+	mGridAvatars.resize( count );
+	for( S32 i = 0; i < count; i++ )
+	{
+		const U8 cell = avatar_cell[i];
+		GridAvatar& avatar = mGridAvatars[mGridStart[cell] + --cell_count[cell]];
+		avatar.mPos = mMapAvatars.get(i);
+		// The old message format carries no IDs
+		avatar.mID = (i < id_count) ? mMapAvatarIDs.get(i) : LLUUID::null;
+	}
+
+	LLC::ManagerImpl::GetInstance()->UpdateLocalAvatars( this );
 }
 
 
@@ -622,21 +677,94 @@ void LLViewerRegion::getAvatars	( LLUUIDList& avatar_ids
 								) const
 {
 	avatar_ids.clear();
-	//
+	addAvatars( &avatar_ids, NULL, relative_to, radius );
+}
+
+
+void LLViewerRegion::addAvatars	( LLUUIDList* avatar_ids
+								, std::vector<LLVector3d>* positions
+								, const LLVector3d& relative_to
+								, F32 radius
+								) const
+{
 	const LLVector3d& origin_global = getOriginGlobal();
-	S32 count = mMapAvatars.count();
-	for (S32 i = 0; i < count; i++)
+	const F64 local_x = relative_to.mdV[VX] - origin_global.mdV[VX];
+	const F64 local_y = relative_to.mdV[VY] - origin_global.mdV[VY];
+
+	// Range of cells the radius's bounding square covers
+	const S32 cell_size = 1 << AVATAR_GRID_SHIFT;
+	S32 min_x = llfloor( (F32)((local_x - radius) / cell_size) );
+	S32 max_x = llfloor( (F32)((local_x + radius) / cell_size) );
+	S32 min_y = llfloor( (F32)((local_y - radius) / cell_size) );
+	S32 max_y = llfloor( (F32)((local_y + radius) / cell_size) );
+	if( max_x < 0 || max_y < 0 || min_x >= AVATAR_GRID_WIDTH || min_y >= AVATAR_GRID_WIDTH )
+	{
+		return;
+	}
+	min_x = llmax( min_x, 0 );
+	min_y = llmax( min_y, 0 );
+	max_x = llmin( max_x, (S32)AVATAR_GRID_WIDTH - 1 );
+	max_y = llmin( max_y, (S32)AVATAR_GRID_WIDTH - 1 );
+
+	for( S32 y = min_y; y <= max_y; y++ )
 	{
-		LLVector3d pos_global = unpackLocalToGlobalPosition( mMapAvatars.get(i), origin_global );
-		const F32 distance = dist_vec( pos_global, relative_to );
-		if( distance <= radius )
+		// Cells in a row are contiguous in mGridAvatars
+		const S32 begin = mGridStart[y * AVATAR_GRID_WIDTH + min_x];
+		const S32 end   = mGridStart[y * AVATAR_GRID_WIDTH + max_x + 1];
+		for( S32 i = begin; i < end; i++ )
 		{
-			avatar_ids.push_back( mMapAvatarIDs.get(i) );
+			const GridAvatar& avatar = mGridAvatars[i];
+			LLVector3d pos_global = unpackLocalToGlobalPosition( avatar.mPos, origin_global );
+			if( dist_vec( pos_global, relative_to ) <= radius )
+			{
+				if( avatar_ids )
+				{
+					avatar_ids->push_back( avatar.mID );
+				}
+				if( positions )
+				{
+					positions->push_back( pos_global );
+				}
+			}
 		}
 	}
 }
 
 
+bool LLViewerRegion::updateNearbyAvatars( LLUUIDList& near_ids
+										, const LLVector3d& relative_to
+										, F32 radius
+										, LLUUIDList& entered
+										, LLUUIDList& left
+										)
+{
+	entered.clear();
+	left.clear();
+
+	LLUUIDList& now_near = mNowNear;
+	now_near.clear();
+	addAvatars( &now_near, NULL, relative_to, radius );
+	std::sort( now_near.begin(), now_near.end() );
+
+	std::set_difference( now_near.begin(), now_near.end()
+					   , near_ids.begin(), near_ids.end()
+					   , std::back_inserter( entered )
+					   );
+	std::set_difference( near_ids.begin(), near_ids.end()
+					   , now_near.begin(), now_near.end()
+					   , std::back_inserter( left )
+					   );
+
+	if( entered.empty() && left.empty() )
+	{
+		return false;
+	}
+
+	near_ids.swap( now_near );
+	return true;
+}
+
+
 LLVector3d LLViewerRegion::getPosGlobalFromRegion(const LLVector3 &pos_region) const
 {
 	LLVector3d pos_region_d;
@@ -129,6 +129,25 @@ public:
 					, F32 radius
 					) const;
 
+	// Appends the avatars within radius of relative_to.  Only the grid
+	// cells the radius touches are looked at, so a far-off point costs
+	// next to nothing.  Either list may be NULL.
+	void addAvatars	( LLUUIDList* avatar_ids
+					, std::vector<LLVector3d>* positions
+					, const LLVector3d& relative_to
+					, F32 radius
+					) const;
+
+	// Brings near_ids, which is kept sorted, up to date with the avatars
+	// within radius of relative_to, and fills entered and left with the
+	// difference.  Returns true if anything changed.
+	bool updateNearbyAvatars( LLUUIDList& near_ids
+							, const LLVector3d& relative_to
+							, F32 radius
+							, LLUUIDList& entered
+							, LLUUIDList& left
+							);
+
 private:
 	typedef std::map<std::string, std::string> CapabilityMap;
 	CapabilityMap               m_capabilities;
@@ -169,9 +188,24 @@ private:
 	LLDynamicArray<U32> mMapAvatars;
 	LLDynamicArray<LLUUID> mMapAvatarIDs;
 
+	// The same avatars bucketed into a grid of 16m columns, rebuilt with a
+	// counting sort on every coarse update: cell i holds
+	// mGridAvatars[mGridStart[i]] up to mGridAvatars[mGridStart[i+1]].
+	enum { AVATAR_GRID_SHIFT = 4, AVATAR_GRID_WIDTH = 256 >> AVATAR_GRID_SHIFT };
+	struct GridAvatar
+	{
+		LLUUID	mID;
+		U32		mPos;		// packed as in mMapAvatars
+	};
+	std::vector<GridAvatar>	mGridAvatars;
+	U16						mGridStart[AVATAR_GRID_WIDTH * AVATAR_GRID_WIDTH + 1];
+	std::vector<U8>			mAvatarCell;	// scratch for coarseLocationsUpdated(): each avatar's cell
+	LLUUIDList				mNowNear;		// scratch for updateNearbyAvatars(): the previous near list, kept for its storage
+
 	friend class CoarseLocationUpdate;
 
 	void			initStats();
+	void			coarseLocationsUpdated();
 };
 
 
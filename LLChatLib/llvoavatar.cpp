@@ -1419,6 +1419,13 @@ void LLVOAvatar::deleteCachedImages(bool clearAll)
 //------------------------------------------------------------------------
 void LLVOAvatar::initClass()
 { 
+	// avatar_lad.xml is parsed the first time an avatar is created, and
+	// only then; startup reads just its header.
+	if (sAvatarXmlInfo)
+	{
+		return;
+	}
+
 	std::string xmlFile;
 
 	xmlFile = gDirUtilp->getExpandedFilename(LL_PATH_CHARACTER,AVATAR_DEFAULT_CHAR) + "_lad.xml";
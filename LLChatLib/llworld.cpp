@@ -63,28 +63,6 @@ const F32 LLWorld::mWidthInMeters = mWidth * mScale;
 
 const S32 WORLD_PATCH_SIZE = 16;
 
-static LLVector3d unpackLocalToGlobalPosition(U32 compact_local, const LLVector3d& region_origin)
-{
-	LLVector3d pos_global;
-	LLVector3 pos_local;
-	U8 bits;
-
-	bits = compact_local & 0xFF;
-	pos_local.mV[VZ] = F32(bits) * 4.f;
-	compact_local >>= 8;
-
-	bits = compact_local & 0xFF;
-	pos_local.mV[VY] = (F32)bits;
-	compact_local >>= 8;
-
-	bits = compact_local & 0xFF;
-	pos_local.mV[VX] = (F32)bits;
-
-	pos_global.setVec( pos_local );
-	pos_global += region_origin;
-	return pos_global;
-}
-
 //
 // Functions
 //
@@ -728,25 +706,8 @@ void LLWorld::getAvatars	( std::vector<LLUUID>* avatar_ids
 	for (LLWorld::region_list_t::const_iterator iter = LLWorld::getInstance()->getRegionList().begin();
 		iter != LLWorld::getInstance()->getRegionList().end(); ++iter)
 	{
-		LLViewerRegionPtr regionp = *iter;
-		const LLVector3d& origin_global = regionp->getOriginGlobal();
-		S32 count = regionp->GetMapAvatars().count();
-		for (S32 i = 0; i < count; i++)
-		{
-			LLVector3d pos_global = unpackLocalToGlobalPosition(regionp->GetMapAvatars().get(i), origin_global );
-			const F32 distance = dist_vec(pos_global, relative_to);
-			if( distance <= radius )
-			{
-				if(positions != NULL)
-				{
-					positions->push_back(pos_global);
-				}
-				if(avatar_ids != NULL)
-				{
-					avatar_ids->push_back(regionp->GetMapAvatarIDs().get(i));
-				}
-			}
-		}
+		// Regions the radius doesn't reach return straight away
+		(*iter)->addAvatars(avatar_ids, positions, relative_to, radius);
 	}
 }
 
@@ -0,0 +1,471 @@
+/** 
+ * \brief Model/view chat transcript that lays out and paints only the visible lines.
+ *
+ * Copyright (c) 2009-2010 by R. Douglas Barbieri
+ * 
+ * The source code in this file ("Source Code") is provided by R. Douglas Barbieri
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL").  Terms of the GPL can be found in doc/GPL-license.txt in this distribution.
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL SOURCE CODE IN THIS DISTRIBUTION IS PROVIDED "AS IS." THE AUTHOR MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ */
+
+#include "ChatTranscript.h"
+
+#include <QAbstractTextDocumentLayout>
+#include <QApplication>
+#include <QClipboard>
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QScrollBar>
+
+#include <math.h>
+
+#define LINE_MARGIN			2
+#define LAYOUT_CACHE_SIZE	256		// Laid out documents kept around; a few screens' worth
+#define LAYOUT_BATCH_SIZE	200
+#define MAX_LINES			2000	// Rows kept before the oldest are dropped
+#define TRIM_BATCH			200		// Rows dropped at a time
+
+
+//------------------------------------------------------------------------------
+// ChatTranscriptModel
+//------------------------------------------------------------------------------
+
+ChatTranscriptModel::ChatTranscriptModel( QObject* parent )
+	: QAbstractListModel( parent )
+	, m_nextId(0)
+	, m_hasTransient(false)
+{
+}
+
+
+int ChatTranscriptModel::rowCount( const QModelIndex& parent ) const
+{
+	return parent.isValid()? 0: m_lines.size();
+}
+
+
+QVariant ChatTranscriptModel::data( const QModelIndex& index, int role ) const
+{
+	if( !index.isValid() || index.row() >= m_lines.size() )
+	{
+		return QVariant();
+	}
+	//
+	const Line& line = m_lines[index.row()];
+	switch( role )
+	{
+		case Qt::DisplayRole:	return line.m_html;
+		case LineIdRole:		return qulonglong(line.m_id);
+	}
+	return QVariant();
+}
+
+
+ChatTranscriptModel::Line ChatTranscriptModel::MakeLine( const QString& html, const qint64 logOffset )
+{
+	Line line;
+	line.m_id			= m_nextId++;
+	line.m_logOffset	= logOffset;
+	line.m_html			= html;
+	return line;
+}
+
+
+void ChatTranscriptModel::AppendLine( const QString& html, const qint64 logOffset )
+{
+	// New lines go in above the transient line, if there is one
+	//
+	const int row = m_lines.size() - (m_hasTransient? 1: 0);
+	beginInsertRows( QModelIndex(), row, row );
+	m_lines.insert( row, MakeLine( html, logOffset ) );
+	endInsertRows();
+}
+
+
+void ChatTranscriptModel::PrependLines( const QStringList& lines, const QList<qint64>& logOffsets )
+{
+	if( lines.isEmpty() )
+	{
+		return;
+	}
+	//
+	beginInsertRows( QModelIndex(), 0, lines.size() - 1 );
+	for( int idx = lines.size() - 1; idx >= 0; --idx )
+	{
+		m_lines.prepend( MakeLine( lines[idx], logOffsets.value( idx, -1 ) ) );
+	}
+	endInsertRows();
+}
+
+
+void ChatTranscriptModel::RemoveFirstLines( const int count )
+{
+	// Never the transient line
+	//
+	const int rows = qMin( count, m_lines.size() - (m_hasTransient? 1: 0) );
+	if( rows <= 0 )
+	{
+		return;
+	}
+	//
+	QList<quint64> ids;
+	ids.reserve( rows );
+	beginRemoveRows( QModelIndex(), 0, rows - 1 );
+	for( int idx = 0; idx < rows; ++idx )
+	{
+		ids << m_lines.first().m_id;
+		m_lines.removeFirst();
+	}
+	endRemoveRows();
+	Q_EMIT linesDropped( ids );
+}
+
+
+void ChatTranscriptModel::SetTransientLine( const QString& html )
+{
+	if( m_hasTransient )
+	{
+		// A fresh id, so nothing cached for the old text is reused
+		//
+		const int row = m_lines.size() - 1;
+		const quint64 oldId = m_lines[row].m_id;
+		m_lines[row] = MakeLine( html );
+		Q_EMIT linesDropped( QList<quint64>() << oldId );
+		const QModelIndex changed = index( row );
+		Q_EMIT dataChanged( changed, changed );
+	}
+	else
+	{
+		const int row = m_lines.size();
+		beginInsertRows( QModelIndex(), row, row );
+		m_lines.append( MakeLine( html ) );
+		m_hasTransient = true;
+		endInsertRows();
+	}
+}
+
+
+void ChatTranscriptModel::ClearTransientLine()
+{
+	if( m_hasTransient )
+	{
+		const int row = m_lines.size() - 1;
+		const quint64 id = m_lines[row].m_id;
+		beginRemoveRows( QModelIndex(), row, row );
+		m_lines.removeLast();
+		m_hasTransient = false;
+		endRemoveRows();
+		Q_EMIT linesDropped( QList<quint64>() << id );
+	}
+}
+
+
+qint64 ChatTranscriptModel::FirstLogOffset() const
+{
+	foreach( const Line& line, m_lines )
+	{
+		if( line.m_logOffset >= 0 )
+		{
+			return line.m_logOffset;
+		}
+	}
+	return -1;
+}
+
+
+void ChatTranscriptModel::Clear()
+{
+	beginResetModel();
+	m_lines.clear();
+	m_hasTransient = false;
+	endResetModel();
+}
+
+
+//------------------------------------------------------------------------------
+// ChatTranscriptDelegate
+//------------------------------------------------------------------------------
+
+ChatTranscriptDelegate::ChatTranscriptDelegate( QListView* view )
+	: QStyledItemDelegate( view )
+	, m_view(view)
+	, m_layouts(LAYOUT_CACHE_SIZE)
+	, m_width(-1)
+{
+}
+
+
+int ChatTranscriptDelegate::TextWidth() const
+{
+	return qMax( 1, m_view->viewport()->width() - 2*LINE_MARGIN );
+}
+
+
+QTextDocument* ChatTranscriptDelegate::Layout( const QModelIndex& index, const QFont& font ) const
+{
+	const int width = TextWidth();
+	if( width != m_width )
+	{
+		// Every line wraps differently now
+		//
+		m_layouts.clear();
+		m_heights.clear();
+		m_width = width;
+	}
+	//
+	const quint64 id = index.data( ChatTranscriptModel::LineIdRole ).toULongLong();
+	QTextDocument* doc = m_layouts.object( id );
+	if( !doc )
+	{
+		doc = new QTextDocument;
+		doc->setDocumentMargin( 0 );
+		doc->setDefaultFont( font );
+		doc->setHtml( index.data( Qt::DisplayRole ).toString() );
+		doc->setTextWidth( width );
+		//
+		m_heights.insert( id, int(ceil(doc->size().height())) );
+		m_layouts.insert( id, doc );
+	}
+	return doc;
+}
+
+
+QSize ChatTranscriptDelegate::sizeHint( const QStyleOptionViewItem& option, const QModelIndex& index ) const
+{
+	// Once a line has been measured at this width, its height is all the view
+	// needs until it scrolls into sight.
+	//
+	const quint64 id = index.data( ChatTranscriptModel::LineIdRole ).toULongLong();
+	if( TextWidth() != m_width || !m_heights.contains( id ) )
+	{
+		Layout( index, option.font );
+	}
+	return QSize( m_width + 2*LINE_MARGIN, m_heights.value( id ) + 2*LINE_MARGIN );
+}
+
+
+void ChatTranscriptDelegate::paint( QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index ) const
+{
+	QStyleOptionViewItemV4 opt = option;
+	initStyleOption( &opt, index );
+	opt.text = QString();
+	m_view->style()->drawControl( QStyle::CE_ItemViewItem, &opt, painter, m_view );
+	//
+	QTextDocument* doc = Layout( index, option.font );
+	//
+	QAbstractTextDocumentLayout::PaintContext context;
+	context.palette = option.palette;
+	if( option.state & QStyle::State_Selected )
+	{
+		context.palette.setColor( QPalette::Text, option.palette.color( QPalette::HighlightedText ) );
+	}
+	context.clip = QRectF( 0, 0, option.rect.width() - 2*LINE_MARGIN, option.rect.height() - 2*LINE_MARGIN );
+	//
+	painter->save();
+	painter->translate( option.rect.left() + LINE_MARGIN, option.rect.top() + LINE_MARGIN );
+	painter->setClipRect( context.clip );
+	doc->documentLayout()->draw( painter, context );
+	painter->restore();
+}
+
+
+QString ChatTranscriptDelegate::AnchorAt( const QModelIndex& index, const QRect& rect, const QPoint& pos ) const
+{
+	QTextDocument* doc = Layout( index, m_view->font() );
+	const QPoint docPos = pos - rect.topLeft() - QPoint( LINE_MARGIN, LINE_MARGIN );
+	return doc->documentLayout()->anchorAt( docPos );
+}
+
+
+void ChatTranscriptDelegate::ClearLayouts()
+{
+	m_layouts.clear();
+	m_heights.clear();
+}
+
+
+void ChatTranscriptDelegate::ForgetLines( const QList<quint64>& ids )
+{
+	// Ids are never reused, so nothing would ever look these up again
+	//
+	foreach( const quint64 id, ids )
+	{
+		m_layouts.remove( id );
+		m_heights.remove( id );
+	}
+}
+
+
+//------------------------------------------------------------------------------
+// ChatTranscriptView
+//------------------------------------------------------------------------------
+
+ChatTranscriptView::ChatTranscriptView( QWidget* parent )
+	: QListView( parent )
+	, m_model( new ChatTranscriptModel( this ) )
+	, m_delegate( new ChatTranscriptDelegate( this ) )
+{
+	setModel( m_model );
+	setItemDelegate( m_delegate );
+	connect( m_model, SIGNAL(linesDropped(QList<quint64>)), m_delegate, SLOT(ForgetLines(QList<quint64>)) );
+	//
+	// Rows are laid out a batch at a time from the event loop, so even a
+	// very long transcript never stalls the GUI on resize.
+	//
+	setLayoutMode( QListView::Batched );
+	setBatchSize( LAYOUT_BATCH_SIZE );
+	setResizeMode( QListView::Adjust );
+	setUniformItemSizes( false );
+	setWordWrap( true );
+	setVerticalScrollMode( QAbstractItemView::ScrollPerPixel );
+	setHorizontalScrollBarPolicy( Qt::ScrollBarAlwaysOff );
+	setSelectionMode( QAbstractItemView::ExtendedSelection );
+	setEditTriggers( QAbstractItemView::NoEditTriggers );
+	setMouseTracking( true );
+	//
+	connect( verticalScrollBar(), SIGNAL(actionTriggered(int)), this, SLOT(OnScrollAction(int)) );
+}
+
+
+void ChatTranscriptView::AppendLine( const QString& html, const qint64 logOffset )
+{
+	const QScrollBar* bar = verticalScrollBar();
+	const bool atBottom = bar->value() == bar->maximum();
+	//
+	m_model->AppendLine( html, logOffset );
+	//
+	// Drop the oldest lines a batch at a time. While the reader is scrolled
+	// up they are left alone, unless twice as many as usual have piled up.
+	//
+	const int excess = m_model->rowCount() - MAX_LINES;
+	if( excess >= TRIM_BATCH && (atBottom || excess >= MAX_LINES) )
+	{
+		m_model->RemoveFirstLines( excess );
+		Q_EMIT linesTrimmed( m_model->FirstLogOffset() );
+	}
+}
+
+
+void ChatTranscriptView::PrependLines( const QStringList& lines, const QList<qint64>& logOffsets )
+{
+	m_model->PrependLines( lines, logOffsets );
+}
+
+
+void ChatTranscriptView::RemoveFirstLines( const int count )
+{
+	m_model->RemoveFirstLines( count );
+}
+
+
+void ChatTranscriptView::SetTransientLine( const QString& html )
+{
+	m_model->SetTransientLine( html );
+}
+
+
+void ChatTranscriptView::ClearTransientLine()
+{
+	m_model->ClearTransientLine();
+}
+
+
+void ChatTranscriptView::Clear()
+{
+	m_model->Clear();
+	m_delegate->ClearLayouts();
+}
+
+
+void ChatTranscriptView::ScrollToEnd()
+{
+	scrollToBottom();
+}
+
+
+QString ChatTranscriptView::AnchorAt( const QPoint& pos ) const
+{
+	const QModelIndex index = indexAt( pos );
+	if( !index.isValid() )
+	{
+		return QString();
+	}
+	return m_delegate->AnchorAt( index, visualRect( index ), pos );
+}
+
+
+void ChatTranscriptView::CopySelection()
+{
+	QModelIndexList selected = selectedIndexes();
+	qSort( selected );
+	//
+	QStringList lines;
+	foreach( const QModelIndex& index, selected )
+	{
+		QTextDocument doc;
+		doc.setHtml( index.data( Qt::DisplayRole ).toString() );
+		lines << doc.toPlainText();
+	}
+	//
+	QApplication::clipboard()->setText( lines.join("\n") );
+}
+
+
+void ChatTranscriptView::keyPressEvent( QKeyEvent* event )
+{
+	if( event == QKeySequence::Copy )
+	{
+		CopySelection();
+		event->accept();
+		return;
+	}
+	QListView::keyPressEvent( event );
+}
+
+
+void ChatTranscriptView::mouseMoveEvent( QMouseEvent* event )
+{
+	const bool overLink = !AnchorAt( event->pos() ).isEmpty();
+	viewport()->setCursor( overLink? Qt::PointingHandCursor: Qt::ArrowCursor );
+	//
+	QListView::mouseMoveEvent( event );
+}
+
+
+void ChatTranscriptView::mouseReleaseEvent( QMouseEvent* event )
+{
+	if( event->button() == Qt::LeftButton )
+	{
+		const QString anchor = AnchorAt( event->pos() );
+		if( !anchor.isEmpty() )
+		{
+			Q_EMIT anchorClicked( QUrl( anchor ) );
+		}
+	}
+	//
+	QListView::mouseReleaseEvent( event );
+}
+
+
+void ChatTranscriptView::OnScrollAction( int /*action*/ )
+{
+	// Only fires for the reader moving the bar, not for the view scrolling
+	// itself, so paging in more history from here can't run away.
+	//
+	const QScrollBar* bar = verticalScrollBar();
+	if( bar->sliderPosition() == bar->minimum() )
+	{
+		Q_EMIT scrolledToTop();
+	}
+}
+
+// vim: ts=4 sw=4 noexpandtab syntax=cpp.doxygen
@@ -0,0 +1,165 @@
+/** 
+ * \brief Model/view chat transcript that lays out and paints only the visible lines.
+ *
+ * Copyright (c) 2009-2010 by R. Douglas Barbieri
+ * 
+ * The source code in this file ("Source Code") is provided by R. Douglas Barbieri
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL").  Terms of the GPL can be found in doc/GPL-license.txt in this distribution.
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL SOURCE CODE IN THIS DISTRIBUTION IS PROVIDED "AS IS." THE AUTHOR MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ */
+#ifndef __CHATTRANSCRIPT_H__
+#define __CHATTRANSCRIPT_H__
+
+#include <QAbstractListModel>
+#include <QCache>
+#include <QHash>
+#include <QList>
+#include <QListView>
+#include <QStringList>
+#include <QStyledItemDelegate>
+#include <QTextDocument>
+#include <QUrl>
+
+/// One HTML line per row. Lines carry a serial number that stays with them
+/// when older history is prepended, so per-line caches survive row shifts,
+/// and the offset of their entry in the conversation log, if they have one.
+/// An optional transient line (e.g. "typing...") always sits at the bottom.
+///
+class ChatTranscriptModel
+	: public QAbstractListModel
+{
+	Q_OBJECT
+	Q_DISABLE_COPY(ChatTranscriptModel)
+
+public:
+	enum { LineIdRole = Qt::UserRole };
+
+	explicit ChatTranscriptModel( QObject* parent = 0 );
+
+	int			rowCount( const QModelIndex& parent = QModelIndex() ) const;
+	QVariant	data( const QModelIndex& index, int role = Qt::DisplayRole ) const;
+
+	void		AppendLine( const QString& html, const qint64 logOffset = -1 );
+	void		PrependLines( const QStringList& lines, const QList<qint64>& logOffsets = QList<qint64>() );
+	void		RemoveFirstLines( const int count );
+	void		SetTransientLine( const QString& html );
+	void		ClearTransientLine();
+	void		Clear();
+
+	/// Log offset of the oldest line that came from the log, or -1.
+	qint64		FirstLogOffset() const;
+
+Q_SIGNALS:
+	/// Lines that have left the model, or been replaced, for good.
+	void		linesDropped( const QList<quint64>& ids );
+
+private:
+	struct Line
+	{
+		quint64	m_id;
+		qint64	m_logOffset;
+		QString	m_html;
+	};
+	typedef QList<Line>	LineList;
+
+	LineList	m_lines;
+	quint64		m_nextId;
+	bool		m_hasTransient;
+
+	Line		MakeLine( const QString& html, const qint64 logOffset = -1 );
+};
+
+
+/// Renders the HTML of a row with a QTextDocument. Row heights are kept per
+/// line for the current viewport width, and the laid out documents for the
+/// most recently painted rows are kept in a bounded cache, so only lines
+/// scrolled into view are ever laid out again.
+///
+class ChatTranscriptDelegate
+	: public QStyledItemDelegate
+{
+	Q_OBJECT
+	Q_DISABLE_COPY(ChatTranscriptDelegate)
+
+public:
+	explicit ChatTranscriptDelegate( QListView* view );
+
+	void		paint( QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index ) const;
+	QSize		sizeHint( const QStyleOptionViewItem& option, const QModelIndex& index ) const;
+
+	QString		AnchorAt( const QModelIndex& index, const QRect& rect, const QPoint& pos ) const;
+	void		ClearLayouts();
+
+public Q_SLOTS:
+	void		ForgetLines( const QList<quint64>& ids );
+
+private:
+	QListView*								m_view;
+	mutable QCache<quint64,QTextDocument>	m_layouts;
+	mutable QHash<quint64,int>				m_heights;
+	mutable int								m_width;
+
+	int				TextWidth() const;
+	QTextDocument*	Layout( const QModelIndex& index, const QFont& font ) const;
+};
+
+
+/// Drop-in replacement for the QTextBrowser that used to hold the chat text.
+/// Only the newest lines are kept; older ones are dropped from the top and
+/// the owner is told where in the log to page them back in from.
+///
+class ChatTranscriptView
+	: public QListView
+{
+	Q_OBJECT
+	Q_DISABLE_COPY(ChatTranscriptView)
+
+public:
+	explicit ChatTranscriptView( QWidget* parent = 0 );
+
+	void		AppendLine( const QString& html, const qint64 logOffset = -1 );
+	void		PrependLines( const QStringList& lines, const QList<qint64>& logOffsets = QList<qint64>() );
+	void		RemoveFirstLines( const int count );
+	void		SetTransientLine( const QString& html );
+	void		ClearTransientLine();
+	void		Clear();
+
+	void		ScrollToEnd();
+
+Q_SIGNALS:
+	void		anchorClicked( const QUrl& url );
+
+	/// Lines were dropped from the top. The oldest line left starts at
+	/// "logOffset" in the log, or -1 if none of them came from it.
+	void		linesTrimmed( qint64 logOffset );
+
+	/// The reader scrolled up as far as the transcript goes.
+	void		scrolledToTop();
+
+protected:
+	void		keyPressEvent( QKeyEvent* event );
+	void		mouseMoveEvent( QMouseEvent* event );
+	void		mouseReleaseEvent( QMouseEvent* event );
+
+private:
+	ChatTranscriptModel*	m_model;
+	ChatTranscriptDelegate*	m_delegate;
+
+	QString		AnchorAt( const QPoint& pos ) const;
+	void		CopySelection();
+
+private Q_SLOTS:
+	void		OnScrollAction( int action );
+};
+
+#endif //__CHATTRANSCRIPT_H__
+
+// vim: ts=4 sw=4 noexpandtab syntax=cpp.doxygen
@@ -17,6 +17,7 @@
  */
 
 #include "ChatWindow.h"
+#include "ChatTranscript.h"
 #include "LLChatLib.h"
 #include "Utility.h"
 #include "Common.h"
@@ -46,6 +47,9 @@
 #define TYPING_TIMEOUT		3
 
 #define FULLPATH_TEMPLATE	"%1/%2.txt"
+#define HISTORY_LOAD_LINES	200		// Lines of history shown when a tab opens
+#define HISTORY_PAGE_LINES	200		// Lines pulled in each time older history is requested
+#define OLDER_HISTORY_URL	"slitechat:older-history"
 
 
 namespace
@@ -80,6 +84,9 @@ QString GetLanguageName( const LLC::String& agent_id )
 }
 
 
+ChatWindow::RosterRoutes ChatWindow::s_rosterRoutes;
+
+
 ChatWindow::ChatWindow( QWidget* parent )
 	: QWidget( parent )
 	, m_imId("LocalChat")
@@ -90,14 +97,15 @@ ChatWindow::ChatWindow( QWidget* parent )
 	, m_typingMessagePending(false)
 	, m_isTyping(0)
     , m_ui(0)
+	, m_avIndex(0)
 	, m_timerId(-1)
 	, m_lastChannel(0)
+	, m_olderOffset(0)
 {
 	InitPanel( false /*isIMWindow*/, true /*showRoomList*/ );
 	//
 	//m_ui->m_dockWidget->setWindowTitle( "Nearby Residents (Local Chat)" );
 	//
-	m_ui->m_textEdit->setSource( QUrl() );
 	Load();
 	m_startDate = QDate::currentDate();
 
@@ -130,8 +138,10 @@ ChatWindow::ChatWindow( QWidget* parent, const QString& id, const QString& fullN
 	, m_typingMessagePending(false)
 	, m_isTyping(0)
     , m_ui(0)
+	, m_avIndex(0)
 	, m_timerId(-1)
 	, m_lastChannel(0)
+	, m_olderOffset(0)
 {
 	InitPanel( true /*isIMWindow*/, is_group /*showRoomList*/  );
 	//
@@ -154,10 +164,10 @@ ChatWindow::~ChatWindow()
 	m_closeConnection			.disconnect();
 	m_friendAcceptConnection	.disconnect();
 	m_friendTerminateConnection	.disconnect();
-	m_cacheConnection			.disconnect();
 	m_localAvsConnection		.disconnect();
 	m_imConnection				.disconnect();
 	//
+	ClearRoster();
 	Save();
 	//
 	delete m_ui;
@@ -194,32 +204,34 @@ void ChatWindow::Load()
 	if( PersistConvo() )
 	{
 		QString user_path = GetPersistFullPath( m_imId );
-		QFile inputFile( user_path );
-		if( inputFile.open( QIODevice::ReadOnly | QIODevice::Text ) )
+		if( m_log.Open( user_path ) )
 		{
-			QString htmlInput("<font color=\"gray\">");
-			while( !inputFile.atEnd() )
+			// Only the tail of the log is shown; older history is paged in
+			// from the log when the reader scrolls up or asks for it.
+			//
+			QList<qint64> offsets;
+			const QStringList history = m_log.ReadTail( HISTORY_LOAD_LINES, &m_olderOffset, &offsets );
+			//
+			ChatTranscriptView* transcript = m_ui->m_transcript;
+			transcript->Clear();
+			if( m_olderOffset > 0 )
 			{
-				QByteArray line		= inputFile.readLine();
-				QString    strLine	= QString::fromUtf8(line.constData());
-				htmlInput += QString("%1<br>").arg(strLine);
-				m_history += strLine;
+				transcript->AppendLine( OlderHistoryLink() );
+			}
+			for( int idx = 0; idx < history.size(); ++idx )
+			{
+				transcript->AppendLine( QString("<font color=\"gray\">%1</font>").arg(history[idx]), offsets.value( idx, -1 ) );
 			}
 			//
 			if( m_isLocalChat )
 			{
-				htmlInput += tr("-- Local chat logging enabled --<br>");
+				transcript->AppendLine( QString("<font color=\"gray\">%1</font>").arg(tr("-- Local chat logging enabled --")) );
 			}
 			else
 			{
-				htmlInput += tr("-- Instant message logging enabled --<br>");
+				transcript->AppendLine( QString("<font color=\"gray\">%1</font>").arg(tr("-- Instant message logging enabled --")) );
 			}
 			//
-			htmlInput += "</font>";
-			//
-			QTextBrowser* editor = m_ui->m_textEdit;
-			editor->setHtml( htmlInput );
-			//
 			MoveCursorToEnd();
 		}
 	}
@@ -228,23 +240,44 @@ void ChatWindow::Load()
 
 void ChatWindow::Save()
 {
-	if( PersistConvo() )
+	// Entries are appended to the log as they arrive, so all that is left is
+	// to get the last batch onto disk.
+	//
+	m_log.Close();
+}
+
+
+QString ChatWindow::OlderHistoryLink() const
+{
+	return QString("<a href=\"%1\">%2</a>").arg(OLDER_HISTORY_URL).arg(tr("Show older history..."));
+}
+
+
+void ChatWindow::LoadOlderHistory()
+{
+	QList<qint64> offsets;
+	QStringList lines = m_log.ReadBefore( &m_olderOffset, HISTORY_PAGE_LINES, &offsets );
+	for( QStringList::iterator it = lines.begin(); it != lines.end(); ++it )
 	{
-		LLC::Manager mgr;
-		QString user_path = GetPersistFullPath( m_imId );
-		QFile outputFile( user_path );
-		if( outputFile.open( QIODevice::WriteOnly | QIODevice::Text ) )
-		{
-#if 0
-			QTextBrowser* editor = m_ui->m_textEdit;
-			editor->clear();
-			editor->insertHtml( m_history );
-			outputFile.write( editor->toPlainText().toUtf8() );
-#else
-			outputFile.write( m_history.toUtf8() );
-#endif
-		}
+		*it = QString("<font color=\"gray\">%1</font>").arg(*it);
+	}
+	//
+	// Replace the "older history" link (always the first line) with the page
+	// just read, then put a new link above it if there is more to come.
+	//
+	if( m_olderOffset > 0 )
+	{
+		lines.prepend( OlderHistoryLink() );
+		offsets.prepend( -1 );
 	}
+	//
+	// Keep the reader's place: the line that was second from the top (just
+	// under the link) stays at the top of the view.
+	//
+	ChatTranscriptView* transcript = m_ui->m_transcript;
+	transcript->RemoveFirstLines( 1 );
+	transcript->PrependLines( lines, offsets );
+	transcript->scrollTo( transcript->model()->index( lines.size(), 0 ), QAbstractItemView::PositionAtTop );
 }
 
 
@@ -254,6 +287,7 @@ void ChatWindow::InitPanel( const bool isIMWindow, const bool showRoomList )
 	//
     m_ui = new Ui_ChatWindow;
 	m_ui->setupUi( this );
+	m_avIndex = new TreeIndex( m_ui->m_avList, 0, Qt::AscendingOrder, 1, Qt::AscendingOrder );
 	//
 	if( showRoomList )
 	{
@@ -267,8 +301,6 @@ void ChatWindow::InitPanel( const bool isIMWindow, const bool showRoomList )
 		m_ui->m_splitter->setSizes( sizes );
 #endif
 		//
-		m_cacheConnection = mgr.ConnectCacheSignal( boost::bind( &ChatWindow::OnCacheSignal, this, _1, _2, _3 ) );
-
 		m_ui->m_avList->insertAction( 0, m_ui->m_actionSendIM );
 		m_ui->m_avList->insertAction( 0, m_ui->m_actionChangeLanguage );
 	}
@@ -300,7 +332,8 @@ void ChatWindow::InitPanel( const bool isIMWindow, const bool showRoomList )
 	}
 	else
 	{
-		m_localAvsConnection = mgr.ConnectLocalAgentsPresentSignal( boost::bind( &ChatWindow::OnLocalAvsPresent, this ) );
+		m_localAvsConnection = mgr.ConnectLocalAgentUpdateSignal( boost::bind( &ChatWindow::UpdateRoster, this, _1, _2 ) );
+		OnLocalAvsPresent();
 		//
 		const int count = m_ui->m_topButtonLayout->count();
 		for( int index = 0; index < count; ++index )
@@ -322,10 +355,7 @@ void ChatWindow::InitPanel( const bool isIMWindow, const bool showRoomList )
 
 void ChatWindow::MoveCursorToEnd()
 {
-	QTextBrowser* editor = m_ui->m_textEdit;
-	QTextCursor cursor = editor->textCursor();
-	cursor.movePosition( QTextCursor::End );
-	editor->setTextCursor( cursor );
+	m_ui->m_transcript->ScrollToEnd();
 }
 
 
@@ -470,35 +500,40 @@ QString CR2BR( const QString& text )
 
 void ChatWindow::AddText( const QString& text, const bool moveCursor )
 {
-	QTextBrowser* editor = m_ui->m_textEdit;
-	//
-	if( moveCursor )
-	{
-		MoveCursorToEnd();
-	}
+	ChatTranscriptView* transcript = m_ui->m_transcript;
 	//
 	if( m_startDate != QDate::currentDate() )
 	{
-		// Clear out text and put in history text, because it contains full date/time stamps.
+		// The on-screen stamps only carry the time, so mark where the new day starts.
 		//
 		m_startDate = QDate::currentDate();
-		editor->clear();
-		editor->insertHtml( m_history );
+		transcript->AppendLine( QString("<font color=\"gray\">-- %1 --</font>").arg(m_startDate.toString("yyyy/MM/dd")) );
 	}
 	//
+	QString line;
+	QString entry;
 	if( ShowTimestamps() )
 	{
 		QString currentTime = QTime::currentTime().toString("hh:mm");
-		QString timeStamp   = QString("<font color=\"black\">[%1] </font>").arg( currentTime );
-		editor->insertHtml( timeStamp );
+		line = QString("<font color=\"black\">[%1] </font>").arg( currentTime );
 		//
 		QString dateStamp   = QDateTime::currentDateTime().toString("yyyy/MM/dd hh:mm");
-		m_history += QString("<font color=\"black\">[%1] </font>").arg(dateStamp);
+		entry = QString("<font color=\"black\">[%1] </font>").arg(dateStamp);
 	}
 	//
-	editor->insertHtml( CR2BR(WrapHTML(text)) );
-	editor->insertPlainText( "\n" );
-	m_history += QString("%1\n").arg(text);
+	entry += text;
+	//
+	qint64 logOffset = -1;
+	if( PersistConvo() )
+	{
+		if( !m_log.IsOpen() )
+		{
+			m_log.Open( GetPersistFullPath( m_imId ) );
+		}
+		logOffset = m_log.Append( entry, m_startDate );
+	}
+	//
+	transcript->AppendLine( line + CR2BR(WrapHTML(text)), logOffset );
 
 	if( moveCursor )
 	{
@@ -542,10 +577,7 @@ void ChatWindow::RemoveTypingMessage()
 	{
 		m_typingMessagePending = false;
 
-		QTextBrowser* editor = m_ui->m_textEdit;
-		editor->undo();
-		//
-		MoveCursorToEnd();
+		m_ui->m_transcript->ClearTransientLine();
 	}
 }
 
@@ -736,9 +768,6 @@ void ChatWindow::AddTypingStatus( const QString& from, bool start )
 	
 	if( start )
 	{
-		QTextBrowser* editor = m_ui->m_textEdit;
-		QTextCursor cursor = editor->textCursor();
-		cursor.beginEditBlock();
 		QString msg;
 		QTextStream(&msg)
 			<< "<font color=\"green\">"
@@ -746,10 +775,11 @@ void ChatWindow::AddTypingStatus( const QString& from, bool start )
 			<< (start? tr(" started"): tr(" stopped"))
 			<< tr(" typing...")
 			<< "</font>";
-		AddText( msg, false );
-		cursor.endEditBlock();
-		cursor.movePosition( QTextCursor::End );
-		editor->setTextCursor( cursor );
+		//
+		// Shown below the conversation until the next message arrives; never logged.
+		//
+		m_ui->m_transcript->SetTransientLine( msg );
+		MoveCursorToEnd();
 		//
 		m_typingMessagePending = true;
 		//
@@ -787,18 +817,22 @@ void ChatWindow::AddLogEntry( const QString& message, bool error )
 
 void ChatWindow::UpdateNamesInChat( const QString& agentId, const bool entering )
 {
-	// Check to see if we are already in the agents list.
-	//
-	QTreeWidget* avList = m_ui->m_avList;
-	QTreeWidgetItemIterator it( avList );
-	for( ; *it; ++it )
+	if( !entering )
 	{
-		if( (*it)->data( 0, Qt::UserRole ).toString() == agentId )
+		if( m_avIndex->Remove( agentId ) )
 		{
-			// Already in list, so just stop here
-			//
-			return;
+			s_rosterRoutes.remove( agentId, this );
 		}
+		return;
+	}
+
+	// Check to see if we are already in the agents list.
+	//
+	if( m_avIndex->Contains( agentId ) )
+	{
+		// Already in list, so just stop here
+		//
+		return;
 	}
 
 	// Save in list
@@ -817,12 +851,30 @@ void ChatWindow::UpdateNamesInChat( const QString& agentId, const bool entering
 	item->setFont( 0, font );
 	item->setData( 0, Qt::UserRole, agentId );
 	item->setFont( 1, font );
-	avList->addTopLevelItem( item );
+	m_avIndex->Add( item );
+	s_rosterRoutes.insert( agentId, this );
+}
 
-	// Set sort order
+
+void ChatWindow::UpdateRoster( const LLC::IdList& entered, const LLC::IdList& left )
+{
+	// Applied as one change: a single repaint, and a single sort once back in the event loop
+	//
+	m_ui->m_avList->setUpdatesEnabled( false );
 	//
-	avList->sortItems( 1, Qt::AscendingOrder  );
-	avList->sortItems( 0, Qt::AscendingOrder );
+	char agentId[LLC::IdList::ID_STRING_SIZE];
+	for( int idx = 0; idx < left.GetCount(); ++idx )
+	{
+		left.GetId( idx, agentId );
+		UpdateNamesInChat( QString::fromLatin1(agentId), false /*entering*/ );
+	}
+	for( int idx = 0; idx < entered.GetCount(); ++idx )
+	{
+		entered.GetId( idx, agentId );
+		UpdateNamesInChat( QString::fromLatin1(agentId), true /*entering*/ );
+	}
+	//
+	m_ui->m_avList->setUpdatesEnabled( true );
 }
 
 
@@ -830,33 +882,44 @@ void ChatWindow::OnCacheSignal( LLC::String agent_id, LLC::String fullName, bool
 {
 	QString			qAgentId	= LS2Q(agent_id);
 	//
-	// Check to see if we are already in the friends list.
+	// Update the entry if the agent is in our list
 	//
-	QTreeWidget* avList = m_ui->m_avList;
-	QTreeWidgetItemIterator it( avList );
-	for( ; *it; ++it )
+	QTreeWidgetItem* item = m_avIndex->Edit( qAgentId );
+	if( item )
 	{
-		QTreeWidgetItem* item = *it;
-		if( item->data( 0, Qt::UserRole ).toString() == qAgentId )
-		{
-			// Update list entry
-			//
-			QFont font( item->font(0) );
-			font.setBold( false );
-			item->setText( 0, LS2Q(fullName));
-			item->setFont( 0, font );
-			item->setText( 1, GetLanguageName( agent_id ) );
-			item->setFont( 1, font );
-
-			// Set sort order
-			//
-			avList->sortItems( 1, Qt::AscendingOrder  );
-			avList->sortItems( 0, Qt::AscendingOrder );
-		}
+		QFont font( item->font(0) );
+		font.setBold( false );
+		item->setText( 0, LS2Q(fullName));
+		item->setFont( 0, font );
+		item->setText( 1, GetLanguageName( agent_id ) );
+		item->setFont( 1, font );
+	}
+}
+
+
+// static
+void ChatWindow::RouteCacheSignal( LLC::String agent_id, LLC::String fullName, bool is_group )
+{
+	// Copied, since a window could in principle drop the agent as it updates
+	//
+	const QList<ChatWindow*> windows = s_rosterRoutes.values( LS2Q(agent_id) );
+	foreach( ChatWindow* chatWnd, windows )
+	{
+		chatWnd->OnCacheSignal( agent_id, fullName, is_group );
 	}
 }
 
 
+void ChatWindow::ClearRoster()
+{
+	foreach( const QString& agentId, m_avIndex->Ids() )
+	{
+		s_rosterRoutes.remove( agentId, this );
+	}
+	m_avIndex->Clear();
+}
+
+
 void ChatWindow::OnFriendshipAccept( LLC::String agentId )
 {
 	QString id( agentId.GetString() );
@@ -885,8 +948,7 @@ void ChatWindow::OnTerminateFriendship( LLC::String agentId )
 
 void ChatWindow::OnLocalAvsPresent()
 {
-	QTreeWidget* avList = m_ui->m_avList;
-	avList->clear();
+	ClearRoster();
 	//
 	LLC::Manager mgr;
 	const int av_count = mgr.GetLocalAvatarCount();
@@ -1088,7 +1150,11 @@ void ChatWindow::OnCloseButtonClicked()
 
 void ChatWindow::OnAnchorClicked( QUrl url )
 {
-	if( url.scheme() == "secondlife" )
+	if( url == QUrl(OLDER_HISTORY_URL) )
+	{
+		LoadOlderHistory();
+	}
+	else if( url.scheme() == "secondlife" )
 	{
 		QString msg = tr("Are you sure you want to teleport to %1?").arg(url.toString());
 		//
@@ -1106,6 +1172,28 @@ void ChatWindow::OnAnchorClicked( QUrl url )
 }
 
 
+void ChatWindow::OnTranscriptTrimmed( qint64 logOffset )
+{
+	// The dropped lines are still in the log; page them back in from just
+	// before the oldest line still on display.
+	//
+	m_olderOffset = qMax<qint64>( logOffset, 0 );
+	if( m_olderOffset > 0 )
+	{
+		m_ui->m_transcript->PrependLines( QStringList() << OlderHistoryLink() );
+	}
+}
+
+
+void ChatWindow::OnTranscriptScrolledToTop()
+{
+	if( m_olderOffset > 0 )
+	{
+		LoadOlderHistory();
+	}
+}
+
+
 void ChatWindow::OnItemDoubleClicked( QTreeWidgetItem* item, int column )
 {
     if( item )
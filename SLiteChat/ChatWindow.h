@@ -19,12 +19,15 @@
 #define __CHATWINDOW_H__
 
 #include "LLChatLib.h"
+#include "ConversationLog.h"
+#include "TreeIndex.h"
 
 #include <boost/signals.hpp>
 
 #include <QWidget>
 #include <QTimer>
 #include <QDate>
+#include <QMultiHash>
 
 #include "ui_ChatWindow.h"
 
@@ -71,8 +74,12 @@ public:
 	void		AddLogEntry( const QString& message, bool error = false );
 
 	void		UpdateNamesInChat( const QString& agentId, const bool entering );
+	void		UpdateRoster( const LLC::IdList& entered, const LLC::IdList& left );
 	void		OnCacheSignal( LLC::String agent_id, LLC::String fullName, bool is_group );
 
+	/// Hand a name arrival to just the windows whose roster lists that ID
+	static void	RouteCacheSignal( LLC::String agent_id, LLC::String fullName, bool is_group );
+
 	typedef boost::signal<void (bool)> BoolSignal;
 	void ConnectTypingSignal( const BoolSignal::slot_type& slot ) { m_typingConnection = m_typingSignal.connect(slot); }
 	//
@@ -87,6 +94,13 @@ protected:
 
 private:
 	Ui_ChatWindow*  m_ui;
+	TreeIndex*      m_avIndex;		// Owned by m_ui->m_avList
+
+	// Which windows list each agent, so a name arrival isn't offered to all
+	//
+	typedef QMultiHash<QString,ChatWindow*> RosterRoutes;
+	static RosterRoutes s_rosterRoutes;
+	void		ClearRoster();
 	bool            m_connected;
 	int             m_pageIndex;
 	QString         m_imId;
@@ -96,7 +110,6 @@ private:
 	LLC::Connection m_closeConnection;
 	LLC::Connection m_friendAcceptConnection;
 	LLC::Connection m_friendTerminateConnection;
-	LLC::Connection m_cacheConnection;
 	LLC::Connection m_localAvsConnection;
 	LLC::Connection m_imConnection;
 	BoolSignal      m_typingSignal;
@@ -109,12 +122,15 @@ private:
 	int             m_timerId;
 	int             m_lastChannel;
 	QDate           m_startDate;
-	QString         m_history;
+	ConversationLog m_log;
+	qint64          m_olderOffset;		// Log offset of the oldest line on display
 
 	// Private methods
 	//
 	void Load();
 	void Save();
+	QString OlderHistoryLink() const;
+	void LoadOlderHistory();
 	void InitPanel( const bool isIMWindow, const bool showRoomList );
 	bool PersistConvo() const;
 	bool ShowTimestamps() const;
@@ -151,6 +167,8 @@ private slots:
 	void OnAddButtonClicked();
 	void OnCloseButtonClicked();
 	void OnAnchorClicked( QUrl url );
+	void OnTranscriptTrimmed( qint64 logOffset );
+	void OnTranscriptScrolledToTop();
 	void OnItemDoubleClicked( QTreeWidgetItem* item, int column );
 	void OnSendIM();
 	void OnChangeLanguage();
@@ -35,6 +35,8 @@
 #define DEFAULT_GX          "off"
 #define ECHO_SOURCE         "EchoSource"
 #define DEFAULT_ES          "on"
+#define NETWORK_THREAD      "NetworkThread"
+#define DEFAULT_NT          false
 
 #define MESSAGE_TIMEOUT_MSECS	10
 
@@ -0,0 +1,331 @@
+/** 
+ * \brief Append-only conversation log with a per-day offset index.
+ *
+ * Copyright (c) 2009-2010 by R. Douglas Barbieri
+ * 
+ * The source code in this file ("Source Code") is provided by R. Douglas Barbieri
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL").  Terms of the GPL can be found in doc/GPL-license.txt in this distribution.
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL SOURCE CODE IN THIS DISTRIBUTION IS PROVIDED "AS IS." THE AUTHOR MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ */
+
+#include "ConversationLog.h"
+
+#include <QRegExp>
+
+#ifdef Q_OS_WIN
+#	include <io.h>
+#else
+#	include <unistd.h>
+#endif
+
+#define SYNC_MSECS		2000
+#define READ_CHUNK		4096
+#define STAMP_SEARCH	64		// Timestamps are within this many bytes of the start of a line
+#define DATE_FORMAT		"yyyy/MM/dd"
+#define INDEX_SUFFIX	".idx"
+
+
+namespace
+{
+
+// Matches the "[yyyy/MM/dd hh:mm]" stamp ChatWindow writes in front of each entry
+//
+const QRegExp g_stampRegExp( "\\[(\\d{4}/\\d{2}/\\d{2}) \\d{2}:\\d{2}\\]" );
+
+
+QDate ParseLineDate( const QByteArray& line )
+{
+	QRegExp re( g_stampRegExp );
+	if( re.indexIn( QString::fromUtf8( line.left(STAMP_SEARCH).constData() ) ) != -1 )
+	{
+		return QDate::fromString( re.cap(1), DATE_FORMAT );
+	}
+	return QDate();
+}
+
+}
+// namespace
+
+
+ConversationLog::ConversationLog( QObject* parent )
+	: QObject( parent )
+	, m_dirty(false)
+{
+	m_syncTimer.setSingleShot( true );
+	m_syncTimer.setInterval( SYNC_MSECS );
+	connect( &m_syncTimer, SIGNAL(timeout()), this, SLOT(Sync()) );
+}
+
+
+ConversationLog::~ConversationLog()
+{
+	Close();
+}
+
+
+bool ConversationLog::Open( const QString& path )
+{
+	Close();
+	//
+	m_file.setFileName( path );
+	if( !m_file.open( QIODevice::ReadWrite ) )
+	{
+		return false;
+	}
+	//
+	m_indexFile.setFileName( path + INDEX_SUFFIX );
+	LoadIndex();
+	//
+	// Anything written since the index was last updated (or a log from an
+	// older version with no index at all) is picked up here. Only the tail
+	// past the last known day start has to be read.
+	//
+	ScanForDays( m_index.isEmpty()? 0: m_index.last().second );
+	return true;
+}
+
+
+void ConversationLog::Close()
+{
+	if( m_file.isOpen() )
+	{
+		Sync();
+		m_file.close();
+		m_indexFile.close();
+	}
+	m_index.clear();
+	m_lastDate = QDate();
+}
+
+
+qint64 ConversationLog::Append( const QString& line, const QDate& date )
+{
+	if( !m_file.isOpen() )
+	{
+		return -1;
+	}
+	//
+	const qint64 offset = m_file.size();
+	if( date.isValid() && date != m_lastDate )
+	{
+		AddIndexEntry( date, offset );
+	}
+	//
+	m_file.seek( offset );
+	m_file.write( line.toUtf8() );
+	m_file.write( "\n", 1 );
+	//
+	m_dirty = true;
+	if( !m_syncTimer.isActive() )
+	{
+		m_syncTimer.start();
+	}
+	//
+	return offset;
+}
+
+
+QStringList ConversationLog::ReadTail( const int count, qint64* start, QList<qint64>* offsets )
+{
+	*start = 0;
+	if( !m_file.isOpen() )
+	{
+		return QStringList();
+	}
+	//
+	m_file.flush();
+	return ReadLines( 0, m_file.size(), count, start, offsets );
+}
+
+
+QStringList ConversationLog::ReadBefore( qint64* offset, const int count, QList<qint64>* offsets )
+{
+	if( !m_file.isOpen() || *offset <= 0 )
+	{
+		return QStringList();
+	}
+	//
+	m_file.flush();
+	return ReadLines( DayStartBefore( *offset ), *offset, count, offset, offsets );
+}
+
+
+void ConversationLog::Sync()
+{
+	m_syncTimer.stop();
+	//
+	if( m_dirty )
+	{
+		m_dirty = false;
+		//
+		m_file.flush();
+		m_indexFile.flush();
+#ifdef Q_OS_WIN
+		_commit( m_file.handle() );
+#else
+		::fsync( m_file.handle() );
+#endif
+	}
+}
+
+
+void ConversationLog::LoadIndex()
+{
+	m_index.clear();
+	//
+	if( !m_indexFile.open( QIODevice::ReadWrite | QIODevice::Text ) )
+	{
+		return;
+	}
+	//
+	const qint64 logSize = m_file.size();
+	while( !m_indexFile.atEnd() )
+	{
+		const QString     line  = QString::fromUtf8( m_indexFile.readLine().constData() ).trimmed();
+		const QStringList parts = line.split( ' ', QString::SkipEmptyParts );
+		if( parts.size() != 2 )
+		{
+			continue;
+		}
+		//
+		const QDate  date   = QDate::fromString( parts[0], DATE_FORMAT );
+		const qint64 offset = parts[1].toLongLong();
+		if( !date.isValid() || offset > logSize )
+		{
+			// The log was truncated or replaced behind our back, so the index
+			// no longer describes it. Start over.
+			//
+			m_index.clear();
+			m_indexFile.resize( 0 );
+			break;
+		}
+		m_index.append( IndexEntry( date, offset ) );
+	}
+	//
+	if( !m_index.isEmpty() )
+	{
+		m_lastDate = m_index.last().first;
+	}
+}
+
+
+void ConversationLog::ScanForDays( const qint64 from )
+{
+	m_file.seek( from );
+	while( !m_file.atEnd() )
+	{
+		const qint64     offset = m_file.pos();
+		const QByteArray line   = m_file.readLine();
+		const QDate      date   = ParseLineDate( line );
+		if( date.isValid() && date != m_lastDate )
+		{
+			AddIndexEntry( date, offset );
+		}
+	}
+	m_indexFile.flush();
+}
+
+
+void ConversationLog::AddIndexEntry( const QDate& date, const qint64 offset )
+{
+	m_lastDate = date;
+	m_index.append( IndexEntry( date, offset ) );
+	//
+	if( m_indexFile.isOpen() )
+	{
+		const QString entry = QString("%1 %2\n").arg(date.toString(DATE_FORMAT)).arg(offset);
+		m_indexFile.seek( m_indexFile.size() );
+		m_indexFile.write( entry.toUtf8() );
+	}
+}
+
+
+qint64 ConversationLog::DayStartBefore( const qint64 offset ) const
+{
+	// Index entries are in file order, so the last one before the offset is
+	// the start of the day the offset falls in.
+	//
+	for( int idx = m_index.size() - 1; idx >= 0; --idx )
+	{
+		if( m_index[idx].second < offset )
+		{
+			return m_index[idx].second;
+		}
+	}
+	return 0;
+}
+
+
+QStringList ConversationLog::ReadLines( const qint64 floor, const qint64 end, const int count, qint64* start, QList<qint64>* offsets )
+{
+	// Read backwards from "end" in chunks until there are enough line breaks
+	// to cover "count" lines, or until we hit the floor.
+	//
+	QByteArray buffer;
+	qint64     pos   = end;
+	int        found = 0;
+	while( pos > floor && found <= count )
+	{
+		const qint64 chunk = qMin<qint64>( READ_CHUNK, pos - floor );
+		pos -= chunk;
+		m_file.seek( pos );
+		const QByteArray block = m_file.read( chunk );
+		found += block.count( '\n' );
+		buffer.prepend( block );
+	}
+	//
+	int lineEnd = buffer.size();
+	if( lineEnd > 0 && buffer[lineEnd-1] == '\n' )
+	{
+		--lineEnd;
+	}
+	//
+	int lineStart = 0;
+	int lines     = 0;
+	for( int idx = lineEnd - 1; idx >= 0; --idx )
+	{
+		if( buffer[idx] == '\n' && ++lines == count )
+		{
+			lineStart = idx + 1;
+			break;
+		}
+	}
+	//
+	*start = pos + lineStart;
+	if( lineStart >= lineEnd )
+	{
+		return QStringList();
+	}
+	//
+	if( offsets )
+	{
+		offsets->append( *start );
+		for( int idx = lineStart; idx < lineEnd; ++idx )
+		{
+			if( buffer[idx] == '\n' )
+			{
+				offsets->append( pos + idx + 1 );
+			}
+		}
+	}
+	//
+	QStringList result = QString::fromUtf8( buffer.mid( lineStart, lineEnd - lineStart ).constData() ).split( '\n' );
+	for( QStringList::iterator it = result.begin(); it != result.end(); ++it )
+	{
+		if( it->endsWith( '\r' ) )
+		{
+			it->chop( 1 );
+		}
+	}
+	return result;
+}
+
+// vim: ts=4 sw=4 noexpandtab syntax=cpp.doxygen
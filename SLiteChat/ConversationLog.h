@@ -0,0 +1,87 @@
+/** 
+ * \brief Append-only conversation log with a per-day offset index.
+ *
+ * Copyright (c) 2009-2010 by R. Douglas Barbieri
+ * 
+ * The source code in this file ("Source Code") is provided by R. Douglas Barbieri
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL").  Terms of the GPL can be found in doc/GPL-license.txt in this distribution.
+ * 
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ * 
+ * ALL SOURCE CODE IN THIS DISTRIBUTION IS PROVIDED "AS IS." THE AUTHOR MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ */
+#ifndef __CONVERSATIONLOG_H__
+#define __CONVERSATIONLOG_H__
+
+#include <QObject>
+#include <QFile>
+#include <QDate>
+#include <QList>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+
+/// Conversation history for one chat tab, kept in "<name>.txt" as one line
+/// per entry (the same format older versions rewrote on exit). Lines are only
+/// ever appended; a small "<name>.idx" file records the byte offset at which
+/// each day starts so that older history can be paged in a day at a time
+/// without reading the whole file. Writes are flushed to disk in batches.
+///
+class ConversationLog
+	: public QObject
+{
+	Q_OBJECT
+	Q_DISABLE_COPY(ConversationLog)
+
+public:
+	explicit ConversationLog( QObject* parent = 0 );
+	virtual ~ConversationLog();
+
+	bool		Open( const QString& path );
+	void		Close();
+	bool		IsOpen() const { return m_file.isOpen(); }
+
+	/// Append one entry. The date is the day the entry belongs to, and starts
+	/// a new index section when it differs from the previous one. Returns the
+	/// offset of the entry, or -1 if the log isn't open.
+	qint64		Append( const QString& line, const QDate& date = QDate::currentDate() );
+
+	/// Last "count" lines of the log. "start" receives the offset of the first
+	/// line returned, to be handed to ReadBefore() for the next page. If given,
+	/// "offsets" receives the offset of each line returned.
+	QStringList	ReadTail( const int count, qint64* start, QList<qint64>* offsets = 0 );
+
+	/// Up to "count" lines ending just before "*offset", never reaching back
+	/// past the start of that day. "*offset" is moved to the first line read.
+	QStringList	ReadBefore( qint64* offset, const int count, QList<qint64>* offsets = 0 );
+
+public slots:
+	void		Sync();
+
+private:
+	typedef QPair<QDate,qint64>	IndexEntry;
+	typedef QList<IndexEntry>	Index;
+
+	QFile		m_file;
+	QFile		m_indexFile;
+	Index		m_index;
+	QDate		m_lastDate;
+	QTimer		m_syncTimer;
+	bool		m_dirty;
+
+	void		LoadIndex();
+	void		ScanForDays( const qint64 from );
+	void		AddIndexEntry( const QDate& date, const qint64 offset );
+	qint64		DayStartBefore( const qint64 offset ) const;
+	QStringList	ReadLines( const qint64 floor, const qint64 end, const int count, qint64* start, QList<qint64>* offsets );
+};
+
+#endif //__CONVERSATIONLOG_H__
+
+// vim: ts=4 sw=4 noexpandtab syntax=cpp.doxygen
@@ -73,6 +73,7 @@ QIcon GetOnlineIcon( const bool online )
 MainWindow::MainWindow( QWidget* parent )
 	: QMainWindow( parent )
 	, m_ui( new Ui_MainWindow )
+	, m_friendIndex(0)
 	, m_localChatWindow(0)
 	, m_netState(NetStateShutdown)
 	, m_timerId(-1)
@@ -98,12 +99,17 @@ MainWindow::MainWindow( QWidget* parent )
 	llmgr.DeclareString( LLC::String(LOCAL_LANGUAGE_CODE), LLC::String(DEFAULT_LLC), LLC::String("Code of local language") );
 	llmgr.DeclareBool  ( LLC::String(GOOGLE_XLATE), DEFAULT_GX, LLC::String("Should we use Google to translate messages") );
 	llmgr.DeclareBool  ( LLC::String(ECHO_SOURCE), DEFAULT_ES, LLC::String("Should source message be displayed") );
+	llmgr.DeclareBool  ( LLC::String(NETWORK_THREAD), DEFAULT_NT, LLC::String("Process network traffic on its own thread") );
 	//
 	llmgr.StartMessagingSystem("SLiteChat", "settings.xml");
 	
 	// Now set up the UI
 	m_ui->setupUi( this );
 	//
+	// Online friends first, then by name
+	//
+	m_friendIndex = new TreeIndex( m_ui->m_friendsList, 0, Qt::DescendingOrder, 1, Qt::AscendingOrder );
+	//
 	m_localChatWindow = m_ui->m_localChatWindow;
 	m_localChatWindow->SetFocus();
 	m_localChatWindow->ConnectTypingSignal	( boost::bind( &MainWindow::OnIMTyping  , this, _1     ) );
@@ -181,6 +187,7 @@ MainWindow::~MainWindow()
 	{
 		killTimer( m_timerId );
 	}
+	ReleasePumpNotifiers();
 	
 	QAction* friendsViewAction = m_ui->m_friendsDock->toggleViewAction();
 	QAction* groupsViewAction  = m_ui->m_groupsDock ->toggleViewAction();
@@ -208,10 +215,10 @@ void MainWindow::ConnectMgrSignals()
 	//
 	LLC::Manager	llmgr;	// Singleton
 	//
-	llmgr.ConnectFriendAddSignal             ( boost::bind( &MainWindow::OnAddFriendSignal             , this, _1 ) );
+	llmgr.ConnectFriendsAddedSignal          ( boost::bind( &MainWindow::OnFriendsAddedSignal          , this, _1 ) );
 	llmgr.ConnectCacheSignal                 ( boost::bind( &MainWindow::OnCacheSignal                 , this, _1, _2, _3 ) );
 	llmgr.ConnectGroupCacheSignal            ( boost::bind( &MainWindow::OnGroupCacheSignal            , this, _1, _2	) );
-	llmgr.ConnectGroupChatAgentUpdateSignal  ( boost::bind( &MainWindow::OnGroupChatAgentUpdateSignal  , this, _1, _2, _3 ) );
+	llmgr.ConnectRosterDeltaSignal           ( boost::bind( &MainWindow::OnRosterDeltaSignal           , this, _1, _2, _3 ) );
 	llmgr.ConnectImSignal                    ( boost::bind( &MainWindow::OnImSignal                    , this, _1, _2, _3, _4, _5, _6 ) );
 	llmgr.ConnectGroupChatSignal             ( boost::bind( &MainWindow::OnGroupChatSignal             , this, _1, _2, _3, _4, _5, _6, _7 ) );
 	llmgr.ConnectLocalChatSignal             ( boost::bind( &MainWindow::OnLocalChatSignal             , this, _1, _2, _3, _4, _5, _6, _7 ) );
@@ -253,6 +260,8 @@ void MainWindow::showEvent( QShowEvent * event )
 void MainWindow::closeEvent( QCloseEvent* event )
 {
 	killTimer( m_timerId );
+	m_timerId = -1;
+	ReleasePumpNotifiers();
 
 	//
 	if( m_netState == NetStateConnected )
@@ -468,6 +477,7 @@ void MainWindow::Logout()
 void MainWindow::timerEvent( QTimerEvent* event )
 {
 	killTimer( m_timerId );
+	m_timerId = -1;
 
 	switch( m_netState )
 	{
@@ -501,6 +511,13 @@ void MainWindow::timerEvent( QTimerEvent* event )
 
 						m_netState = NetStateConnected;
 
+						// From here on signals arrive through PumpMessages() either way
+						//
+						if( llmgr.GetBool( NETWORK_THREAD ) )
+						{
+							llmgr.StartNetworkThread();
+						}
+
 						Common::IsOnline( true );
 					}
 				}
@@ -522,23 +539,7 @@ void MainWindow::timerEvent( QTimerEvent* event )
 		// We are logged in and everything is happy. Process messages.
 		//
 		case NetStateConnected:
-			{
-				LLC::Manager llmgr;
-				if( llmgr.IsOnline() )
-				{
-					llmgr.PumpMessages();
-				}
-				else
-				{
-					// We lost the connection--move to shutdown state
-					//
-					m_netState = NetStateShutdown;
-					//
-					Common::IsOnline( false );
-				}
-				//
-				MessageDialog::PurgeHiddenDialogs();
-			}
+			PumpConnected();
 			break;
 
 		case NetStateShutdown:
@@ -547,13 +548,136 @@ void MainWindow::timerEvent( QTimerEvent* event )
 			break;
 	}
 
-	if( m_netState != NetStateShutdown )
+	RearmPump();
+}
+
+
+void MainWindow::PumpConnected()
+{
+	LLC::Manager llmgr;
+	if( llmgr.IsOnline() )
 	{
-		m_timerId = startTimer( MESSAGE_TIMEOUT_MSECS );
+		llmgr.PumpMessages();
+	}
+	else
+	{
+		// We lost the connection--move to shutdown state
+		//
+		llmgr.StopNetworkThread();
+		m_netState = NetStateShutdown;
+		//
+		Common::IsOnline( false );
+	}
+	//
+	MessageDialog::PurgeHiddenDialogs();
+}
+
+
+void MainWindow::RearmPump()
+{
+	switch( m_netState )
+	{
+		case NetStateLogin:
+			// Login goes through a blocking XML-RPC transfer, so keep polling for the response
+			//
+			m_timerId = startTimer( MESSAGE_TIMEOUT_MSECS );
+			break;
+
+		case NetStateConnected:
+			ArmPumpWakeups();
+			break;
+
+		case NetStateShutdown:
+			ReleasePumpNotifiers();
+			break;
+	}
+}
+
+
+/** \brief Reuse the notifier for fd from oldMap if there is one, else create it.
+ */
+QSocketNotifier* MainWindow::TakeNotifier( NotifierMap& oldMap, NotifierMap& newMap, const int fd, const QSocketNotifier::Type type )
+{
+	QSocketNotifier* notifier = oldMap.take( fd );
+	if( !notifier )
+	{
+		notifier = new QSocketNotifier( fd, type, this );
+		connect( notifier, SIGNAL(activated(int)), this, SLOT(OnPumpSocketActivated(int)) );
+	}
+	notifier->setEnabled( true );
+	newMap[fd] = notifier;
+	return notifier;
+}
+
+
+/** \brief Sleep until LLChatLib has socket traffic or its next deadline comes due.
+ *
+ * The set of sockets changes as HTTP requests come and go, so this is done after every pump.
+ */
+void MainWindow::ArmPumpWakeups()
+{
+	LLC::Manager llmgr;
+
+	std::vector<LLC::Manager::PollFd> fds( 16 );
+	int count = llmgr.GetPollFds( &fds[0], fds.size() );
+	if( count > (int) fds.size() )
+	{
+		fds.resize( count );
+		count = llmgr.GetPollFds( &fds[0], fds.size() );
+	}
+
+	NotifierMap readNotifiers, writeNotifiers;
+	for( int idx = 0; idx < count && idx < (int) fds.size(); ++idx )
+	{
+		if( fds[idx].m_read  ) TakeNotifier( m_readNotifiers,  readNotifiers,  fds[idx].m_fd, QSocketNotifier::Read  );
+		if( fds[idx].m_write ) TakeNotifier( m_writeNotifiers, writeNotifiers, fds[idx].m_fd, QSocketNotifier::Write );
+	}
+
+	// Whatever is left over belongs to sockets that went away
+	//
+	ReleasePumpNotifiers();
+	m_readNotifiers  = readNotifiers;
+	m_writeNotifiers = writeNotifiers;
+
+	m_timerId = startTimer( llmgr.GetNextDeadline() );
+}
+
+
+void MainWindow::ReleasePumpNotifiers()
+{
+	// We may be inside one of their activated() signals, so don't delete them outright
+	//
+	NotifierMap* maps[] = { &m_readNotifiers, &m_writeNotifiers };
+	for( int idx = 0; idx < 2; ++idx )
+	{
+		foreach( QSocketNotifier* notifier, *maps[idx] )
+		{
+			notifier->setEnabled( false );
+			notifier->deleteLater();
+		}
+		maps[idx]->clear();
 	}
 }
 
 
+void MainWindow::OnPumpSocketActivated( int /*socket*/ )
+{
+	if( m_netState != NetStateConnected )
+	{
+		return;
+	}
+
+	if( m_timerId != -1 )
+	{
+		killTimer( m_timerId );
+		m_timerId = -1;
+	}
+
+	PumpConnected();
+	RearmPump();
+}
+
+
 MainWindow::ChatWindowPtr MainWindow::GetIMWindow( const QString& id, const QString& fullName, const bool create, const bool is_group )
 {
 	ChatWindowPtr chatWnd = m_imWindowMap[id];
@@ -1013,16 +1137,11 @@ void MainWindow::OnAddFriendSignal( LLC::String agent_id )
 	
 	// Check to see if we are already in the friends list.
 	//
-	QTreeWidget* friendsList = m_ui->m_friendsList;
-	QTreeWidgetItemIterator it( friendsList );
-	for( ; *it; ++it )
+	if( m_friendIndex->Contains( qAgentId ) )
 	{
-		if( (*it)->data( 0, Qt::UserRole ).toString() == qAgentId )
-		{
-			// Already in list, so just stop here
-			//
-			return;
-		}
+		// Already in list, so just stop here
+		//
+		return;
 	}
 
 	// Save in list
@@ -1043,29 +1162,32 @@ void MainWindow::OnAddFriendSignal( LLC::String agent_id )
 	item->setFont( 0, font );
 	item->setFont( 1, font );
 	item->setData( 0, Qt::UserRole, qAgentId );
-	friendsList->addTopLevelItem( item );
+	m_friendIndex->Add( item );
 }
 
 
-void MainWindow::OnTerminateFrienshipSignal( LLC::String agent_id )
+void MainWindow::OnFriendsAddedSignal( LLC::IdList agent_ids )
 {
-	const QString qAgentId( LS2Q(agent_id.GetString()) );
-	QTreeWidget* friendsList = m_ui->m_friendsList;
-	QTreeWidgetItemIterator it( friendsList );
-	for( ; *it; ++it )
+	// Hold off repainting until the whole list is in; the index sorts it once after
+	//
+	m_ui->m_friendsList->setUpdatesEnabled( false );
+	//
+	char agentId[LLC::IdList::ID_STRING_SIZE];
+	const int count = agent_ids.GetCount();
+	for( int idx = 0; idx < count; ++idx )
 	{
-		if( (*it)->data( 0, Qt::UserRole ).toString() == qAgentId )
-		{
-			const int index = friendsList->indexOfTopLevelItem( *it );
-			delete friendsList->takeTopLevelItem( index );
-			break;
-		}
+		agent_ids.GetId( idx, agentId );
+		OnAddFriendSignal( agentId );
 	}
-
-	// Set sort order
 	//
-	friendsList->sortItems( 1, Qt::AscendingOrder  );
-	friendsList->sortItems( 0, Qt::DescendingOrder );
+	m_ui->m_friendsList->setUpdatesEnabled( true );
+}
+
+
+void MainWindow::OnTerminateFrienshipSignal( LLC::String agent_id )
+{
+	const QString qAgentId( LS2Q(agent_id.GetString()) );
+	m_friendIndex->Remove( qAgentId );
 
 	// Tell user about termination of friendship
 	//
@@ -1093,34 +1215,26 @@ void MainWindow::OnCacheSignal( LLC::String id, LLC::String fullName, bool is_gr
 		//
 		m_ui->m_tabWidget->setTabText( chatWnd->GetPageIndex(), chatWnd->GetFullName() );
 	}
+
+	// Only the rosters that have this resident in them hear about it
+	//
+	ChatWindow::RouteCacheSignal( id, fullName, is_group );
 	
-	// Check to see if we are already in the friends list.
+	// Update the friends list entry, if there is one
 	//
-	QTreeWidget* friendsList = m_ui->m_friendsList;
-	QTreeWidgetItemIterator it( friendsList );
-	for( ; *it; ++it )
+	QTreeWidgetItem* item = m_friendIndex->Edit( qAgentId );
+	if( item )
 	{
-		QTreeWidgetItem* item = *it;
-		if( item->data( 0, Qt::UserRole ).toString() == qAgentId )
-		{
-			// Update list entry
-			//
-			const bool	online	= llmgr.IsOnline( id );
-			//
-			QFont font( item->font(0) );
-			font.setBold( online? true: false );
-			item->setText( 0, (online? tr("Online"): tr("Offline")) );
-			item->setIcon( 0, GetOnlineIcon( online ) );
-			item->setFont( 0, font );
-			//
-			item->setText( 1, LS2Q(fullName) );
-			item->setFont( 1, font );
-
-			// Set sort order
-			//
-			friendsList->sortItems( 1, Qt::AscendingOrder  );
-			friendsList->sortItems( 0, Qt::DescendingOrder );
-		}
+		const bool	online	= llmgr.IsOnline( id );
+		//
+		QFont font( item->font(0) );
+		font.setBold( online? true: false );
+		item->setText( 0, (online? tr("Online"): tr("Offline")) );
+		item->setIcon( 0, GetOnlineIcon( online ) );
+		item->setFont( 0, font );
+		//
+		item->setText( 1, LS2Q(fullName) );
+		item->setFont( 1, font );
 	}
 }
 
@@ -1154,15 +1268,15 @@ void MainWindow::OnGroupCacheSignal( LLC::String id, LLC::String group_name )
 }
 
 
-void MainWindow::OnGroupChatAgentUpdateSignal	( LLC::String session_id
-												, LLC::String agent_id
-												, bool entering
-												)
+void MainWindow::OnRosterDeltaSignal	( LLC::String session_id
+										, LLC::IdList entered
+										, LLC::IdList left
+										)
 {
 	ChatWindowPtr chatWnd = GetIMWindow( LS2Q(session_id), QString(), false /*create*/, true /*is_group*/ );
 	if( chatWnd )
 	{
-		chatWnd->UpdateNamesInChat( LS2Q(agent_id), entering );
+		chatWnd->UpdateRoster( entered, left );
 	}
 }
 
@@ -1393,29 +1507,19 @@ void MainWindow::OnOnlineSignal( LLC::String id, bool online )
 	}
 
 	QString qAgentId = LS2Q(id);
-	QTreeWidget* friendsList = m_ui->m_friendsList;
-	QTreeWidgetItemIterator it( friendsList );
-	bool friend_found = false;
-	for( ; *it; ++it )
+	QTreeWidgetItem* item = m_friendIndex->Edit( qAgentId );
+	if( item )
 	{
-		QTreeWidgetItem* item = *it;
-		if( item->data( 0, Qt::UserRole ).toString() == qAgentId )
-		{
-			item->setText( 0, online? tr("Online"): tr("Offline") );
-			//
-			QFont font( item->font(0) );
-			font.setBold( online? true: false );
-			//
-			item->setIcon( 0, GetOnlineIcon( online ) );
-			item->setFont( 0, font );
-			item->setFont( 1, font );
-			//
-			friend_found = true;
-			break;
-		}
+		item->setText( 0, online? tr("Online"): tr("Offline") );
+		//
+		QFont font( item->font(0) );
+		font.setBold( online? true: false );
+		//
+		item->setIcon( 0, GetOnlineIcon( online ) );
+		item->setFont( 0, font );
+		item->setFont( 1, font );
 	}
-
-	if( !friend_found )
+	else
 	{
 		LLC::Manager mgr;
 
@@ -1423,11 +1527,6 @@ void MainWindow::OnOnlineSignal( LLC::String id, bool online )
 		//
 		OnCacheSignal( id, mgr.GetNameFromCache(id), false );
 	}
-
-	// Set sort order
-	//
-	friendsList->sortItems( 1, Qt::AscendingOrder  );
-	friendsList->sortItems( 0, Qt::DescendingOrder );
 }
 
 
@@ -1499,8 +1598,12 @@ void MainWindow::OnForcedQuitSignal( LLC::String message )
 
 void MainWindow::OnLogoutReplySignal()
 {
+	LLC::Manager llmgr;
+	llmgr.StopNetworkThread();
 	m_netState = NetStateShutdown;
 	killTimer( m_timerId );
+	m_timerId = -1;
+	ReleasePumpNotifiers();
 
 	m_localChatWindow->AddLogEntry( tr("You have been logged out...") );
 
@@ -1531,14 +1634,7 @@ void MainWindow::OnLogoutReplySignal()
 
 	// Clear friends list
 	//
-	QTreeWidget* friendsList = m_ui->m_friendsList;
-	QTreeWidgetItemIterator it( friendsList );
-	for( ; *it; ++it )
-	{
-		const int index = friendsList->indexOfTopLevelItem( *it );
-		delete friendsList->takeTopLevelItem( index );
-	}
-	friendsList->clear();
+	m_friendIndex->Clear();
 
 	// Clear groups list
 	//
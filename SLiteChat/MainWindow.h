@@ -25,6 +25,7 @@
 #include "LLChatLib.h"
 #include "ChatWindow.h"
 #include "LoginWindow.h"
+#include "TreeIndex.h"
 
 #include <QMainWindow>
 #include <QTreeWidgetItem>
@@ -32,6 +33,8 @@
 #include <QShowEvent>
 #include <QCloseEvent>
 #include <QNetworkAccessManager>
+#include <QSocketNotifier>
+#include <QMap>
 
 #include <boost/shared_ptr.hpp>
 
@@ -54,6 +57,7 @@ protected:
 
 private:
 	Ui_MainWindow*	m_ui;
+	TreeIndex*		m_friendIndex;	// Owned by m_ui->m_friendsList
 
 	typedef boost::shared_ptr<ChatWindow> ChatWindowPtr;
 	typedef std::map<QString,ChatWindowPtr> ChatWindowMap;
@@ -79,6 +83,12 @@ private:
 	QNetworkAccessManager	m_networkManager;
 	LoginWindow::LoginInfo	m_loginInfo;
 
+	// Wake the message pump when LLChatLib has traffic, instead of polling
+	//
+	typedef QMap<int,QSocketNotifier*> NotifierMap;
+	NotifierMap	m_readNotifiers;
+	NotifierMap	m_writeNotifiers;
+
 	static bool	m_isOnline;
 
 	// Private methods
@@ -92,6 +102,11 @@ private:
 	void HandleFriendRemoval	( const long index );
 	void DisplayTodoWarning		();
 	void ClearChatTabs			();
+	void PumpConnected			();
+	void RearmPump				();
+	void ArmPumpWakeups			();
+	void ReleasePumpNotifiers	();
+	QSocketNotifier* TakeNotifier( NotifierMap& oldMap, NotifierMap& newMap, const int fd, const QSocketNotifier::Type type );
 
 	void CreateImTab			( const QString& agentId, const QString& fullName = QString() );
 	void CreateGroupTab			( const QString& groupId, const QString& fullName = QString() );
@@ -102,13 +117,14 @@ private:
 	// LLChatLib Signals handlers
 	//
 	void OnAddFriendSignal			( LLC::String id );
+	void OnFriendsAddedSignal		( LLC::IdList ids );
 	void OnTerminateFrienshipSignal	( LLC::String id );
 	void OnCacheSignal				( LLC::String id, LLC::String fullName, bool is_group );
     void OnGroupCacheSignal			( LLC::String id, LLC::String group_name );
-	void OnGroupChatAgentUpdateSignal	( LLC::String session_id
-										, LLC::String agent_id
-										, bool entering
-										);
+	void OnRosterDeltaSignal		( LLC::String session_id
+									, LLC::IdList entered
+									, LLC::IdList left
+									);
 	void OnImSignal					( LLC::String id
 									, LLC::String from
 									, bool has_me
@@ -199,6 +215,10 @@ private slots:
 	// For online update checks
 	//
 	void OnRequestFinished( QNetworkReply* reply );
+
+	// LLChatLib socket activity
+	//
+	void OnPumpSocketActivated( int socket );
 };
 
 #endif //__MAINWINDOW_H__
@@ -0,0 +1,107 @@
+/**
+ * \brief ID index and deferred sorting for the friends and roster lists.
+ *
+ * Copyright (c) 2009-2010 by R. Douglas Barbieri
+ *
+ * The source code in this file ("Source Code") is provided by R. Douglas Barbieri
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL").  Terms of the GPL can be found in doc/GPL-license.txt in this distribution.
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL SOURCE CODE IN THIS DISTRIBUTION IS PROVIDED "AS IS." THE AUTHOR MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ */
+
+#include "TreeIndex.h"
+
+#include <QTimer>
+
+
+TreeIndex::TreeIndex( QTreeWidget* tree
+					, const int firstColumn,  const Qt::SortOrder firstOrder
+					, const int secondColumn, const Qt::SortOrder secondOrder
+					)
+	: QObject( tree )
+	, m_tree( tree )
+	, m_firstColumn( firstColumn )
+	, m_firstOrder( firstOrder )
+	, m_secondColumn( secondColumn )
+	, m_secondOrder( secondOrder )
+	, m_sortPending( false )
+{
+}
+
+
+TreeIndex::~TreeIndex()
+{
+}
+
+
+QTreeWidgetItem* TreeIndex::Edit( const QString& id )
+{
+	QTreeWidgetItem* item = m_items.value( id, 0 );
+	if( item )
+	{
+		ScheduleSort();
+	}
+	return item;
+}
+
+
+void TreeIndex::Add( QTreeWidgetItem* item )
+{
+	ScheduleSort();
+	m_items.insert( item->data( 0, Qt::UserRole ).toString(), item );
+	m_tree->addTopLevelItem( item );
+}
+
+
+bool TreeIndex::Remove( const QString& id )
+{
+	QTreeWidgetItem* item = m_items.take( id );
+	if( !item )
+	{
+		return false;
+	}
+	// Taking an item out leaves the rest in order, so no resort
+	//
+	delete m_tree->takeTopLevelItem( m_tree->indexOfTopLevelItem( item ) );
+	return true;
+}
+
+
+void TreeIndex::Clear()
+{
+	m_items.clear();
+	m_tree->clear();
+}
+
+
+void TreeIndex::ScheduleSort()
+{
+	if( m_sortPending )
+	{
+		return;
+	}
+	m_sortPending = true;
+
+	// With sorting on, the tree would move each item as its text changes
+	//
+	m_tree->setSortingEnabled( false );
+	QTimer::singleShot( 0, this, SLOT(Sort()) );
+}
+
+
+void TreeIndex::Sort()
+{
+	m_sortPending = false;
+	m_tree->setSortingEnabled( true );
+	m_tree->sortItems( m_secondColumn, m_secondOrder );
+	m_tree->sortItems( m_firstColumn,  m_firstOrder  );
+}
+
+// vim: ts=4 sw=4 noexpandtab syntax=cpp.doxygen
@@ -0,0 +1,83 @@
+/**
+ * \brief ID index and deferred sorting for the friends and roster lists.
+ *
+ * Copyright (c) 2009-2010 by R. Douglas Barbieri
+ *
+ * The source code in this file ("Source Code") is provided by R. Douglas Barbieri
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL").  Terms of the GPL can be found in doc/GPL-license.txt in this distribution.
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL SOURCE CODE IN THIS DISTRIBUTION IS PROVIDED "AS IS." THE AUTHOR MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ */
+#ifndef __TREEINDEX_H__
+#define __TREEINDEX_H__
+
+#include <QObject>
+#include <QHash>
+#include <QString>
+#include <QTreeWidget>
+#include <QTreeWidgetItem>
+
+/// Looks up the top-level items of a QTreeWidget by the agent or group ID
+/// they keep in column 0's Qt::UserRole data, instead of walking the tree.
+///
+/// Any change made through the index holds off the tree's own sorting until
+/// control gets back to the event loop, and then sorts once: by the second
+/// key, then by the first. A login that adds a thousand friends, or a busy
+/// group roster filling up, costs one sort rather than one per name.
+///
+class TreeIndex
+	: public QObject
+{
+	Q_OBJECT
+	Q_DISABLE_COPY(TreeIndex)
+
+public:
+	TreeIndex	( QTreeWidget* tree
+				, const int firstColumn,  const Qt::SortOrder firstOrder
+				, const int secondColumn, const Qt::SortOrder secondOrder
+				);
+	virtual ~TreeIndex();
+
+	bool				Contains( const QString& id ) const { return m_items.contains( id ); }
+	int					Count() const { return m_items.count(); }
+	QList<QString>		Ids() const { return m_items.keys(); }
+
+	/// The item for id, or 0. The caller may change it; the tree is resorted later.
+	QTreeWidgetItem*	Edit( const QString& id );
+
+	/// Adds a new item to the tree. Its ID must already be set.
+	void				Add( QTreeWidgetItem* item );
+
+	/// Removes and deletes the item for id, if there is one.
+	bool				Remove( const QString& id );
+
+	/// Removes and deletes every item.
+	void				Clear();
+
+private slots:
+	void				Sort();
+
+private:
+	typedef QHash<QString,QTreeWidgetItem*>	ItemHash;
+
+	QTreeWidget*	m_tree;
+	ItemHash		m_items;
+	int				m_firstColumn;
+	Qt::SortOrder	m_firstOrder;
+	int				m_secondColumn;
+	Qt::SortOrder	m_secondOrder;
+	bool			m_sortPending;
+
+	void				ScheduleSort();
+};
+
+#endif // __TREEINDEX_H__
+
+// vim: ts=4 sw=4 noexpandtab syntax=cpp.doxygen
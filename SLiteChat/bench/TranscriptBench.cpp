@@ -0,0 +1,213 @@
+/**
+ * \brief Frame time and memory of the chat transcript with 100k lines
+ *
+ * Copyright (c) 2009-2010 by R. Douglas Barbieri
+ *
+ * The source code in this file ("Source Code") is provided by R. Douglas Barbieri
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL").  Terms of the GPL can be found in doc/GPL-license.txt in this distribution.
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL SOURCE CODE IN THIS DISTRIBUTION IS PROVIDED "AS IS." THE AUTHOR MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ */
+
+#include "ChatTranscript.h"
+
+// Qt4
+//
+#include <QApplication>
+#include <QScrollBar>
+#include <QTextBrowser>
+#include <QTime>
+
+// stdc++
+//
+#include <cstdio>
+#include <cstring>
+
+#if defined(__linux__)
+#	include <unistd.h>
+#endif
+
+
+namespace
+{
+
+const int LINE_COUNT	= 100000;
+const int APPEND_BATCH	= 50;		// Lines that arrive between two repaints
+const int SCROLL_FRAMES	= 2000;
+const int VIEW_WIDTH	= 600;
+const int VIEW_HEIGHT	= 800;
+
+/// Resident set size in KiB, or -1 where it can't be read
+///
+long ResidentKb()
+{
+#if defined(__linux__)
+	FILE* statm = fopen( "/proc/self/statm", "r" );
+	if( !statm )
+	{
+		return -1;
+	}
+	long size = 0;
+	long resident = 0;
+	const int read = fscanf( statm, "%ld %ld", &size, &resident );
+	fclose( statm );
+	return (read == 2)? resident * (sysconf( _SC_PAGESIZE ) / 1024): -1;
+#else
+	return -1;
+#endif
+}
+
+/// What ChatWindow::AddText() produces: a time stamp, a linked name and some text
+///
+QString MakeLine( const int idx )
+{
+	return QString("[%1:%2] <a href=\"secondlife:///app/agent/%3/about\"><b>Resident %3</b></a>: "
+				   "line %4 of the scripted chat, with <i>a little</i> formatting and enough "
+				   "words to wrap at least once in a window of the usual width")
+		.arg( (idx / 60) % 24, 2, 10, QChar('0') )
+		.arg( idx % 60, 2, 10, QChar('0') )
+		.arg( idx % 37 )
+		.arg( idx );
+}
+
+void Report( const char* what, const double value, const char* unit )
+{
+	printf( "%-12s %-40s %12.3f %s\n", "transcript", what, value, unit );
+	fflush( stdout );
+}
+
+void ReportMemory( const char* what, const long baseKb )
+{
+	const long rss = ResidentKb();
+	if( rss >= 0 && baseKb >= 0 )
+	{
+		Report( what, (rss - baseKb) / 1024.0, "MiB" );
+	}
+}
+
+/// Appends LINE_COUNT lines while following the bottom, then scrolls back
+/// up a page at a time, painting every frame.
+///
+void RunTranscript()
+{
+	const long baseKb = ResidentKb();
+	ChatTranscriptView view;
+	view.resize( VIEW_WIDTH, VIEW_HEIGHT );
+	view.show();
+	qApp->processEvents();
+	//
+	QTime timer;
+	int worst = 0;
+	timer.start();
+	for( int idx = 0; idx < LINE_COUNT; )
+	{
+		QTime frame;
+		frame.start();
+		for( int end = idx + APPEND_BATCH; idx < end; ++idx )
+		{
+			view.AppendLine( MakeLine( idx ), idx );
+		}
+		view.ScrollToEnd();
+		view.viewport()->repaint();
+		worst = qMax( worst, frame.elapsed() );
+	}
+	const int appendMs = timer.elapsed();
+	//
+	Report( "view, append per line", appendMs * 1000.0 / LINE_COUNT, "us" );
+	Report( "view, worst append frame", worst, "ms" );
+	Report( "view, rows kept", view.model()->rowCount(), "rows" );
+	ReportMemory( "view, RSS growth after append", baseKb );
+	//
+	QScrollBar* bar = view.verticalScrollBar();
+	const int page = qMax( 1, bar->pageStep() );
+	worst = 0;
+	timer.start();
+	for( int step = 0; step < SCROLL_FRAMES; ++step )
+	{
+		QTime frame;
+		frame.start();
+		bar->setValue( bar->maximum() - (step * page) % (bar->maximum() + 1) );
+		view.viewport()->repaint();
+		worst = qMax( worst, frame.elapsed() );
+	}
+	Report( "view, scroll frame", (double)timer.elapsed() / SCROLL_FRAMES, "ms" );
+	Report( "view, worst scroll frame", worst, "ms" );
+	ReportMemory( "view, RSS growth after scroll", baseKb );
+}
+
+/// The QTextBrowser the transcript replaced, for comparison. It slows down
+/// as the document grows, so it is only run when asked for.
+///
+void RunTextBrowser()
+{
+	const long baseKb = ResidentKb();
+	QTextBrowser browser;
+	browser.resize( VIEW_WIDTH, VIEW_HEIGHT );
+	browser.show();
+	qApp->processEvents();
+	//
+	QTime timer;
+	int worst = 0;
+	timer.start();
+	for( int idx = 0; idx < LINE_COUNT; )
+	{
+		QTime frame;
+		frame.start();
+		for( int end = idx + APPEND_BATCH; idx < end; ++idx )
+		{
+			browser.append( MakeLine( idx ) );
+		}
+		browser.viewport()->repaint();
+		worst = qMax( worst, frame.elapsed() );
+	}
+	Report( "textbrowser, append per line", timer.elapsed() * 1000.0 / LINE_COUNT, "us" );
+	Report( "textbrowser, worst append frame", worst, "ms" );
+	ReportMemory( "textbrowser, RSS growth after append", baseKb );
+	//
+	QScrollBar* bar = browser.verticalScrollBar();
+	const int page = qMax( 1, bar->pageStep() );
+	worst = 0;
+	timer.start();
+	for( int step = 0; step < SCROLL_FRAMES; ++step )
+	{
+		QTime frame;
+		frame.start();
+		bar->setValue( bar->maximum() - (step * page) % (bar->maximum() + 1) );
+		browser.viewport()->repaint();
+		worst = qMax( worst, frame.elapsed() );
+	}
+	Report( "textbrowser, scroll frame", (double)timer.elapsed() / SCROLL_FRAMES, "ms" );
+	Report( "textbrowser, worst scroll frame", worst, "ms" );
+}
+
+}
+// namespace
+
+
+int main( int argc, char* argv[] )
+{
+	QApplication app( argc, argv );
+	//
+	const bool baseline = (argc > 1 && !strcmp( argv[1], "--textbrowser" ));
+	if( argc > 1 && !baseline )
+	{
+		fprintf( stderr, "Usage: %s [--textbrowser]\n", argv[0] );
+		return 1;
+	}
+	//
+	RunTranscript();
+	if( baseline )
+	{
+		RunTextBrowser();
+	}
+	return 0;
+}
+
+// vim: ts=4 sw=4 noexpandtab syntax=cpp.doxygen
@@ -21,26 +21,26 @@
 #include "errors.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <fcntl.h>
 #if (LL_DARWIN or LL_LINUX)
 #	include <arpa/inet.h>
+#	include <sys/socket.h>
 #endif
 
 #include <boost/bind.hpp>
 
-// Static message buffer
-char Robot::buffer[BUFFLEN];
+// Most datagrams handled per wake-up, so a flood can't starve the grid side
+#define RECEIVE_BATCH 32
 
 
 // Constructor
 Robot::Robot(
 	const LLC::String &bot_owner,
-	const LLC::String &bot_group,
 	const LLC::String &bot_prefix,
 	const LLC::String &bot_ignore)
   : owner(bot_owner.GetString()),
-	group(bot_group.GetString()),
 	prefix(bot_prefix.GetString()),
 	ignore(bot_ignore.GetString())
 {
@@ -59,8 +59,7 @@ Robot::Robot(
 
 	// By default, we use no socket and talk to nobody
 	my_socket = -1;
-	for (bool *p = client; p < client + NUMCLIENTS; p++)
-		*p = false;
+	clients = 0;
 
 	// We're not online yet
 	online = false;
@@ -150,12 +149,95 @@ int Robot::prepareSend(
 	}
 
 	// Register the client
-	client[num] = true;
+	clients |= 1u << num;
+	client_index[clientKey(*p)] = num;
 
 	return 0;
 }
 
 
+// Declare a group to bridge and the robots to exchange its chat with.
+// The peers are given as a comma-separated list of client numbers
+// (1 to NUMCLIENTS), or as an empty string for all of them.
+// Returns 0 if OK
+int Robot::addRoute(
+	const LLC::String &group_id,
+	const LLC::String &tag,
+	const LLC::String &peers)
+{
+	const char	*grp = group_id.GetString(),
+				*tg = tag.GetString(),
+				*p = peers.GetString();
+
+	// Return if nothing to do
+	if (!*grp || !strcmp(grp, "00000000-0000-0000-0000-000000000000"))
+		return 0;
+
+	// The tag is terminated by a colon on the wire
+	if (strchr(tg, ':'))
+	{
+		printf("Invalid group tag \"%s\"\n", tg);
+		return -1;
+	}
+	if (route_by_group.count(grp) || route_by_tag.count(tg))
+	{
+		printf("Group \"%s\" or tag \"%s\" mapped twice\n", grp, tg);
+		return -2;
+	}
+
+	Route route;
+	route.group = grp;
+	route.tag = tg;
+	route.peers = *p? 0: ALL_PEERS;
+	while (*p)
+	{
+		char *end;
+		long num = strtol(p, &end, 10);
+		if (end == p || num < 1 || num > NUMCLIENTS)
+		{
+			printf("Invalid peer list \"%s\"\n", peers.GetString());
+			return -3;
+		}
+		route.peers |= 1u << (num - 1);
+		for (p = end; *p == ',' || *p == ' '; p++)
+			;
+	}
+
+	route_by_group[route.group] = routes.size();
+	route_by_tag[route.tag] = routes.size();
+	routes.push_back(route);
+
+	return 0;
+}
+
+
+// Join the chat sessions of all bridged groups
+void Robot::joinGroups() const
+{
+	LLC::Manager llmgr;
+
+	for (std::vector<Route>::const_iterator it = routes.begin(); it != routes.end(); ++it)
+		llmgr.SendGroupChatStartRequest(LLC::String(it->group.c_str()));
+}
+
+
+// Leave the chat sessions of all bridged groups
+void Robot::leaveGroups() const
+{
+	LLC::Manager llmgr;
+
+	for (std::vector<Route>::const_iterator it = routes.begin(); it != routes.end(); ++it)
+		llmgr.SendGroupChatLeaveRequest(LLC::String(it->group.c_str()));
+}
+
+
+// Lookup key for a robot's address
+unsigned long long Robot::clientKey(const struct sockaddr_in &addr)
+{
+	return ((unsigned long long) addr.sin_addr.s_addr << 16) | addr.sin_port;
+}
+
+
 // Blocking inworld authentication routine
 // Returns 0 on success
 int Robot::authenticate(
@@ -200,57 +282,77 @@ void Robot::listenPort() const
 	if (my_socket == -1)
 		return;
 
-	// Get message from other bot
-	int length;
-	struct sockaddr_in si_other;
-	socklen_t other_length = sizeof(struct sockaddr_in);
-
-	length = recvfrom(
-		my_socket,
-		buffer,
-		BUFFLEN,
-		0,
-		(struct sockaddr *) &si_other,
-		&other_length);
-
-	// Return if nothing (length = -1) or
-	// empty message (length = 0) received
-	if (length <= 0)
-		return;
-
-	// Security: check that the data comes from one of the other robots
-	int num;
-	for (num = 0; num < NUMCLIENTS; num++)
+	// Drain what the other bots sent since the last wake-up
+	for (int received = 0; received < RECEIVE_BATCH; received++)
 	{
-		if (client[num])
+		char buffer[BUFFLEN];
+		int length;
+		struct sockaddr_in si_other;
+		socklen_t other_length = sizeof(struct sockaddr_in);
+
+		length = recvfrom(
+			my_socket,
+			buffer,
+			BUFFLEN,
+			0,
+			(struct sockaddr *) &si_other,
+			&other_length);
+
+		// Return if nothing (length = -1) or
+		// empty message (length = 0) received
+		if (length <= 0)
+			return;
+
+		// Security: ensure the buffer is NUL-terminated
+		if (length >= BUFFLEN)
+			length = BUFFLEN - 1;
+		buffer[length] = '\0';
+
+		// Security: check that the data comes from one of the other robots
+		ClientMap::const_iterator client = client_index.find(clientKey(si_other));
+		if (client == client_index.end())
 		{
-			if (si_client[num].sin_addr.s_addr == si_other.sin_addr.s_addr &&
-                si_client[num].sin_port        == si_other.sin_port)
-				break;
+			printf("Received data from an unknown source: \"%s\"\n", buffer);
+			continue;
 		}
-	}
-	if (num == NUMCLIENTS)
-	{
-		printf("Received data from an unknown source: \"%s\"\n", buffer);
-		return;
-	}
-
-	// Security: ensure the buffer is NUL-terminated
-	if (length >= BUFFLEN)
-		length = BUFFLEN - 1;
-	buffer[length] = '\0';
+		int num = client->second;
 
-	// Analyze data received
-	switch (*buffer)
-	{
-		case 'D':
-			dataReceived(num, buffer + 1, length - 1);
-			break;
-		case 'C':
-			commandReceived(num, buffer + 1, length - 1);
-			break;
-		default:
-			printf("Received invalid data: \"%s\"\n", buffer);
+		// Analyze data received
+		RouteMap::const_iterator route;
+		const char *text;
+		switch (*buffer)
+		{
+			case 'D':
+				route = route_by_tag.find(std::string());
+				if (route == route_by_tag.end())
+				{
+					printf("Received data for no group: \"%s\"\n", buffer);
+					break;
+				}
+				dataReceived(num, routes[route->second], buffer + 1, length - 1);
+				break;
+			case 'G':
+				text = strchr(buffer + 1, ':');
+				if (!text)
+				{
+					printf("Received invalid data: \"%s\"\n", buffer);
+					break;
+				}
+				route = route_by_tag.find(std::string(buffer + 1, text - buffer - 1));
+				if (route == route_by_tag.end())
+				{
+					printf("Received data for an unknown group: \"%s\"\n", buffer);
+					break;
+				}
+				text++;
+				dataReceived(num, routes[route->second], text, length - (text - buffer));
+				break;
+			case 'C':
+				commandReceived(num, buffer + 1, length - 1);
+				break;
+			default:
+				printf("Received invalid data: \"%s\"\n", buffer);
+		}
 	}
 }
 
@@ -274,8 +376,8 @@ void Robot::imSlot(
 	if (!strcmp(msg, "Ping"))
 	{
 		// Ping other robots
-		snprintf(buffer, BUFFLEN, "CPing");
-		sendMessage();
+		static const char ping[] = "CPing";
+		sendMessage(clients, ping, sizeof(ping));
 
 		// Pong owner
 		if (online)
@@ -304,20 +406,33 @@ void Robot::groupChatSlot(
 				*pre = prefix.GetString(),
 				*ign = ignore.GetString();
 
+	// Only bridged groups are forwarded
+	RouteMap::const_iterator found = route_by_group.find(group_id.GetString());
+	if (found == route_by_group.end())
+		return;
+	const Route &route = routes[found->second];
+
 	// Prevent retroaction (grid A forwards to grid B
 	// which forwards to grid A which...)
 	if (!strcmp(frm, ign))
 		return;
 
 	// Format message before transmission
-	snprintf(
-		buffer, BUFFLEN,
-		has_me? "D%s%s%s": "D%s%s: %s",
-		pre, frm, msg);
+	char buffer[BUFFLEN];
+	if (route.tag.empty())
+		snprintf(
+			buffer, BUFFLEN,
+			has_me? "D%s%s%s": "D%s%s: %s",
+			pre, frm, msg);
+	else
+		snprintf(
+			buffer, BUFFLEN,
+			has_me? "G%s:%s%s%s": "G%s:%s%s: %s",
+			route.tag.c_str(), pre, frm, msg);
 	buffer[BUFFLEN - 1] = '\0';
 
-	// Send message to other robots
-	sendMessage();
+	// Send message to the robots bridging that group
+	sendMessage(route.peers, buffer, strlen(buffer) + 1);
 }
 
 
@@ -356,35 +471,76 @@ void Robot::messageBoxSlot(LLC::String message) const
 }
 
 
-// Send message to other robots
-void Robot::sendMessage() const
+// Send message to a set of other robots
+void Robot::sendMessage(PeerSet peers, const char *data, int length) const
 {
-	int len = strlen(buffer) + 1;
+	if (my_socket == -1)
+		return;
+	peers &= clients;
+
+	int skip = 0;
+#if LL_LINUX
+	// Fan out to all robots with a single system call
+	struct mmsghdr msgs[NUMCLIENTS];
+	struct iovec iov;
+	int count = 0;
+
+	iov.iov_base = (void *) data;
+	iov.iov_len = length;
+	memset(msgs, 0, sizeof(msgs));
 	for (int num = 0; num < NUMCLIENTS; num++)
-		sendMessage(num, len);
-}
-
+	{
+		if (!(peers & (1u << num)))
+			continue;
+		msgs[count].msg_hdr.msg_name = (void *) (si_client + num);
+		msgs[count].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+		msgs[count].msg_hdr.msg_iov = &iov;
+		msgs[count].msg_hdr.msg_iovlen = 1;
+		count++;
+	}
+	if (!count)
+		return;
 
-// Send message to another robot
-void Robot::sendMessage(int other, int length) const
-{
-	if (my_socket == -1 || !client[other])
+	int sent = sendmmsg(my_socket, msgs, count, 0);
+	if (sent == count)
 		return;
+	// Whatever wasn't sent (or everything, if sendmmsg() is not
+	// available) goes out one robot at a time
+	if (sent > 0)
+		skip = sent;
+#endif
 
-	if (sendto(
-		my_socket,
-		buffer,
-	    length,
-		0,
-		(struct sockaddr *) (si_client + other),
-		sizeof(struct sockaddr_in)) == -1)
-			printf("UDP emission error: \"%s\"\n", buffer);
+	for (int num = 0; num < NUMCLIENTS; num++)
+	{
+		if (!(peers & (1u << num)))
+			continue;
+		if (skip)
+		{
+			skip--;
+			continue;
+		}
+		if (sendto(
+			my_socket,
+			data,
+			length,
+			0,
+			(struct sockaddr *) (si_client + num),
+			sizeof(struct sockaddr_in)) == -1)
+				printf("UDP emission error: \"%s\"\n", data);
+	}
 }
 
 
 // Data has been received from another robot
-void Robot::dataReceived(int other, const char *data, int length) const
+void Robot::dataReceived(int other, const Route &route, const char *data, int length) const
 {
+	// Security: the robot must be one that bridges that group
+	if (!(route.peers & (1u << other)))
+	{
+		printf("Received data for a group not bridged with that robot: \"%s\"\n", data);
+		return;
+	}
+
 	if (!length)
 	{
 		printf("Received empty message: \"%s\"\n", data);
@@ -395,7 +551,7 @@ void Robot::dataReceived(int other, const char *data, int length) const
 	LLC::Manager llmgr;
 
 	llmgr.SendInstantMessage(
-		group,
+		LLC::String(route.group.c_str()),
 		LLC::String(data),
 		true);
 }
@@ -427,6 +583,7 @@ void Robot::commandReceived(int other, const char *command, int length) const
 // Anwser a ping from another robot
 void Robot::pongRobot(int other) const
 {
+	char buffer[BUFFLEN];
 	int length;
 
 	snprintf(buffer, BUFFLEN, "CPong %s(xgridchat version %d.%d.%d)",
@@ -434,7 +591,7 @@ void Robot::pongRobot(int other) const
 	    xgridchat_VERSION_MAJOR, xgridchat_VERSION_MINOR, xgridchat_VERSION_PATCH);
 	length = strlen(buffer) + 1;
 
-	sendMessage(other, length);
+	sendMessage(1u << other, buffer, length);
 }
 
 
@@ -442,6 +599,7 @@ void Robot::pongRobot(int other) const
 void Robot::pongOwner() const
 {
 	LLC::Manager llmgr;
+	char buffer[BUFFLEN];
 
 	snprintf(buffer, BUFFLEN, "Pong %s(xgridchat version %d.%d.%d)",
 		prefix.GetString(),
@@ -23,6 +23,10 @@
 
 #include "config.h"
 
+#include <map>
+#include <string>
+#include <vector>
+
 #if (LL_DARWIN or LL_LINUX)
 #	include <netinet/in.h>
 #endif
@@ -37,19 +41,26 @@
 #define BUFFLEN 1024
 
 // Maximum number of other robots
-#define NUMCLIENTS 4
+#define NUMCLIENTS 16
+
+// Maximum number of extra group mappings (BotGroup1 ... BotGroupN)
+#define NUMGROUPS 8
+
+// Set of other robots, one bit per client number
+typedef unsigned int PeerSet;
+#define ALL_PEERS ((PeerSet) ((1u << NUMCLIENTS) - 1))
 
 class Robot
 {
 public:
 	Robot(
 		const LLC::String &bot_owner,
-		const LLC::String &bot_group,
 		const LLC::String &bot_prefix,
 		const LLC::String &bot_ignore);
 	~Robot();
 
 	inline bool isOnline() const { return online; }
+	inline int getSocket() const { return my_socket; }
 
 	int prepareListen(
 		const LLC::String &listenAddress,
@@ -58,6 +69,12 @@ public:
 		int num,
 		const LLC::String &sendAddress,
 		unsigned int sendPort);
+	int addRoute(
+		const LLC::String &group_id,
+		const LLC::String &tag,
+		const LLC::String &peers);
+	void joinGroups() const;
+	void leaveGroups() const;
 	int authenticate(
 		const LLC::String &grid,
 		const LLC::String &first,
@@ -89,19 +106,34 @@ public:
 		LLC::String message) const;
 
 private:
-	void sendMessage() const;
-	void sendMessage(int other, int length) const;
-	void dataReceived(int other, const char *data, int length) const;
+	// One inworld group and the robots its chat is exchanged with.
+	// Robots on other grids know the group by its tag, as the group
+	// UUID differs from grid to grid. The route read from the legacy
+	// BotGroup setting has an empty tag and uses 'D' packets.
+	struct Route
+	{
+		std::string group;
+		std::string tag;
+		PeerSet peers;
+	};
+	typedef std::map<std::string, int> RouteMap;
+	typedef std::map<unsigned long long, int> ClientMap;
+
+	void sendMessage(PeerSet peers, const char *data, int length) const;
+	void dataReceived(int other, const Route &route, const char *data, int length) const;
 	void commandReceived(int other, const char *command, int length) const;
 	void pongRobot(int other) const;
 	void pongOwner() const;
 
-	static char buffer[BUFFLEN];
+	static unsigned long long clientKey(const struct sockaddr_in &addr);
 
-	LLC::String owner, group, prefix, ignore;
+	LLC::String owner, prefix, ignore;
 	int my_socket;
-	bool client[NUMCLIENTS];
+	PeerSet clients;
 	struct sockaddr_in si_client[NUMCLIENTS];
+	ClientMap client_index;
+	std::vector<Route> routes;
+	RouteMap route_by_group, route_by_tag;
 	bool online;
 };
 
@@ -4,3 +4,4 @@
 #define UDP_ERROR -2
 #define LOGIN_ERROR -3
 #define UNCLEAN_SHUTDOWN -4
+#define CONFIG_ERROR -5
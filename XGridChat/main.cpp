@@ -25,6 +25,7 @@
 #	include <unistd.h>
 #endif
 #include <signal.h>
+#include <boost/bind.hpp>
 #if defined(HAVE_WINDOWS_H)
 #include <windows.h>
 #endif
@@ -89,6 +90,18 @@ void declare_settings()
 		sprintf(comment, "Client UDP port %d", num + 1);
 		llmgr.DeclareUInt(LLC::String(name), 0, LLC::String(comment));
 	}
+	for (int num = 0; num < NUMGROUPS; num++)
+	{
+		sprintf(name, "BotGroup%d", num + 1);
+		sprintf(comment, "UUID of bridged group %d", num + 1);
+		llmgr.DeclareString(LLC::String(name), LLC::String(), LLC::String(comment));
+		sprintf(name, "BotGroupTag%d", num + 1);
+		sprintf(comment, "Name of bridged group %d between robots", num + 1);
+		llmgr.DeclareString(LLC::String(name), LLC::String(), LLC::String(comment));
+		sprintf(name, "BotGroupPeers%d", num + 1);
+		sprintf(comment, "Clients bridging group %d, e.g. \"1,3\"", num + 1);
+		llmgr.DeclareString(LLC::String(name), LLC::String(), LLC::String(comment));
+	}
 }
 
 
@@ -119,6 +132,43 @@ int initialize_network(Robot *bot)
 }
 
 
+// Build the table of bridged groups
+// Returns 0 if okay
+int initialize_routes(Robot *bot)
+{
+	LLC::Manager llmgr;
+
+	// The single group of older settings files talks to all other bots
+	if (bot->addRoute(
+		llmgr.GetString("BotGroup"),
+		LLC::String(),
+		LLC::String() ))
+			return -1;
+
+	char group[40], tag[40], peers[40];
+	for (int num = 0; num < NUMGROUPS; num++)
+	{
+		sprintf(group, "BotGroup%d", num + 1);
+		sprintf(tag, "BotGroupTag%d", num + 1);
+		sprintf(peers, "BotGroupPeers%d", num + 1);
+		if (!*llmgr.GetString(group).GetString())
+			continue;
+		if (!*llmgr.GetString(tag).GetString())
+		{
+			printf("%s has no %s\n", group, tag);
+			return -2;
+		}
+		if (bot->addRoute(
+			llmgr.GetString(group),
+			llmgr.GetString(tag),
+			llmgr.GetString(peers) ))
+				return -3;
+	}
+
+	return 0;
+}
+
+
 // Logout signal handler
 void signal_logout(int sig)
 {
@@ -152,13 +202,15 @@ int main(int argc, char *argv[])
 
 	Robot bot(
 		llmgr.GetString("BotOwner"),
-		llmgr.GetString("BotGroup"),
 		llmgr.GetString("BotPrefix"),
 		llmgr.GetString("BotIgnore") );
 
 	if (initialize_network(&bot))
 		return UDP_ERROR;
 
+	if (initialize_routes(&bot))
+		return CONFIG_ERROR;
+
 	if (bot.authenticate(
 		llmgr.GetString("BotGrid"),
 		llmgr.GetString("BotFirst"),
@@ -168,24 +220,19 @@ int main(int argc, char *argv[])
 			return LOGIN_ERROR;
 
 	llmgr.AnnounceInSim();
-	llmgr.SendGroupChatStartRequest(llmgr.GetString("BotGroup"));
+	bot.joinGroups();
 
 	signal(SIGINT, signal_logout);
 
-	while (bot.isOnline())
-	{
-#define SLEEP_VALUE 10000L
-#ifdef LL_WINDOWS
-		::Sleep(SLEEP_VALUE);
-#else
-		usleep(SLEEP_VALUE);
-#endif
-		bot.listenPort();
-		llmgr.PumpMessages();
-	}
+	// Sleep until the grid or one of the other bots has something for us
+	if (bot.getSocket() != -1)
+		llmgr.WatchFd(bot.getSocket(), boost::bind(&Robot::listenPort, &bot));
+	llmgr.RunUntil(!boost::bind(&Robot::isOnline, &bot));
+	if (bot.getSocket() != -1)
+		llmgr.UnwatchFd(bot.getSocket());
 
 	printf("Leaving...\n");
-	llmgr.SendGroupChatLeaveRequest(llmgr.GetString("BotGroup"));
+	bot.leaveGroups();
 	llmgr.Shutdown();
 
 	return 0;